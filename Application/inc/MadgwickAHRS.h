@@ -0,0 +1,36 @@
+//=====================================================================================================
+// MadgwickAHRS.h
+//=====================================================================================================
+//
+// Implementation of Madgwick's IMU and AHRS algorithms.
+// See: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
+//
+// Date			Author          Notes
+// 29/09/2011	SOH Madgwick    Initial release
+// 02/10/2011	SOH Madgwick	Optimised for reduced CPU load
+//
+//=====================================================================================================
+#ifndef MadgwickAHRS_h
+#define MadgwickAHRS_h
+
+//----------------------------------------------------------------------------------------------------
+// Type declaration
+
+typedef struct {
+	float beta;									// algorithm gain
+	float q0, q1, q2, q3;						// quaternion of sensor frame relative to auxiliary frame
+} MadgwickAHRS_t;
+
+#define MADGWICK_AHRS_INITIALISER(beta)	{ (beta), 1.0f, 0.0f, 0.0f, 0.0f }
+
+//---------------------------------------------------------------------------------------------------
+// Function declarations
+
+void MadgwickAHRSinit(MadgwickAHRS_t *ahrs, float beta);
+void MadgwickAHRSupdateInstance(MadgwickAHRS_t *ahrs, float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
+void MadgwickAHRSupdateIMUInstance(MadgwickAHRS_t *ahrs, float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+#endif
+//=====================================================================================================
+// End of file
+//=====================================================================================================
@@ -14,17 +14,41 @@
 #define MahonyAHRS_h
 
 //----------------------------------------------------------------------------------------------------
-// Variable declaration
+// Type declaration
 
-extern volatile float twoKp;			// 2 * proportional gain (Kp)
-extern volatile float twoKi;			// 2 * integral gain (Ki)
-extern volatile float q0, q1, q2, q3;	// quaternion of sensor frame relative to auxiliary frame
+typedef struct {
+	float twoKp;								// 2 * proportional gain (Kp)
+	float twoKi;								// 2 * integral gain (Ki)
+	float q0, q1, q2, q3;						// quaternion of sensor frame relative to auxiliary frame
+	float integralFBx, integralFBy, integralFBz;	// integral error terms scaled by Ki
+} MahonyAHRS_t;
+
+typedef struct {
+	float gx, gy, gz;							// gyroscope in rad/s
+	float ax, ay, az;							// accelerometer, any unit
+	float dt;									// interval since previous sample in seconds
+} MahonyAHRSsample_t;
+
+typedef struct {
+	float q0, q1, q2, q3;
+} MahonyAHRSquaternion_t;
+
+#define MAHONY_AHRS_INITIALISER(twoKp, twoKi)	{ (twoKp), (twoKi), 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }
 
 //---------------------------------------------------------------------------------------------------
 // Function declarations
 
+void MahonyAHRSinit(MahonyAHRS_t *ahrs, float twoKp, float twoKi);
+void MahonyAHRSupdateInstance(MahonyAHRS_t *ahrs, float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
+void MahonyAHRSupdateIMUInstance(MahonyAHRS_t *ahrs, float gx, float gy, float gz, float ax, float ay, float az, float dt);
+void MahonyAHRSupdateBatch(MahonyAHRS_t *ahrs, const MahonyAHRSsample_t *samples, unsigned int count, MahonyAHRSquaternion_t *outputs);
+void printQuaternionInstance (const MahonyAHRS_t *ahrs);
+
+// Legacy single-instance API
 void MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz);
 void MahonyAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az);
+void MahonyAHRSupdateDt(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
+void MahonyAHRSupdateIMUDt(float gx, float gy, float gz, float ax, float ay, float az, float dt);
 void printQuaternion (void);
 
 #endif
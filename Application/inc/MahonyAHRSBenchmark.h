@@ -0,0 +1,28 @@
+//=====================================================================================================
+// MahonyAHRSBenchmark.h
+//=====================================================================================================
+//
+// Reference copy of MahonyAHRS.c as it was before the instance API (state in volatile globals,
+// bit-hack inverse square-root), kept only to measure the current filter against it on the same
+// stream, on target with GetCycleCount and on host in Tests/test_mahony_instances.c. The benchmark
+// also times MahonyAHRSupdateBatch against single IMU updates, see Tests/test_mahony_batch.c.
+//
+//=====================================================================================================
+#ifndef MahonyAHRSBenchmark_h
+#define MahonyAHRSBenchmark_h
+
+#include "MahonyAHRS.h"
+
+//---------------------------------------------------------------------------------------------------
+// Function declarations
+
+void MahonyAHRSBaselineInit(float twoKpInit, float twoKiInit);
+void MahonyAHRSBaselineUpdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
+void MahonyAHRSBaselineUpdateIMU(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+void MahonyAHRSBaselineGet(MahonyAHRSquaternion_t *q);
+void MahonyBenchmark_Run(void);
+
+#endif
+//=====================================================================================================
+// End of file
+//=====================================================================================================
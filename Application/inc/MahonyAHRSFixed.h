@@ -0,0 +1,49 @@
+//=====================================================================================================
+// MahonyAHRSFixed.h
+//=====================================================================================================
+//
+// Fixed-point port of Madgwick's implementation of Mayhony's AHRS algorithm (see MahonyAHRS.h)
+// for targets without FPU. Results are bit-identical on every platform: target uses Cortex-M4
+// DSP instructions, other builds the same arithmetic in portable C.
+//
+// Formats:
+//	quaternion						Q1.30
+//	gyroscope						Q16.16 rad/s
+//	integral feedback				Q8.24 rad/s
+//	accelerometer, magnetometer		any scale, e.g. raw sensor counts
+//	gains							Q16.16
+//	dt								Q1.30 seconds
+//
+//=====================================================================================================
+#ifndef MahonyAHRSFixed_h
+#define MahonyAHRSFixed_h
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------------------------------
+// Type declaration
+
+typedef struct {
+	int32_t twoKp;								// 2 * proportional gain (Kp), Q16.16
+	int32_t twoKi;								// 2 * integral gain (Ki), Q16.16
+	int32_t q0, q1, q2, q3;						// quaternion of sensor frame relative to auxiliary frame, Q1.30
+	int32_t integralFBx, integralFBy, integralFBz;	// integral error terms scaled by Ki, Q8.24
+} MahonyAHRSFixed_t;
+
+#define MAHONY_FIXED_Q30(x)		((int32_t)((x) * 1073741824.0f))
+#define MAHONY_FIXED_Q16(x)		((int32_t)((x) * 65536.0f))
+#define MAHONY_FIXED_ONE		((int32_t)1 << 30)
+
+//---------------------------------------------------------------------------------------------------
+// Function declarations
+
+void MahonyAHRSFixedInit(MahonyAHRSFixed_t *ahrs, int32_t twoKp, int32_t twoKi);
+void MahonyAHRSFixedUpdate(MahonyAHRSFixed_t *ahrs, int32_t gx, int32_t gy, int32_t gz, int32_t ax, int32_t ay, int32_t az, int32_t mx, int32_t my, int32_t mz, int32_t dt);
+void MahonyAHRSFixedUpdateIMU(MahonyAHRSFixed_t *ahrs, int32_t gx, int32_t gy, int32_t gz, int32_t ax, int32_t ay, int32_t az, int32_t dt);
+uint32_t MahonyAHRSFixedChecksum(const MahonyAHRSFixed_t *ahrs);
+void MahonyFixedBenchmark_Run(void);
+
+#endif
+//=====================================================================================================
+// End of file
+//=====================================================================================================
@@ -0,0 +1,67 @@
+#ifndef _ATTITUDE_CONTROLLER_API_
+#define _ATTITUDE_CONTROLLER_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpu9250_api.h"
+#include "attitude_estimator_api.h"
+#include "fusion_math_api.h"
+
+
+typedef enum {
+    eControlAxis_First,
+    eControlAxis_Roll = eControlAxis_First,
+    eControlAxis_Pitch,
+    eControlAxis_Yaw,
+    eControlAxis_Last,
+} eControlAxis_t;
+
+/* Gains in continuous time, converted to per sample coefficients with Dt at init */
+typedef struct {
+    float AngleKp;                      // 1/s, rate setpoint per rad of attitude error
+    float AngleKi;                      // 1/s^2
+    float RateKp;                       // output per rad/s
+    float RateKi;                       // output per rad
+    float RateKd;                       // output per rad/s^2, on measured rate
+    float DerivativeCutoff;             // Hz, first order low pass on derivative term
+    float RateLimit;                    // rad/s, clamps angle loop output
+    float OutputLimit;                  // clamps rate loop output, e.g. motor command amplitude
+    float RateFeedForward;              // output per rad/s of measured rate, subtracted after the PID, 0 disables
+    float FeedForwardCutoff;            // Hz, first order low pass on the fed forward rate, 0 for none
+} sAxisControllerConfig_t;
+
+typedef struct {
+    sAxisControllerConfig_t Axis[eControlAxis_Last];
+    float Dt;                           // seconds, nominal control period
+} sAttitudeControllerConfig_t;
+
+typedef struct {
+    sMathPid_t Angle;                   // outer loop, attitude error to rate setpoint
+    sMathPid_t Rate;                    // inner loop PI, rate error to output
+    float RateKd;                       // per sample, Kd / Dt
+    float DerivativeAlpha;              // low pass coefficient
+    float FilteredDerivative;           // rate difference per sample after low pass
+    float PreviousRate;
+    float RateLimit;
+    float OutputLimit;
+    float FeedForwardGain;
+    float FeedForwardAlpha;             // low pass coefficient
+    float FilteredRate;                 // rad/s, fed forward rate after low pass
+} sAxisController_t;
+
+typedef struct {
+    sAxisController_t Axis[eControlAxis_Last];
+    bool PreviousRateValid;
+    sData3D_t Error;                    // rad, last attitude error in sensor frame
+    sData3D_t RateSetpoint;             // rad/s, last angle loop output
+    sData3D_t FeedForward;              // last feed-forward term, already in Output
+} sAttitudeController_t;
+
+void AttitudeController_GetDefaultConfig (sAttitudeControllerConfig_t *Config);
+bool AttitudeController_Init (sAttitudeController_t *Controller, const sAttitudeControllerConfig_t *Config);
+void AttitudeController_Reset (sAttitudeController_t *Controller);
+bool AttitudeController_Update (sAttitudeController_t *Controller, const sQuaternion_t *Setpoint, const sQuaternion_t *Estimate,
+                                const sData3D_t *Rate, sData3D_t *Output);
+void ControllerBenchmark_Run (void);
+
+#endif /* _ATTITUDE_CONTROLLER_API_ */
@@ -0,0 +1,79 @@
+#ifndef _ATTITUDE_ESTIMATOR_API_
+#define _ATTITUDE_ESTIMATOR_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpu9250_api.h"
+#include "MahonyAHRS.h"
+#include "MadgwickAHRS.h"
+#include "mekf_api.h"
+#include "multirate_fusion_api.h"
+
+
+typedef enum {
+    eAttitudeEstimator_First,
+    eAttitudeEstimator_Mahony = eAttitudeEstimator_First,
+    eAttitudeEstimator_Madgwick,
+    eAttitudeEstimator_Mekf,
+    eAttitudeEstimator_MultiRate,
+    eAttitudeEstimator_Last,
+} eAttitudeEstimator_t;
+
+typedef struct {
+    float W;
+    float X;
+    float Y;
+    float Z;
+} sQuaternion_t;
+
+/* Tuning of one instance, each engine reads only its own fields */
+typedef struct {
+    float TwoKp;                        // Mahony, MultiRate: 2 * proportional gain
+    float TwoKi;                        // Mahony, MultiRate: 2 * integral gain
+    float Beta;                         // Madgwick
+    float AccVariance;                  // MEKF
+    float MagVariance;                  // MEKF
+    unsigned int CorrectionDecimation;  // MultiRate
+    unsigned int BootAlignSamples;      // samples averaged for initial attitude, 0 starts from identity
+    float BootGainScale;                // correction gain multiplier right after alignment
+    float BootRampTime;                 // seconds for gain to ramp back down to nominal
+} sAttitudeEstimatorConfig_t;
+
+typedef enum {
+    eAttitudeBootPhase_Align,           // averaging accelerometer/magnetometer, attitude not valid yet
+    eAttitudeBootPhase_Ramp,            // running with raised gain
+    eAttitudeBootPhase_Done,            // running with nominal gain
+} eAttitudeBootPhase_t;
+
+typedef struct {
+    eAttitudeBootPhase_t Phase;
+    sData3D_t AccSum;
+    sData3D_t MagSum;
+    unsigned int AccCount;
+    unsigned int MagCount;
+    float Elapsed;                      // seconds since start of current phase
+} sAttitudeBoot_t;
+
+typedef struct {
+    eAttitudeEstimator_t Engine;
+    sAttitudeEstimatorConfig_t Config;
+    sAttitudeBoot_t Boot;
+    union {
+        MahonyAHRS_t Mahony;
+        MadgwickAHRS_t Madgwick;
+        sMekf_t Mekf;
+        sMultiRateFusion_t MultiRate;
+    } State;
+} sAttitudeEstimator_t;
+
+void AttitudeEstimator_GetDefaultConfig (sAttitudeEstimatorConfig_t *Config);
+bool AttitudeEstimator_Init (sAttitudeEstimator_t *Estimator, eAttitudeEstimator_t Engine);
+bool AttitudeEstimator_InitWithConfig (sAttitudeEstimator_t *Estimator, eAttitudeEstimator_t Engine, const sAttitudeEstimatorConfig_t *Config);
+bool AttitudeEstimator_Update (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt);
+bool AttitudeEstimator_GetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion);
+bool AttitudeEstimator_GetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias);
+eAttitudeBootPhase_t AttitudeEstimator_GetBootPhase (const sAttitudeEstimator_t *Estimator);
+const char *AttitudeEstimator_GetName (eAttitudeEstimator_t Engine);
+void AttitudeEstimator_Print (const sAttitudeEstimator_t *Estimator);
+
+#endif /* _ATTITUDE_ESTIMATOR_API_ */
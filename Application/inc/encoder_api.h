@@ -0,0 +1,28 @@
+#ifndef _ENCODER_API_
+#define _ENCODER_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "motor_api.h"
+
+
+/* One AS5048A per motor shaft, daisy chained on the SPI2 encoder chip select */
+typedef struct {
+    uint16_t Raw;                       // 14 bit angle
+    float Angle;                        // rad, mechanical, 0 to 2 * pi
+    bool Valid;                         // false on parity error, error flag or while an error is being cleared
+} sEncoderSample_t;
+
+typedef struct {
+    uint32_t Reads;                     // chain transactions
+    uint32_t BusErrors;                 // SPI transfer failed, no sample for any motor
+    uint32_t ParityErrors;
+    uint32_t ErrorFlags;                // frames with the encoder error flag set, each triggers a clear
+} sEncoderStats_t;
+
+bool Encoder_Init (void);
+bool Encoder_Read (sEncoderSample_t Output[eMotor_Last]);
+bool Encoder_GetStats (sEncoderStats_t *Output);
+void Encoder_PrintStats (void);
+
+#endif /* _ENCODER_API_ */
@@ -0,0 +1,64 @@
+#ifndef _FOC_API_
+#define _FOC_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "motor_api.h"
+#include "encoder_api.h"
+#include "fusion_math_api.h"
+
+
+/* Voltages are in volt here and normalised to the SVPWM limit (bus / sqrt(3) phase peak) only when written out */
+typedef struct {
+    unsigned int PolePairs;
+    float Direction;                    // +1 when encoder angle grows with field angle, -1 otherwise
+    float PhaseResistance;              // ohm, phase to star point
+    float BackEmfConstant;              // V phase peak per rad/s mechanical
+    float CurrentLimit;                 // A, q axis current for a command of 1
+    float CurrentKp;                    // V/A, current loops run only with measured phase currents
+    float CurrentKi;                    // V/(A s)
+    float VelocityCutoff;               // Hz, first order low pass on encoder velocity
+    float AlignVoltage;                 // V on d axis while the electrical offset is measured
+} sFocMotorConfig_t;
+
+typedef struct {
+    sFocMotorConfig_t Motor[eMotor_Last];
+    float BusVoltage;                   // V
+    float Dt;                           // seconds, control period
+    float LatencyPeriods;               // encoder sample age plus PWM delay, in control periods
+    unsigned int MaxMissedSamples;      // extrapolated before the motor is switched off
+} sFocConfig_t;
+
+typedef struct {
+    float ElectricalOffset;             // rad, electrical angle = Direction * PolePairs * mechanical + offset
+    float Angle;                        // rad, mechanical, last sample or extrapolation
+    float Velocity;                     // rad/s, mechanical, filtered
+    float ElectricalAngle;              // rad, latency compensated angle the voltage was applied at
+    float Id;                           // A, measured, zero without current sensing
+    float Iq;
+    float Vd;                           // V, applied
+    float Vq;
+    sMathPid_t IdPid;
+    sMathPid_t IqPid;
+    unsigned int MissedSamples;
+    bool AngleValid;
+    bool Aligned;
+} sFocMotor_t;
+
+typedef struct {
+    sFocConfig_t Config;
+    sFocMotor_t Motor[eMotor_Last];
+    float VelocityAlpha[eMotor_Last];
+    float VoltageToVector;              // 1 / SVPWM phase peak limit
+} sFoc_t;
+
+void Foc_GetDefaultConfig (sFocConfig_t *Config);
+bool Foc_Init (sFoc_t *Foc, const sFocConfig_t *Config);
+void Foc_AlignStart (sFoc_t *Foc);
+bool Foc_AlignFinish (sFoc_t *Foc, const sEncoderSample_t Samples[eMotor_Last]);
+bool Foc_Update (sFoc_t *Foc, const sEncoderSample_t Samples[eMotor_Last], const float Command[eMotor_Last],
+                 const float (*PhaseCurrents)[2]);
+void Foc_Release (sFoc_t *Foc);
+void FocBenchmark_Run (void);
+
+#endif /* _FOC_API_ */
@@ -0,0 +1,199 @@
+#ifndef _FUSION_MATH_API_
+#define _FUSION_MATH_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernels are called per sample from fusion and control loops, they live here so they get inlined.
+ * On target square root maps to VSQRT through CMSIS-DSP, everything else is plain single precision
+ * C which compiles to FPU instructions: at 3 and 4 elements a CMSIS-DSP call costs more than the work. */
+#if defined(ARM_MATH_CM4)
+#include "stm32f3xx.h"  // __FPU_PRESENT must be known before arm_math.h pulls in core_cm4.h
+#include "arm_math.h"
+#else
+#include <math.h>
+#endif
+
+
+static inline float Math_Sqrt (float Value) {
+#if defined(ARM_MATH_CM4)
+    float Result;
+    arm_sqrt_f32(Value, &Result);
+    return Result;
+#else
+    return (Value > 0.0f) ? sqrtf(Value) : 0.0f;
+#endif
+}
+
+/* Returns 0 for zero or negative input, so a vanishing norm (e.g. Madgwick gradient at the optimum) scales to zero
+ * instead of turning the state into NaN */
+static inline float Math_InvSqrt (float Value) {
+    return (Value > 0.0f) ? (1.0f / Math_Sqrt(Value)) : 0.0f;
+}
+
+/* Returns false and leaves vector untouched if it has zero length */
+static inline bool Math_Normalise3 (float Vector[3]) {
+    float NormSq = Vector[0] * Vector[0] + Vector[1] * Vector[1] + Vector[2] * Vector[2];
+    bool RetVal = false;
+    if (NormSq > 0.0f) {
+        float RecipNorm = Math_InvSqrt(NormSq);
+        Vector[0] *= RecipNorm;
+        Vector[1] *= RecipNorm;
+        Vector[2] *= RecipNorm;
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+static inline bool Math_Normalise4 (float Vector[4]) {
+    float NormSq = Vector[0] * Vector[0] + Vector[1] * Vector[1] + Vector[2] * Vector[2] + Vector[3] * Vector[3];
+    bool RetVal = false;
+    if (NormSq > 0.0f) {
+        float RecipNorm = Math_InvSqrt(NormSq);
+        Vector[0] *= RecipNorm;
+        Vector[1] *= RecipNorm;
+        Vector[2] *= RecipNorm;
+        Vector[3] *= RecipNorm;
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* Output must not alias inputs */
+static inline void Math_Cross3 (const float A[3], const float B[3], float Output[3]) {
+    Output[0] = A[1] * B[2] - A[2] * B[1];
+    Output[1] = A[2] * B[0] - A[0] * B[2];
+    Output[2] = A[0] * B[1] - A[1] * B[0];
+}
+
+/* Hamilton product, quaternions stored as W, X, Y, Z; output must not alias inputs */
+static inline void Math_QuaternionMultiply (const float P[4], const float Q[4], float Output[4]) {
+    Output[0] = P[0] * Q[0] - P[1] * Q[1] - P[2] * Q[2] - P[3] * Q[3];
+    Output[1] = P[0] * Q[1] + P[1] * Q[0] + P[2] * Q[3] - P[3] * Q[2];
+    Output[2] = P[0] * Q[2] - P[1] * Q[3] + P[2] * Q[0] + P[3] * Q[1];
+    Output[3] = P[0] * Q[3] + P[1] * Q[2] - P[2] * Q[1] + P[3] * Q[0];
+}
+
+/* Output = M * V, or M^T * V when Transpose is set; output must not alias input */
+static inline void Math_MatrixVector3 (const float M[3][3], const float V[3], bool Transpose, float Output[3]) {
+    if (Transpose) {
+        Output[0] = M[0][0] * V[0] + M[1][0] * V[1] + M[2][0] * V[2];
+        Output[1] = M[0][1] * V[0] + M[1][1] * V[1] + M[2][1] * V[2];
+        Output[2] = M[0][2] * V[0] + M[1][2] * V[1] + M[2][2] * V[2];
+    } else {
+        Output[0] = M[0][0] * V[0] + M[0][1] * V[1] + M[0][2] * V[2];
+        Output[1] = M[1][0] * V[0] + M[1][1] * V[1] + M[1][2] * V[2];
+        Output[2] = M[2][0] * V[0] + M[2][1] * V[1] + M[2][2] * V[2];
+    }
+}
+
+/* Quadrant reduction to |r| <= pi / 4, then Taylor series to r^8. Error below 1e-6 within a few turns, beyond that
+ * float resolution of the angle itself dominates. */
+static inline void Math_SinCos (float Angle, float *Sin, float *Cos) {
+    float Scaled = Angle * 0.636619772f;
+    int32_t Quadrant = (int32_t)(Scaled + ((Scaled >= 0.0f) ? 0.5f : -0.5f));
+    float R = (Angle - (float)Quadrant * 1.57079637f) + (float)Quadrant * 4.37113883e-8f;
+    float R2 = R * R;
+    float S = R * (1.0f - R2 * (1.0f / 6.0f) * (1.0f - R2 * (1.0f / 20.0f) * (1.0f - R2 * (1.0f / 42.0f))));
+    float C = 1.0f - R2 * 0.5f * (1.0f - R2 * (1.0f / 12.0f) * (1.0f - R2 * (1.0f / 30.0f) * (1.0f - R2 * (1.0f / 56.0f))));
+    switch (Quadrant & 3) {
+        case 0:  *Sin = S;  *Cos = C;  break;
+        case 1:  *Sin = C;  *Cos = -S; break;
+        case 2:  *Sin = -S; *Cos = -C; break;
+        default: *Sin = -C; *Cos = S;  break;
+    }
+}
+
+/* Field oriented control transforms, amplitude invariant. On target these are the CMSIS-DSP inline functions,
+ * elsewhere copies of them with the same argument order. */
+static inline void Math_Clarke (float A, float B, float *Alpha, float *Beta) {
+#if defined(ARM_MATH_CM4)
+    arm_clarke_f32(A, B, Alpha, Beta);
+#else
+    *Alpha = A;
+    *Beta = 0.57735026919f * A + 1.15470053838f * B;
+#endif
+}
+
+static inline void Math_InvClarke (float Alpha, float Beta, float *A, float *B) {
+#if defined(ARM_MATH_CM4)
+    arm_inv_clarke_f32(Alpha, Beta, A, B);
+#else
+    *A = Alpha;
+    *B = -0.5f * Alpha + 0.8660254039f * Beta;
+#endif
+}
+
+static inline void Math_Park (float Alpha, float Beta, float *D, float *Q, float Sin, float Cos) {
+#if defined(ARM_MATH_CM4)
+    arm_park_f32(Alpha, Beta, D, Q, Sin, Cos);
+#else
+    *D = Alpha * Cos + Beta * Sin;
+    *Q = -Alpha * Sin + Beta * Cos;
+#endif
+}
+
+static inline void Math_InvPark (float D, float Q, float *Alpha, float *Beta, float Sin, float Cos) {
+#if defined(ARM_MATH_CM4)
+    arm_inv_park_f32(D, Q, Alpha, Beta, Sin, Cos);
+#else
+    *Alpha = D * Cos - Q * Sin;
+    *Beta = D * Sin + Q * Cos;
+#endif
+}
+
+/* Incremental PID, y[n] = y[n-1] + A0 * x[n] + A1 * x[n-1] + A2 * x[n-2]. On target this is CMSIS-DSP
+ * arm_pid_f32 (inline in arm_math.h), elsewhere a copy of it with the same instance layout. */
+#if defined(ARM_MATH_CM4)
+typedef arm_pid_instance_f32 sMathPid_t;
+#else
+typedef struct {
+    float A0;
+    float A1;
+    float A2;
+    float state[3];                     // x[n-1], x[n-2], y[n-1]
+    float Kp;
+    float Ki;
+    float Kd;
+} sMathPid_t;
+#endif
+
+/* Gains are per sample (Ki * Dt, Kd / Dt). Same coefficients as arm_pid_init_f32 with reset, which lives in the
+ * CMSIS-DSP library rather than the header, so the library does not have to be linked for it. */
+static inline void Math_PidInit (sMathPid_t *Pid, float Kp, float Ki, float Kd) {
+    Pid->Kp = Kp;
+    Pid->Ki = Ki;
+    Pid->Kd = Kd;
+    Pid->A0 = Kp + Ki + Kd;
+    Pid->A1 = -Kp - 2.0f * Kd;
+    Pid->A2 = Kd;
+    Pid->state[0] = 0.0f;
+    Pid->state[1] = 0.0f;
+    Pid->state[2] = 0.0f;
+}
+
+static inline float Math_Pid (sMathPid_t *Pid, float Input) {
+#if defined(ARM_MATH_CM4)
+    return arm_pid_f32(Pid, Input);
+#else
+    float Output = (Pid->A0 * Input) + (Pid->A1 * Pid->state[0]) + (Pid->A2 * Pid->state[1]) + Pid->state[2];
+    Pid->state[1] = Pid->state[0];
+    Pid->state[0] = Input;
+    Pid->state[2] = Output;
+    return Output;
+#endif
+}
+
+/* Clamps stored output y[n-1], in incremental form this is what stops the integral from winding up */
+static inline float Math_PidClamp (sMathPid_t *Pid, float Limit) {
+    if (Pid->state[2] > Limit) {
+        Pid->state[2] = Limit;
+    } else if (Pid->state[2] < -Limit) {
+        Pid->state[2] = -Limit;
+    }
+    return Pid->state[2];
+}
+
+void MathBenchmark_Run (void);
+
+#endif /* _FUSION_MATH_API_ */
@@ -0,0 +1,48 @@
+#ifndef _GYRO_BIAS_API_
+#define _GYRO_BIAS_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpu9250_api.h"
+
+
+/* Samples are split into windows, a window counts as stationary when gyro and accelerometer variance are both low.
+ * Once calibrated the motors may be running, so refinement has its own accelerometer limit above their vibration. */
+typedef struct {
+    unsigned int WindowSamples;
+    float GyroVarianceThreshold;        // (rad/s)^2, summed over axes
+    float AccVarianceThreshold;         // unit of accelerometer squared, summed over axes
+    float OnlineAccVarianceThreshold;   // same, for refinement windows after calibration
+    float ConfidenceThreshold;          // rad/s, standard error of bias at which boot calibration ends
+    float RefineGain;                   // 0..1, weight of each stationary window once calibrated
+} sGyroBiasConfig_t;
+
+/* Running mean and sum of squared deviations (Welford) */
+typedef struct {
+    unsigned int Count;
+    float Mean[3];
+    float M2[3];
+} sWelford3_t;
+
+typedef struct {
+    sGyroBiasConfig_t Config;
+    sWelford3_t Gyro;                   // current window
+    sWelford3_t Acc;                    // current window
+    float Bias[3];                      // rad/s, to be subtracted from gyro reading
+    float StationarySum[3];             // gyro sum over all stationary boot windows
+    float StationaryM2[3];              // within-window squared deviations over all stationary boot windows
+    unsigned int StationaryCount;
+    float StandardError;                // rad/s, worst axis
+    float Elapsed;                      // seconds until boot calibration finished
+    bool Valid;                         // at least one stationary window seen
+    bool Calibrated;                    // confidence threshold met, online refinement from here on
+} sGyroBias_t;
+
+void GyroBias_GetDefaultConfig (sGyroBiasConfig_t *Config);
+bool GyroBias_Init (sGyroBias_t *Estimator, const sGyroBiasConfig_t *Config);
+bool GyroBias_Update (sGyroBias_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, float Dt);
+bool GyroBias_Correct (const sGyroBias_t *Estimator, sData3D_t *Gyro);
+bool GyroBias_IsCalibrated (const sGyroBias_t *Estimator);
+void GyroBias_Print (const sGyroBias_t *Estimator);
+
+#endif /* _GYRO_BIAS_API_ */
@@ -0,0 +1,27 @@
+#ifndef _MEKF_API_
+#define _MEKF_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpu9250_api.h"
+
+
+#define MEKF_STATES 6
+
+/* Error state: attitude error (rad, body frame) followed by gyro bias error (rad/s) */
+typedef struct {
+    float Q[4];                         // W, X, Y, Z; sensor frame relative to earth frame
+    float Bias[3];                      // rad/s
+    float P[MEKF_STATES][MEKF_STATES];
+    float GyroVariance;                 // (rad/s)^2 per Hz, attitude random walk
+    float BiasVariance;                 // (rad/s^2)^2 per Hz, bias random walk
+    float AccVariance;                  // on normalised accelerometer vector
+    float MagVariance;                  // on normalised magnetometer vector
+} sMekf_t;
+
+void Mekf_Init (sMekf_t *Mekf);
+void Mekf_Predict (sMekf_t *Mekf, const sData3D_t *Gyro, float Dt);
+bool Mekf_UpdateAcc (sMekf_t *Mekf, const sData3D_t *Acc);
+bool Mekf_UpdateMag (sMekf_t *Mekf, const sData3D_t *Mag);
+
+#endif /* _MEKF_API_ */
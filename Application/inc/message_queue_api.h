@@ -16,7 +16,9 @@ typedef enum {
     eQueue_Spi_First,
         eQueue_Spi1Rx = eQueue_Spi_First,
         eQueue_Spi1Tx,
-    eQueue_Spi_Last = eQueue_Spi1Tx,
+        eQueue_Spi2Rx,
+        eQueue_Spi2Tx,
+    eQueue_Spi_Last = eQueue_Spi2Tx,
     /* This entry must be last */
     eQueue_Last,
 } eQueue_t;
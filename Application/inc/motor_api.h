@@ -0,0 +1,32 @@
+#ifndef _MOTOR_API_
+#define _MOTOR_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* One gimbal motor per stabilised axis, same order as eControlAxis_t */
+typedef enum {
+    eMotor_First,
+    eMotor_Roll = eMotor_First,
+    eMotor_Pitch,
+    eMotor_Yaw,
+    eMotor_Last,
+} eMotor_t;
+
+/* Angle and amplitude are from the last Motor_Set / Motor_SetRaw, Motor_SetVoltage only updates duties */
+typedef struct {
+    uint16_t Angle;                     // electrical angle, full turn is 65536
+    uint16_t Amplitude;                 // Q15, 32767 is full bus voltage
+    uint16_t Duty[3];                   // compare values last written to phases A, B, C
+} sMotorState_t;
+
+bool Motor_Init (void);
+bool Motor_Set (eMotor_t Motor, float ElectricalAngle, float Amplitude);
+bool Motor_SetRaw (eMotor_t Motor, uint16_t ElectricalAngle, uint16_t Amplitude);
+bool Motor_SetVoltage (eMotor_t Motor, float Alpha, float Beta);
+bool Motor_GetState (eMotor_t Motor, sMotorState_t *Output);
+uint16_t Motor_GetPwmPeriod (void);
+void MotorBenchmark_Run (void);
+
+#endif /* _MOTOR_API_ */
@@ -15,11 +15,35 @@ typedef struct {
     sData3D_t A;
     sData3D_t G;
     sData3D_t M;
+    bool MagFresh;  // M holds a new magnetometer measurement
+    uint32_t Timestamp; // DWT cycle count at data ready
 } sImuData_t;
 
+typedef enum {
+    eMpuSensor_First,
+    eMpuSensor_Acc = eMpuSensor_First,
+    eMpuSensor_Gyr,
+    eMpuSensor_Mag,
+    eMpuSensor_Last,
+} eMpuSensor_t;
+
+/* Out = Matrix * (Raw * Scale - Bias), in output units (mg, dps) */
+typedef struct {
+    float Matrix[3][3];
+    sData3D_t Bias;
+} sSensorCalibration_t;
+
 bool Mpu_Init (void);
+bool Mpu_SetCalibration (eMpuSensor_t Sensor, const sSensorCalibration_t *Calibration);
 void HandleExt3IRQ (void);
+uint32_t Mpu_GetDataReadyTimestamp (void);
+unsigned int Mpu_GetSamplePeriodUs (void);
 bool ReadIMU (sImuData_t *ImuData);
+bool ReadIMUFifo (sImuData_t *ImuData, unsigned int MaxSamples, unsigned int *SamplesRead);
+unsigned int Mpu_GetFifoOverflowCount (void);
 void Mpu_PrintData (sImuData_t *ImuData);
+void Mpu_PrintCsvHeader (void);
+void Mpu_PrintCsv (const sImuData_t *ImuData);
+void MpuBenchmark_Run (void);
 
 #endif /* _MPU9250_API_ */
@@ -0,0 +1,29 @@
+#ifndef _MULTIRATE_FUSION_API_
+#define _MULTIRATE_FUSION_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpu9250_api.h"
+
+
+/* Gyro is integrated on every sample, accelerometer/magnetometer correction runs every CorrectionDecimation samples */
+typedef struct {
+    float Q[4];                         // W, X, Y, Z; sensor frame relative to earth frame
+    float TwoKp;                        // 2 * proportional gain, as in Mahony filter
+    float TwoKi;                        // 2 * integral gain
+    float IntegralFeedback[3];          // rad/s, added to gyro rate
+    float PreviousDelta[3];             // previous rotation increment, for coning compensation
+    bool PreviousDeltaValid;
+    sData3D_t AccSum;                   // accelerometer accumulated since last correction
+    unsigned int AccCount;
+    sData3D_t Mag;                      // latest magnetometer sample
+    bool MagValid;
+    float CorrectionInterval;           // seconds integrated since last correction
+    unsigned int SampleCounter;
+    unsigned int CorrectionDecimation;
+} sMultiRateFusion_t;
+
+void MultiRateFusion_Init (sMultiRateFusion_t *Fusion, float TwoKp, float TwoKi, unsigned int CorrectionDecimation);
+void MultiRateFusion_Update (sMultiRateFusion_t *Fusion, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt);
+
+#endif /* _MULTIRATE_FUSION_API_ */
@@ -16,16 +16,33 @@ typedef enum {
 typedef enum {
     eSpiSlave_First,
     eSpiSlave_MPU = eSpiSlave_First,
+    eSpiSlave_Encoder,
     /* These two must be last */
     eSpiSlave_None,
     eSpiSlave_Last,
 } eSpiSlave_t;
 
+typedef struct {
+    uint32_t BytesTransferred;  // bytes clocked on the wire, including command and dummy bytes
+    uint32_t CsToggles;         // chip select edges
+    uint32_t MutexAcquisitions;
+    uint32_t TransferErrors;
+    uint32_t MutexTimeouts;     // accesses dropped because the bus stayed busy
+} sSpiStats_t;
+
 void InitializeSpiMutexes (void);
+void InitializeSpiSlaves (void);
 void HandleSpiRxIRQ (eSpi_t CurrentSpi);
 void HandleSpiTxIRQ (eSpi_t CurrentSpi);
+void HandleSpiDmaRxIRQ (eSpi_t CurrentSpi);
 bool SpiReadSlaveRegister (uint8_t *DataResponse, uint8_t RegisterAddress, eSpiSlave_t Slave);
+bool SpiReadSlaveRegisters (eSpiSlave_t Slave, uint8_t StartAddress, uint8_t *Buffer, uint16_t Length);
 bool SpiWriteSlaveRegister (uint8_t WriteValue, uint8_t RegisterAddress, eSpiSlave_t Slave);
+bool SpiWriteSlaveRegisters (eSpiSlave_t Slave, uint8_t StartAddress, const uint8_t *Buffer, uint16_t Length);
+bool SpiTransferSlave (eSpiSlave_t Slave, const uint8_t *TxBuffer, uint8_t *RxBuffer, uint16_t Length);
+bool SpiGetStats (eSpi_t Spi, sSpiStats_t *Output);
+bool SpiResetStats (eSpi_t Spi);
+void SpiPrintStats (eSpi_t Spi);
 
 #endif /* _SPI_API_ */
 
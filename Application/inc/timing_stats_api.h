@@ -0,0 +1,53 @@
+#ifndef _TIMING_STATS_API_
+#define _TIMING_STATS_API_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define TIMING_HISTOGRAM_BINS 16
+
+typedef enum {
+    eTimingHistogram_First,
+    eTimingHistogram_SampleLatency = eTimingHistogram_First,
+    eTimingHistogram_SampleJitter,
+    eTimingHistogram_ReadImuCost,
+    eTimingHistogram_FusionCost,
+    eTimingHistogram_ControlCost,
+    eTimingHistogram_Last,
+} eTimingHistogram_t;
+
+typedef struct {
+    uint32_t Count;
+    uint32_t MinUs;
+    uint32_t MaxUs;
+    uint64_t SumUs;
+    uint32_t Bins[TIMING_HISTOGRAM_BINS];
+} sTimingHistogram_t;
+
+/* Per period figures of a fixed-rate loop, start is measured against the period's trigger time */
+typedef struct {
+    uint32_t Periods;
+    uint32_t DeadlineMisses;            // periods whose work ended after the next trigger
+    uint32_t SkippedPeriods;            // triggers that arrived while the previous period was still running
+    uint32_t LastExecutionUs;
+    uint32_t MaxExecutionUs;
+    uint32_t LastStartJitterUs;
+    uint32_t MaxStartJitterUs;
+} sLoopStats_t;
+
+void            InitializeCycleCounter          (void);
+uint32_t        GetCycleCount                   (void);
+uint32_t        CyclesToUs                      (uint32_t Cycles);
+uint32_t        UsToCycles                      (uint32_t Us);
+float           CyclesToSeconds                 (uint32_t Cycles);
+bool            TimingHistogramAdd              (eTimingHistogram_t Histogram, uint32_t ValueUs);
+bool            TimingHistogramGet              (eTimingHistogram_t Histogram, sTimingHistogram_t *Output);
+bool            TimingHistogramReset            (eTimingHistogram_t Histogram);
+void            TimingHistogramPrint            (eTimingHistogram_t Histogram);
+void            LoopStatsRecord                 (uint32_t TriggerCycles, uint32_t StartCycles, uint32_t EndCycles, uint32_t PeriodUs, uint32_t Skipped);
+bool            LoopStatsGet                    (sLoopStats_t *Output);
+void            LoopStatsReset                  (void);
+void            LoopStatsPrint                  (void);
+
+#endif /* _TIMING_STATS_API_ */
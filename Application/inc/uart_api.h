@@ -19,5 +19,6 @@ void            InitializeUartInterrupts    (void);
 void            HandleUartRxIRQ             (eUart_t CurrentUart);
 void            HandleUartTxIRQ             (eUart_t CurrentUart);
 bool            PrintToUart                 (eUart_t OutputUart, char *Format, ...);
+bool            ReceiveMessageFromUart      (eUart_t InputUart, char *OutputBuffer, unsigned int MaxLength);
 
 #endif /* _UART_API_ */
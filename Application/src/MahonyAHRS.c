@@ -16,6 +16,8 @@
 
 #include "MahonyAHRS.h"
 #include <math.h>
+#include "fusion_math_api.h"
+#include <stddef.h>
 
 #include "uart_api.h"
 //---------------------------------------------------------------------------------------------------
@@ -24,14 +26,12 @@
 #define sampleFreq	512.0f			// sample frequency in Hz
 #define twoKpDef	(2.0f * 0.5f)	// 2 * proportional gain
 #define twoKiDef	(2.0f * 0.0f)	// 2 * integral gain
+#define batchRenormThreshold	1.0e-4f	// allowed |norm^2 - 1| of quaternion inside batch
 
 //---------------------------------------------------------------------------------------------------
 // Variable definitions
 
-volatile float twoKp = twoKpDef;											// 2 * proportional gain (Kp)
-volatile float twoKi = twoKiDef;											// 2 * integral gain (Ki)
-volatile float q0 = 1.0f, q1 = 0.0f, q2 = 0.0f, q3 = 0.0f;					// quaternion of sensor frame relative to auxiliary frame
-volatile float integralFBx = 0.0f,  integralFBy = 0.0f, integralFBz = 0.0f;	// integral error terms scaled by Ki
+static MahonyAHRS_t mahonyDefault = MAHONY_AHRS_INITIALISER(twoKpDef, twoKiDef);	// instance behind legacy API
 
 //---------------------------------------------------------------------------------------------------
 // Function declarations
@@ -41,23 +41,48 @@ float invSqrt(float x);
 //====================================================================================================
 // Functions
 
+//---------------------------------------------------------------------------------------------------
+// Instance initialisation
+
+void MahonyAHRSinit(MahonyAHRS_t *ahrs, float twoKp, float twoKi) {
+	*ahrs = (MahonyAHRS_t)MAHONY_AHRS_INITIALISER(twoKp, twoKi);
+}
+
 //---------------------------------------------------------------------------------------------------
 // AHRS algorithm update
 
 void MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz) {
+	MahonyAHRSupdateInstance(&mahonyDefault, gx, gy, gz, ax, ay, az, mx, my, mz, 1.0f / sampleFreq);
+}
+
+void MahonyAHRSupdateDt(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
+	MahonyAHRSupdateInstance(&mahonyDefault, gx, gy, gz, ax, ay, az, mx, my, mz, dt);
+}
+
+//---------------------------------------------------------------------------------------------------
+// AHRS algorithm update on filter instance with measured sample interval dt in seconds
+// State is copied to locals so the update math stays in registers
+
+void MahonyAHRSupdateInstance(MahonyAHRS_t *ahrs, float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
 	float recipNorm;
     float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;  
 	float hx, hy, bx, bz;
 	float halfvx, halfvy, halfvz, halfwx, halfwy, halfwz;
 	float halfex, halfey, halfez;
 	float qa, qb, qc;
+	float q0, q1, q2, q3;
 
 	// Use IMU algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
 	if((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
-		MahonyAHRSupdateIMU(gx, gy, gz, ax, ay, az);
+		MahonyAHRSupdateIMUInstance(ahrs, gx, gy, gz, ax, ay, az, dt);
 		return;
 	}
 
+	q0 = ahrs->q0;
+	q1 = ahrs->q1;
+	q2 = ahrs->q2;
+	q3 = ahrs->q3;
+
 	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
 	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 
@@ -88,7 +113,7 @@ void MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az
         // Reference direction of Earth's magnetic field
         hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
         hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
-        bx = sqrt(hx * hx + hy * hy);
+        bx = Math_Sqrt(hx * hx + hy * hy);
         bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
 
 		// Estimated direction of gravity and magnetic field
@@ -105,30 +130,30 @@ void MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az
 		halfez = (ax * halfvy - ay * halfvx) + (mx * halfwy - my * halfwx);
 
 		// Compute and apply integral feedback if enabled
-		if(twoKi > 0.0f) {
-			integralFBx += twoKi * halfex * (1.0f / sampleFreq);	// integral error scaled by Ki
-			integralFBy += twoKi * halfey * (1.0f / sampleFreq);
-			integralFBz += twoKi * halfez * (1.0f / sampleFreq);
-			gx += integralFBx;	// apply integral feedback
-			gy += integralFBy;
-			gz += integralFBz;
+		if(ahrs->twoKi > 0.0f) {
+			ahrs->integralFBx += ahrs->twoKi * halfex * dt;	// integral error scaled by Ki
+			ahrs->integralFBy += ahrs->twoKi * halfey * dt;
+			ahrs->integralFBz += ahrs->twoKi * halfez * dt;
+			gx += ahrs->integralFBx;	// apply integral feedback
+			gy += ahrs->integralFBy;
+			gz += ahrs->integralFBz;
 		}
 		else {
-			integralFBx = 0.0f;	// prevent integral windup
-			integralFBy = 0.0f;
-			integralFBz = 0.0f;
+			ahrs->integralFBx = 0.0f;	// prevent integral windup
+			ahrs->integralFBy = 0.0f;
+			ahrs->integralFBz = 0.0f;
 		}
 
 		// Apply proportional feedback
-		gx += twoKp * halfex;
-		gy += twoKp * halfey;
-		gz += twoKp * halfez;
+		gx += ahrs->twoKp * halfex;
+		gy += ahrs->twoKp * halfey;
+		gz += ahrs->twoKp * halfez;
 	}
 	
 	// Integrate rate of change of quaternion
-	gx *= (0.5f * (1.0f / sampleFreq));		// pre-multiply common factors
-	gy *= (0.5f * (1.0f / sampleFreq));
-	gz *= (0.5f * (1.0f / sampleFreq));
+	gx *= (0.5f * dt);		// pre-multiply common factors
+	gy *= (0.5f * dt);
+	gz *= (0.5f * dt);
 	qa = q0;
 	qb = q1;
 	qc = q2;
@@ -139,20 +164,32 @@ void MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az
 	
 	// Normalise quaternion
 	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
-	q0 *= recipNorm;
-	q1 *= recipNorm;
-	q2 *= recipNorm;
-	q3 *= recipNorm;
+	ahrs->q0 = q0 * recipNorm;
+	ahrs->q1 = q1 * recipNorm;
+	ahrs->q2 = q2 * recipNorm;
+	ahrs->q3 = q3 * recipNorm;
 }
 
 //---------------------------------------------------------------------------------------------------
 // IMU algorithm update
 
 void MahonyAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az) {
+	MahonyAHRSupdateIMUInstance(&mahonyDefault, gx, gy, gz, ax, ay, az, 1.0f / sampleFreq);
+}
+
+void MahonyAHRSupdateIMUDt(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+	MahonyAHRSupdateIMUInstance(&mahonyDefault, gx, gy, gz, ax, ay, az, dt);
+}
+
+//---------------------------------------------------------------------------------------------------
+// IMU algorithm update on filter instance with measured sample interval dt in seconds
+
+void MahonyAHRSupdateIMUInstance(MahonyAHRS_t *ahrs, float gx, float gy, float gz, float ax, float ay, float az, float dt) {
 	float recipNorm;
 	float halfvx, halfvy, halfvz;
 	float halfex, halfey, halfez;
 	float qa, qb, qc;
+	float q0 = ahrs->q0, q1 = ahrs->q1, q2 = ahrs->q2, q3 = ahrs->q3;
 
 	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
 	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
@@ -174,30 +211,30 @@ void MahonyAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float
 		halfez = (ax * halfvy - ay * halfvx);
 
 		// Compute and apply integral feedback if enabled
-		if(twoKi > 0.0f) {
-			integralFBx += twoKi * halfex * (1.0f / sampleFreq);	// integral error scaled by Ki
-			integralFBy += twoKi * halfey * (1.0f / sampleFreq);
-			integralFBz += twoKi * halfez * (1.0f / sampleFreq);
-			gx += integralFBx;	// apply integral feedback
-			gy += integralFBy;
-			gz += integralFBz;
+		if(ahrs->twoKi > 0.0f) {
+			ahrs->integralFBx += ahrs->twoKi * halfex * dt;	// integral error scaled by Ki
+			ahrs->integralFBy += ahrs->twoKi * halfey * dt;
+			ahrs->integralFBz += ahrs->twoKi * halfez * dt;
+			gx += ahrs->integralFBx;	// apply integral feedback
+			gy += ahrs->integralFBy;
+			gz += ahrs->integralFBz;
 		}
 		else {
-			integralFBx = 0.0f;	// prevent integral windup
-			integralFBy = 0.0f;
-			integralFBz = 0.0f;
+			ahrs->integralFBx = 0.0f;	// prevent integral windup
+			ahrs->integralFBy = 0.0f;
+			ahrs->integralFBz = 0.0f;
 		}
 
 		// Apply proportional feedback
-		gx += twoKp * halfex;
-		gy += twoKp * halfey;
-		gz += twoKp * halfez;
+		gx += ahrs->twoKp * halfex;
+		gy += ahrs->twoKp * halfey;
+		gz += ahrs->twoKp * halfez;
 	}
 	
 	// Integrate rate of change of quaternion
-	gx *= (0.5f * (1.0f / sampleFreq));		// pre-multiply common factors
-	gy *= (0.5f * (1.0f / sampleFreq));
-	gz *= (0.5f * (1.0f / sampleFreq));
+	gx *= (0.5f * dt);		// pre-multiply common factors
+	gy *= (0.5f * dt);
+	gz *= (0.5f * dt);
 	qa = q0;
 	qb = q1;
 	qc = q2;
@@ -208,24 +245,124 @@ void MahonyAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float
 	
 	// Normalise quaternion
 	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
-	q0 *= recipNorm;
-	q1 *= recipNorm;
-	q2 *= recipNorm;
-	q3 *= recipNorm;
+	ahrs->q0 = q0 * recipNorm;
+	ahrs->q1 = q1 * recipNorm;
+	ahrs->q2 = q2 * recipNorm;
+	ahrs->q3 = q3 * recipNorm;
+}
+
+//---------------------------------------------------------------------------------------------------
+// IMU algorithm update over a burst of samples (e.g. one FIFO read)
+// Quaternion and integral terms stay in locals across the batch, quaternion is renormalised only
+// when its norm drifts beyond batchRenormThreshold and once more before it is stored.
+// outputs may be NULL, otherwise it receives the attitude after every sample.
+
+void MahonyAHRSupdateBatch(MahonyAHRS_t *ahrs, const MahonyAHRSsample_t *samples, unsigned int count, MahonyAHRSquaternion_t *outputs) {
+	float recipNorm, normSq;
+	float gx, gy, gz, ax, ay, az, dt;
+	float halfvx, halfvy, halfvz;
+	float halfex, halfey, halfez;
+	float qa, qb, qc;
+	float q0 = ahrs->q0, q1 = ahrs->q1, q2 = ahrs->q2, q3 = ahrs->q3;
+	float integralFBx = ahrs->integralFBx, integralFBy = ahrs->integralFBy, integralFBz = ahrs->integralFBz;
+	const float twoKp = ahrs->twoKp, twoKi = ahrs->twoKi;
+	unsigned int i;
+
+	for(i = 0; i < count; i++) {
+		gx = samples[i].gx;
+		gy = samples[i].gy;
+		gz = samples[i].gz;
+		ax = samples[i].ax;
+		ay = samples[i].ay;
+		az = samples[i].az;
+		dt = samples[i].dt;
+
+		// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+		if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+
+			// Normalise accelerometer measurement
+			recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+			ax *= recipNorm;
+			ay *= recipNorm;
+			az *= recipNorm;
+
+			// Estimated direction of gravity
+			halfvx = q1 * q3 - q0 * q2;
+			halfvy = q0 * q1 + q2 * q3;
+			halfvz = q0 * q0 - 0.5f + q3 * q3;
+
+			// Error is sum of cross product between estimated and measured direction of gravity
+			halfex = (ay * halfvz - az * halfvy);
+			halfey = (az * halfvx - ax * halfvz);
+			halfez = (ax * halfvy - ay * halfvx);
+
+			// Compute and apply integral feedback if enabled
+			if(twoKi > 0.0f) {
+				integralFBx += twoKi * halfex * dt;	// integral error scaled by Ki
+				integralFBy += twoKi * halfey * dt;
+				integralFBz += twoKi * halfez * dt;
+				gx += integralFBx;	// apply integral feedback
+				gy += integralFBy;
+				gz += integralFBz;
+			}
+			else {
+				integralFBx = 0.0f;	// prevent integral windup
+				integralFBy = 0.0f;
+				integralFBz = 0.0f;
+			}
+
+			// Apply proportional feedback
+			gx += twoKp * halfex;
+			gy += twoKp * halfey;
+			gz += twoKp * halfez;
+		}
+
+		// Integrate rate of change of quaternion
+		gx *= (0.5f * dt);		// pre-multiply common factors
+		gy *= (0.5f * dt);
+		gz *= (0.5f * dt);
+		qa = q0;
+		qb = q1;
+		qc = q2;
+		q0 += (-qb * gx - qc * gy - q3 * gz);
+		q1 += (qa * gx + qc * gz - q3 * gy);
+		q2 += (qa * gy - qb * gz + q3 * gx);
+		q3 += (qa * gz + qb * gy - qc * gx);
+
+		// Normalise quaternion only when it drifted noticeably
+		normSq = q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3;
+		if(fabsf(normSq - 1.0f) > batchRenormThreshold) {
+			recipNorm = invSqrt(normSq);
+			q0 *= recipNorm;
+			q1 *= recipNorm;
+			q2 *= recipNorm;
+			q3 *= recipNorm;
+		}
+
+		if(outputs != NULL) {
+			outputs[i].q0 = q0;
+			outputs[i].q1 = q1;
+			outputs[i].q2 = q2;
+			outputs[i].q3 = q3;
+		}
+	}
+
+	// Stored attitude is always unit length
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	ahrs->q0 = q0 * recipNorm;
+	ahrs->q1 = q1 * recipNorm;
+	ahrs->q2 = q2 * recipNorm;
+	ahrs->q3 = q3 * recipNorm;
+	ahrs->integralFBx = integralFBx;
+	ahrs->integralFBy = integralFBy;
+	ahrs->integralFBz = integralFBz;
 }
 
 //---------------------------------------------------------------------------------------------------
-// Fast inverse square-root
-// See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
+// Inverse square-root, VSQRT based on target (replaces fast inverse square-root bit hack)
 
 float invSqrt(float x) {
-	float halfx = 0.5f * x;
-	float y = x;
-	long i = *(long*)&y;
-	i = 0x5f3759df - (i>>1);
-	y = *(float*)&i;
-	y = y * (1.5f - (halfx * y * y));
-	return y;
+	return Math_InvSqrt(x);
 }
 
 //====================================================================================================
@@ -233,5 +370,9 @@ float invSqrt(float x) {
 //====================================================================================================
 
 void printQuaternion (void) {
-	PrintToUart(eUart_1, "q0: %f\tq1: %f\tq2: %f\t q3: %f\r", q0, q1, q2, q3);
+	printQuaternionInstance(&mahonyDefault);
+}
+
+void printQuaternionInstance (const MahonyAHRS_t *ahrs) {
+	PrintToUart(eUart_1, "q0: %f\tq1: %f\tq2: %f\t q3: %f\r", ahrs->q0, ahrs->q1, ahrs->q2, ahrs->q3);
 }
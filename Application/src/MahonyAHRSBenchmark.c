@@ -0,0 +1,358 @@
+//=====================================================================================================
+// MahonyAHRSBenchmark.c
+//=====================================================================================================
+//
+// Update functions below are MahonyAHRS.c as it was before the instance API, unchanged except for
+// their names and the inverse square-root type pun, which read a 32 bit float through long and so
+// only worked where long is 32 bits.
+//
+//=====================================================================================================
+
+//---------------------------------------------------------------------------------------------------
+// Header files
+
+#include "MahonyAHRSBenchmark.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timing_stats_api.h"
+#include "uart_api.h"
+
+//---------------------------------------------------------------------------------------------------
+// Definitions
+
+#define benchmarkTableSize	256				// distinct samples, cycled through
+#define benchmarkUpdates	4096
+#define benchmarkBurst		32				// samples per MahonyAHRSupdateBatch call, about one FIFO read
+#define benchmarkDt			0.001f
+#define benchmarkTwoKp		(2.0f * 0.5f)
+#define benchmarkTwoKi		(2.0f * 0.1f)
+
+//---------------------------------------------------------------------------------------------------
+// Variable definitions
+
+static volatile float twoKp;												// 2 * proportional gain (Kp)
+static volatile float twoKi;												// 2 * integral gain (Ki)
+static volatile float q0 = 1.0f, q1 = 0.0f, q2 = 0.0f, q3 = 0.0f;			// quaternion of sensor frame relative to auxiliary frame
+static volatile float integralFBx = 0.0f,  integralFBy = 0.0f, integralFBz = 0.0f;	// integral error terms scaled by Ki
+
+static MahonyAHRSsample_t benchmarkSamples[benchmarkTableSize];
+static float benchmarkMag[benchmarkTableSize][3];
+
+//---------------------------------------------------------------------------------------------------
+// Function declarations
+
+static float invSqrt(float x);
+static void benchmarkFill(void);
+
+//====================================================================================================
+// Functions
+
+//---------------------------------------------------------------------------------------------------
+// Baseline state reset
+
+void MahonyAHRSBaselineInit(float twoKpInit, float twoKiInit) {
+	twoKp = twoKpInit;
+	twoKi = twoKiInit;
+	q0 = 1.0f;
+	q1 = 0.0f;
+	q2 = 0.0f;
+	q3 = 0.0f;
+	integralFBx = 0.0f;
+	integralFBy = 0.0f;
+	integralFBz = 0.0f;
+}
+
+void MahonyAHRSBaselineGet(MahonyAHRSquaternion_t *q) {
+	q->q0 = q0;
+	q->q1 = q1;
+	q->q2 = q2;
+	q->q3 = q3;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Baseline AHRS algorithm update with measured sample interval dt in seconds
+
+void MahonyAHRSBaselineUpdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
+	float recipNorm;
+    float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;  
+	float hx, hy, bx, bz;
+	float halfvx, halfvy, halfvz, halfwx, halfwy, halfwz;
+	float halfex, halfey, halfez;
+	float qa, qb, qc;
+
+	// Use IMU algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
+	if((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
+		MahonyAHRSBaselineUpdateIMU(gx, gy, gz, ax, ay, az, dt);
+		return;
+	}
+
+	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+
+		// Normalise accelerometer measurement
+		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		ax *= recipNorm;
+		ay *= recipNorm;
+		az *= recipNorm;     
+
+		// Normalise magnetometer measurement
+		recipNorm = invSqrt(mx * mx + my * my + mz * mz);
+		mx *= recipNorm;
+		my *= recipNorm;
+		mz *= recipNorm;   
+
+        // Auxiliary variables to avoid repeated arithmetic
+        q0q0 = q0 * q0;
+        q0q1 = q0 * q1;
+        q0q2 = q0 * q2;
+        q0q3 = q0 * q3;
+        q1q1 = q1 * q1;
+        q1q2 = q1 * q2;
+        q1q3 = q1 * q3;
+        q2q2 = q2 * q2;
+        q2q3 = q2 * q3;
+        q3q3 = q3 * q3;   
+
+        // Reference direction of Earth's magnetic field
+        hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+        hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+        bx = sqrt(hx * hx + hy * hy);
+        bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
+
+		// Estimated direction of gravity and magnetic field
+		halfvx = q1q3 - q0q2;
+		halfvy = q0q1 + q2q3;
+		halfvz = q0q0 - 0.5f + q3q3;
+        halfwx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+        halfwy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+        halfwz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);  
+	
+		// Error is sum of cross product between estimated direction and measured direction of field vectors
+		halfex = (ay * halfvz - az * halfvy) + (my * halfwz - mz * halfwy);
+		halfey = (az * halfvx - ax * halfvz) + (mz * halfwx - mx * halfwz);
+		halfez = (ax * halfvy - ay * halfvx) + (mx * halfwy - my * halfwx);
+
+		// Compute and apply integral feedback if enabled
+		if(twoKi > 0.0f) {
+			integralFBx += twoKi * halfex * dt;	// integral error scaled by Ki
+			integralFBy += twoKi * halfey * dt;
+			integralFBz += twoKi * halfez * dt;
+			gx += integralFBx;	// apply integral feedback
+			gy += integralFBy;
+			gz += integralFBz;
+		}
+		else {
+			integralFBx = 0.0f;	// prevent integral windup
+			integralFBy = 0.0f;
+			integralFBz = 0.0f;
+		}
+
+		// Apply proportional feedback
+		gx += twoKp * halfex;
+		gy += twoKp * halfey;
+		gz += twoKp * halfez;
+	}
+	
+	// Integrate rate of change of quaternion
+	gx *= (0.5f * dt);		// pre-multiply common factors
+	gy *= (0.5f * dt);
+	gz *= (0.5f * dt);
+	qa = q0;
+	qb = q1;
+	qc = q2;
+	q0 += (-qb * gx - qc * gy - q3 * gz);
+	q1 += (qa * gx + qc * gz - q3 * gy);
+	q2 += (qa * gy - qb * gz + q3 * gx);
+	q3 += (qa * gz + qb * gy - qc * gx); 
+	
+	// Normalise quaternion
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	q0 *= recipNorm;
+	q1 *= recipNorm;
+	q2 *= recipNorm;
+	q3 *= recipNorm;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Baseline IMU algorithm update with measured sample interval dt in seconds
+
+void MahonyAHRSBaselineUpdateIMU(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+	float recipNorm;
+	float halfvx, halfvy, halfvz;
+	float halfex, halfey, halfez;
+	float qa, qb, qc;
+
+	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+
+		// Normalise accelerometer measurement
+		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		ax *= recipNorm;
+		ay *= recipNorm;
+		az *= recipNorm;        
+
+		// Estimated direction of gravity and vector perpendicular to magnetic flux
+		halfvx = q1 * q3 - q0 * q2;
+		halfvy = q0 * q1 + q2 * q3;
+		halfvz = q0 * q0 - 0.5f + q3 * q3;
+	
+		// Error is sum of cross product between estimated and measured direction of gravity
+		halfex = (ay * halfvz - az * halfvy);
+		halfey = (az * halfvx - ax * halfvz);
+		halfez = (ax * halfvy - ay * halfvx);
+
+		// Compute and apply integral feedback if enabled
+		if(twoKi > 0.0f) {
+			integralFBx += twoKi * halfex * dt;	// integral error scaled by Ki
+			integralFBy += twoKi * halfey * dt;
+			integralFBz += twoKi * halfez * dt;
+			gx += integralFBx;	// apply integral feedback
+			gy += integralFBy;
+			gz += integralFBz;
+		}
+		else {
+			integralFBx = 0.0f;	// prevent integral windup
+			integralFBy = 0.0f;
+			integralFBz = 0.0f;
+		}
+
+		// Apply proportional feedback
+		gx += twoKp * halfex;
+		gy += twoKp * halfey;
+		gz += twoKp * halfez;
+	}
+	
+	// Integrate rate of change of quaternion
+	gx *= (0.5f * dt);		// pre-multiply common factors
+	gy *= (0.5f * dt);
+	gz *= (0.5f * dt);
+	qa = q0;
+	qb = q1;
+	qc = q2;
+	q0 += (-qb * gx - qc * gy - q3 * gz);
+	q1 += (qa * gx + qc * gz - q3 * gy);
+	q2 += (qa * gy - qb * gz + q3 * gx);
+	q3 += (qa * gz + qb * gy - qc * gx); 
+	
+	// Normalise quaternion
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	q0 *= recipNorm;
+	q1 *= recipNorm;
+	q2 *= recipNorm;
+	q3 *= recipNorm;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Fast inverse square-root
+// See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
+
+static float invSqrt(float x) {
+	float halfx = 0.5f * x;
+	union { float f; int32_t i; } y = { x };
+	y.i = 0x5f3759df - (y.i>>1);
+	y.f = y.f * (1.5f - (halfx * y.f * y.f));
+	return y.f;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Synthetic 1 kHz stream: slow wobble around all axes with tilted gravity and fixed field, gyro in
+// rad/s, accel in mg, mag in uT
+
+static void benchmarkFill(void) {
+	unsigned int i;
+	for(i = 0; i < benchmarkTableSize; i++) {
+		float phase = 8.0f * (float)i * benchmarkDt;
+		benchmarkSamples[i].gx = 0.3f * sinf(phase);
+		benchmarkSamples[i].gy = 0.1f;
+		benchmarkSamples[i].gz = -0.2f * cosf(2.0f * phase);
+		benchmarkSamples[i].ax = 300.0f + 50.0f * sinf(3.0f * phase);
+		benchmarkSamples[i].ay = -200.0f;
+		benchmarkSamples[i].az = 930.0f;
+		benchmarkSamples[i].dt = benchmarkDt;
+		benchmarkMag[i][0] = 20.0f;
+		benchmarkMag[i][1] = 5.0f + 2.0f * cosf(phase);
+		benchmarkMag[i][2] = -25.0f;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------
+// 9-axis update of the volatile-global baseline against MahonyAHRSupdateInstance over the same
+// benchmarkUpdates samples: cycles per update of each and worst quaternion element difference.
+// Then the IMU path over the same samples, one MahonyAHRSupdateIMUInstance call per sample against
+// MahonyAHRSupdateBatch in benchmarkBurst bursts: cycles per sample of each.
+
+void MahonyBenchmark_Run(void) {
+	MahonyAHRS_t instance;
+	MahonyAHRSquaternion_t baseline;
+	uint32_t baselineCycles, instanceCycles, singleCycles, batchCycles, start;
+	float maxError = 0.0f;
+	unsigned int i, j;
+
+	benchmarkFill();
+
+	MahonyAHRSBaselineInit(benchmarkTwoKp, benchmarkTwoKi);
+	taskENTER_CRITICAL();
+	start = GetCycleCount();
+	for(i = 0; i < benchmarkUpdates; i++) {
+		const MahonyAHRSsample_t *s = &benchmarkSamples[i % benchmarkTableSize];
+		const float *m = benchmarkMag[i % benchmarkTableSize];
+		MahonyAHRSBaselineUpdate(s->gx, s->gy, s->gz, s->ax, s->ay, s->az, m[0], m[1], m[2], s->dt);
+	}
+	baselineCycles = (GetCycleCount() - start) / benchmarkUpdates;
+	taskEXIT_CRITICAL();
+
+	MahonyAHRSinit(&instance, benchmarkTwoKp, benchmarkTwoKi);
+	taskENTER_CRITICAL();
+	start = GetCycleCount();
+	for(i = 0; i < benchmarkUpdates; i++) {
+		const MahonyAHRSsample_t *s = &benchmarkSamples[i % benchmarkTableSize];
+		const float *m = benchmarkMag[i % benchmarkTableSize];
+		MahonyAHRSupdateInstance(&instance, s->gx, s->gy, s->gz, s->ax, s->ay, s->az, m[0], m[1], m[2], s->dt);
+	}
+	instanceCycles = (GetCycleCount() - start) / benchmarkUpdates;
+	taskEXIT_CRITICAL();
+
+	// Both filters ended on the same stream, compare them after every update on a second pass
+	MahonyAHRSBaselineInit(benchmarkTwoKp, benchmarkTwoKi);
+	MahonyAHRSinit(&instance, benchmarkTwoKp, benchmarkTwoKi);
+	for(i = 0; i < benchmarkUpdates; i++) {
+		const MahonyAHRSsample_t *s = &benchmarkSamples[i % benchmarkTableSize];
+		const float *m = benchmarkMag[i % benchmarkTableSize];
+		MahonyAHRSBaselineUpdate(s->gx, s->gy, s->gz, s->ax, s->ay, s->az, m[0], m[1], m[2], s->dt);
+		MahonyAHRSupdateInstance(&instance, s->gx, s->gy, s->gz, s->ax, s->ay, s->az, m[0], m[1], m[2], s->dt);
+		MahonyAHRSBaselineGet(&baseline);
+		const float q[4] = { instance.q0, instance.q1, instance.q2, instance.q3 };
+		const float qBaseline[4] = { baseline.q0, baseline.q1, baseline.q2, baseline.q3 };
+		for(j = 0; j < 4; j++) {
+			float error = fabsf(q[j] - qBaseline[j]);
+			if(error > maxError) maxError = error;
+		}
+	}
+
+	MahonyAHRSinit(&instance, benchmarkTwoKp, benchmarkTwoKi);
+	taskENTER_CRITICAL();
+	start = GetCycleCount();
+	for(i = 0; i < benchmarkUpdates; i++) {
+		const MahonyAHRSsample_t *s = &benchmarkSamples[i % benchmarkTableSize];
+		MahonyAHRSupdateIMUInstance(&instance, s->gx, s->gy, s->gz, s->ax, s->ay, s->az, s->dt);
+	}
+	singleCycles = (GetCycleCount() - start) / benchmarkUpdates;
+	taskEXIT_CRITICAL();
+
+	MahonyAHRSinit(&instance, benchmarkTwoKp, benchmarkTwoKi);
+	taskENTER_CRITICAL();
+	start = GetCycleCount();
+	for(i = 0; i < benchmarkUpdates; i += benchmarkBurst) {
+		MahonyAHRSupdateBatch(&instance, &benchmarkSamples[i % benchmarkTableSize], benchmarkBurst, NULL);
+	}
+	batchCycles = (GetCycleCount() - start) / benchmarkUpdates;
+	taskEXIT_CRITICAL();
+
+	PrintToUart(eUart_1, "MAHONY x%u baseline[cyc] %u instance[cyc] %u max|dq| %e\r", (unsigned int)benchmarkUpdates,
+				(unsigned int)baselineCycles, (unsigned int)instanceCycles, maxError);
+	PrintToUart(eUart_1, "MAHONY IMU x%u single[cyc] %u batch x%u[cyc] %u\r", (unsigned int)benchmarkUpdates,
+				(unsigned int)singleCycles, (unsigned int)benchmarkBurst, (unsigned int)batchCycles);
+}
@@ -0,0 +1,425 @@
+//=====================================================================================================
+// MahonyAHRSFixed.c
+//=====================================================================================================
+//
+// Fixed-point port of Madgwick's implementation of Mayhony's AHRS algorithm (see MahonyAHRS.c).
+// Every operation is defined in terms of integer arithmetic with fixed rounding (truncation toward
+// minus infinity), so target and host builds produce identical bits.
+//
+//=====================================================================================================
+
+//---------------------------------------------------------------------------------------------------
+// Header files
+
+#include "MahonyAHRSFixed.h"
+#include <stdint.h>
+#include <math.h>
+#if defined(ARM_MATH_CM4)
+#include "stm32f3xx.h"	// CMSIS intrinsics
+#endif
+#include "FreeRTOS.h"
+#include "task.h"
+#include "MahonyAHRS.h"
+#include "timing_stats_api.h"
+#include "uart_api.h"
+
+//---------------------------------------------------------------------------------------------------
+// Definitions
+
+#define Q30_HALF		((int32_t)1 << 29)
+#define Q28_ONE			((int32_t)1 << 28)
+#define newtonSteps		4				// inverse square-root iterations, error below Q1.30 resolution
+#define benchmarkSamples	1000
+#define benchmarkDt			0.001f
+#define benchmarkTwoKp		(2.0f * 0.5f)
+#define benchmarkTwoKi		(2.0f * 0.1f)
+
+//---------------------------------------------------------------------------------------------------
+// Function declarations
+
+static inline int32_t mulQ30(int32_t a, int32_t b);
+static int normaliseQ30(int32_t *v, unsigned int n);
+static int32_t sqrtQ30(int32_t x);
+static inline unsigned int countLeadingZeros(uint32_t x);
+static int32_t invSqrtQ28(int32_t s);
+static void benchmarkSample(unsigned int index, float g[3], float a[3], float m[3]);
+
+//====================================================================================================
+// Functions
+
+//---------------------------------------------------------------------------------------------------
+// Instance initialisation
+
+void MahonyAHRSFixedInit(MahonyAHRSFixed_t *ahrs, int32_t twoKp, int32_t twoKi) {
+	ahrs->twoKp = twoKp;
+	ahrs->twoKi = twoKi;
+	ahrs->q0 = MAHONY_FIXED_ONE;
+	ahrs->q1 = 0;
+	ahrs->q2 = 0;
+	ahrs->q3 = 0;
+	ahrs->integralFBx = 0;
+	ahrs->integralFBy = 0;
+	ahrs->integralFBz = 0;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Integral and proportional feedback from error halfe* in Q1.30, added to gyroscope in g[] (Q16.16)
+
+static void applyFeedback(MahonyAHRSFixed_t *ahrs, int32_t g[3], int32_t halfex, int32_t halfey, int32_t halfez, int32_t dt) {
+	// Compute and apply integral feedback if enabled, twoKi * halfe * dt kept in Q8.24
+	if(ahrs->twoKi > 0) {
+		ahrs->integralFBx += (int32_t)(((((int64_t)ahrs->twoKi * halfex) >> 22) * dt) >> 30);
+		ahrs->integralFBy += (int32_t)(((((int64_t)ahrs->twoKi * halfey) >> 22) * dt) >> 30);
+		ahrs->integralFBz += (int32_t)(((((int64_t)ahrs->twoKi * halfez) >> 22) * dt) >> 30);
+		g[0] += ahrs->integralFBx >> 8;	// apply integral feedback
+		g[1] += ahrs->integralFBy >> 8;
+		g[2] += ahrs->integralFBz >> 8;
+	}
+	else {
+		ahrs->integralFBx = 0;	// prevent integral windup
+		ahrs->integralFBy = 0;
+		ahrs->integralFBz = 0;
+	}
+
+	// Apply proportional feedback
+	g[0] += (int32_t)(((int64_t)ahrs->twoKp * halfex) >> 30);
+	g[1] += (int32_t)(((int64_t)ahrs->twoKp * halfey) >> 30);
+	g[2] += (int32_t)(((int64_t)ahrs->twoKp * halfez) >> 30);
+}
+
+//---------------------------------------------------------------------------------------------------
+// Integrate rate of change of quaternion and normalise
+
+static void integrateQuaternion(MahonyAHRSFixed_t *ahrs, const int32_t g[3], int32_t dt) {
+	int32_t gx, gy, gz, qa, qb, qc;
+	int32_t q[4];
+
+	// Pre-multiply common factors, g * 0.5 * dt: Q16.16 * Q1.30 >> 17 gives Q1.30
+	gx = (int32_t)(((int64_t)g[0] * dt) >> 17);
+	gy = (int32_t)(((int64_t)g[1] * dt) >> 17);
+	gz = (int32_t)(((int64_t)g[2] * dt) >> 17);
+	qa = ahrs->q0;
+	qb = ahrs->q1;
+	qc = ahrs->q2;
+	q[0] = qa + (-mulQ30(qb, gx) - mulQ30(qc, gy) - mulQ30(ahrs->q3, gz));
+	q[1] = qb + (mulQ30(qa, gx) + mulQ30(qc, gz) - mulQ30(ahrs->q3, gy));
+	q[2] = qc + (mulQ30(qa, gy) - mulQ30(qb, gz) + mulQ30(ahrs->q3, gx));
+	q[3] = ahrs->q3 + (mulQ30(qa, gz) + mulQ30(qb, gy) - mulQ30(qc, gx));
+
+	// Normalise quaternion
+	if(normaliseQ30(q, 4)) {
+		ahrs->q0 = q[0];
+		ahrs->q1 = q[1];
+		ahrs->q2 = q[2];
+		ahrs->q3 = q[3];
+	}
+}
+
+//---------------------------------------------------------------------------------------------------
+// AHRS algorithm update
+
+void MahonyAHRSFixedUpdate(MahonyAHRSFixed_t *ahrs, int32_t gx, int32_t gy, int32_t gz, int32_t ax, int32_t ay, int32_t az, int32_t mx, int32_t my, int32_t mz, int32_t dt) {
+	int32_t a[3], m[3];
+	int32_t q0, q1, q2, q3;
+	int32_t q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
+	int32_t hx, hy, bx, bz;
+	int32_t halfvx, halfvy, halfvz, halfwx, halfwy, halfwz;
+	int32_t halfex, halfey, halfez;
+	int32_t g[3] = { gx, gy, gz };
+
+	// Use IMU algorithm if magnetometer measurement invalid (avoids division by zero in magnetometer normalisation)
+	if((mx == 0) && (my == 0) && (mz == 0)) {
+		MahonyAHRSFixedUpdateIMU(ahrs, gx, gy, gz, ax, ay, az, dt);
+		return;
+	}
+
+	// Compute feedback only if accelerometer measurement valid
+	a[0] = ax;
+	a[1] = ay;
+	a[2] = az;
+	m[0] = mx;
+	m[1] = my;
+	m[2] = mz;
+	if(normaliseQ30(a, 3) && normaliseQ30(m, 3)) {
+		q0 = ahrs->q0;
+		q1 = ahrs->q1;
+		q2 = ahrs->q2;
+		q3 = ahrs->q3;
+
+		// Auxiliary variables to avoid repeated arithmetic
+		q0q0 = mulQ30(q0, q0);
+		q0q1 = mulQ30(q0, q1);
+		q0q2 = mulQ30(q0, q2);
+		q0q3 = mulQ30(q0, q3);
+		q1q1 = mulQ30(q1, q1);
+		q1q2 = mulQ30(q1, q2);
+		q1q3 = mulQ30(q1, q3);
+		q2q2 = mulQ30(q2, q2);
+		q2q3 = mulQ30(q2, q3);
+		q3q3 = mulQ30(q3, q3);
+
+		// Reference direction of Earth's magnetic field
+		hx = 2 * (mulQ30(m[0], Q30_HALF - q2q2 - q3q3) + mulQ30(m[1], q1q2 - q0q3) + mulQ30(m[2], q1q3 + q0q2));
+		hy = 2 * (mulQ30(m[0], q1q2 + q0q3) + mulQ30(m[1], Q30_HALF - q1q1 - q3q3) + mulQ30(m[2], q2q3 - q0q1));
+		bx = sqrtQ30(mulQ30(hx, hx) + mulQ30(hy, hy));
+		bz = 2 * (mulQ30(m[0], q1q3 - q0q2) + mulQ30(m[1], q2q3 + q0q1) + mulQ30(m[2], Q30_HALF - q1q1 - q2q2));
+
+		// Estimated direction of gravity and magnetic field
+		halfvx = q1q3 - q0q2;
+		halfvy = q0q1 + q2q3;
+		halfvz = q0q0 - Q30_HALF + q3q3;
+		halfwx = mulQ30(bx, Q30_HALF - q2q2 - q3q3) + mulQ30(bz, q1q3 - q0q2);
+		halfwy = mulQ30(bx, q1q2 - q0q3) + mulQ30(bz, q0q1 + q2q3);
+		halfwz = mulQ30(bx, q0q2 + q1q3) + mulQ30(bz, Q30_HALF - q1q1 - q2q2);
+
+		// Error is sum of cross product between estimated direction and measured direction of field vectors
+		halfex = (mulQ30(a[1], halfvz) - mulQ30(a[2], halfvy)) + (mulQ30(m[1], halfwz) - mulQ30(m[2], halfwy));
+		halfey = (mulQ30(a[2], halfvx) - mulQ30(a[0], halfvz)) + (mulQ30(m[2], halfwx) - mulQ30(m[0], halfwz));
+		halfez = (mulQ30(a[0], halfvy) - mulQ30(a[1], halfvx)) + (mulQ30(m[0], halfwy) - mulQ30(m[1], halfwx));
+		applyFeedback(ahrs, g, halfex, halfey, halfez, dt);
+	}
+
+	integrateQuaternion(ahrs, g, dt);
+}
+
+//---------------------------------------------------------------------------------------------------
+// IMU algorithm update
+
+void MahonyAHRSFixedUpdateIMU(MahonyAHRSFixed_t *ahrs, int32_t gx, int32_t gy, int32_t gz, int32_t ax, int32_t ay, int32_t az, int32_t dt) {
+	int32_t a[3];
+	int32_t q0, q1, q2, q3;
+	int32_t halfvx, halfvy, halfvz;
+	int32_t halfex, halfey, halfez;
+	int32_t g[3] = { gx, gy, gz };
+
+	// Compute feedback only if accelerometer measurement valid
+	a[0] = ax;
+	a[1] = ay;
+	a[2] = az;
+	if(normaliseQ30(a, 3)) {
+		q0 = ahrs->q0;
+		q1 = ahrs->q1;
+		q2 = ahrs->q2;
+		q3 = ahrs->q3;
+
+		// Estimated direction of gravity and vector perpendicular to magnetic flux
+		halfvx = mulQ30(q1, q3) - mulQ30(q0, q2);
+		halfvy = mulQ30(q0, q1) + mulQ30(q2, q3);
+		halfvz = mulQ30(q0, q0) - Q30_HALF + mulQ30(q3, q3);
+
+		// Error is sum of cross product between estimated and measured direction of gravity
+		halfex = (mulQ30(a[1], halfvz) - mulQ30(a[2], halfvy));
+		halfey = (mulQ30(a[2], halfvx) - mulQ30(a[0], halfvz));
+		halfez = (mulQ30(a[0], halfvy) - mulQ30(a[1], halfvx));
+		applyFeedback(ahrs, g, halfex, halfey, halfez, dt);
+	}
+
+	integrateQuaternion(ahrs, g, dt);
+}
+
+//---------------------------------------------------------------------------------------------------
+// Q1.30 multiply: high word of 64-bit product (SMMUL) shifted back by 2, last 2 bits are dropped
+
+static inline int32_t mulQ30(int32_t a, int32_t b) {
+#if defined(ARM_MATH_CM4)
+	return (int32_t)((uint32_t)__SMMLA(a, b, 0) << 2);
+#else
+	return (int32_t)((uint32_t)(int32_t)(((int64_t)a * b) >> 32) << 2);
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------
+// Leading zero count, CLZ instruction on target
+
+static inline unsigned int countLeadingZeros(uint32_t x) {
+#if defined(ARM_MATH_CM4)
+	return __CLZ(x);
+#else
+	unsigned int n = 0;
+	if(x == 0) return 32;
+	while(!(x & 0x80000000u)) {
+		x <<= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------
+// Inverse square-root of s in [1, 4) given in Q4.28, result in Q4.28, Newton iterations from linear guess
+
+static int32_t invSqrtQ28(int32_t s) {
+	int32_t y = (int32_t)((((int64_t)7 << 28) - s) / 6);		// 7/6 - s/6
+	int32_t y2, t;
+	int i;
+	for(i = 0; i < newtonSteps; i++) {
+		y2 = (int32_t)(((int64_t)y * y) >> 28);
+		t = (int32_t)(((int64_t)s * y2) >> 28);
+		y = (int32_t)(((int64_t)y * (3 * Q28_ONE - t)) >> 29);
+	}
+	return y;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Scales vector of up to 4 elements to unit length in Q1.30, returns 0 for zero vector
+
+static int normaliseQ30(int32_t *v, unsigned int n) {
+	uint32_t maxAbs = 0;
+	int32_t sum, y;
+	int64_t sumSq = 0;
+	int shift, post = 0;
+	unsigned int i;
+
+	for(i = 0; i < n; i++) {
+		uint32_t absValue = (v[i] < 0) ? (uint32_t)0 - (uint32_t)v[i] : (uint32_t)v[i];
+		if(absValue > maxAbs) maxAbs = absValue;
+	}
+	if(maxAbs == 0) return 0;
+
+	// Exact power of two scaling so that largest element is in [0.5, 1) of Q1.30
+	shift = (int)countLeadingZeros(maxAbs) - 2;
+	for(i = 0; i < n; i++) {
+		if(shift >= 0) {
+			v[i] = (int32_t)((uint32_t)v[i] << shift);
+		}
+		else {
+			v[i] = v[i] >> -shift;
+		}
+		sumSq += (int64_t)v[i] * v[i];
+	}
+
+	// Sum of squares in [0.25, 4] as Q4.28, moved to [1, 4) with a factor 4 compensated after
+	sum = (int32_t)(sumSq >> 32);
+	if(sum < Q28_ONE) {
+		sum <<= 2;
+		post = 1;
+	}
+	y = invSqrtQ28(sum);
+	for(i = 0; i < n; i++) {
+		v[i] = (int32_t)(((int64_t)v[i] * y) >> (28 - post));
+	}
+	return 1;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Square-root of Q1.30 value in [0, 2), x is scaled by an even power of two 4^j into [1, 4) of Q4.28
+// so that sqrt(x) = sqrt(s) / 2^j with sqrt(s) = s * invSqrt(s)
+
+static int32_t sqrtQ30(int32_t x) {
+	int32_t s;
+	int64_t r;
+	int twoJ;
+
+	if(x <= 0) return 0;
+	twoJ = (int)(countLeadingZeros((uint32_t)x) & ~1u);	// top bit moves to bit 28 or 29
+	s = (twoJ >= 2) ? (int32_t)((uint32_t)x << (twoJ - 2)) : (x >> 2);
+	r = ((int64_t)s * invSqrtQ28(s)) >> 28;		// sqrt(s) in Q4.28
+	return (int32_t)((r << 2) >> (twoJ / 2));
+}
+
+//---------------------------------------------------------------------------------------------------
+// FNV-1a over quaternion and integral terms, equal on every build for equal inputs
+
+uint32_t MahonyAHRSFixedChecksum(const MahonyAHRSFixed_t *ahrs) {
+	const int32_t state[7] = { ahrs->q0, ahrs->q1, ahrs->q2, ahrs->q3, ahrs->integralFBx, ahrs->integralFBy, ahrs->integralFBz };
+	uint32_t checksum = 2166136261u;
+	unsigned int i, byte;
+	for(i = 0; i < 7; i++) {
+		for(byte = 0; byte < 4; byte++) {
+			checksum ^= ((uint32_t)state[i] >> (8 * byte)) & 0xFFu;
+			checksum *= 16777619u;
+		}
+	}
+	return checksum;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Benchmark against float MahonyAHRS.c over the same stream: cycles per update, worst quaternion
+// element difference, and the checksum of the final fixed-point state. The filter is bit-exact by
+// design, but this stream comes from sinf, so the checksum only matches across builds whose sinf
+// agrees; Tests/test_mahony_fixed.c pins checksums on an integer stream that matches everywhere.
+
+void MahonyFixedBenchmark_Run(void) {
+	static float gyro[benchmarkSamples][3];
+	static float acc[benchmarkSamples][3];
+	static float mag[benchmarkSamples][3];
+	static int32_t gyroFixed[benchmarkSamples][3];
+	MahonyAHRS_t reference;
+	MahonyAHRSFixed_t fixed;
+	const int32_t dtFixed = MAHONY_FIXED_Q30(benchmarkDt);
+	uint32_t floatCycles, fixedCycles, start;
+	float maxError = 0.0f;
+	unsigned int i, j;
+
+	for(i = 0; i < benchmarkSamples; i++) {
+		benchmarkSample(i, gyro[i], acc[i], mag[i]);
+		for(j = 0; j < 3; j++) {
+			gyroFixed[i][j] = MAHONY_FIXED_Q16(gyro[i][j]);
+		}
+	}
+
+	MahonyAHRSinit(&reference, benchmarkTwoKp, benchmarkTwoKi);
+	taskENTER_CRITICAL();
+	start = GetCycleCount();
+	for(i = 0; i < benchmarkSamples; i++) {
+		MahonyAHRSupdateInstance(&reference, gyro[i][0], gyro[i][1], gyro[i][2], acc[i][0], acc[i][1], acc[i][2],
+								 mag[i][0], mag[i][1], mag[i][2], benchmarkDt);
+	}
+	floatCycles = (GetCycleCount() - start) / benchmarkSamples;
+	taskEXIT_CRITICAL();
+
+	MahonyAHRSFixedInit(&fixed, MAHONY_FIXED_Q16(benchmarkTwoKp), MAHONY_FIXED_Q16(benchmarkTwoKi));
+	taskENTER_CRITICAL();
+	start = GetCycleCount();
+	for(i = 0; i < benchmarkSamples; i++) {
+		MahonyAHRSFixedUpdate(&fixed, gyroFixed[i][0], gyroFixed[i][1], gyroFixed[i][2],
+							  (int32_t)acc[i][0], (int32_t)acc[i][1], (int32_t)acc[i][2],
+							  (int32_t)mag[i][0], (int32_t)mag[i][1], (int32_t)mag[i][2], dtFixed);
+	}
+	fixedCycles = (GetCycleCount() - start) / benchmarkSamples;
+	taskEXIT_CRITICAL();
+
+	// Accuracy pass runs both filters in lockstep so the error is taken after every update
+	MahonyAHRSinit(&reference, benchmarkTwoKp, benchmarkTwoKi);
+	MahonyAHRSFixedInit(&fixed, MAHONY_FIXED_Q16(benchmarkTwoKp), MAHONY_FIXED_Q16(benchmarkTwoKi));
+	for(i = 0; i < benchmarkSamples; i++) {
+		MahonyAHRSupdateInstance(&reference, gyro[i][0], gyro[i][1], gyro[i][2], acc[i][0], acc[i][1], acc[i][2],
+								 mag[i][0], mag[i][1], mag[i][2], benchmarkDt);
+		MahonyAHRSFixedUpdate(&fixed, gyroFixed[i][0], gyroFixed[i][1], gyroFixed[i][2],
+							  (int32_t)acc[i][0], (int32_t)acc[i][1], (int32_t)acc[i][2],
+							  (int32_t)mag[i][0], (int32_t)mag[i][1], (int32_t)mag[i][2], dtFixed);
+		const float q[4] = {
+			(float)fixed.q0 / MAHONY_FIXED_ONE, (float)fixed.q1 / MAHONY_FIXED_ONE,
+			(float)fixed.q2 / MAHONY_FIXED_ONE, (float)fixed.q3 / MAHONY_FIXED_ONE,
+		};
+		const float qReference[4] = { reference.q0, reference.q1, reference.q2, reference.q3 };
+		for(j = 0; j < 4; j++) {
+			float error = fabsf(q[j] - qReference[j]);
+			if(error > maxError) maxError = error;
+		}
+	}
+
+	PrintToUart(eUart_1, "MAHONY float[cyc] %u fixed[cyc] %u max|dq| %e state %08x\r",
+				(unsigned int)floatCycles, (unsigned int)fixedCycles, maxError, (unsigned int)MahonyAHRSFixedChecksum(&fixed));
+}
+
+//---------------------------------------------------------------------------------------------------
+// Synthetic 1 kHz benchmark stream: slow wobble around all axes with tilted gravity and fixed field,
+// gyro in rad/s, accel in mg, mag in uT
+
+static void benchmarkSample(unsigned int index, float g[3], float a[3], float m[3]) {
+	float phase = (float)index * benchmarkDt;
+	g[0] = 0.3f * sinf(phase);
+	g[1] = 0.1f;
+	g[2] = -0.2f * cosf(2.0f * phase);
+	a[0] = 300.0f + 50.0f * sinf(3.0f * phase);
+	a[1] = -200.0f;
+	a[2] = 930.0f;
+	m[0] = 20.0f;
+	m[1] = 5.0f;
+	m[2] = -25.0f;
+}
+
+//====================================================================================================
+// END OF CODE
+//====================================================================================================
@@ -0,0 +1,411 @@
+#include "attitude_estimator_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "mpu9250_api.h"
+#include "MahonyAHRS.h"
+#include "MadgwickAHRS.h"
+#include "mekf_api.h"
+#include "multirate_fusion_api.h"
+#include "fusion_math_api.h"
+#include "uart_api.h"
+
+
+/* Checked with Tests/bench_attitude_estimators.c on its 30 s handheld stream (1 kHz, magnetometer at 100 Hz). On target
+ * GyroBias takes gyro bias out in front of the estimator and the FIFO path passes no magnetometer, so gains are
+ * chosen on RMS tilt error with bias removed; figures in degrees.
+ * Mahony: twoKp 0.25 to 1.0 all land at 0.020-0.024, higher lets vibration through (0.048 at 8). twoKi stays 0 as
+ * there is no bias left to integrate, it would only matter without GyroBias (0.3 dps raw bias: 0.77 at 0, 0.31 at 0.1).
+ * Madgwick: published beta, 0.068; 0.033 gets 0.048 but heading with raw bias goes from 1.8 to 2.4.
+ * MultiRate: 0.055 against 0.022 correcting every sample and 0.108 every 20th, for a tenth of the correction cost.
+ * MEKF: acc 1e-2 gives 0.024 (1e-3: 0.029, 1: 0.138 with raw bias as correction starts to lag). Mag 5e-2 costs 0.004
+ * of heading against 1e-2 (0.083 vs 0.079 with magnetometer) and gives disturbed fields less weight.
+ * Boot: 50 samples average the stream's 8 mg accelerometer noise to ~1 mg, 0.06 of tilt; raised gain for 2 s pulls in
+ * whatever the average got wrong if the device was not quite still. */
+#define HARDCODED_MAHONY_TWO_KP     (2.0f * 0.5f)
+#define HARDCODED_MAHONY_TWO_KI     (2.0f * 0.0f)
+#define HARDCODED_MADGWICK_BETA     0.1f
+#define HARDCODED_MULTIRATE_DECIMATION  10  // 100 Hz correction at 1 kHz ODR
+#define HARDCODED_MEKF_ACC_VARIANCE     1.0e-2f
+#define HARDCODED_MEKF_MAG_VARIANCE     5.0e-2f
+#define HARDCODED_BOOT_ALIGN_SAMPLES    50      // 50 ms at 1 kHz ODR
+#define HARDCODED_BOOT_GAIN_SCALE       10.0f
+#define HARDCODED_BOOT_RAMP_TIME        2.0f
+/* Below this |sin| between gravity and heading reference, the next fallback axis is used */
+#define BOOT_ALIGN_MIN_SIN              0.1f
+
+static void Estimator_MahonyInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config);
+static void Estimator_MahonyUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt);
+static void Estimator_MahonyGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion);
+static void Estimator_MahonyGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias);
+static void Estimator_MahonySetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion);
+static void Estimator_MahonySetGainScale (sAttitudeEstimator_t *Estimator, float Scale);
+static void Estimator_MadgwickInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config);
+static void Estimator_MadgwickUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt);
+static void Estimator_MadgwickGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion);
+static void Estimator_MadgwickGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias);
+static void Estimator_MadgwickSetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion);
+static void Estimator_MadgwickSetGainScale (sAttitudeEstimator_t *Estimator, float Scale);
+static void Estimator_MekfInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config);
+static void Estimator_MekfUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt);
+static void Estimator_MekfGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion);
+static void Estimator_MekfGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias);
+static void Estimator_MekfSetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion);
+static void Estimator_MekfSetGainScale (sAttitudeEstimator_t *Estimator, float Scale);
+static void Estimator_MultiRateInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config);
+static void Estimator_MultiRateUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt);
+static void Estimator_MultiRateGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion);
+static void Estimator_MultiRateGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias);
+static void Estimator_MultiRateSetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion);
+static void Estimator_MultiRateSetGainScale (sAttitudeEstimator_t *Estimator, float Scale);
+
+const struct {
+    const char *Name;
+    void (*Init) (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config);
+    void (*Update) (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt);
+    void (*GetQuaternion) (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion);
+    void (*GetGyroBias) (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias);
+    void (*SetQuaternion) (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion);
+    void (*SetGainScale) (sAttitudeEstimator_t *Estimator, float Scale);
+} AttitudeEstimatorDescriptor[eAttitudeEstimator_Last] = {
+    [eAttitudeEstimator_Mahony]     = {"Mahony",    Estimator_MahonyInit,   Estimator_MahonyUpdate,     Estimator_MahonyGetQuaternion,      Estimator_MahonyGetGyroBias,    Estimator_MahonySetQuaternion,      Estimator_MahonySetGainScale},
+    [eAttitudeEstimator_Madgwick]   = {"Madgwick",  Estimator_MadgwickInit, Estimator_MadgwickUpdate,   Estimator_MadgwickGetQuaternion,    Estimator_MadgwickGetGyroBias,  Estimator_MadgwickSetQuaternion,    Estimator_MadgwickSetGainScale},
+    [eAttitudeEstimator_Mekf]       = {"MEKF",      Estimator_MekfInit,     Estimator_MekfUpdate,       Estimator_MekfGetQuaternion,        Estimator_MekfGetGyroBias,      Estimator_MekfSetQuaternion,        Estimator_MekfSetGainScale},
+    [eAttitudeEstimator_MultiRate]  = {"MultiRate", Estimator_MultiRateInit, Estimator_MultiRateUpdate, Estimator_MultiRateGetQuaternion,   Estimator_MultiRateGetGyroBias, Estimator_MultiRateSetQuaternion,   Estimator_MultiRateSetGainScale},
+};
+
+
+static void Estimator_MahonyInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config) {
+    MahonyAHRSinit(&Estimator->State.Mahony, Config->TwoKp, Config->TwoKi);
+}
+
+static void Estimator_MahonyUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt) {
+    if (Mag != NULL) {
+        MahonyAHRSupdateInstance(&Estimator->State.Mahony, Gyro->X, Gyro->Y, Gyro->Z, Acc->X, Acc->Y, Acc->Z, Mag->X, Mag->Y, Mag->Z, Dt);
+    } else {
+        MahonyAHRSupdateIMUInstance(&Estimator->State.Mahony, Gyro->X, Gyro->Y, Gyro->Z, Acc->X, Acc->Y, Acc->Z, Dt);
+    }
+}
+
+static void Estimator_MahonyGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion) {
+    *Quaternion = (sQuaternion_t) {Estimator->State.Mahony.q0, Estimator->State.Mahony.q1, Estimator->State.Mahony.q2, Estimator->State.Mahony.q3};
+}
+
+/* Integral feedback is added to gyro rate, so it converges to negative bias */
+static void Estimator_MahonyGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias) {
+    *Bias = (sData3D_t) {-Estimator->State.Mahony.integralFBx, -Estimator->State.Mahony.integralFBy, -Estimator->State.Mahony.integralFBz};
+}
+
+static void Estimator_MahonySetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion) {
+    Estimator->State.Mahony.q0 = Quaternion->W;
+    Estimator->State.Mahony.q1 = Quaternion->X;
+    Estimator->State.Mahony.q2 = Quaternion->Y;
+    Estimator->State.Mahony.q3 = Quaternion->Z;
+}
+
+/* Only proportional gain is raised, integral term would wind up on the initial error */
+static void Estimator_MahonySetGainScale (sAttitudeEstimator_t *Estimator, float Scale) {
+    Estimator->State.Mahony.twoKp = Estimator->Config.TwoKp * Scale;
+}
+
+static void Estimator_MadgwickInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config) {
+    MadgwickAHRSinit(&Estimator->State.Madgwick, Config->Beta);
+}
+
+static void Estimator_MadgwickUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt) {
+    if (Mag != NULL) {
+        MadgwickAHRSupdateInstance(&Estimator->State.Madgwick, Gyro->X, Gyro->Y, Gyro->Z, Acc->X, Acc->Y, Acc->Z, Mag->X, Mag->Y, Mag->Z, Dt);
+    } else {
+        MadgwickAHRSupdateIMUInstance(&Estimator->State.Madgwick, Gyro->X, Gyro->Y, Gyro->Z, Acc->X, Acc->Y, Acc->Z, Dt);
+    }
+}
+
+static void Estimator_MadgwickGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion) {
+    *Quaternion = (sQuaternion_t) {Estimator->State.Madgwick.q0, Estimator->State.Madgwick.q1, Estimator->State.Madgwick.q2, Estimator->State.Madgwick.q3};
+}
+
+/* Plain gradient descent filter does not estimate bias */
+static void Estimator_MadgwickGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias) {
+    (void)Estimator;
+    *Bias = (sData3D_t) {0.0f, 0.0f, 0.0f};
+}
+
+static void Estimator_MadgwickSetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion) {
+    Estimator->State.Madgwick.q0 = Quaternion->W;
+    Estimator->State.Madgwick.q1 = Quaternion->X;
+    Estimator->State.Madgwick.q2 = Quaternion->Y;
+    Estimator->State.Madgwick.q3 = Quaternion->Z;
+}
+
+static void Estimator_MadgwickSetGainScale (sAttitudeEstimator_t *Estimator, float Scale) {
+    Estimator->State.Madgwick.beta = Estimator->Config.Beta * Scale;
+}
+
+static void Estimator_MekfInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config) {
+    Mekf_Init(&Estimator->State.Mekf);
+    Estimator->State.Mekf.AccVariance = Config->AccVariance;
+    Estimator->State.Mekf.MagVariance = Config->MagVariance;
+}
+
+static void Estimator_MekfUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt) {
+    Mekf_Predict(&Estimator->State.Mekf, Gyro, Dt);
+    Mekf_UpdateAcc(&Estimator->State.Mekf, Acc);
+    if (Mag != NULL) {
+        Mekf_UpdateMag(&Estimator->State.Mekf, Mag);
+    }
+}
+
+static void Estimator_MekfGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion) {
+    *Quaternion = (sQuaternion_t) {Estimator->State.Mekf.Q[0], Estimator->State.Mekf.Q[1], Estimator->State.Mekf.Q[2], Estimator->State.Mekf.Q[3]};
+}
+
+static void Estimator_MekfGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias) {
+    *Bias = (sData3D_t) {Estimator->State.Mekf.Bias[0], Estimator->State.Mekf.Bias[1], Estimator->State.Mekf.Bias[2]};
+}
+
+static void Estimator_MekfSetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion) {
+    Estimator->State.Mekf.Q[0] = Quaternion->W;
+    Estimator->State.Mekf.Q[1] = Quaternion->X;
+    Estimator->State.Mekf.Q[2] = Quaternion->Y;
+    Estimator->State.Mekf.Q[3] = Quaternion->Z;
+}
+
+/* Filter has no gain, trusting measurements more has the same effect */
+static void Estimator_MekfSetGainScale (sAttitudeEstimator_t *Estimator, float Scale) {
+    Estimator->State.Mekf.AccVariance = Estimator->Config.AccVariance / Scale;
+    Estimator->State.Mekf.MagVariance = Estimator->Config.MagVariance / Scale;
+}
+
+static void Estimator_MultiRateInit (sAttitudeEstimator_t *Estimator, const sAttitudeEstimatorConfig_t *Config) {
+    MultiRateFusion_Init(&Estimator->State.MultiRate, Config->TwoKp, Config->TwoKi, Config->CorrectionDecimation);
+}
+
+static void Estimator_MultiRateUpdate (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt) {
+    MultiRateFusion_Update(&Estimator->State.MultiRate, Gyro, Acc, Mag, Dt);
+}
+
+static void Estimator_MultiRateGetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion) {
+    const sMultiRateFusion_t *Fusion = &Estimator->State.MultiRate;
+    *Quaternion = (sQuaternion_t) {Fusion->Q[0], Fusion->Q[1], Fusion->Q[2], Fusion->Q[3]};
+}
+
+/* Integral feedback is added to gyro rate, so it converges to negative bias */
+static void Estimator_MultiRateGetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias) {
+    const sMultiRateFusion_t *Fusion = &Estimator->State.MultiRate;
+    *Bias = (sData3D_t) {-Fusion->IntegralFeedback[0], -Fusion->IntegralFeedback[1], -Fusion->IntegralFeedback[2]};
+}
+
+static void Estimator_MultiRateSetQuaternion (sAttitudeEstimator_t *Estimator, const sQuaternion_t *Quaternion) {
+    sMultiRateFusion_t *Fusion = &Estimator->State.MultiRate;
+    Fusion->Q[0] = Quaternion->W;
+    Fusion->Q[1] = Quaternion->X;
+    Fusion->Q[2] = Quaternion->Y;
+    Fusion->Q[3] = Quaternion->Z;
+}
+
+static void Estimator_MultiRateSetGainScale (sAttitudeEstimator_t *Estimator, float Scale) {
+    Estimator->State.MultiRate.TwoKp = Estimator->Config.TwoKp * Scale;
+}
+
+/* TRIAD: earth Z is the averaged accelerometer, earth X the part of the heading reference orthogonal to it.
+ * Heading reference is the averaged magnetometer, without one yaw is taken as zero from the sensor X
+ * (or Y when X points along gravity) axis. Rows of R are earth axes in sensor frame, as in MultiRate. */
+static bool AttitudeEstimator_Triad (const sData3D_t *Acc, const sData3D_t *Mag, sQuaternion_t *Quaternion) {
+    const float Fallback[2][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+    float R[3][3] = {{0.0f}, {0.0f}, {Acc->X, Acc->Y, Acc->Z}};
+    bool Found = false;
+    if (!Math_Normalise3(R[2])) {
+        return false;
+    }
+    for (unsigned int i = (Mag != NULL) ? 0 : 1; (i < 3) && !Found; i++) {
+        float Heading[3];
+        if (i == 0) {
+            Heading[0] = Mag->X;
+            Heading[1] = Mag->Y;
+            Heading[2] = Mag->Z;
+        } else {
+            Heading[0] = Fallback[i - 1][0];
+            Heading[1] = Fallback[i - 1][1];
+            Heading[2] = Fallback[i - 1][2];
+        }
+        /* Earth Y (West in NWU) = Z x heading, its length is |sin| of angle between them */
+        if (Math_Normalise3(Heading)) {
+            Math_Cross3(R[2], Heading, R[1]);
+            Found = (R[1][0] * R[1][0] + R[1][1] * R[1][1] + R[1][2] * R[1][2]) > (BOOT_ALIGN_MIN_SIN * BOOT_ALIGN_MIN_SIN);
+        }
+    }
+    if (!Found || !Math_Normalise3(R[1])) {
+        return false;
+    }
+    Math_Cross3(R[1], R[2], R[0]);
+    /* Rotation matrix to quaternion, branch on largest diagonal term for accuracy */
+    float Trace = R[0][0] + R[1][1] + R[2][2];
+    float Q[4];
+    if (Trace > 0.0f) {
+        float S = 0.5f / Math_Sqrt(Trace + 1.0f);
+        Q[0] = 0.25f / S;
+        Q[1] = (R[2][1] - R[1][2]) * S;
+        Q[2] = (R[0][2] - R[2][0]) * S;
+        Q[3] = (R[1][0] - R[0][1]) * S;
+    } else if ((R[0][0] > R[1][1]) && (R[0][0] > R[2][2])) {
+        float S = 2.0f * Math_Sqrt(1.0f + R[0][0] - R[1][1] - R[2][2]);
+        Q[0] = (R[2][1] - R[1][2]) / S;
+        Q[1] = 0.25f * S;
+        Q[2] = (R[0][1] + R[1][0]) / S;
+        Q[3] = (R[0][2] + R[2][0]) / S;
+    } else if (R[1][1] > R[2][2]) {
+        float S = 2.0f * Math_Sqrt(1.0f + R[1][1] - R[0][0] - R[2][2]);
+        Q[0] = (R[0][2] - R[2][0]) / S;
+        Q[1] = (R[0][1] + R[1][0]) / S;
+        Q[2] = 0.25f * S;
+        Q[3] = (R[1][2] + R[2][1]) / S;
+    } else {
+        float S = 2.0f * Math_Sqrt(1.0f + R[2][2] - R[0][0] - R[1][1]);
+        Q[0] = (R[1][0] - R[0][1]) / S;
+        Q[1] = (R[0][2] + R[2][0]) / S;
+        Q[2] = (R[1][2] + R[2][1]) / S;
+        Q[3] = 0.25f * S;
+    }
+    Math_Normalise4(Q);
+    *Quaternion = (sQuaternion_t) {Q[0], Q[1], Q[2], Q[3]};
+    return true;
+}
+
+static void AttitudeEstimator_StartRamp (sAttitudeEstimator_t *Estimator) {
+    Estimator->Boot.Elapsed = 0.0f;
+    if ((Estimator->Config.BootRampTime > 0.0f) && (Estimator->Config.BootGainScale > 1.0f)) {
+        Estimator->Boot.Phase = eAttitudeBootPhase_Ramp;
+        AttitudeEstimatorDescriptor[Estimator->Engine].SetGainScale(Estimator, Estimator->Config.BootGainScale);
+    } else {
+        Estimator->Boot.Phase = eAttitudeBootPhase_Done;
+    }
+}
+
+/* Gyro is not integrated while averaging, device is expected to be roughly still for these few samples */
+static void AttitudeEstimator_Align (sAttitudeEstimator_t *Estimator, const sData3D_t *Acc, const sData3D_t *Mag) {
+    sAttitudeBoot_t *Boot = &Estimator->Boot;
+    Boot->AccSum.X += Acc->X;
+    Boot->AccSum.Y += Acc->Y;
+    Boot->AccSum.Z += Acc->Z;
+    Boot->AccCount++;
+    if (Mag != NULL) {
+        Boot->MagSum.X += Mag->X;
+        Boot->MagSum.Y += Mag->Y;
+        Boot->MagSum.Z += Mag->Z;
+        Boot->MagCount++;
+    }
+    if (Boot->AccCount >= Estimator->Config.BootAlignSamples) {
+        sQuaternion_t Quaternion;
+        /* Sums point the same way as averages */
+        if (AttitudeEstimator_Triad(&Boot->AccSum, (Boot->MagCount > 0) ? &Boot->MagSum : NULL, &Quaternion)) {
+            AttitudeEstimatorDescriptor[Estimator->Engine].SetQuaternion(Estimator, &Quaternion);
+        }
+        AttitudeEstimator_StartRamp(Estimator);
+    }
+}
+
+/* Gain falls linearly from BootGainScale to 1 over BootRampTime */
+static void AttitudeEstimator_Ramp (sAttitudeEstimator_t *Estimator, float Dt) {
+    Estimator->Boot.Elapsed += Dt;
+    if (Estimator->Boot.Elapsed >= Estimator->Config.BootRampTime) {
+        Estimator->Boot.Phase = eAttitudeBootPhase_Done;
+        AttitudeEstimatorDescriptor[Estimator->Engine].SetGainScale(Estimator, 1.0f);
+    } else {
+        float Remaining = 1.0f - Estimator->Boot.Elapsed / Estimator->Config.BootRampTime;
+        AttitudeEstimatorDescriptor[Estimator->Engine].SetGainScale(Estimator, 1.0f + (Estimator->Config.BootGainScale - 1.0f) * Remaining);
+    }
+}
+
+void AttitudeEstimator_GetDefaultConfig (sAttitudeEstimatorConfig_t *Config) {
+    /* Input check */
+    if (Config != NULL) {
+        Config->TwoKp = HARDCODED_MAHONY_TWO_KP;
+        Config->TwoKi = HARDCODED_MAHONY_TWO_KI;
+        Config->Beta = HARDCODED_MADGWICK_BETA;
+        Config->AccVariance = HARDCODED_MEKF_ACC_VARIANCE;
+        Config->MagVariance = HARDCODED_MEKF_MAG_VARIANCE;
+        Config->CorrectionDecimation = HARDCODED_MULTIRATE_DECIMATION;
+        Config->BootAlignSamples = HARDCODED_BOOT_ALIGN_SAMPLES;
+        Config->BootGainScale = HARDCODED_BOOT_GAIN_SCALE;
+        Config->BootRampTime = HARDCODED_BOOT_RAMP_TIME;
+    }
+}
+
+bool AttitudeEstimator_Init (sAttitudeEstimator_t *Estimator, eAttitudeEstimator_t Engine) {
+    sAttitudeEstimatorConfig_t Config;
+    AttitudeEstimator_GetDefaultConfig(&Config);
+    return AttitudeEstimator_InitWithConfig(Estimator, Engine, &Config);
+}
+
+/* All state lives in Estimator, instances with different configs can run side by side (e.g. gain sweeps) */
+bool AttitudeEstimator_InitWithConfig (sAttitudeEstimator_t *Estimator, eAttitudeEstimator_t Engine, const sAttitudeEstimatorConfig_t *Config) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Estimator != NULL) && (Engine < eAttitudeEstimator_Last) && (Config != NULL)) {
+        Estimator->Engine = Engine;
+        Estimator->Config = *Config;
+        Estimator->Boot = (sAttitudeBoot_t) {0};
+        AttitudeEstimatorDescriptor[Engine].Init(Estimator, Config);
+        if (Config->BootAlignSamples == 0) {
+            AttitudeEstimator_StartRamp(Estimator);
+        }
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* Gyro in rad/s, Mag is NULL when there is no new magnetometer sample */
+bool AttitudeEstimator_Update (sAttitudeEstimator_t *Estimator, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Estimator != NULL) && (Estimator->Engine < eAttitudeEstimator_Last) && (Gyro != NULL) && (Acc != NULL)) {
+        if (Estimator->Boot.Phase == eAttitudeBootPhase_Align) {
+            AttitudeEstimator_Align(Estimator, Acc, Mag);
+        } else {
+            AttitudeEstimatorDescriptor[Estimator->Engine].Update(Estimator, Gyro, Acc, Mag, Dt);
+            if (Estimator->Boot.Phase == eAttitudeBootPhase_Ramp) {
+                AttitudeEstimator_Ramp(Estimator, Dt);
+            }
+        }
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+bool AttitudeEstimator_GetQuaternion (const sAttitudeEstimator_t *Estimator, sQuaternion_t *Quaternion) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Estimator != NULL) && (Estimator->Engine < eAttitudeEstimator_Last) && (Quaternion != NULL)) {
+        AttitudeEstimatorDescriptor[Estimator->Engine].GetQuaternion(Estimator, Quaternion);
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* rad/s, to be subtracted from gyro reading */
+bool AttitudeEstimator_GetGyroBias (const sAttitudeEstimator_t *Estimator, sData3D_t *Bias) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Estimator != NULL) && (Estimator->Engine < eAttitudeEstimator_Last) && (Bias != NULL)) {
+        AttitudeEstimatorDescriptor[Estimator->Engine].GetGyroBias(Estimator, Bias);
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+eAttitudeBootPhase_t AttitudeEstimator_GetBootPhase (const sAttitudeEstimator_t *Estimator) {
+    return (Estimator != NULL) ? Estimator->Boot.Phase : eAttitudeBootPhase_Align;
+}
+
+const char *AttitudeEstimator_GetName (eAttitudeEstimator_t Engine) {
+    return (Engine < eAttitudeEstimator_Last) ? AttitudeEstimatorDescriptor[Engine].Name : "?";
+}
+
+void AttitudeEstimator_Print (const sAttitudeEstimator_t *Estimator) {
+    sQuaternion_t Quaternion;
+    if (AttitudeEstimator_GetQuaternion(Estimator, &Quaternion)) {
+        PrintToUart(eUart_1, "%s q0: %f\tq1: %f\tq2: %f\t q3: %f\r", AttitudeEstimator_GetName(Estimator->Engine),
+                    Quaternion.W, Quaternion.X, Quaternion.Y, Quaternion.Z);
+    }
+}
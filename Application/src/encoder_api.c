@@ -0,0 +1,142 @@
+#include "encoder_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "spi_api.h"
+#include "uart_api.h"
+
+
+#define AS5048_CMD_READ_ANGLE       0xFFFF      // read 0x3FFF, with parity
+#define AS5048_CMD_CLEAR_ERROR      0x4001      // read 0x0001, reading clears the error register
+#define AS5048_PARITY_BIT           0x8000
+#define AS5048_ERROR_FLAG           0x4000
+#define AS5048_DATA_MASK            0x3FFF
+#define AS5048_COUNTS               16384.0f
+#define TWO_PI                      6.28318531f
+
+/* Frame position in the chain for each motor: first frame clocked in comes from the last device, whose MISO is on the bus.
+ * Change to match the wiring. */
+static const unsigned int g_EncoderChainPosition[eMotor_Last] = {
+    [eMotor_Roll]  = 2,
+    [eMotor_Pitch] = 1,
+    [eMotor_Yaw]   = 0,
+};
+
+/* Encoder answers a command in the following frame, so each read returns the angle latched by the previous one.
+ * The last commands sent stay in g_EncoderTx to know what a response holds. Buffers are static, they are DMA targets. */
+static uint16_t g_EncoderTx[eMotor_Last];
+static uint16_t g_EncoderRx[eMotor_Last];
+static uint16_t g_EncoderPendingCommand[eMotor_Last];
+static sEncoderStats_t g_EncoderStats;
+
+static bool Encoder_ParityOk (uint16_t Frame) {
+    Frame ^= Frame >> 8;
+    Frame ^= Frame >> 4;
+    Frame ^= Frame >> 2;
+    Frame ^= Frame >> 1;
+    return (Frame & 1) == 0;
+}
+
+/* Sends one command per chain position, the frames received answer the commands of the previous transfer */
+static bool Encoder_Transfer (const uint16_t Command[eMotor_Last]) {
+    for (unsigned int i = 0; i < eMotor_Last; i++) {
+        g_EncoderTx[i] = Command[i];
+    }
+    bool RetVal = SpiTransferSlave(eSpiSlave_Encoder, (const uint8_t *)g_EncoderTx, (uint8_t *)g_EncoderRx, sizeof(g_EncoderTx));
+    taskENTER_CRITICAL();
+    g_EncoderStats.Reads++;
+    if (!RetVal) {
+        g_EncoderStats.BusErrors++;
+    }
+    taskEXIT_CRITICAL();
+    return RetVal;
+}
+
+/* Primes the pipeline and checks every chain position answers: a missing device reads as all zeros or all ones */
+bool Encoder_Init (void) {
+    bool RetVal = true;
+    for (unsigned int i = 0; i < eMotor_Last; i++) {
+        g_EncoderPendingCommand[i] = AS5048_CMD_READ_ANGLE;
+    }
+    for (unsigned int Attempt = 0; Attempt < 2; Attempt++) {
+        RetVal = Encoder_Transfer(g_EncoderPendingCommand);
+    }
+    for (unsigned int i = 0; RetVal && (i < eMotor_Last); i++) {
+        if ((g_EncoderRx[i] == 0x0000) || (g_EncoderRx[i] == 0xFFFF)) {
+            RetVal = false;
+        }
+    }
+    return RetVal;
+}
+
+/* One chain transaction per call, from the control task. A frame with the error flag gets a clear error command next,
+ * the motor has no sample for that read, nor for the two after it: the frame answering the read sent alongside the
+ * clear still carries the flag and the one after holds the error register. */
+bool Encoder_Read (sEncoderSample_t Output[eMotor_Last]) {
+    bool RetVal = false;
+    /* Input check */
+    if (Output != NULL) {
+        uint16_t Command[eMotor_Last];
+        uint16_t Answered[eMotor_Last];
+        for (unsigned int i = 0; i < eMotor_Last; i++) {
+            Answered[i] = g_EncoderTx[i];
+            Command[i] = g_EncoderPendingCommand[i];
+            g_EncoderPendingCommand[i] = AS5048_CMD_READ_ANGLE;
+        }
+        if (Encoder_Transfer(Command)) {
+            uint32_t ParityErrors = 0;
+            uint32_t ErrorFlags = 0;
+            for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+                unsigned int Position = g_EncoderChainPosition[Motor];
+                uint16_t Frame = g_EncoderRx[Position];
+                Output[Motor].Valid = false;
+                if (!Encoder_ParityOk(Frame)) {
+                    ParityErrors++;
+                } else if (Frame & AS5048_ERROR_FLAG) {
+                    /* Flag seen while a clear is on its way is the same error */
+                    if (Command[Position] != AS5048_CMD_CLEAR_ERROR) {
+                        ErrorFlags++;
+                        g_EncoderPendingCommand[Position] = AS5048_CMD_CLEAR_ERROR;
+                    }
+                } else if (Answered[Position] == AS5048_CMD_READ_ANGLE) {
+                    Output[Motor].Raw = Frame & AS5048_DATA_MASK;
+                    Output[Motor].Angle = (float)Output[Motor].Raw * (TWO_PI / AS5048_COUNTS);
+                    Output[Motor].Valid = true;
+                }
+            }
+            taskENTER_CRITICAL();
+            g_EncoderStats.ParityErrors += ParityErrors;
+            g_EncoderStats.ErrorFlags += ErrorFlags;
+            taskEXIT_CRITICAL();
+            RetVal = true;
+        } else {
+            for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+                Output[Motor].Valid = false;
+            }
+        }
+    }
+    return RetVal;
+}
+
+bool Encoder_GetStats (sEncoderStats_t *Output) {
+    bool RetVal = false;
+    /* Input check */
+    if (Output != NULL) {
+        taskENTER_CRITICAL();
+        *Output = g_EncoderStats;
+        taskEXIT_CRITICAL();
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+void Encoder_PrintStats (void) {
+    sEncoderStats_t Snapshot;
+    if (Encoder_GetStats(&Snapshot)) {
+        PrintToUart(eUart_1, "ENC reads=%u bus=%u parity=%u ef=%u\r", (unsigned int)Snapshot.Reads, (unsigned int)Snapshot.BusErrors,
+                    (unsigned int)Snapshot.ParityErrors, (unsigned int)Snapshot.ErrorFlags);
+    }
+}
@@ -0,0 +1,256 @@
+#include "foc_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "main.h"
+#include "motor_api.h"
+#include "encoder_api.h"
+#include "fusion_math_api.h"
+#include "timing_stats_api.h"
+#include "uart_api.h"
+
+
+/* Motor figures are data sheet values of a 2804 class gimbal motor with ~100 turns on a 3S supply. Voltage mode sets q
+ * current through them: on a winding with 20% more resistance a command of 1 gives 0.42 A instead of 0.5
+ * (Tests/test_foc.c). The current loop gains settle a 0.5 A step in 14 ms without overshoot; with the period of delay
+ * Kp 3 overshoots by 16% and Kp 5 rings. Latency compensation takes the torque angle at 10 rad/s from 15 to 3 deg. */
+#define HARDCODED_POLE_PAIRS        7
+#define HARDCODED_DIRECTION         1.0f
+#define HARDCODED_PHASE_RESISTANCE  5.0f
+#define HARDCODED_BACK_EMF          0.25f
+#define HARDCODED_CURRENT_LIMIT     0.5f
+#define HARDCODED_CURRENT_KP        1.5f        // one period delay at 1 kHz, higher gains ring
+#define HARDCODED_CURRENT_KI        1500.0f
+#define HARDCODED_VELOCITY_CUTOFF   100.0f
+#define HARDCODED_ALIGN_VOLTAGE     2.0f
+#define HARDCODED_BUS_VOLTAGE       12.0f
+#define HARDCODED_CONTROL_DT        0.001f
+#define HARDCODED_LATENCY_PERIODS   1.5f        // sample is one read old, PWM applies half a period later on average
+#define HARDCODED_MAX_MISSED        3
+#define TWO_PI                      6.28318531f
+#define SQRT3                       1.73205081f
+#define FOC_BENCHMARK_STEPS         1000
+#define FOC_BENCHMARK_RATE          2000        // Hz, same target rate as controller benchmark
+
+static float Foc_WrapPi (float Angle) {
+    if (Angle > 0.5f * TWO_PI) {
+        Angle -= TWO_PI;
+    } else if (Angle < -0.5f * TWO_PI) {
+        Angle += TWO_PI;
+    }
+    return Angle;
+}
+
+/* Into [0, 2 * pi) for angles at most one turn outside */
+static float Foc_WrapTwoPi (float Angle) {
+    if (Angle >= TWO_PI) {
+        Angle -= TWO_PI;
+    } else if (Angle < 0.0f) {
+        Angle += TWO_PI;
+    }
+    return Angle;
+}
+
+static float Foc_Clamp (float Value, float Limit) {
+    return (Value > Limit) ? Limit : ((Value < -Limit) ? -Limit : Value);
+}
+
+static void Foc_ResetCurrentLoops (sFocMotor_t *State) {
+    Math_PidInit(&State->IdPid, State->IdPid.Kp, State->IdPid.Ki, 0.0f);
+    Math_PidInit(&State->IqPid, State->IqPid.Kp, State->IqPid.Ki, 0.0f);
+}
+
+static void Foc_Off (eMotor_t Motor, sFocMotor_t *State) {
+    State->Vd = 0.0f;
+    State->Vq = 0.0f;
+    Foc_ResetCurrentLoops(State);
+    Motor_SetVoltage(Motor, 0.0f, 0.0f);
+}
+
+/* New sample updates angle and filtered velocity, a missing one is bridged by extrapolation for a few periods */
+static bool Foc_TrackAngle (sFoc_t *Foc, eMotor_t Motor, const sEncoderSample_t *Sample) {
+    sFocMotor_t *State = &Foc->Motor[Motor];
+    float Dt = Foc->Config.Dt;
+    if (Sample->Valid) {
+        if (State->AngleValid) {
+            float Velocity = Foc_WrapPi(Sample->Angle - State->Angle) / Dt;
+            State->Velocity += Foc->VelocityAlpha[Motor] * (Velocity - State->Velocity);
+        }
+        State->Angle = Sample->Angle;
+        State->AngleValid = true;
+        State->MissedSamples = 0;
+    } else if (State->AngleValid && (State->MissedSamples < Foc->Config.MaxMissedSamples)) {
+        State->Angle = Foc_WrapTwoPi(State->Angle + State->Velocity * Dt);
+        State->MissedSamples++;
+    } else {
+        State->AngleValid = false;
+        State->Velocity = 0.0f;
+    }
+    return State->AngleValid;
+}
+
+void Foc_GetDefaultConfig (sFocConfig_t *Config) {
+    /* Input check */
+    if (Config != NULL) {
+        for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+            Config->Motor[i] = (sFocMotorConfig_t) {
+                HARDCODED_POLE_PAIRS, HARDCODED_DIRECTION, HARDCODED_PHASE_RESISTANCE, HARDCODED_BACK_EMF, HARDCODED_CURRENT_LIMIT,
+                HARDCODED_CURRENT_KP, HARDCODED_CURRENT_KI, HARDCODED_VELOCITY_CUTOFF, HARDCODED_ALIGN_VOLTAGE
+            };
+        }
+        Config->BusVoltage = HARDCODED_BUS_VOLTAGE;
+        Config->Dt = HARDCODED_CONTROL_DT;
+        Config->LatencyPeriods = HARDCODED_LATENCY_PERIODS;
+        Config->MaxMissedSamples = HARDCODED_MAX_MISSED;
+    }
+}
+
+bool Foc_Init (sFoc_t *Foc, const sFocConfig_t *Config) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Foc != NULL) && (Config != NULL) && (Config->Dt > 0.0f) && (Config->BusVoltage > 0.0f)) {
+        memset(Foc, 0, sizeof(sFoc_t));
+        Foc->Config = *Config;
+        Foc->VoltageToVector = SQRT3 / Config->BusVoltage;
+        for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+            const sFocMotorConfig_t *MotorConfig = &Config->Motor[i];
+            float Tau = (MotorConfig->VelocityCutoff > 0.0f) ? 1.0f / (TWO_PI * MotorConfig->VelocityCutoff) : 0.0f;
+            Foc->VelocityAlpha[i] = Config->Dt / (Tau + Config->Dt);
+            Math_PidInit(&Foc->Motor[i].IdPid, MotorConfig->CurrentKp, MotorConfig->CurrentKi * Config->Dt, 0.0f);
+            Math_PidInit(&Foc->Motor[i].IqPid, MotorConfig->CurrentKp, MotorConfig->CurrentKi * Config->Dt, 0.0f);
+        }
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* Pulls every rotor onto electrical angle zero with a d axis voltage, Foc_AlignFinish reads where they settled */
+void Foc_AlignStart (sFoc_t *Foc) {
+    /* Input check */
+    if (Foc != NULL) {
+        for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+            Foc->Motor[i].Aligned = false;
+            Motor_SetVoltage(i, Foc->Config.Motor[i].AlignVoltage * Foc->VoltageToVector, 0.0f);
+        }
+    }
+}
+
+/* Motors without a valid sample stay unaligned and are never driven. Returns true when all are aligned. */
+bool Foc_AlignFinish (sFoc_t *Foc, const sEncoderSample_t Samples[eMotor_Last]) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Foc != NULL) && (Samples != NULL)) {
+        RetVal = true;
+        for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+            const sFocMotorConfig_t *MotorConfig = &Foc->Config.Motor[i];
+            sFocMotor_t *State = &Foc->Motor[i];
+            State->Aligned = Samples[i].Valid;
+            State->AngleValid = Samples[i].Valid;
+            State->Angle = Samples[i].Angle;
+            State->Velocity = 0.0f;
+            State->MissedSamples = 0;
+            /* Whole electrical turns removed, keeps the electrical angle within a few turns */
+            float Offset = -MotorConfig->Direction * (float)MotorConfig->PolePairs * Samples[i].Angle;
+            State->ElectricalOffset = Offset - TWO_PI * (float)(int32_t)(Offset / TWO_PI);
+            RetVal = RetVal && State->Aligned;
+            Foc_Off(i, State);
+        }
+    }
+    return RetVal;
+}
+
+/* Once per control period with fresh encoder samples. Command is per motor in +-1 of CurrentLimit, positive turns the shaft
+ * towards growing encoder angle. With PhaseCurrents (A, phases A and B per motor) d and q currents are closed by PI loops,
+ * without them q voltage is set from the motor model (R * I plus back EMF) and d voltage is zero. */
+bool Foc_Update (sFoc_t *Foc, const sEncoderSample_t Samples[eMotor_Last], const float Command[eMotor_Last],
+                 const float (*PhaseCurrents)[2]) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Foc != NULL) && (Samples != NULL) && (Command != NULL)) {
+        float VoltageLimit = Foc->Config.BusVoltage / SQRT3;
+        for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+            const sFocMotorConfig_t *MotorConfig = &Foc->Config.Motor[i];
+            sFocMotor_t *State = &Foc->Motor[i];
+            if (!Foc_TrackAngle(Foc, i, &Samples[i]) || !State->Aligned) {
+                Foc_Off(i, State);
+                continue;
+            }
+            float Sin, Cos;
+            float ElectricalScale = MotorConfig->Direction * (float)MotorConfig->PolePairs;
+            float Predicted = State->Angle + State->Velocity * Foc->Config.LatencyPeriods * Foc->Config.Dt;
+            State->ElectricalAngle = ElectricalScale * Predicted + State->ElectricalOffset;
+            Math_SinCos(State->ElectricalAngle, &Sin, &Cos);
+            float IqReference = MotorConfig->Direction * Foc_Clamp(Command[i], 1.0f) * MotorConfig->CurrentLimit;
+            float BackEmf = MotorConfig->Direction * MotorConfig->BackEmfConstant * State->Velocity;
+            if (PhaseCurrents != NULL) {
+                float Alpha, Beta;
+                Math_Clarke(PhaseCurrents[i][0], PhaseCurrents[i][1], &Alpha, &Beta);
+                Math_Park(Alpha, Beta, &State->Id, &State->Iq, Sin, Cos);
+                Math_Pid(&State->IdPid, -State->Id);
+                Math_Pid(&State->IqPid, IqReference - State->Iq);
+                State->Vd = Math_PidClamp(&State->IdPid, VoltageLimit);
+                State->Vq = Math_PidClamp(&State->IqPid, VoltageLimit) + BackEmf;
+            } else {
+                State->Vd = 0.0f;
+                State->Vq = MotorConfig->PhaseResistance * IqReference + BackEmf;
+            }
+            /* Circle limit keeps the vector direction when the bus runs out */
+            float MagnitudeSq = State->Vd * State->Vd + State->Vq * State->Vq;
+            if (MagnitudeSq > VoltageLimit * VoltageLimit) {
+                float Scale = VoltageLimit * Math_InvSqrt(MagnitudeSq);
+                State->Vd *= Scale;
+                State->Vq *= Scale;
+            }
+            float Alpha, Beta;
+            Math_InvPark(State->Vd, State->Vq, &Alpha, &Beta, Sin, Cos);
+            Motor_SetVoltage(i, Alpha * Foc->VoltageToVector, Beta * Foc->VoltageToVector);
+        }
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* Zero voltage on all motors, alignment is kept */
+void Foc_Release (sFoc_t *Foc) {
+    /* Input check */
+    if (Foc != NULL) {
+        for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+            Foc_Off(i, &Foc->Motor[i]);
+        }
+    }
+}
+
+/* Cost of one update of all three motors without the encoder transfer, in voltage and current mode. Samples do not move
+ * and command is zero, so motors see no voltage. Run before alignment, it leaves the motors unaligned. */
+void FocBenchmark_Run (void) {
+    static sFoc_t Foc;
+    sFocConfig_t Config;
+    sEncoderSample_t Samples[eMotor_Last];
+    const float Command[eMotor_Last] = {0.0f, 0.0f, 0.0f};
+    const float Currents[eMotor_Last][2] = {{0.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f}};
+    uint32_t Cycles[2];
+    Foc_GetDefaultConfig(&Config);
+    Config.Dt = 1.0f / FOC_BENCHMARK_RATE;
+    for (unsigned int Mode = 0; Mode < 2; Mode++) {
+        Foc_Init(&Foc, &Config);
+        for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+            Samples[i] = (sEncoderSample_t) {4096, 1.57079637f, true};
+        }
+        Foc_AlignFinish(&Foc, Samples);
+        taskENTER_CRITICAL();
+        uint32_t Start = GetCycleCount();
+        for (unsigned int Step = 0; Step < FOC_BENCHMARK_STEPS; Step++) {
+            Foc_Update(&Foc, Samples, Command, (Mode == 0) ? NULL : Currents);
+        }
+        Cycles[Mode] = (GetCycleCount() - Start) / FOC_BENCHMARK_STEPS;
+        taskEXIT_CRITICAL();
+    }
+    Foc_Release(&Foc);
+    uint32_t Budget = SystemCoreClock / FOC_BENCHMARK_RATE;
+    PrintToUart(eUart_1, "FOC update x%u[cyc] voltage %u current %u budget@%uHz[cyc] %u\r", (unsigned int)eMotor_Last,
+                (unsigned int)Cycles[0], (unsigned int)Cycles[1], (unsigned int)FOC_BENCHMARK_RATE, (unsigned int)Budget);
+}
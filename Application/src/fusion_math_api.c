@@ -0,0 +1,271 @@
+#include "fusion_math_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "main.h"
+#include "timing_stats_api.h"
+#include "uart_api.h"
+
+
+#define MATH_BENCHMARK_SAMPLES      256
+#define MATH_BENCHMARK_PRINT_DELAY  10
+
+typedef enum {
+    eMathKernel_First,
+    eMathKernel_InvSqrt = eMathKernel_First,
+    eMathKernel_Sqrt,
+    eMathKernel_Normalise3,
+    eMathKernel_Cross3,
+    eMathKernel_QuaternionRotate,
+    eMathKernel_MatrixVector3,
+    eMathKernel_Last,
+} eMathKernel_t;
+
+typedef struct {
+    uint32_t Cycles;
+    float MaxError;
+} sMathBenchmarkResult_t;
+
+/* Keeps results alive so the loops are not optimised away */
+static volatile float g_MathBenchmarkSink;
+
+/* Code paths used by fusion before this layer existed, kept only as benchmark reference */
+static float MathBenchmark_LegacyInvSqrt (float x) {
+    float halfx = 0.5f * x;
+    float y = x;
+    int32_t i;
+    memcpy(&i, &y, sizeof(i));          // bit copy, the pointer cast of the original breaks strict aliasing
+    i = 0x5f3759df - (i>>1);
+    memcpy(&y, &i, sizeof(y));
+    y = y * (1.5f - (halfx * y * y));
+    return y;
+}
+
+static float MathBenchmark_LegacySqrt (float x) {
+    return sqrt(x);
+}
+
+static void MathBenchmark_LegacyNormalise3 (float Vector[3]) {
+    float RecipNorm = MathBenchmark_LegacyInvSqrt(Vector[0] * Vector[0] + Vector[1] * Vector[1] + Vector[2] * Vector[2]);
+    Vector[0] *= RecipNorm;
+    Vector[1] *= RecipNorm;
+    Vector[2] *= RecipNorm;
+}
+
+/* Mahony error term, written out with scalar temporaries */
+static void MathBenchmark_LegacyCross3 (const float A[3], const float B[3], float Output[3]) {
+    float ax = A[0], ay = A[1], az = A[2];
+    float bx = B[0], by = B[1], bz = B[2];
+    Output[0] = ay * bz - az * by;
+    Output[1] = az * bx - ax * bz;
+    Output[2] = ax * by - ay * bx;
+}
+
+/* MEKF quaternion propagation, Q * [1, Delta / 2] with the unit scalar part folded in */
+static void MathBenchmark_LegacyQuaternionRotate (const float Q[4], const float Delta[3], float Output[4]) {
+    float Dx = 0.5f * Delta[0];
+    float Dy = 0.5f * Delta[1];
+    float Dz = 0.5f * Delta[2];
+    float Qw = Q[0], Qx = Q[1], Qy = Q[2], Qz = Q[3];
+    Output[0] = Qw - Qx * Dx - Qy * Dy - Qz * Dz;
+    Output[1] = Qx + Qw * Dx + Qy * Dz - Qz * Dy;
+    Output[2] = Qy + Qw * Dy - Qx * Dz + Qz * Dx;
+    Output[3] = Qz + Qw * Dz + Qx * Dy - Qy * Dx;
+}
+
+/* MEKF magnetometer rotation to earth frame */
+static void MathBenchmark_LegacyMatrixVector3 (const float M[3][3], const float V[3], float Output[3]) {
+    for (unsigned int i = 0; i < 3; i++) {
+        Output[i] = M[i][0] * V[0] + M[i][1] * V[1] + M[i][2] * V[2];
+    }
+}
+
+/* Spread over range seen by fusion: squared norms of mg, dps and uT readings */
+static float MathBenchmark_Input (unsigned int Index) {
+    return 1.0e-3f + (float)(Index * Index) * 16.0f;
+}
+
+/* Vector and matrix elements in [-1, 1), cheap enough to generate inside the timed loop. Seed picks the sequence. */
+static float MathBenchmark_Operand (unsigned int Index, unsigned int Seed) {
+    return (float)((int32_t)((Index * Seed) & 0xFF) - 128) * (1.0f / 128.0f);
+}
+
+/* One call of a kernel on sample Index, returns number of output elements */
+static inline unsigned int MathBenchmark_Kernel (eMathKernel_t Kernel, bool Legacy, unsigned int Index, float Output[4]) {
+    unsigned int Length = 0;
+    float Input = MathBenchmark_Input(Index);
+    switch (Kernel) {
+        case eMathKernel_InvSqrt:
+            Output[0] = Legacy ? MathBenchmark_LegacyInvSqrt(Input) : Math_InvSqrt(Input);
+            Length = 1;
+            break;
+        case eMathKernel_Sqrt:
+            Output[0] = Legacy ? MathBenchmark_LegacySqrt(Input) : Math_Sqrt(Input);
+            Length = 1;
+            break;
+        case eMathKernel_Normalise3:
+            Output[0] = Input;
+            Output[1] = -0.5f * Input;
+            Output[2] = 0.25f;
+            if (Legacy) {
+                MathBenchmark_LegacyNormalise3(Output);
+            } else {
+                Math_Normalise3(Output);
+            }
+            Length = 3;
+            break;
+        case eMathKernel_Cross3: {
+            const float A[3] = {MathBenchmark_Operand(Index, 3), MathBenchmark_Operand(Index, 5), MathBenchmark_Operand(Index, 7)};
+            const float B[3] = {MathBenchmark_Operand(Index, 11), MathBenchmark_Operand(Index, 13), MathBenchmark_Operand(Index, 17)};
+            if (Legacy) {
+                MathBenchmark_LegacyCross3(A, B, Output);
+            } else {
+                Math_Cross3(A, B, Output);
+            }
+            Length = 3;
+            break;
+        }
+        case eMathKernel_QuaternionRotate: {
+            const float Q[4] = {MathBenchmark_Operand(Index, 3), MathBenchmark_Operand(Index, 5), MathBenchmark_Operand(Index, 7),
+                                MathBenchmark_Operand(Index, 11)};
+            const float Delta[3] = {0.01f * MathBenchmark_Operand(Index, 13), 0.01f * MathBenchmark_Operand(Index, 17),
+                                    0.01f * MathBenchmark_Operand(Index, 19)};
+            if (Legacy) {
+                MathBenchmark_LegacyQuaternionRotate(Q, Delta, Output);
+            } else {
+                const float Increment[4] = {1.0f, 0.5f * Delta[0], 0.5f * Delta[1], 0.5f * Delta[2]};
+                Math_QuaternionMultiply(Q, Increment, Output);
+            }
+            Length = 4;
+            break;
+        }
+        case eMathKernel_MatrixVector3: {
+            const float M[3][3] = {
+                {MathBenchmark_Operand(Index, 3), MathBenchmark_Operand(Index, 5), MathBenchmark_Operand(Index, 7)},
+                {MathBenchmark_Operand(Index, 11), MathBenchmark_Operand(Index, 13), MathBenchmark_Operand(Index, 17)},
+                {MathBenchmark_Operand(Index, 19), MathBenchmark_Operand(Index, 23), MathBenchmark_Operand(Index, 29)},
+            };
+            const float V[3] = {MathBenchmark_Operand(Index, 31), MathBenchmark_Operand(Index, 37), MathBenchmark_Operand(Index, 41)};
+            if (Legacy) {
+                MathBenchmark_LegacyMatrixVector3(M, V, Output);
+            } else {
+                Math_MatrixVector3(M, V, false, Output);
+            }
+            Length = 3;
+            break;
+        }
+        default:
+            break;
+    }
+    return Length;
+}
+
+/* Same computation in double precision from the same float operands */
+static void MathBenchmark_Reference (eMathKernel_t Kernel, unsigned int Index, double Output[4]) {
+    double Input = MathBenchmark_Input(Index);
+    double Op[12];
+    const unsigned int Seed[12] = {3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41};
+    for (unsigned int i = 0; i < 12; i++) {
+        Op[i] = MathBenchmark_Operand(Index, Seed[i]);
+    }
+    switch (Kernel) {
+        case eMathKernel_InvSqrt:
+            Output[0] = 1.0 / sqrt(Input);
+            break;
+        case eMathKernel_Sqrt:
+            Output[0] = sqrt(Input);
+            break;
+        case eMathKernel_Normalise3: {
+            double Z = 0.25;
+            double Norm = sqrt(Input * Input + 0.25 * Input * Input + Z * Z);
+            Output[0] = Input / Norm;
+            Output[1] = -0.5 * Input / Norm;
+            Output[2] = Z / Norm;
+            break;
+        }
+        case eMathKernel_Cross3:
+            Output[0] = Op[1] * Op[5] - Op[2] * Op[4];
+            Output[1] = Op[2] * Op[3] - Op[0] * Op[5];
+            Output[2] = Op[0] * Op[4] - Op[1] * Op[3];
+            break;
+        case eMathKernel_QuaternionRotate: {
+            /* Delta is scaled in float first, as in the kernels */
+            double Dx = 0.5 * (double)(0.01f * (float)Op[4]);
+            double Dy = 0.5 * (double)(0.01f * (float)Op[5]);
+            double Dz = 0.5 * (double)(0.01f * (float)Op[6]);
+            Output[0] = Op[0] - Op[1] * Dx - Op[2] * Dy - Op[3] * Dz;
+            Output[1] = Op[1] + Op[0] * Dx + Op[2] * Dz - Op[3] * Dy;
+            Output[2] = Op[2] + Op[0] * Dy - Op[1] * Dz + Op[3] * Dx;
+            Output[3] = Op[3] + Op[0] * Dz + Op[1] * Dy - Op[2] * Dx;
+            break;
+        }
+        case eMathKernel_MatrixVector3:
+            for (unsigned int i = 0; i < 3; i++) {
+                Output[i] = Op[3 * i] * Op[9] + Op[3 * i + 1] * Op[10] + Op[3 * i + 2] * Op[11];
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void MathBenchmark_Measure (eMathKernel_t Kernel, bool Legacy, sMathBenchmarkResult_t *Result) {
+    float Sink = 0.0f;
+    float MaxError = 0.0f;
+    float Output[4];
+    taskENTER_CRITICAL();
+    uint32_t Start = GetCycleCount();
+    for (unsigned int i = 0; i < MATH_BENCHMARK_SAMPLES; i++) {
+        MathBenchmark_Kernel(Kernel, Legacy, i, Output);
+        Sink += Output[0];
+    }
+    Result->Cycles = (GetCycleCount() - Start) / MATH_BENCHMARK_SAMPLES;
+    taskEXIT_CRITICAL();
+    g_MathBenchmarkSink = Sink;
+    /* Accuracy pass is separate so double precision reference does not end up in cycle count. Error is largest element
+     * difference relative to the length of the reference result, which is plain relative error for scalar kernels. */
+    for (unsigned int i = 0; i < MATH_BENCHMARK_SAMPLES; i++) {
+        double Reference[4] = {0.0, 0.0, 0.0, 0.0};
+        double NormSq = 0.0;
+        double Difference = 0.0;
+        unsigned int Length = MathBenchmark_Kernel(Kernel, Legacy, i, Output);
+        MathBenchmark_Reference(Kernel, i, Reference);
+        for (unsigned int j = 0; j < Length; j++) {
+            NormSq += Reference[j] * Reference[j];
+            if (fabs((double)Output[j] - Reference[j]) > Difference) {
+                Difference = fabs((double)Output[j] - Reference[j]);
+            }
+        }
+        float Error = (NormSq > 0.0) ? (float)(Difference / sqrt(NormSq)) : 0.0f;
+        if (Error > MaxError) {
+            MaxError = Error;
+        }
+    }
+    Result->MaxError = MaxError;
+}
+
+/* Prints one row per kernel: cycles per call and worst relative error, old code path against this layer */
+void MathBenchmark_Run (void) {
+    const char *KernelName[eMathKernel_Last] = {
+        [eMathKernel_InvSqrt]           = "invsqrt",
+        [eMathKernel_Sqrt]              = "sqrt",
+        [eMathKernel_Normalise3]        = "normalise3",
+        [eMathKernel_Cross3]            = "cross3",
+        [eMathKernel_QuaternionRotate]  = "quatmul",
+        [eMathKernel_MatrixVector3]     = "matvec3",
+    };
+    sMathBenchmarkResult_t Legacy;
+    sMathBenchmarkResult_t Current;
+    PrintToUart(eUart_1, "MATH kernel     old[cyc] old[err]    new[cyc] new[err]\r");
+    for (eMathKernel_t i = eMathKernel_First; i < eMathKernel_Last; i++) {
+        vTaskDelay(MATH_BENCHMARK_PRINT_DELAY);
+        MathBenchmark_Measure(i, true, &Legacy);
+        MathBenchmark_Measure(i, false, &Current);
+        PrintToUart(eUart_1, "MATH %-10s %8u %e %8u %e\r", KernelName[i],
+                    (unsigned int)Legacy.Cycles, Legacy.MaxError, (unsigned int)Current.Cycles, Current.MaxError);
+    }
+}
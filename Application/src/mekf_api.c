@@ -0,0 +1,210 @@
+#include "mekf_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include "mpu9250_api.h"
+#include "fusion_math_api.h"
+
+
+/* Checked with Tests/bench_attitude_estimators.c, 30 s handheld stream with 0.3 dps gyro bias left in, magnetometer
+ * at 100 Hz. Gyro variance 1e-5 gives the lowest tilt error, 0.023 deg against 0.026-0.029 from 1e-7 to 1e-4, and
+ * bias converges in 2.7 s (10 s or more at 1e-4). Bias random walk from 1e-11 to 1e-7 moves nothing by more than
+ * 0.003 deg. Initial bias variance (0.6 dps) is sized for the residual GyroBias leaves; at 1e-6 a raw 0.3 dps bias did
+ * not converge in 30 s, at 1e-2 (the MPU9250 +-5 dps offset tolerance) it does in 0.1 s, which is the value to use
+ * without GyroBias. Initial attitude variance does not matter after boot alignment, 1e-2 to 1 give the same tilt.
+ * Acc and mag variances are overridden from sAttitudeEstimatorConfig_t, see attitude_estimator_api.c. */
+#define HARDCODED_INITIAL_ATTITUDE_VARIANCE     0.1f        // rad^2
+#define HARDCODED_INITIAL_BIAS_VARIANCE         1.0e-4f     // (rad/s)^2
+#define HARDCODED_GYRO_VARIANCE                 1.0e-5f
+#define HARDCODED_BIAS_VARIANCE                 1.0e-9f
+#define HARDCODED_ACC_VARIANCE                  1.0e-2f
+#define HARDCODED_MAG_VARIANCE                  5.0e-2f
+/* Singular innovation covariance, measurement is skipped */
+#define MEKF_MIN_DETERMINANT                    1.0e-12f
+
+
+/* Q = Q * [1, Delta / 2], followed by normalisation */
+static void Mekf_RotateQuaternion (float Q[4], const float Delta[3]) {
+    const float Increment[4] = {1.0f, 0.5f * Delta[0], 0.5f * Delta[1], 0.5f * Delta[2]};
+    const float Previous[4] = {Q[0], Q[1], Q[2], Q[3]};
+    Math_QuaternionMultiply(Previous, Increment, Q);
+    Math_Normalise4(Q);
+}
+
+/* Rotation matrix from sensor to earth frame */
+static void Mekf_RotationMatrix (const float Q[4], float R[3][3]) {
+    float Qw = Q[0], Qx = Q[1], Qy = Q[2], Qz = Q[3];
+    R[0][0] = 1.0f - 2.0f * (Qy * Qy + Qz * Qz);
+    R[0][1] = 2.0f * (Qx * Qy - Qw * Qz);
+    R[0][2] = 2.0f * (Qx * Qz + Qw * Qy);
+    R[1][0] = 2.0f * (Qx * Qy + Qw * Qz);
+    R[1][1] = 1.0f - 2.0f * (Qx * Qx + Qz * Qz);
+    R[1][2] = 2.0f * (Qy * Qz - Qw * Qx);
+    R[2][0] = 2.0f * (Qx * Qz - Qw * Qy);
+    R[2][1] = 2.0f * (Qy * Qz + Qw * Qx);
+    R[2][2] = 1.0f - 2.0f * (Qx * Qx + Qy * Qy);
+}
+
+static bool Mekf_Invert3x3 (const float M[3][3], float Inverse[3][3]) {
+    bool RetVal = false;
+    float C00 = M[1][1] * M[2][2] - M[1][2] * M[2][1];
+    float C01 = M[1][2] * M[2][0] - M[1][0] * M[2][2];
+    float C02 = M[1][0] * M[2][1] - M[1][1] * M[2][0];
+    float Determinant = M[0][0] * C00 + M[0][1] * C01 + M[0][2] * C02;
+    if (fabsf(Determinant) > MEKF_MIN_DETERMINANT) {
+        float RecipDet = 1.0f / Determinant;
+        Inverse[0][0] = C00 * RecipDet;
+        Inverse[1][0] = C01 * RecipDet;
+        Inverse[2][0] = C02 * RecipDet;
+        Inverse[0][1] = (M[0][2] * M[2][1] - M[0][1] * M[2][2]) * RecipDet;
+        Inverse[1][1] = (M[0][0] * M[2][2] - M[0][2] * M[2][0]) * RecipDet;
+        Inverse[2][1] = (M[0][1] * M[2][0] - M[0][0] * M[2][1]) * RecipDet;
+        Inverse[0][2] = (M[0][1] * M[1][2] - M[0][2] * M[1][1]) * RecipDet;
+        Inverse[1][2] = (M[0][2] * M[1][0] - M[0][0] * M[1][2]) * RecipDet;
+        Inverse[2][2] = (M[0][0] * M[1][1] - M[0][1] * M[1][0]) * RecipDet;
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* Measured and Predicted are unit vectors in sensor frame, H = [[Predicted x], 0] */
+static bool Mekf_VectorUpdate (sMekf_t *Mekf, const float Measured[3], const float Predicted[3], float Variance) {
+    bool RetVal = false;
+    float Skew[3][3] = {
+        {0.0f,          -Predicted[2],  Predicted[1]},
+        {Predicted[2],  0.0f,           -Predicted[0]},
+        {-Predicted[1], Predicted[0],   0.0f}
+    };
+    float PHt[MEKF_STATES][3];
+    float S[3][3];
+    float SInverse[3][3];
+    float K[MEKF_STATES][3];
+    float Correction[MEKF_STATES];
+    float Innovation[3] = {Measured[0] - Predicted[0], Measured[1] - Predicted[1], Measured[2] - Predicted[2]};
+    /* P * H^T, only attitude columns of H are non-zero and Skew^T = -Skew */
+    for (unsigned int i = 0; i < MEKF_STATES; i++) {
+        for (unsigned int j = 0; j < 3; j++) {
+            PHt[i][j] = -(Mekf->P[i][0] * Skew[0][j] + Mekf->P[i][1] * Skew[1][j] + Mekf->P[i][2] * Skew[2][j]);
+        }
+    }
+    /* S = H * P * H^T + R */
+    for (unsigned int i = 0; i < 3; i++) {
+        for (unsigned int j = 0; j < 3; j++) {
+            S[i][j] = Skew[i][0] * PHt[0][j] + Skew[i][1] * PHt[1][j] + Skew[i][2] * PHt[2][j];
+        }
+        S[i][i] += Variance;
+    }
+    if (Mekf_Invert3x3(S, SInverse)) {
+        for (unsigned int i = 0; i < MEKF_STATES; i++) {
+            for (unsigned int j = 0; j < 3; j++) {
+                K[i][j] = PHt[i][0] * SInverse[0][j] + PHt[i][1] * SInverse[1][j] + PHt[i][2] * SInverse[2][j];
+            }
+            Correction[i] = K[i][0] * Innovation[0] + K[i][1] * Innovation[1] + K[i][2] * Innovation[2];
+        }
+        /* P = P - K * H * P, where H * P = PHt^T since P is symmetric */
+        for (unsigned int i = 0; i < MEKF_STATES; i++) {
+            for (unsigned int j = i; j < MEKF_STATES; j++) {
+                float Value = Mekf->P[i][j] - (K[i][0] * PHt[j][0] + K[i][1] * PHt[j][1] + K[i][2] * PHt[j][2]);
+                Mekf->P[i][j] = Value;
+                Mekf->P[j][i] = Value;
+            }
+        }
+        /* Move error into nominal state, error state is reset to zero */
+        Mekf_RotateQuaternion(Mekf->Q, &Correction[0]);
+        Mekf->Bias[0] += Correction[3];
+        Mekf->Bias[1] += Correction[4];
+        Mekf->Bias[2] += Correction[5];
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+void Mekf_Init (sMekf_t *Mekf) {
+    /* Input check */
+    if (Mekf != NULL) {
+        memset(Mekf, 0, sizeof(sMekf_t));
+        Mekf->Q[0] = 1.0f;
+        for (unsigned int i = 0; i < 3; i++) {
+            Mekf->P[i][i] = HARDCODED_INITIAL_ATTITUDE_VARIANCE;
+            Mekf->P[i + 3][i + 3] = HARDCODED_INITIAL_BIAS_VARIANCE;
+        }
+        Mekf->GyroVariance = HARDCODED_GYRO_VARIANCE;
+        Mekf->BiasVariance = HARDCODED_BIAS_VARIANCE;
+        Mekf->AccVariance = HARDCODED_ACC_VARIANCE;
+        Mekf->MagVariance = HARDCODED_MAG_VARIANCE;
+    }
+}
+
+/* Gyro in rad/s */
+void Mekf_Predict (sMekf_t *Mekf, const sData3D_t *Gyro, float Dt) {
+    /* Input check */
+    if ((Mekf != NULL) && (Gyro != NULL)) {
+        float Delta[3] = {(Gyro->X - Mekf->Bias[0]) * Dt, (Gyro->Y - Mekf->Bias[1]) * Dt, (Gyro->Z - Mekf->Bias[2]) * Dt};
+        /* F = [[I - [Delta x], -I * Dt], [0, I]] */
+        float F[3][3] = {
+            {1.0f,      Delta[2],   -Delta[1]},
+            {-Delta[2], 1.0f,       Delta[0]},
+            {Delta[1],  -Delta[0],  1.0f}
+        };
+        float FP[MEKF_STATES][MEKF_STATES];
+        Mekf_RotateQuaternion(Mekf->Q, Delta);
+        /* F * P, bias rows are unchanged */
+        for (unsigned int j = 0; j < MEKF_STATES; j++) {
+            for (unsigned int i = 0; i < 3; i++) {
+                FP[i][j] = F[i][0] * Mekf->P[0][j] + F[i][1] * Mekf->P[1][j] + F[i][2] * Mekf->P[2][j] - Dt * Mekf->P[i + 3][j];
+                FP[i + 3][j] = Mekf->P[i + 3][j];
+            }
+        }
+        /* P = F * P * F^T + Qd */
+        for (unsigned int i = 0; i < MEKF_STATES; i++) {
+            for (unsigned int j = 0; j < 3; j++) {
+                Mekf->P[i][j] = FP[i][0] * F[j][0] + FP[i][1] * F[j][1] + FP[i][2] * F[j][2] - Dt * FP[i][j + 3];
+                Mekf->P[i][j + 3] = FP[i][j + 3];
+            }
+        }
+        for (unsigned int i = 0; i < 3; i++) {
+            Mekf->P[i][i] += Mekf->GyroVariance * Dt;
+            Mekf->P[i + 3][i + 3] += Mekf->BiasVariance * Dt;
+        }
+    }
+}
+
+/* Accelerometer is taken as measurement of gravity direction, any unit */
+bool Mekf_UpdateAcc (sMekf_t *Mekf, const sData3D_t *Acc) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Mekf != NULL) && (Acc != NULL) && !((Acc->X == 0.0f) && (Acc->Y == 0.0f) && (Acc->Z == 0.0f))) {
+        float Measured[3] = {Acc->X, Acc->Y, Acc->Z};
+        float R[3][3];
+        Math_Normalise3(Measured);
+        Mekf_RotationMatrix(Mekf->Q, R);
+        /* Earth Z axis seen from sensor frame */
+        float Predicted[3] = {R[2][0], R[2][1], R[2][2]};
+        RetVal = Mekf_VectorUpdate(Mekf, Measured, Predicted, Mekf->AccVariance);
+    }
+    return RetVal;
+}
+
+/* Reference field is rebuilt from measurement as in Mahony filter: horizontal part on earth X axis */
+bool Mekf_UpdateMag (sMekf_t *Mekf, const sData3D_t *Mag) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Mekf != NULL) && (Mag != NULL) && !((Mag->X == 0.0f) && (Mag->Y == 0.0f) && (Mag->Z == 0.0f))) {
+        float Measured[3] = {Mag->X, Mag->Y, Mag->Z};
+        float Earth[3];
+        float Reference[3];
+        float Predicted[3];
+        float R[3][3];
+        Math_Normalise3(Measured);
+        Mekf_RotationMatrix(Mekf->Q, R);
+        Math_MatrixVector3(R, Measured, false, Earth);
+        Reference[0] = Math_Sqrt(Earth[0] * Earth[0] + Earth[1] * Earth[1]);
+        Reference[1] = 0.0f;
+        Reference[2] = Earth[2];
+        Math_MatrixVector3(R, Reference, true, Predicted);
+        RetVal = Mekf_VectorUpdate(Mekf, Measured, Predicted, Mekf->MagVariance);
+    }
+    return RetVal;
+}
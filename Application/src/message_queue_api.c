@@ -24,7 +24,9 @@ struct {
 } QueueDescriptor[eQueue_Last] = {
     [eQueue_Uart1]      = { NULL,   sizeof(sMessageQueueItem_t) },
     [eQueue_Spi1Rx]     = { NULL,   sizeof(uint8_t)             },
-    [eQueue_Spi1Tx]     = { NULL,   sizeof(uint8_t)             }
+    [eQueue_Spi1Tx]     = { NULL,   sizeof(uint8_t)             },
+    [eQueue_Spi2Rx]     = { NULL,   sizeof(uint8_t)             },
+    [eQueue_Spi2Tx]     = { NULL,   sizeof(uint8_t)             }
 };
 
 
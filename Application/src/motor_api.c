@@ -0,0 +1,207 @@
+#include "motor_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32f3xx_ll_tim.h"
+#include "timing_stats_api.h"
+#include "fusion_math_api.h"
+#include "uart_api.h"
+
+
+/* 72 MHz timer clock, centre aligned counts up and down: 72e6 / (2 * 1800) = 20 kHz, above audible range */
+#define MOTOR_PWM_PERIOD            1800
+#define MOTOR_PWM_HALF_PERIOD       (MOTOR_PWM_PERIOD / 2)
+#define MOTOR_TABLE_BITS            8
+#define MOTOR_TABLE_SIZE            (1 << MOTOR_TABLE_BITS)
+#define MOTOR_TABLE_SHIFT           (16 - MOTOR_TABLE_BITS)
+#define MOTOR_PHASE_SHIFT           21845       // 2 * pi / 3 in 16 bit angle units
+#define MOTOR_AMPLITUDE_ONE         32767
+#define MOTOR_ANGLE_SCALE           10430.378f  // 65536 / (2 * pi)
+#define MOTOR_VECTOR_SCALE          1.15470054f // 2 / sqrt(3), same full scale as the table
+#define MOTOR_BENCHMARK_STEPS       1000
+#define MOTOR_BENCHMARK_RATE        2000        // Hz, same target rate as controller benchmark
+
+/* Space vector modulation as min/max zero sequence injection, one electrical turn of phase A, Q15, scaled so the
+ * peak of sin(x) - (max + min) / 2 over three phases (sqrt(3) / 2) is full scale, 15 % more voltage than plain sine.
+ * g_MotorSvpwmTable is generated from MOTOR_TABLE_BITS by motor_svpwm_table.py, which the Keil project runs before
+ * every build; run it by hand when changing MOTOR_TABLE_BITS elsewhere. */
+#include "motor_svpwm_table.h"
+#if MOTOR_SVPWM_TABLE_BITS != MOTOR_TABLE_BITS
+#error "motor_svpwm_table.h is stale, run motor_svpwm_table.py"
+#endif
+
+/* Pins are not on the CubeMX pin list yet: TIM1 CH1-3 PC0-PC2, TIM2 CH1-3 PA0-PA2, TIM3 CH1-3 PC6-PC8.
+ * TIM1 is master, TIM2 and TIM3 are started from its trigger output (ITR0), so all nine phases are in step. */
+struct {
+    TIM_TypeDef *Timer;
+    GPIO_TypeDef *Port;
+    uint16_t Pins;
+    uint8_t Alternate;
+    sMotorState_t State;
+} MotorDescriptor[eMotor_Last] = {
+    [eMotor_Roll]  = {TIM1, GPIOC, GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2, GPIO_AF2_TIM1, {0}},
+    [eMotor_Pitch] = {TIM2, GPIOA, GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2, GPIO_AF1_TIM2, {0}},
+    [eMotor_Yaw]   = {TIM3, GPIOC, GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_8, GPIO_AF2_TIM3, {0}},
+};
+
+static const uint32_t g_MotorChannels[3] = {LL_TIM_CHANNEL_CH1, LL_TIM_CHANNEL_CH2, LL_TIM_CHANNEL_CH3};
+
+/* Keeps benchmark results alive so the loop is not optimised away */
+static volatile uint32_t g_MotorBenchmarkSink;
+
+static uint16_t Motor_PhaseDuty (uint16_t Angle, int32_t Scale) {
+    /* Rounded to nearest table entry */
+    int32_t Value = g_MotorSvpwmTable[(uint16_t)(Angle + (1 << (MOTOR_TABLE_SHIFT - 1))) >> MOTOR_TABLE_SHIFT];
+    return (uint16_t)(MOTOR_PWM_HALF_PERIOD + ((Value * Scale) >> 15));
+}
+
+/* Compare registers are preloaded, new duties take effect together at the next update event */
+static void Motor_WriteDuty (TIM_TypeDef *Timer, const uint16_t Duty[3]) {
+    LL_TIM_OC_SetCompareCH1(Timer, Duty[0]);
+    LL_TIM_OC_SetCompareCH2(Timer, Duty[1]);
+    LL_TIM_OC_SetCompareCH3(Timer, Duty[2]);
+}
+
+/* Centre aligned PWM1 on channels 1-3 at zero amplitude (all phases 50 %, no voltage across windings), counter stopped */
+static void Motor_ConfigureTimer (TIM_TypeDef *Timer) {
+    LL_TIM_DisableCounter(Timer);
+    LL_TIM_SetCounterMode(Timer, LL_TIM_COUNTERMODE_CENTER_UP);
+    LL_TIM_SetPrescaler(Timer, 0);
+    LL_TIM_SetAutoReload(Timer, MOTOR_PWM_PERIOD);
+    LL_TIM_EnableARRPreload(Timer);
+    for (unsigned int i = 0; i < 3; i++) {
+        LL_TIM_OC_SetMode(Timer, g_MotorChannels[i], LL_TIM_OCMODE_PWM1);
+        LL_TIM_OC_SetPolarity(Timer, g_MotorChannels[i], LL_TIM_OCPOLARITY_HIGH);
+        LL_TIM_OC_EnablePreload(Timer, g_MotorChannels[i]);
+    }
+    const uint16_t Duty[3] = {MOTOR_PWM_HALF_PERIOD, MOTOR_PWM_HALF_PERIOD, MOTOR_PWM_HALF_PERIOD};
+    Motor_WriteDuty(Timer, Duty);
+    LL_TIM_SetCounter(Timer, 0);
+    LL_TIM_GenerateEvent_UPDATE(Timer);
+    LL_TIM_CC_EnableChannel(Timer, LL_TIM_CHANNEL_CH1 | LL_TIM_CHANNEL_CH2 | LL_TIM_CHANNEL_CH3);
+    if (IS_TIM_BREAK_INSTANCE(Timer)) {
+        LL_TIM_EnableAllOutputs(Timer);
+    }
+}
+
+bool Motor_Init (void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    __HAL_RCC_TIM1_CLK_ENABLE();
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+        Motor_ConfigureTimer(MotorDescriptor[i].Timer);
+        MotorDescriptor[i].State = (sMotorState_t) {0, 0, {MOTOR_PWM_HALF_PERIOD, MOTOR_PWM_HALF_PERIOD, MOTOR_PWM_HALF_PERIOD}};
+        GPIO_InitStruct.Pin = MotorDescriptor[i].Pins;
+        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+        GPIO_InitStruct.Pull = GPIO_NOPULL;
+        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+        GPIO_InitStruct.Alternate = MotorDescriptor[i].Alternate;
+        HAL_GPIO_Init(MotorDescriptor[i].Port, &GPIO_InitStruct);
+        if (MotorDescriptor[i].Timer != TIM1) {
+            LL_TIM_SetTriggerInput(MotorDescriptor[i].Timer, LL_TIM_TS_ITR0);
+            LL_TIM_SetSlaveMode(MotorDescriptor[i].Timer, LL_TIM_SLAVEMODE_TRIGGER);
+        }
+    }
+    LL_TIM_SetTriggerOutput(TIM1, LL_TIM_TRGO_ENABLE);
+    LL_TIM_EnableCounter(TIM1);
+    /* Slaves enable their own counter on the trigger */
+    return LL_TIM_IsEnabledCounter(TIM2) && LL_TIM_IsEnabledCounter(TIM3);
+}
+
+/* Angle in 1 / 65536 of an electrical turn, amplitude Q15. Phase B lags and phase C leads phase A by a third of a turn. */
+bool Motor_SetRaw (eMotor_t Motor, uint16_t ElectricalAngle, uint16_t Amplitude) {
+    bool RetVal = false;
+    /* Input check */
+    if (Motor < eMotor_Last) {
+        if (Amplitude > MOTOR_AMPLITUDE_ONE) {
+            Amplitude = MOTOR_AMPLITUDE_ONE;
+        }
+        int32_t Scale = ((int32_t)Amplitude * MOTOR_PWM_HALF_PERIOD) >> 15;
+        sMotorState_t *State = &MotorDescriptor[Motor].State;
+        State->Angle = ElectricalAngle;
+        State->Amplitude = Amplitude;
+        State->Duty[0] = Motor_PhaseDuty(ElectricalAngle, Scale);
+        State->Duty[1] = Motor_PhaseDuty((uint16_t)(ElectricalAngle - MOTOR_PHASE_SHIFT), Scale);
+        State->Duty[2] = Motor_PhaseDuty((uint16_t)(ElectricalAngle + MOTOR_PHASE_SHIFT), Scale);
+        Motor_WriteDuty(MotorDescriptor[Motor].Timer, State->Duty);
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* Angle in rad (any value, wraps every electrical turn), amplitude 0..1 of bus voltage */
+bool Motor_Set (eMotor_t Motor, float ElectricalAngle, float Amplitude) {
+    Amplitude = (Amplitude < 0.0f) ? 0.0f : ((Amplitude > 1.0f) ? 1.0f : Amplitude);
+    /* Through int32 so negative angles wrap the same way as positive ones */
+    uint16_t Angle = (uint16_t)(int32_t)(ElectricalAngle * MOTOR_ANGLE_SCALE);
+    return Motor_SetRaw(Motor, Angle, (uint16_t)(Amplitude * MOTOR_AMPLITUDE_ONE));
+}
+
+/* Stationary frame voltage vector, alpha along phase A. Length 1 is the largest vector SVPWM makes without clipping,
+ * same as amplitude 1 in Motor_Set, whose angle is that of the vector plus pi / 2 (phase A follows sine there).
+ * Same min/max zero sequence as the table, computed directly so the full angle resolution is kept. */
+bool Motor_SetVoltage (eMotor_t Motor, float Alpha, float Beta) {
+    bool RetVal = false;
+    /* Input check */
+    if (Motor < eMotor_Last) {
+        float Phase[3];
+        Math_InvClarke(Alpha, Beta, &Phase[0], &Phase[1]);
+        Phase[2] = -Phase[0] - Phase[1];
+        float Max = (Phase[0] > Phase[1]) ? Phase[0] : Phase[1];
+        float Min = (Phase[0] > Phase[1]) ? Phase[1] : Phase[0];
+        Max = (Phase[2] > Max) ? Phase[2] : Max;
+        Min = (Phase[2] < Min) ? Phase[2] : Min;
+        float Offset = 0.5f * (Max + Min);
+        sMotorState_t *State = &MotorDescriptor[Motor].State;
+        for (unsigned int i = 0; i < 3; i++) {
+            float Duty = MOTOR_PWM_HALF_PERIOD * (1.0f + (Phase[i] - Offset) * MOTOR_VECTOR_SCALE);
+            Duty = (Duty < 0.0f) ? 0.0f : ((Duty > MOTOR_PWM_PERIOD) ? MOTOR_PWM_PERIOD : Duty);
+            State->Duty[i] = (uint16_t)(Duty + 0.5f);
+        }
+        Motor_WriteDuty(MotorDescriptor[Motor].Timer, State->Duty);
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+bool Motor_GetState (eMotor_t Motor, sMotorState_t *Output) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Motor < eMotor_Last) && (Output != NULL)) {
+        *Output = MotorDescriptor[Motor].State;
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+uint16_t Motor_GetPwmPeriod (void) {
+    return MOTOR_PWM_PERIOD;
+}
+
+/* Cost of one control update, all three motors. Runs at zero amplitude, so motors see no voltage while it sweeps. */
+void MotorBenchmark_Run (void) {
+    uint32_t Sink = 0;
+    taskENTER_CRITICAL();
+    uint32_t Start = GetCycleCount();
+    for (unsigned int i = 0; i < MOTOR_BENCHMARK_STEPS; i++) {
+        float Angle = 0.01f * (float)i;
+        for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+            Motor_Set(Motor, Angle, 0.0f);
+        }
+        Sink += MotorDescriptor[eMotor_Roll].State.Duty[0];
+    }
+    uint32_t Cycles = (GetCycleCount() - Start) / MOTOR_BENCHMARK_STEPS;
+    taskEXIT_CRITICAL();
+    g_MotorBenchmarkSink = Sink;
+    uint32_t Budget = SystemCoreClock / MOTOR_BENCHMARK_RATE;
+    PrintToUart(eUart_1, "MOTOR update x%u[cyc] %u budget@%uHz[cyc] %u load %u.%u%%\r", (unsigned int)eMotor_Last, (unsigned int)Cycles,
+                (unsigned int)MOTOR_BENCHMARK_RATE, (unsigned int)Budget, (unsigned int)(Cycles * 100 / Budget),
+                (unsigned int)((Cycles * 1000 / Budget) % 10));
+}
@@ -0,0 +1,32 @@
+/* Generated by motor_svpwm_table.py from MOTOR_TABLE_BITS in motor_api.c, do not edit */
+#ifndef _MOTOR_SVPWM_TABLE_
+#define _MOTOR_SVPWM_TABLE_
+
+#define MOTOR_SVPWM_TABLE_BITS      8
+
+static const int16_t g_MotorSvpwmTable[1 << MOTOR_SVPWM_TABLE_BITS] = {
+         0,   1393,   2785,   4175,   5563,   6947,   8328,   9703,  11072,  12435,  13790,  15137,
+     16475,  17803,  19120,  20426,  21719,  22999,  24266,  25517,  26754,  27974,  28641,  29023,
+     29388,  29735,  30064,  30374,  30667,  30941,  31196,  31433,  31650,  31849,  32028,  32189,
+     32329,  32451,  32552,  32634,  32697,  32740,  32763,  32766,  32749,  32713,  32657,  32582,
+     32487,  32372,  32238,  32084,  31911,  31719,  31507,  31277,  31028,  30760,  30474,  30169,
+     29846,  29505,  29147,  28771,  28377,  28771,  29147,  29505,  29846,  30169,  30474,  30760,
+     31028,  31277,  31507,  31719,  31911,  32084,  32238,  32372,  32487,  32582,  32657,  32713,
+     32749,  32766,  32763,  32740,  32697,  32634,  32552,  32451,  32329,  32189,  32028,  31849,
+     31650,  31433,  31196,  30941,  30667,  30374,  30064,  29735,  29388,  29023,  28641,  27974,
+     26754,  25517,  24266,  22999,  21719,  20426,  19120,  17803,  16475,  15137,  13790,  12435,
+     11072,   9703,   8328,   6947,   5563,   4175,   2785,   1393,      0,  -1393,  -2785,  -4175,
+     -5563,  -6947,  -8328,  -9703, -11072, -12435, -13790, -15137, -16475, -17803, -19120, -20426,
+    -21719, -22999, -24266, -25517, -26754, -27974, -28641, -29023, -29388, -29735, -30064, -30374,
+    -30667, -30941, -31196, -31433, -31650, -31849, -32028, -32189, -32329, -32451, -32552, -32634,
+    -32697, -32740, -32763, -32766, -32749, -32713, -32657, -32582, -32487, -32372, -32238, -32084,
+    -31911, -31719, -31507, -31277, -31028, -30760, -30474, -30169, -29846, -29505, -29147, -28771,
+    -28377, -28771, -29147, -29505, -29846, -30169, -30474, -30760, -31028, -31277, -31507, -31719,
+    -31911, -32084, -32238, -32372, -32487, -32582, -32657, -32713, -32749, -32766, -32763, -32740,
+    -32697, -32634, -32552, -32451, -32329, -32189, -32028, -31849, -31650, -31433, -31196, -30941,
+    -30667, -30374, -30064, -29735, -29388, -29023, -28641, -27974, -26754, -25517, -24266, -22999,
+    -21719, -20426, -19120, -17803, -16475, -15137, -13790, -12435, -11072,  -9703,  -8328,  -6947,
+     -5563,  -4175,  -2785,  -1393,
+};
+
+#endif /* _MOTOR_SVPWM_TABLE_ */
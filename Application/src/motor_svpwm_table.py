@@ -0,0 +1,74 @@
+"""Generates motor_svpwm_table.h, the SVPWM table of motor_api.c.
+
+Run by the Keil project before every build (Options > User > Before Build), and by hand after changing
+MOTOR_TABLE_BITS on hosts without Keil. The table size is read from motor_api.c, so the two cannot disagree; the
+header is only rewritten when its content changes, so an unchanged table does not rebuild motor_api.c.
+
+Space vector modulation as min/max zero sequence injection, one electrical turn of phase A, Q15, scaled so the
+peak of sin(x) - (max + min) / 2 over three phases (sqrt(3) / 2) is full scale:
+round(32767 * 2 / sqrt(3) * (sin(x_a) - (max(x_a, x_b, x_c) + min(x_a, x_b, x_c)) / 2)), x_a = 2 * pi * i / size,
+x_b and x_c 120 degrees behind and ahead. Rounding is half away from zero, as lround in Tests/test_motor.c.
+"""
+
+import math
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SOURCE = os.path.join(HERE, "motor_api.c")
+OUTPUT = os.path.join(HERE, "motor_svpwm_table.h")
+AMPLITUDE_ONE = 32767
+PER_LINE = 12
+
+
+def table_bits():
+    with open(SOURCE) as source:
+        match = re.search(r"^#define\s+MOTOR_TABLE_BITS\s+(\d+)", source.read(), re.MULTILINE)
+    if match is None:
+        sys.exit("%s: MOTOR_TABLE_BITS not found" % SOURCE)
+    return int(match.group(1))
+
+
+def svpwm(x):
+    phases = [math.sin(x), math.sin(x - 2.0 * math.pi / 3.0), math.sin(x + 2.0 * math.pi / 3.0)]
+    return 2.0 / math.sqrt(3.0) * (phases[0] - (max(phases) + min(phases)) / 2.0)
+
+
+def round_half_away(value):
+    return int(math.copysign(math.floor(abs(value) + 0.5), value))
+
+
+def render(bits):
+    size = 1 << bits
+    entries = [round_half_away(AMPLITUDE_ONE * svpwm(2.0 * math.pi * i / size)) for i in range(size)]
+    lines = [
+        "/* Generated by motor_svpwm_table.py from MOTOR_TABLE_BITS in motor_api.c, do not edit */",
+        "#ifndef _MOTOR_SVPWM_TABLE_",
+        "#define _MOTOR_SVPWM_TABLE_",
+        "",
+        "#define MOTOR_SVPWM_TABLE_BITS      %d" % bits,
+        "",
+        "static const int16_t g_MotorSvpwmTable[1 << MOTOR_SVPWM_TABLE_BITS] = {",
+    ]
+    for start in range(0, size, PER_LINE):
+        lines.append("    " + " ".join("%6d," % entry for entry in entries[start:start + PER_LINE]))
+    lines += ["};", "", "#endif /* _MOTOR_SVPWM_TABLE_ */", ""]
+    return "\n".join(lines)
+
+
+def main():
+    content = render(table_bits())
+    try:
+        with open(OUTPUT) as current:
+            if current.read() == content:
+                return
+    except IOError:
+        pass
+    with open(OUTPUT, "w") as output:
+        output.write(content)
+    print("motor_svpwm_table.py: wrote %s" % OUTPUT)
+
+
+if __name__ == "__main__":
+    main()
@@ -5,11 +5,12 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "cmsis_os.h"
-#include "Spi_api.h"
+#include "spi_api.h"
 #include "uart_api.h"
 #include "error_handling_api.h"
+#include "timing_stats_api.h"
 
-extern osThreadId defaultTaskHandle;
+extern osThreadId controlTaskHandle;
 
 #define SHIFT_TO_H(x) (x << 8)
 
@@ -17,29 +18,62 @@ extern osThreadId defaultTaskHandle;
 #define WHO_AM_I_RESPONSE 0x71
 
 /* Hardcoded config values */
-#define HARDCODED_GYR_CONFIG        0x10 //GYRO_FS_SEL = +500 dps, rest is default
+#define HARDCODED_CONFIG            0x01 //DLPF_CFG = 1, 1 kHz internal rate, FIFO overwrites oldest data
+#define HARDCODED_SMPLRT_DIV        0x00 //ODR = 1 kHz / (1 + SMPLRT_DIV)
+#define MPU_SAMPLE_PERIOD_US        (1000 * (1 + HARDCODED_SMPLRT_DIV))
+#define HARDCODED_GYR_CONFIG        0x10 //GYRO_FS_SEL = +-1000 dps, rest is default
 #define HARDCODED_ACC_CONFIG        0x10 //ACCEL_FS_SEL = +-8 g, rest is default
 
 #define HARDCODED_INT_PIN           0x10 //INT cleared by reading any data
-#define HARDCODED_INT_EN            0x01 //INT only on raw data ready
 #ifdef USE_FIFO
+#define HARDCODED_INT_EN            0x00 //FIFO is polled, data ready would only pile up notifications nobody takes
 #define HARDCODED_FIFO_ENABLE       0x78 //all ACC and GYRO data included in FIFO
-#define HARDCODED_USER_CTRL         0x40 //FIFO enalbed
+#define HARDCODED_USER_CTRL         0x60 //FIFO enalbed, I2C master enabled
+#define HARDCODED_FIFO_RESET        0x64 //FIFO enabled, I2C master enabled, FIFO_RST
 #else
+#define HARDCODED_INT_EN            0x01 //INT only on raw data ready
 #define HARDCODED_FIFO_ENABLE       0x00
-#define HARDCODED_USER_CTRL         0x00
+#define HARDCODED_USER_CTRL         0x20 //I2C master enabled
+#define HARDCODED_FIFO_RESET        0x24
 #endif
 
-#define HARDCODED_I2C_CTRL          0x40 //INT delayed by external sensor
+/* FIFO frame layout for HARDCODED_FIFO_ENABLE: ACCEL XYZ, GYRO XYZ */
+#define MPU_FIFO_SIZE               512
+#define MPU_FIFO_FRAME_LENGTH       12
+#define MPU_FIFO_FRAME_A_OFFSET     0
+#define MPU_FIFO_FRAME_G_OFFSET     6
+#define MPU_FIFO_MAX_FRAMES         (MPU_FIFO_SIZE / MPU_FIFO_FRAME_LENGTH)
+
+#define MPU_BENCHMARK_SAMPLES       1000
+#define MPU_BENCHMARK_RATE          (1000000 / MPU_SAMPLE_PERIOD_US)    // Hz, one conversion per sample at ODR
+
+#define HARDCODED_I2C_CTRL          0x4D //INT delayed by external sensor, 400 kHz I2C master clock
+#define I2C_SLV_READ                0x80 //read bit of I2C_SLVx_ADDR
+#define I2C_SLV_EN                  0x80 //enable bit of I2C_SLVx_CTRL
+#define I2C_SLV4_DONE               0x40 //I2C_MST_STATUS
+#define I2C_SLV4_NACK               0x10 //I2C_MST_STATUS
+#define I2C_SLV4_RETRIES            10
+
+/* AK8963 magnetometer behind MPU9250 I2C master */
+#define AKM_I2C_ADDRESS             0x0C
 #define AKM_DEVICE_ID               0x48
-#define AKM_ADDRESS_TO_READ         0x03
-#define AKM_BYTES_TO_READ           6
+#define AKM_SOFT_RESET              0x01 //CNTL2
+#define AKM_MODE_POWER_DOWN         0x00 //CNTL1
+#define AKM_MODE_FUSE_ROM           0x0F //CNTL1
+#define AKM_MODE_CONTINUOUS_100HZ   0x16 //CNTL1, 16 bit output
+#define AKM_ST1_DRDY                0x01
+#define AKM_ST2_HOFL                0x08
+#define AKM_BYTES_TO_READ           8    //ST1, HXL..HZH, ST2
+#define AKM_UT_PER_LSB              0.15f //16 bit output
 
 
-/* Hardcoded conversion coeficients */
-#define HARDCODED_ACC_CONV_COEF    (1/4.096)
-#define HARDCODED_GYR_CONV_COEF    (1/32.8)
-#define HARDCODED_MAG_CONV_COEF    (1/0.6)
+/* Full scale select field of GYRO_CONFIG and ACCEL_CONFIG */
+#define FS_SEL_SHIFT                3
+#define FS_SEL_MASK                 0x03
+#define MG_IN_G                     1000.0f
+
+/* AXH..MagSt2, read in one burst */
+#define MPU_DATA_BLOCK_LENGTH       (eMpuRegisters_MagSt2 - eMpuRegisters_AXH + 1)
 
 
 typedef enum {
@@ -57,6 +91,13 @@ typedef enum {
     eMpuRegisters_slave0Rer     =   0x26,
     eMpuRegisters_slave0Ctrl    =   0x27,
 
+    eMpuRegisters_slave4Addr    =   0x31,
+    eMpuRegisters_slave4Reg     =   0x32,
+    eMpuRegisters_slave4Do      =   0x33,
+    eMpuRegisters_slave4Ctrl    =   0x34,
+    eMpuRegisters_slave4Di      =   0x35,
+    eMpuRegisters_I2CMstStatus  =   0x36,
+
     eMpuRegisters_IntPinCfg     =   0x37,
     eMpuRegisters_IntEn         =   0x38,
 
@@ -67,6 +108,8 @@ typedef enum {
     eMpuRegisters_AYL           =   0x3E,
     eMpuRegisters_AZH           =   0x3F,
     eMpuRegisters_AZL           =   0x40,
+    eMpuRegisters_TempH         =   0x41,
+    eMpuRegisters_TempL         =   0x42,
 
     eMpuRegisters_GXH           =   0x43,
     eMpuRegisters_GXL           =   0x44,
@@ -74,13 +117,15 @@ typedef enum {
     eMpuRegisters_GYL           =   0x46,
     eMpuRegisters_GZH           =   0x47,
     eMpuRegisters_GZL           =   0x48,
-    /* Taken from external sensor data */
-    eMpuRegisters_MXH           =   0x49,
+    /* Taken from external sensor data, AK8963 ST1..ST2 read by slave0 */
+    eMpuRegisters_MagSt1        =   0x49,
     eMpuRegisters_MXL           =   0x4A,
-    eMpuRegisters_MYH           =   0x4B,
+    eMpuRegisters_MXH           =   0x4B,
     eMpuRegisters_MYL           =   0x4C,
-    eMpuRegisters_MZH           =   0x4D,
+    eMpuRegisters_MYH           =   0x4D,
     eMpuRegisters_MZL           =   0x4E,
+    eMpuRegisters_MZH           =   0x4F,
+    eMpuRegisters_MagSt2        =   0x50,
 
     eMpuRegisters_UserCtrl      =   0x6A,
 
@@ -92,6 +137,16 @@ typedef enum {
     eMpuRegisters_Last,
 } eMpuRegisters_t;
 
+typedef enum {
+    eAkmRegisters_Wia           =   0x00,
+    eAkmRegisters_St1           =   0x02,
+    eAkmRegisters_Cntl1         =   0x0A,
+    eAkmRegisters_Cntl2         =   0x0B,
+    eAkmRegisters_AsaX          =   0x10,
+    eAkmRegisters_AsaY          =   0x11,
+    eAkmRegisters_AsaZ          =   0x12,
+} eAkmRegisters_t;
+
 
 typedef struct {
     int16_t X;
@@ -103,9 +158,65 @@ typedef struct {
     sRawData3D_t A;
     sRawData3D_t G;
     sRawData3D_t M;
+    bool MagFresh;
 } sImuRawData_t;
 
 
+/* Sensitivity for each FS_SEL value */
+static const float g_AccLsbPerG[FS_SEL_MASK + 1]    = {16384.0f, 8192.0f, 4096.0f, 2048.0f};
+static const float g_GyrLsbPerDps[FS_SEL_MASK + 1]  = {131.0f, 65.5f, 32.8f, 16.4f};
+
+/* Calibration in physical units: Out = Matrix * (Raw * Scale - Bias) */
+static sSensorCalibration_t g_MpuCalibration[eMpuSensor_Last] = {
+    [eMpuSensor_Acc] = { {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, {0.0f, 0.0f, 0.0f} },
+    [eMpuSensor_Gyr] = { {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, {0.0f, 0.0f, 0.0f} },
+    [eMpuSensor_Mag] = { {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, {0.0f, 0.0f, 0.0f} },
+};
+
+/* Calibration folded together with sensitivity: Out = Gain * Raw - Offset */
+typedef struct {
+    float Gain[3][3];
+    float Offset[3];
+} sMpuConversion_t;
+
+/* Per axis, magnetometer scale includes factory sensitivity adjustment */
+static float g_MpuScale[eMpuSensor_Last][3] = {
+    [eMpuSensor_Mag] = {AKM_UT_PER_LSB, AKM_UT_PER_LSB, AKM_UT_PER_LSB},
+};
+static sMpuConversion_t g_MpuConversion[eMpuSensor_Last];
+
+typedef struct {
+    eMpuRegisters_t Register;
+    uint8_t Value;
+} sMpuRegisterConfig_t;
+
+/* Applied in this order, keep entries sorted by address so they can be written in bursts */
+static const sMpuRegisterConfig_t g_MpuConfigTable[] = {
+    { eMpuRegisters_SmplRt_div,     HARDCODED_SMPLRT_DIV    },
+    { eMpuRegisters_Config,         HARDCODED_CONFIG        },
+    { eMpuRegisters_GConfig,        HARDCODED_GYR_CONFIG    },
+    { eMpuRegisters_AConfig1,       HARDCODED_ACC_CONFIG    },
+    { eMpuRegisters_FifoEn,         HARDCODED_FIFO_ENABLE   },
+    { eMpuRegisters_I2CCtrl,        HARDCODED_I2C_CTRL      },
+    { eMpuRegisters_slave0Addr,     (I2C_SLV_READ | AKM_I2C_ADDRESS)    },
+    { eMpuRegisters_slave0Rer,      eAkmRegisters_St1                   },
+    { eMpuRegisters_slave0Ctrl,     (I2C_SLV_EN | AKM_BYTES_TO_READ)    },
+    { eMpuRegisters_IntPinCfg,      HARDCODED_INT_PIN       },
+    { eMpuRegisters_IntEn,          HARDCODED_INT_EN        },
+    { eMpuRegisters_UserCtrl,       HARDCODED_USER_CTRL     },
+};
+
+#define MPU_CONFIG_TABLE_LENGTH     (sizeof(g_MpuConfigTable) / sizeof(g_MpuConfigTable[0]))
+/* Read-back block covering every register in config table */
+#define MPU_CONFIG_BLOCK_FIRST      eMpuRegisters_SmplRt_div
+#define MPU_CONFIG_BLOCK_LENGTH     (eMpuRegisters_UserCtrl - eMpuRegisters_SmplRt_div + 1)
+
+static uint8_t g_MpuFifoBuffer[MPU_FIFO_MAX_FRAMES * MPU_FIFO_FRAME_LENGTH];
+static unsigned int g_MpuFifoOverflowCount = 0;
+static volatile uint32_t g_MpuDataReadyTimestamp = 0;
+static volatile float g_MpuBenchmarkSink;
+
+
 bool Mpu_Detect (void) {
     bool RetVal = false;
     uint8_t ResponseBuffer = 0;
@@ -119,179 +230,33 @@ bool Mpu_Detect (void) {
     return RetVal;
 }
 
-/* TODO (long term): improve structure of functions in this file */
-bool Mpu_ARead (sRawData3D_t *AccData) {
-    bool ErrorHasHappened = false;
-    uint8_t ResponseBuffer = 0;
-    /* X data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_AXH, eSpiSlave_MPU)) {
-            AccData->X = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_AXL, eSpiSlave_MPU)) {
-            AccData->X += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    /* Y data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_AYH, eSpiSlave_MPU)) {
-            AccData->Y = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_AYL, eSpiSlave_MPU)) {
-            AccData->Y += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    /* Z data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_AZH, eSpiSlave_MPU)) {
-            AccData->Z = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_AZL, eSpiSlave_MPU)) {
-            AccData->Z += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (ErrorHasHappened) {
-        PrintToUart(eUart_1, "ERROR: Acc data reading failed\r");
-    }
-    return !ErrorHasHappened;
+void Mpu_ParseRaw3D (sRawData3D_t *Data, const uint8_t *Buffer) {
+    Data->X = (int16_t)(SHIFT_TO_H(Buffer[0]) | Buffer[1]);
+    Data->Y = (int16_t)(SHIFT_TO_H(Buffer[2]) | Buffer[3]);
+    Data->Z = (int16_t)(SHIFT_TO_H(Buffer[4]) | Buffer[5]);
 }
 
-bool Mpu_GRead (sRawData3D_t *GyrData) {
-    bool ErrorHasHappened = false;
-    uint8_t ResponseBuffer = 0;
-    /* X data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_GXH, eSpiSlave_MPU)) {
-            GyrData->X = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_GXL, eSpiSlave_MPU)) {
-            GyrData->X += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    /* Y data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_GYH, eSpiSlave_MPU)) {
-            GyrData->Y = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_GYL, eSpiSlave_MPU)) {
-            GyrData->Y += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    /* Z data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_GZH, eSpiSlave_MPU)) {
-            GyrData->Z = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_GZL, eSpiSlave_MPU)) {
-            GyrData->Z += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (ErrorHasHappened) {
-        PrintToUart(eUart_1, "ERROR: Gyr data reading failed\r");
-    }
-    return !ErrorHasHappened;
+/* AK8963 is little endian and its X/Y axes are swapped, Z inverted relative to MPU axes */
+void Mpu_ParseMagRaw3D (sRawData3D_t *Data, const uint8_t *Buffer) {
+    Data->X = (int16_t)(SHIFT_TO_H(Buffer[3]) | Buffer[2]);
+    Data->Y = (int16_t)(SHIFT_TO_H(Buffer[1]) | Buffer[0]);
+    Data->Z = -(int16_t)(SHIFT_TO_H(Buffer[5]) | Buffer[4]);
 }
 
-bool Mpu_MRead (sRawData3D_t *GyrData) {
-    bool ErrorHasHappened = false;
-    uint8_t ResponseBuffer = 0;
-    /* X data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_MXH, eSpiSlave_MPU)) {
-            GyrData->X = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_MXL, eSpiSlave_MPU)) {
-            GyrData->X += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    /* Y data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_MYH, eSpiSlave_MPU)) {
-            GyrData->Y = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_MYL, eSpiSlave_MPU)) {
-            GyrData->Y += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    /* Z data reading */
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_MZH, eSpiSlave_MPU)) {
-            GyrData->Z = SHIFT_TO_H(ResponseBuffer);
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (!ErrorHasHappened) {
-        if (SpiReadSlaveRegister(&ResponseBuffer, eMpuRegisters_MZL, eSpiSlave_MPU)) {
-            GyrData->Z += ResponseBuffer;
-        } else {
-            ErrorHasHappened = true;
-        }
-    }
-    if (ErrorHasHappened) {
-        PrintToUart(eUart_1, "ERROR: Gyr data reading failed\r");
-    }
-    return !ErrorHasHappened;
-}
-
-
-/* TODO: add mag data */
+/* Whole data block (accel, temp, gyro, external sensor) is fetched in a single burst */
 bool Mpu_ImuRead (sImuRawData_t *ImuRawData) {
     bool RetVal = false;
-    if (Mpu_ARead(&(ImuRawData->A))) {
-        if (Mpu_GRead(&(ImuRawData->G))) {
-            if (Mpu_GRead(&(ImuRawData->M))) {
-                RetVal = true;
-            }
-        }
+    uint8_t DataBuffer[MPU_DATA_BLOCK_LENGTH];
+    if (SpiReadSlaveRegisters(eSpiSlave_MPU, eMpuRegisters_AXH, DataBuffer, MPU_DATA_BLOCK_LENGTH)) {
+        Mpu_ParseRaw3D(&(ImuRawData->A), &DataBuffer[eMpuRegisters_AXH - eMpuRegisters_AXH]);
+        Mpu_ParseRaw3D(&(ImuRawData->G), &DataBuffer[eMpuRegisters_GXH - eMpuRegisters_AXH]);
+        Mpu_ParseMagRaw3D(&(ImuRawData->M), &DataBuffer[eMpuRegisters_MXL - eMpuRegisters_AXH]);
+        /* DRDY is seen once per new measurement, reading ST2 by slave0 releases the data registers */
+        ImuRawData->MagFresh = (DataBuffer[eMpuRegisters_MagSt1 - eMpuRegisters_AXH] & AKM_ST1_DRDY) &&
+                               !(DataBuffer[eMpuRegisters_MagSt2 - eMpuRegisters_AXH] & AKM_ST2_HOFL);
+        RetVal = true;
+    } else {
+        PrintToUart(eUart_1, "ERROR: IMU data reading failed\r");
     }
     return RetVal;
 }
@@ -310,6 +275,72 @@ void Mpu_PrintData (sImuData_t *ImuData) {
                             ImuData->M.X, ImuData->M.Y, ImuData->M.Z);
 }
 
+/* Log format for offline replay, one sample per line: timestamp in DWT cycles, acc in mg, gyro in dps, mag in uT */
+void Mpu_PrintCsvHeader (void) {
+    PrintToUart(eUart_1, "IMUCSV,clock=%u,t,ax,ay,az,gx,gy,gz,mx,my,mz,magfresh\r", (unsigned int)SystemCoreClock);
+}
+
+void Mpu_PrintCsv (const sImuData_t *ImuData) {
+    PrintToUart(eUart_1, "IMU,%u,%.2f,%.2f,%.2f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%u\r", (unsigned int)ImuData->Timestamp,
+                ImuData->A.X, ImuData->A.Y, ImuData->A.Z,
+                ImuData->G.X, ImuData->G.Y, ImuData->G.Z,
+                ImuData->M.X, ImuData->M.Y, ImuData->M.Z, (unsigned int)ImuData->MagFresh);
+}
+
+void Mpu_UpdateConversion (eMpuSensor_t Sensor) {
+    sMpuConversion_t Conversion;
+    const sSensorCalibration_t *Calibration = &g_MpuCalibration[Sensor];
+    const float Bias[3] = {Calibration->Bias.X, Calibration->Bias.Y, Calibration->Bias.Z};
+    for (unsigned int i = 0; i < 3; i++) {
+        Conversion.Offset[i] = 0.0f;
+        for (unsigned int j = 0; j < 3; j++) {
+            Conversion.Gain[i][j] = Calibration->Matrix[i][j] * g_MpuScale[Sensor][j];
+            Conversion.Offset[i] += Calibration->Matrix[i][j] * Bias[j];
+        }
+    }
+    taskENTER_CRITICAL();
+    g_MpuConversion[Sensor] = Conversion;
+    taskEXIT_CRITICAL();
+}
+
+/* Scale is derived from full scale range actually written to the sensor */
+void Mpu_SetFullScale (uint8_t AccConfig, uint8_t GyrConfig) {
+    for (unsigned int i = 0; i < 3; i++) {
+        g_MpuScale[eMpuSensor_Acc][i] = MG_IN_G / g_AccLsbPerG[(AccConfig >> FS_SEL_SHIFT) & FS_SEL_MASK];
+        g_MpuScale[eMpuSensor_Gyr][i] = 1.0f / g_GyrLsbPerDps[(GyrConfig >> FS_SEL_SHIFT) & FS_SEL_MASK];
+    }
+    for (eMpuSensor_t i = eMpuSensor_First; i < eMpuSensor_Last; i++) {
+        Mpu_UpdateConversion(i);
+    }
+}
+
+bool Mpu_SetCalibration (eMpuSensor_t Sensor, const sSensorCalibration_t *Calibration) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Sensor < eMpuSensor_Last) && (Calibration != NULL)) {
+        g_MpuCalibration[Sensor] = *Calibration;
+        Mpu_UpdateConversion(Sensor);
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+static inline void Mpu_Convert3D (sData3D_t *Data, const sRawData3D_t *RawData, const sMpuConversion_t *Conversion) {
+    const float X = (float)RawData->X;
+    const float Y = (float)RawData->Y;
+    const float Z = (float)RawData->Z;
+    Data->X = Conversion->Gain[0][0] * X + Conversion->Gain[0][1] * Y + Conversion->Gain[0][2] * Z - Conversion->Offset[0];
+    Data->Y = Conversion->Gain[1][0] * X + Conversion->Gain[1][1] * Y + Conversion->Gain[1][2] * Z - Conversion->Offset[1];
+    Data->Z = Conversion->Gain[2][0] * X + Conversion->Gain[2][1] * Y + Conversion->Gain[2][2] * Z - Conversion->Offset[2];
+}
+
+void Mpu_ConvertData (sImuData_t *ImuData, sImuRawData_t *ImuRawData) {
+    Mpu_Convert3D(&(ImuData->A), &(ImuRawData->A), &g_MpuConversion[eMpuSensor_Acc]);
+    Mpu_Convert3D(&(ImuData->G), &(ImuRawData->G), &g_MpuConversion[eMpuSensor_Gyr]);
+    Mpu_Convert3D(&(ImuData->M), &(ImuRawData->M), &g_MpuConversion[eMpuSensor_Mag]);
+    ImuData->MagFresh = ImuRawData->MagFresh;
+}
+
 /* TODO: update or delete */
 void Mpu_ConfigPrint (void) {
     uint8_t ResponseBuffer = 0;
@@ -345,82 +376,151 @@ void Mpu_ConfigPrint (void) {
     }
 }
 
+bool Mpu_ConfigVerify (void) {
+    bool RetVal = false;
+    uint8_t ReadBackBuffer[MPU_CONFIG_BLOCK_LENGTH];
+    if (SpiReadSlaveRegisters(eSpiSlave_MPU, MPU_CONFIG_BLOCK_FIRST, ReadBackBuffer, MPU_CONFIG_BLOCK_LENGTH)) {
+        RetVal = true;
+        for (unsigned int i = 0; i < MPU_CONFIG_TABLE_LENGTH; i++) {
+            uint8_t ActualValue = ReadBackBuffer[g_MpuConfigTable[i].Register - MPU_CONFIG_BLOCK_FIRST];
+            if (ActualValue != g_MpuConfigTable[i].Value) {
+                PrintToUart(eUart_1, "ERROR: MPU register 0x%02x is 0x%02x, expected 0x%02x\r",
+                            g_MpuConfigTable[i].Register, ActualValue, g_MpuConfigTable[i].Value);
+                RetVal = false;
+            }
+        }
+    }
+    return RetVal;
+}
+
+/* Consecutive table entries are written in one burst, whole block is verified once at the end */
 bool Mpu_Config (void) {
     bool ErrorHasHappened = false;
-    /* set Gyro config*/
-    if (!SpiWriteSlaveRegister(HARDCODED_GYR_CONFIG, eMpuRegisters_GConfig, eSpiSlave_MPU)) {
-        //PrintToUart(eUart_1, "MPU Gyro config failed\r");
-        ErrorHasHappened = true;
-    }
-    /* set Accel config*/
-    if (!SpiWriteSlaveRegister(HARDCODED_ACC_CONFIG, eMpuRegisters_AConfig1, eSpiSlave_MPU)) {
-        //PrintToUart(eUart_1, "MPU Accel config failed\r");
-        ErrorHasHappened = true;
-    }
-    /* set Int pin config*/
-    if (!SpiWriteSlaveRegister(HARDCODED_INT_PIN, eMpuRegisters_IntPinCfg, eSpiSlave_MPU)) {
-        //PrintToUart(eUart_1, "MPU INT PIN config failed\r");
-        ErrorHasHappened = true;
+    uint8_t WriteBuffer[MPU_CONFIG_TABLE_LENGTH];
+    unsigned int RunStart = 0;
+    unsigned int RunLength = 0;
+    while (RunStart < MPU_CONFIG_TABLE_LENGTH) {
+        RunLength = 0;
+        do {
+            WriteBuffer[RunLength] = g_MpuConfigTable[RunStart + RunLength].Value;
+            RunLength++;
+        } while (((RunStart + RunLength) < MPU_CONFIG_TABLE_LENGTH) &&
+                 (g_MpuConfigTable[RunStart + RunLength].Register == (g_MpuConfigTable[RunStart].Register + RunLength)));
+        if (!SpiWriteSlaveRegisters(eSpiSlave_MPU, g_MpuConfigTable[RunStart].Register, WriteBuffer, RunLength)) {
+            ErrorHasHappened = true;
+        }
+        RunStart += RunLength;
     }
-    /* set Int en config*/
-    if (!SpiWriteSlaveRegister(HARDCODED_INT_EN, eMpuRegisters_IntEn, eSpiSlave_MPU)) {
-        //PrintToUart(eUart_1, "MPU INT EN config failed\r");
+    if (!Mpu_ConfigVerify()) {
         ErrorHasHappened = true;
     }
-    /* set FIFO en config*/
-    if (!SpiWriteSlaveRegister(HARDCODED_FIFO_ENABLE, eMpuRegisters_FifoEn, eSpiSlave_MPU)) {
-        //PrintToUart(eUart_1, "MPU FIFO en config failed\r");
-        ErrorHasHappened = true;
+    Mpu_SetFullScale(HARDCODED_ACC_CONFIG, HARDCODED_GYR_CONFIG);
+    return !ErrorHasHappened;
+}
+
+/* Single AK8963 register access through I2C master slave4, slave0 keeps streaming data */
+bool Mpu_MagTransaction (uint8_t Address, uint8_t Register, uint8_t Value, uint8_t *ReadValue) {
+    bool RetVal = false;
+    bool Done = false;
+    uint8_t Status = 0;
+    const uint8_t Slave4Block[] = {Address, Register, Value, I2C_SLV_EN};
+    if (SpiWriteSlaveRegisters(eSpiSlave_MPU, eMpuRegisters_slave4Addr, Slave4Block, sizeof(Slave4Block))) {
+        /* Slave4 transaction is executed on the next sample period */
+        for (unsigned int i = 0; (i < I2C_SLV4_RETRIES) && !Done; i++) {
+            vTaskDelay(1);
+            if (SpiReadSlaveRegister(&Status, eMpuRegisters_I2CMstStatus, eSpiSlave_MPU) && (Status & I2C_SLV4_DONE)) {
+                Done = true;
+            }
+        }
+        if (Done && !(Status & I2C_SLV4_NACK)) {
+            if (ReadValue != NULL) {
+                RetVal = SpiReadSlaveRegister(ReadValue, eMpuRegisters_slave4Di, eSpiSlave_MPU);
+            } else {
+                RetVal = true;
+            }
+        }
     }
-    /* set user ctrl*/
-    if (!SpiWriteSlaveRegister(HARDCODED_USER_CTRL, eMpuRegisters_UserCtrl, eSpiSlave_MPU)) {
-        //PrintToUart(eUart_1, "MPU user ctrl config failed\r");
+    return RetVal;
+}
+
+bool Mpu_MagWriteRegister (eAkmRegisters_t Register, uint8_t Value) {
+    return Mpu_MagTransaction(AKM_I2C_ADDRESS, Register, Value, NULL);
+}
+
+bool Mpu_MagReadRegister (eAkmRegisters_t Register, uint8_t *Value) {
+    return Mpu_MagTransaction((I2C_SLV_READ | AKM_I2C_ADDRESS), Register, 0, Value);
+}
+
+/* Resets AK8963, reads sensitivity adjustment once and starts continuous 100 Hz measurement */
+bool Mpu_MagInit (void) {
+    bool ErrorHasHappened = false;
+    uint8_t DeviceId = 0;
+    uint8_t Asa[3] = {0};
+    if (!Mpu_MagWriteRegister(eAkmRegisters_Cntl2, AKM_SOFT_RESET)) {
         ErrorHasHappened = true;
     }
-    /* set I2C master ctrl*/
-    if (!SpiWriteSlaveRegister(HARDCODED_I2C_CTRL, eMpuRegisters_I2CCtrl, eSpiSlave_MPU)) {
-        ErrorHasHappened = true;
+    if (!ErrorHasHappened) {
+        if (!Mpu_MagReadRegister(eAkmRegisters_Wia, &DeviceId) || (DeviceId != AKM_DEVICE_ID)) {
+            PrintToUart(eUart_1, "ERROR: AK8963 not detected\r");
+            ErrorHasHappened = true;
+        }
     }
-    /* set slave0 addr */
-    if (!SpiWriteSlaveRegister(AKM_DEVICE_ID, eMpuRegisters_slave0Addr, eSpiSlave_MPU)) {
-        ErrorHasHappened = true;
+    /* Sensitivity adjustment values are only readable in fuse ROM access mode */
+    if (!ErrorHasHappened) {
+        if (!Mpu_MagWriteRegister(eAkmRegisters_Cntl1, AKM_MODE_FUSE_ROM) ||
+            !Mpu_MagReadRegister(eAkmRegisters_AsaX, &Asa[0]) ||
+            !Mpu_MagReadRegister(eAkmRegisters_AsaY, &Asa[1]) ||
+            !Mpu_MagReadRegister(eAkmRegisters_AsaZ, &Asa[2])) {
+            ErrorHasHappened = true;
+        }
     }
-    /* set slave0 reg */
-    if (!SpiWriteSlaveRegister(AKM_ADDRESS_TO_READ, eMpuRegisters_slave0Rer, eSpiSlave_MPU)) {
-        ErrorHasHappened = true;
+    /* Mode can only be changed from power down */
+    if (!ErrorHasHappened) {
+        if (!Mpu_MagWriteRegister(eAkmRegisters_Cntl1, AKM_MODE_POWER_DOWN) ||
+            !Mpu_MagWriteRegister(eAkmRegisters_Cntl1, AKM_MODE_CONTINUOUS_100HZ)) {
+            ErrorHasHappened = true;
+        }
     }
-    /* set slave0 data length*/
-    if (!SpiWriteSlaveRegister(AKM_BYTES_TO_READ, eMpuRegisters_slave0Ctrl, eSpiSlave_MPU)) {
-        ErrorHasHappened = true;
+    if (!ErrorHasHappened) {
+        /* Hadj = H * ((ASA - 128) / 256 + 1), MPU X/Y axes are AK8963 Y/X */
+        g_MpuScale[eMpuSensor_Mag][0] = AKM_UT_PER_LSB * (((float)Asa[1] - 128.0f) / 256.0f + 1.0f);
+        g_MpuScale[eMpuSensor_Mag][1] = AKM_UT_PER_LSB * (((float)Asa[0] - 128.0f) / 256.0f + 1.0f);
+        g_MpuScale[eMpuSensor_Mag][2] = AKM_UT_PER_LSB * (((float)Asa[2] - 128.0f) / 256.0f + 1.0f);
+        Mpu_UpdateConversion(eMpuSensor_Mag);
     }
     return !ErrorHasHappened;
 }
 
-void Mpu_ConvertData (sImuData_t *ImuData, sImuRawData_t *ImuRawData) {
-    ImuData->A.X = ImuRawData->A.X * HARDCODED_ACC_CONV_COEF;
-    ImuData->A.Y = ImuRawData->A.Y * HARDCODED_ACC_CONV_COEF;
-    ImuData->A.Z = ImuRawData->A.Z * HARDCODED_ACC_CONV_COEF;
-    ImuData->G.X = ImuRawData->G.X * HARDCODED_GYR_CONV_COEF;
-    ImuData->G.Y = ImuRawData->G.Y * HARDCODED_GYR_CONV_COEF;
-    ImuData->G.Z = ImuRawData->G.Z * HARDCODED_GYR_CONV_COEF;
-    ImuData->M.X = ImuRawData->M.X * HARDCODED_MAG_CONV_COEF;
-    ImuData->M.Y = ImuRawData->M.Y * HARDCODED_MAG_CONV_COEF;
-    ImuData->M.Z = ImuRawData->M.Z * HARDCODED_MAG_CONV_COEF;
-}
-
 bool Mpu_Init (void) {
     bool RetVal = false;
     if (Mpu_Detect()) {
         if(Mpu_Config()) {
             RetVal = true;
+            /* Accel and gyro are usable without magnetometer, MagFresh just never gets set */
+            if (!Mpu_MagInit()) {
+                PrintToUart(eUart_1, "ERROR: AK8963 initialization failed\r");
+            }
         }
     }
     return RetVal;
 }
 
-/* TODO: transfer this functionality from default task */
+/* Data ready interrupt, wakes the control task */
 void HandleExt3IRQ (void) {
-    vTaskNotifyGiveFromISR((TaskHandle_t)defaultTaskHandle, NULL);
+    g_MpuDataReadyTimestamp = GetCycleCount();
+    if (controlTaskHandle != NULL) {
+        BaseType_t HigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR((TaskHandle_t)controlTaskHandle, &HigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(HigherPriorityTaskWoken);
+    }
+}
+
+uint32_t Mpu_GetDataReadyTimestamp (void) {
+    return g_MpuDataReadyTimestamp;
+}
+
+unsigned int Mpu_GetSamplePeriodUs (void) {
+    return MPU_SAMPLE_PERIOD_US;
 }
 
 /*void TestDataRequest (void) {
@@ -441,10 +541,96 @@ void HandleExt3IRQ (void) {
 bool ReadIMU (sImuData_t *ImuData) {
     bool RetVal = false;
     sImuRawData_t ImuRawData;
+    /* Latched by data ready interrupt before the burst is started */
+    uint32_t Timestamp = g_MpuDataReadyTimestamp;
     if (Mpu_ImuRead(&ImuRawData)) {
         Mpu_ConvertData(ImuData, &ImuRawData);
-        Mpu_PrintData(ImuData);
+        ImuData->Timestamp = Timestamp;
         RetVal = true;
     }
     return RetVal;
 }
+
+bool Mpu_FifoReset (void) {
+    const uint8_t UserCtrl = HARDCODED_FIFO_RESET;
+    /* FIFO_RST bit clears itself, so read-back check is not possible */
+    return SpiWriteSlaveRegisters(eSpiSlave_MPU, eMpuRegisters_UserCtrl, &UserCtrl, 1);
+}
+
+bool Mpu_FifoCountRead (uint16_t *FifoCount) {
+    bool RetVal = false;
+    uint8_t CountBuffer[2];
+    if (SpiReadSlaveRegisters(eSpiSlave_MPU, eMpuRegisters_FifoCountH, CountBuffer, sizeof(CountBuffer))) {
+        *FifoCount = (uint16_t)(SHIFT_TO_H(CountBuffer[0]) | CountBuffer[1]);
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+/* Drains whole frames in one burst, returns false on bus error or FIFO overflow */
+bool ReadIMUFifo (sImuData_t *ImuData, unsigned int MaxSamples, unsigned int *SamplesRead) {
+    bool RetVal = false;
+    uint16_t FifoCount = 0;
+    uint32_t FifoCountTime = 0;
+    unsigned int FramesToRead = 0;
+    sImuRawData_t ImuRawData = {0};
+    /* Input check */
+    if ((ImuData != NULL) && (SamplesRead != NULL)) {
+        *SamplesRead = 0;
+        if (Mpu_FifoCountRead(&FifoCount)) {
+            FifoCountTime = GetCycleCount();
+            if ((FifoCount >= MPU_FIFO_SIZE) || (FifoCount % MPU_FIFO_FRAME_LENGTH)) {
+                /* Oldest data got overwritten, frame boundary is lost - realign by starting over */
+                g_MpuFifoOverflowCount++;
+                Mpu_FifoReset();
+            } else {
+                FramesToRead = FifoCount / MPU_FIFO_FRAME_LENGTH;
+                if (FramesToRead > MaxSamples) {
+                    FramesToRead = MaxSamples;
+                }
+                if (FramesToRead == 0) {
+                    RetVal = true;
+                } else if (SpiReadSlaveRegisters(eSpiSlave_MPU, eMpuRegisters_FifoRW, g_MpuFifoBuffer,
+                                                 FramesToRead * MPU_FIFO_FRAME_LENGTH)) {
+                    for (unsigned int i = 0; i < FramesToRead; i++) {
+                        Mpu_ParseRaw3D(&(ImuRawData.A), &g_MpuFifoBuffer[i * MPU_FIFO_FRAME_LENGTH + MPU_FIFO_FRAME_A_OFFSET]);
+                        Mpu_ParseRaw3D(&(ImuRawData.G), &g_MpuFifoBuffer[i * MPU_FIFO_FRAME_LENGTH + MPU_FIFO_FRAME_G_OFFSET]);
+                        /* Magnetometer is not part of FIFO frame */
+                        Mpu_ConvertData(&ImuData[i], &ImuRawData);
+                        /* Newest frame in FIFO is taken as sampled at count read, older ones one ODR period apart */
+                        ImuData[i].Timestamp = FifoCountTime -
+                            (FifoCount / MPU_FIFO_FRAME_LENGTH - 1 - i) * UsToCycles(MPU_SAMPLE_PERIOD_US);
+                    }
+                    *SamplesRead = FramesToRead;
+                    RetVal = true;
+                }
+            }
+        }
+    }
+    return RetVal;
+}
+
+unsigned int Mpu_GetFifoOverflowCount (void) {
+    return g_MpuFifoOverflowCount;
+}
+
+/* Cycles of the float stage of ReadIMU alone, raw sample to calibrated units, against one ODR period */
+void MpuBenchmark_Run (void) {
+    sImuRawData_t ImuRawData = { {1, -2, 3}, {4, -5, 6}, {7, -8, 9}, true };
+    sImuData_t ImuData;
+    float Sink = 0.0f;
+    taskENTER_CRITICAL();
+    uint32_t Start = GetCycleCount();
+    for (unsigned int i = 0; i < MPU_BENCHMARK_SAMPLES; i++) {
+        ImuRawData.A.X = (int16_t)i;
+        Mpu_ConvertData(&ImuData, &ImuRawData);
+        Sink += ImuData.A.X + ImuData.G.Y + ImuData.M.Z;
+    }
+    uint32_t Cycles = (GetCycleCount() - Start) / MPU_BENCHMARK_SAMPLES;
+    taskEXIT_CRITICAL();
+    g_MpuBenchmarkSink = Sink;
+    uint32_t Budget = SystemCoreClock / MPU_BENCHMARK_RATE;
+    PrintToUart(eUart_1, "MPU convert[cyc] %u budget@%uHz[cyc] %u load %u.%u%%\r", (unsigned int)Cycles,
+                (unsigned int)MPU_BENCHMARK_RATE, (unsigned int)Budget, (unsigned int)(Cycles * 100 / Budget),
+                (unsigned int)((Cycles * 1000 / Budget) % 10));
+}
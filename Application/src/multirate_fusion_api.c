@@ -0,0 +1,128 @@
+#include "multirate_fusion_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "mpu9250_api.h"
+#include "fusion_math_api.h"
+
+
+/* Allowed |norm^2 - 1| of quaternion between renormalisations */
+#define MULTIRATE_RENORM_THRESHOLD  1.0e-4f
+
+
+/* Q = Q * exp(Phi / 2), second order expansion is exact to float precision for per-sample angles */
+static void MultiRateFusion_Rotate (float Q[4], const float Phi[3]) {
+    float AngleSq = Phi[0] * Phi[0] + Phi[1] * Phi[1] + Phi[2] * Phi[2];
+    float Scale = 0.5f * (1.0f - AngleSq / 24.0f);
+    const float Increment[4] = {1.0f - AngleSq / 8.0f, Phi[0] * Scale, Phi[1] * Scale, Phi[2] * Scale};
+    const float Previous[4] = {Q[0], Q[1], Q[2], Q[3]};
+    Math_QuaternionMultiply(Previous, Increment, Q);
+    float NormSq = Q[0] * Q[0] + Q[1] * Q[1] + Q[2] * Q[2] + Q[3] * Q[3];
+    if ((NormSq - 1.0f > MULTIRATE_RENORM_THRESHOLD) || (1.0f - NormSq > MULTIRATE_RENORM_THRESHOLD)) {
+        Math_Normalise4(Q);
+    }
+}
+
+/* Mahony feedback computed once per correction interval from averaged accelerometer and latest magnetometer */
+static void MultiRateFusion_Correct (sMultiRateFusion_t *Fusion) {
+    float Acc[3] = {Fusion->AccSum.X, Fusion->AccSum.Y, Fusion->AccSum.Z};
+    float Error[3] = {0.0f, 0.0f, 0.0f};
+    float Qw = Fusion->Q[0], Qx = Fusion->Q[1], Qy = Fusion->Q[2], Qz = Fusion->Q[3];
+    /* Rotation matrix from sensor to earth frame */
+    const float R[3][3] = {
+        {1.0f - 2.0f * (Qy * Qy + Qz * Qz), 2.0f * (Qx * Qy - Qw * Qz),         2.0f * (Qx * Qz + Qw * Qy)},
+        {2.0f * (Qx * Qy + Qw * Qz),        1.0f - 2.0f * (Qx * Qx + Qz * Qz),  2.0f * (Qy * Qz - Qw * Qx)},
+        {2.0f * (Qx * Qz - Qw * Qy),        2.0f * (Qy * Qz + Qw * Qx),         1.0f - 2.0f * (Qx * Qx + Qy * Qy)}
+    };
+    if (Math_Normalise3(Acc)) {
+        /* Earth Z axis seen from sensor frame */
+        const float Gravity[3] = {R[2][0], R[2][1], R[2][2]};
+        Math_Cross3(Acc, Gravity, Error);
+        if (Fusion->MagValid) {
+            float Mag[3] = {Fusion->Mag.X, Fusion->Mag.Y, Fusion->Mag.Z};
+            if (Math_Normalise3(Mag)) {
+                float Earth[3];
+                float Reference[3];
+                float Predicted[3];
+                float MagError[3];
+                Math_MatrixVector3(R, Mag, false, Earth);
+                Reference[0] = Math_Sqrt(Earth[0] * Earth[0] + Earth[1] * Earth[1]);
+                Reference[1] = 0.0f;
+                Reference[2] = Earth[2];
+                Math_MatrixVector3(R, Reference, true, Predicted);
+                Math_Cross3(Mag, Predicted, MagError);
+                Error[0] += MagError[0];
+                Error[1] += MagError[1];
+                Error[2] += MagError[2];
+            }
+        }
+        /* Error vectors above are twice Mahony's half-errors, gains are given doubled */
+        float Correction[3];
+        for (unsigned int i = 0; i < 3; i++) {
+            if (Fusion->TwoKi > 0.0f) {
+                Fusion->IntegralFeedback[i] += 0.5f * Fusion->TwoKi * Error[i] * Fusion->CorrectionInterval;
+            } else {
+                Fusion->IntegralFeedback[i] = 0.0f;
+            }
+            Correction[i] = 0.5f * Fusion->TwoKp * Error[i] * Fusion->CorrectionInterval;
+        }
+        MultiRateFusion_Rotate(Fusion->Q, Correction);
+    }
+    Fusion->AccSum = (sData3D_t) {0.0f, 0.0f, 0.0f};
+    Fusion->AccCount = 0;
+    Fusion->CorrectionInterval = 0.0f;
+}
+
+void MultiRateFusion_Init (sMultiRateFusion_t *Fusion, float TwoKp, float TwoKi, unsigned int CorrectionDecimation) {
+    /* Input check */
+    if (Fusion != NULL) {
+        memset(Fusion, 0, sizeof(sMultiRateFusion_t));
+        Fusion->Q[0] = 1.0f;
+        Fusion->TwoKp = TwoKp;
+        Fusion->TwoKi = TwoKi;
+        Fusion->CorrectionDecimation = (CorrectionDecimation != 0) ? CorrectionDecimation : 1;
+    }
+}
+
+/* Gyro in rad/s, Mag is NULL when there is no new magnetometer sample */
+void MultiRateFusion_Update (sMultiRateFusion_t *Fusion, const sData3D_t *Gyro, const sData3D_t *Acc, const sData3D_t *Mag, float Dt) {
+    /* Input check */
+    if ((Fusion != NULL) && (Gyro != NULL)) {
+        const float Delta[3] = {
+            (Gyro->X + Fusion->IntegralFeedback[0]) * Dt,
+            (Gyro->Y + Fusion->IntegralFeedback[1]) * Dt,
+            (Gyro->Z + Fusion->IntegralFeedback[2]) * Dt
+        };
+        float Phi[3] = {Delta[0], Delta[1], Delta[2]};
+        /* Coning compensation from previous and current increment: Phi = Delta + (Previous x Delta) / 12 */
+        if (Fusion->PreviousDeltaValid) {
+            float Coning[3];
+            Math_Cross3(Fusion->PreviousDelta, Delta, Coning);
+            Phi[0] += Coning[0] / 12.0f;
+            Phi[1] += Coning[1] / 12.0f;
+            Phi[2] += Coning[2] / 12.0f;
+        }
+        MultiRateFusion_Rotate(Fusion->Q, Phi);
+        memcpy(Fusion->PreviousDelta, Delta, sizeof(Delta));
+        Fusion->PreviousDeltaValid = true;
+        if (Acc != NULL) {
+            Fusion->AccSum.X += Acc->X;
+            Fusion->AccSum.Y += Acc->Y;
+            Fusion->AccSum.Z += Acc->Z;
+            Fusion->AccCount++;
+        }
+        if (Mag != NULL) {
+            Fusion->Mag = *Mag;
+            Fusion->MagValid = true;
+        }
+        Fusion->CorrectionInterval += Dt;
+        Fusion->SampleCounter++;
+        if (Fusion->SampleCounter >= Fusion->CorrectionDecimation) {
+            Fusion->SampleCounter = 0;
+            if (Fusion->AccCount) {
+                MultiRateFusion_Correct(Fusion);
+            }
+        }
+    }
+}
@@ -1,14 +1,16 @@
-#include "Spi_api.h"
+#include "spi_api.h"
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include "gpio.h"
-#include "Spi.h"
+#include "spi.h"
 #include "FreeRTOS.h"
-#include "Task.h"
+#include "task.h"
 #include "semphr.h"
 #include "stm32f3xx_it.h"
-#include "stm32f3xx_ll_Spi.h"
+#include "stm32f3xx_ll_spi.h"
+#include "stm32f3xx_ll_dma.h"
 #include "message_queue_api.h"
 #include "uart_api.h"
 #include "error_handling_api.h"
@@ -16,19 +18,42 @@
 #define SPI_READ_REQUEST_BIT 0x80
 #define SPI_WRITE_REQUEST_BIT 0x7F
 
+typedef enum {
+    eSpiDataSize_8Bit,
+    eSpiDataSize_16Bit,
+} eSpiDataSize_t;
+
+/* Bus is reconfigured for every transaction, slaves on same bus may use different clock and mode */
 struct {
     eSpi_t          Spi;
     GPIO_TypeDef*   SlaveCsGpioPort;
     uint16_t        SlaveCsGpioPin;
+    uint32_t        BaudRatePrescaler;
+    uint32_t        ClockPolarity;
+    uint32_t        ClockPhase;
+    eSpiDataSize_t  DataSize;
 } sSpiSlaveDescriptor[eSpiSlave_Last] = {
-    [eSpiSlave_MPU]     = {eSpi_1, GPIOA, GPIO_PIN_4},
-    [eSpiSlave_None]    = {eSpi_Last, NULL, 0}
+    [eSpiSlave_MPU]     = {eSpi_1, GPIOA, GPIO_PIN_4, LL_SPI_BAUDRATEPRESCALER_DIV8, LL_SPI_POLARITY_LOW, LL_SPI_PHASE_1EDGE, eSpiDataSize_8Bit},
+    [eSpiSlave_Encoder] = {eSpi_2, GPIOB, GPIO_PIN_12, LL_SPI_BAUDRATEPRESCALER_DIV4, LL_SPI_POLARITY_LOW, LL_SPI_PHASE_2EDGE, eSpiDataSize_16Bit},
+    [eSpiSlave_None]    = {eSpi_Last, NULL, 0, 0, 0, 0, eSpiDataSize_8Bit}
 };
 
 typedef enum {
-    eSpiDataSize_8Bit,
-    eSpiDataSize_16Bit,
-} eSpiDataSize_t;
+    eSpiTransferMode_Queue,
+    eSpiTransferMode_Dma,
+} eSpiTransferMode_t;
+
+/* Select eSpiTransferMode_Queue to fall back to byte-per-interrupt driver (8-bit slaves only) */
+#ifndef SPI1_TRANSFER_MODE
+#define SPI1_TRANSFER_MODE          eSpiTransferMode_Dma
+#endif
+#ifndef SPI2_TRANSFER_MODE
+#define SPI2_TRANSFER_MODE          eSpiTransferMode_Dma
+#endif
+
+#define SPI_DMA_TIMEOUT             10
+/* Longest holder is a command plus data transfer with both DMA waits timing out */
+#define SPI_MUTEX_TIMEOUT           (3 * SPI_DMA_TIMEOUT)
 
 struct {
     SPI_TypeDef *SpiPeriphPtr;
@@ -37,11 +62,22 @@ struct {
     eSpiSlave_t SelectedSlave;
     const bool Active;
     SemaphoreHandle_t Mutex;
+    const eSpiTransferMode_t TransferMode;
+    DMA_TypeDef *DmaPeriphPtr;
+    const uint32_t DmaRxChannel;
+    const uint32_t DmaTxChannel;
+    SemaphoreHandle_t DmaDone;          // given by RX channel transfer complete interrupt
+    eSpiDataSize_t DataSize;
+    sSpiStats_t Stats;
 } SpiDescriptor[eSpi_Last] = {
-    [eSpi_1] = {SPI1, eQueue_Spi1Rx, eQueue_Spi1Tx, eSpiSlave_None, true, NULL},
-    [eSpi_2] = {SPI2, eQueue_Last, eQueue_Last, eSpiSlave_Last, false, NULL},
+    [eSpi_1] = {SPI1, eQueue_Spi1Rx, eQueue_Spi1Tx, eSpiSlave_None, true, NULL, SPI1_TRANSFER_MODE, DMA1, LL_DMA_CHANNEL_2, LL_DMA_CHANNEL_3, NULL, eSpiDataSize_8Bit, {0}},
+    [eSpi_2] = {SPI2, eQueue_Spi2Rx, eQueue_Spi2Tx, eSpiSlave_None, true, NULL, SPI2_TRANSFER_MODE, DMA1, LL_DMA_CHANNEL_4, LL_DMA_CHANNEL_5, NULL, eSpiDataSize_8Bit, {0}},
 };
 
+/* Wide enough for both frame sizes */
+static const uint16_t g_SpiDmaDummyFrame = 0;
+static uint16_t g_SpiDmaDiscardFrame;
+
 void InitializeSpiMutexes (void) {
     for (eSpi_t i = eSpi_First; i < eSpi_Last; i++) {
         if (SpiDescriptor[i].Active) {
@@ -50,10 +86,21 @@ void InitializeSpiMutexes (void) {
             } else {
                 /* TODO: handle double initialization */
             }
+            /* Own semaphore rather than a task notification, which the data ready interrupt already uses as counter */
+            if ((SpiDescriptor[i].TransferMode == eSpiTransferMode_Dma) && (SpiDescriptor[i].DmaDone == NULL)) {
+                SpiDescriptor[i].DmaDone = xSemaphoreCreateBinary();
+            }
         }
     }
 }
 
+/* Chip selects come up low from GPIO init, release them before first transaction */
+void InitializeSpiSlaves (void) {
+    for (eSpiSlave_t i = eSpiSlave_First; i < eSpiSlave_None; i++) {
+        HAL_GPIO_WritePin(sSpiSlaveDescriptor[i].SlaveCsGpioPort, sSpiSlaveDescriptor[i].SlaveCsGpioPin, GPIO_PIN_SET);
+    }
+}
+
 void HandleSpiRxIRQ (eSpi_t CurrentSpi) {
     /* Input check */
     if (CurrentSpi < eSpi_Last) {
@@ -82,12 +129,33 @@ void HandleSpiTxIRQ (eSpi_t CurrentSpi) {
     }
 }
 
+void HandleSpiDmaRxIRQ (eSpi_t CurrentSpi) {
+    /* Input check */
+    if ((CurrentSpi < eSpi_Last) && (SpiDescriptor[CurrentSpi].DmaPeriphPtr != NULL)) {
+        DMA_TypeDef *Dma = SpiDescriptor[CurrentSpi].DmaPeriphPtr;
+        uint32_t FlagShift = (SpiDescriptor[CurrentSpi].DmaRxChannel - LL_DMA_CHANNEL_1) * 4;
+        if (READ_BIT(Dma->ISR, (DMA_ISR_TCIF1 << FlagShift))) {
+            WRITE_REG(Dma->IFCR, (DMA_IFCR_CGIF1 << FlagShift));
+            LL_DMA_DisableIT_TC(Dma, SpiDescriptor[CurrentSpi].DmaRxChannel);
+            if (SpiDescriptor[CurrentSpi].DmaDone != NULL) {
+                BaseType_t HigherPriorityTaskWoken = pdFALSE;
+                xSemaphoreGiveFromISR(SpiDescriptor[CurrentSpi].DmaDone, &HigherPriorityTaskWoken);
+                portYIELD_FROM_ISR(HigherPriorityTaskWoken);
+            }
+        }
+    }
+}
+
 bool DeselectSpiSlave (eSpi_t TargetSpi) {
     bool RetVal = false;
     /* Input check */
     if ((TargetSpi < eSpi_Last)) {
-        HAL_GPIO_WritePin(sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPort,
-                          sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPin, GPIO_PIN_SET);
+        /* Nothing to release if select failed */
+        if (SpiDescriptor[TargetSpi].SelectedSlave < eSpiSlave_None) {
+            HAL_GPIO_WritePin(sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPort,
+                              sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPin, GPIO_PIN_SET);
+            SpiDescriptor[TargetSpi].Stats.CsToggles++;
+        }
         SpiDescriptor[TargetSpi].SelectedSlave = eSpiSlave_None;
         RetVal = true;
     }
@@ -103,6 +171,7 @@ bool SelectSpiSlave (eSpi_t TargetSpi, eSpiSlave_t NewSlave) {
                 HAL_GPIO_WritePin(sSpiSlaveDescriptor[NewSlave].SlaveCsGpioPort,
                                   sSpiSlaveDescriptor[NewSlave].SlaveCsGpioPin, GPIO_PIN_RESET);
                 SpiDescriptor[TargetSpi].SelectedSlave = NewSlave;
+                SpiDescriptor[TargetSpi].Stats.CsToggles++;
                 RetVal = true;
             }
         } else {
@@ -112,20 +181,6 @@ bool SelectSpiSlave (eSpi_t TargetSpi, eSpiSlave_t NewSlave) {
     return RetVal;
 }
 
-bool ReselectSpiSlave (eSpi_t TargetSpi) {
-    bool RetVal = false;
-    /* Input check */
-    if ((TargetSpi < eSpi_Last)) {
-        HAL_GPIO_WritePin(sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPort,
-                          sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPin, GPIO_PIN_SET);
-        vTaskDelay(10);
-        HAL_GPIO_WritePin(sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPort,
-                          sSpiSlaveDescriptor[SpiDescriptor[TargetSpi].SelectedSlave].SlaveCsGpioPin, GPIO_PIN_RESET);
-        RetVal = true;
-    }
-    return RetVal;
-}
-
 bool SpiSendByte (eSpi_t CurrentSpi, uint8_t ByteToSend) {
     bool RetVal = false;
     /* Input check */
@@ -151,49 +206,107 @@ bool SpiReceiveByte (eSpi_t CurrentSpi, uint8_t *ByteToReceivePtr) {
     return RetVal;
 }
 
-bool SpiReadRequest (eSpi_t TargetSpi,  uint8_t *Response, uint8_t Request) {
-    bool RetVal = false;
+bool SpiQueueTransfer (eSpi_t TargetSpi, const uint8_t *TxBuffer, uint8_t *RxBuffer, uint16_t Length) {
+    bool RetVal = true;
     uint8_t DataToBeDiscarded = 0;
-    /* input check */
-    if ((TargetSpi < eSpi_Last) && (Response != NULL)) {
-        if (SpiSendByte(TargetSpi, Request)) {
-            SpiReceiveByte(TargetSpi, &DataToBeDiscarded);//useless data
-            SpiSendByte(TargetSpi, 0);//dummy data
-            if (SpiReceiveByte(TargetSpi, Response)) {
-                RetVal = true;
-            }
+    for (uint16_t i = 0; (i < Length) && RetVal; i++) {
+        if (!SpiSendByte(TargetSpi, (TxBuffer != NULL) ? TxBuffer[i] : 0)) {
+            RetVal = false;
+        } else if (!SpiReceiveByte(TargetSpi, (RxBuffer != NULL) ? &RxBuffer[i] : &DataToBeDiscarded)) {
+            RetVal = false;
         }
     }
     return RetVal;
 }
 
-bool SpiWriteRequest (eSpi_t TargetSpi, uint8_t Value, uint8_t Address) {
+bool SpiDmaTransfer (eSpi_t TargetSpi, const uint8_t *TxBuffer, uint8_t *RxBuffer, uint16_t Length) {
     bool RetVal = false;
-    uint8_t DataToBeDiscarded = 0;
-    uint8_t DataCheckBuffer = 0;
-    /* input check */
-    if (TargetSpi < eSpi_Last) {
-        if (SpiSendByte(TargetSpi, Address)) {
-            SpiReceiveByte(TargetSpi, &DataToBeDiscarded);//useless data
-            SpiSendByte(TargetSpi, Value);
-            SpiReceiveByte(TargetSpi, &DataToBeDiscarded);//useless data
-            /* Read same register to make sure that data has been written correctly */
-            ReselectSpiSlave(TargetSpi);
-            if (SpiReadRequest(TargetSpi, &DataCheckBuffer, (Address | SPI_READ_REQUEST_BIT))) {
-                if (DataCheckBuffer == Value) {
-                    RetVal = true;
-                } else {
-                    PrintToUart(eUart_1, "ERROR[SPI]: Written value mismatch detected\r");
-                }
-            }
+    SPI_TypeDef *Spi = SpiDescriptor[TargetSpi].SpiPeriphPtr;
+    DMA_TypeDef *Dma = SpiDescriptor[TargetSpi].DmaPeriphPtr;
+    uint32_t RxChannel = SpiDescriptor[TargetSpi].DmaRxChannel;
+    uint32_t TxChannel = SpiDescriptor[TargetSpi].DmaTxChannel;
+    bool WideFrame = (SpiDescriptor[TargetSpi].DataSize == eSpiDataSize_16Bit);
+    uint32_t Alignment = WideFrame ? (LL_DMA_PDATAALIGN_HALFWORD | LL_DMA_MDATAALIGN_HALFWORD) :
+                                     (LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE);
+    /* Length is given in bytes, DMA counts frames */
+    uint16_t Frames = WideFrame ? (Length / 2) : Length;
+    /* Missing buffer means dummy bytes are sent or received data is dropped */
+    LL_DMA_ConfigTransfer(Dma, RxChannel, LL_DMA_DIRECTION_PERIPH_TO_MEMORY | LL_DMA_MODE_NORMAL | LL_DMA_PERIPH_NOINCREMENT |
+                          ((RxBuffer != NULL) ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT) |
+                          Alignment | LL_DMA_PRIORITY_HIGH);
+    LL_DMA_ConfigAddresses(Dma, RxChannel, LL_SPI_DMA_GetRegAddr(Spi),
+                           ((RxBuffer != NULL) ? (uint32_t)(uintptr_t)RxBuffer : (uint32_t)(uintptr_t)&g_SpiDmaDiscardFrame), LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetDataLength(Dma, RxChannel, Frames);
+    LL_DMA_ConfigTransfer(Dma, TxChannel, LL_DMA_DIRECTION_MEMORY_TO_PERIPH | LL_DMA_MODE_NORMAL | LL_DMA_PERIPH_NOINCREMENT |
+                          ((TxBuffer != NULL) ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT) |
+                          Alignment | LL_DMA_PRIORITY_MEDIUM);
+    LL_DMA_ConfigAddresses(Dma, TxChannel, ((TxBuffer != NULL) ? (uint32_t)(uintptr_t)TxBuffer : (uint32_t)(uintptr_t)&g_SpiDmaDummyFrame),
+                           LL_SPI_DMA_GetRegAddr(Spi), LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetDataLength(Dma, TxChannel, Frames);
+    /* Completion is signalled by RX channel, last byte received means whole transfer is done */
+    LL_DMA_EnableIT_TC(Dma, RxChannel);
+    /* Enable order as required by reference manual: RX request, channels, TX request */
+    LL_SPI_EnableDMAReq_RX(Spi);
+    LL_DMA_EnableChannel(Dma, RxChannel);
+    LL_DMA_EnableChannel(Dma, TxChannel);
+    LL_SPI_EnableDMAReq_TX(Spi);
+    if (xSemaphoreTake(SpiDescriptor[TargetSpi].DmaDone, SPI_DMA_TIMEOUT) == pdTRUE) {
+        RetVal = true;
+    }
+    LL_SPI_DisableDMAReq_TX(Spi);
+    LL_DMA_DisableChannel(Dma, TxChannel);
+    LL_DMA_DisableChannel(Dma, RxChannel);
+    LL_SPI_DisableDMAReq_RX(Spi);
+    if (!RetVal) {
+        /* Completion may have raced the timeout, drop it so it is not taken for the next transfer */
+        LL_DMA_DisableIT_TC(Dma, RxChannel);
+        xSemaphoreTake(SpiDescriptor[TargetSpi].DmaDone, 0);
+    }
+    return RetVal;
+}
+
+bool SpiTransfer (eSpi_t TargetSpi, const uint8_t *TxBuffer, uint8_t *RxBuffer, uint16_t Length) {
+    bool RetVal = false;
+    /* Input check */
+    if ((TargetSpi < eSpi_Last) && Length) {
+        if ((SpiDescriptor[TargetSpi].DataSize == eSpiDataSize_16Bit) &&
+            ((SpiDescriptor[TargetSpi].TransferMode != eSpiTransferMode_Dma) || (Length % 2))) {
+            /* Queue driver is byte oriented, wide frames are only supported over DMA */
+        } else if (SpiDescriptor[TargetSpi].TransferMode == eSpiTransferMode_Dma) {
+            RetVal = (SpiDescriptor[TargetSpi].DmaDone != NULL) && SpiDmaTransfer(TargetSpi, TxBuffer, RxBuffer, Length);
+        } else {
+            RetVal = SpiQueueTransfer(TargetSpi, TxBuffer, RxBuffer, Length);
+        }
+        SpiDescriptor[TargetSpi].Stats.BytesTransferred += Length;
+        if (!RetVal) {
+            SpiDescriptor[TargetSpi].Stats.TransferErrors++;
         }
     }
     return RetVal;
 }
 
+/* Must be called while peripheral is disabled */
+void SpiConfigureForSlave (eSpiSlave_t Slave) {
+    eSpi_t Spi = sSpiSlaveDescriptor[Slave].Spi;
+    SPI_TypeDef *SpiPeriph = SpiDescriptor[Spi].SpiPeriphPtr;
+    LL_SPI_SetBaudRatePrescaler(SpiPeriph, sSpiSlaveDescriptor[Slave].BaudRatePrescaler);
+    LL_SPI_SetClockPolarity(SpiPeriph, sSpiSlaveDescriptor[Slave].ClockPolarity);
+    LL_SPI_SetClockPhase(SpiPeriph, sSpiSlaveDescriptor[Slave].ClockPhase);
+    if (sSpiSlaveDescriptor[Slave].DataSize == eSpiDataSize_16Bit) {
+        LL_SPI_SetDataWidth(SpiPeriph, LL_SPI_DATAWIDTH_16BIT);
+        LL_SPI_SetRxFIFOThreshold(SpiPeriph, LL_SPI_RX_FIFO_TH_HALF);
+    } else {
+        LL_SPI_SetDataWidth(SpiPeriph, LL_SPI_DATAWIDTH_8BIT);
+        LL_SPI_SetRxFIFOThreshold(SpiPeriph, LL_SPI_RX_FIFO_TH_QUARTER);
+    }
+    SpiDescriptor[Spi].DataSize = sSpiSlaveDescriptor[Slave].DataSize;
+}
+
 void SpiEnable (eSpi_t Spi) {
     LL_SPI_Enable(SpiDescriptor[Spi].SpiPeriphPtr);
-    LL_SPI_EnableIT_RXNE(SpiDescriptor[Spi].SpiPeriphPtr);
+    if (SpiDescriptor[Spi].TransferMode == eSpiTransferMode_Queue) {
+        LL_SPI_EnableIT_RXNE(SpiDescriptor[Spi].SpiPeriphPtr);
+    }
 }
 
 void SpiDisable (eSpi_t Spi) {
@@ -203,66 +316,118 @@ void SpiDisable (eSpi_t Spi) {
 
 //#define BYPASS_MUTEX
 
-bool SpiReadSlaveRegister (uint8_t *DataResponse, uint8_t RegisterAddress, eSpiSlave_t Slave) {
+/* Locks the bus, sets it up for the slave and runs one chip select frame: optional command byte, then Length bytes
+ * full duplex. Every per-slave access goes through here, so a bus that stays busy past SPI_MUTEX_TIMEOUT fails the
+ * same way for all of them. */
+bool SpiSlaveTransaction (eSpiSlave_t Slave, const uint8_t *Command, const uint8_t *TxBuffer, uint8_t *RxBuffer, uint16_t Length) {
     bool RetVal = false;
-    RegisterAddress |= SPI_READ_REQUEST_BIT;
     /* Check input */
-    if ((Slave < eSpiSlave_Last) && (SpiDescriptor[sSpiSlaveDescriptor[Slave].Spi].Mutex != NULL)) {
+    if ((Slave < eSpiSlave_None) && Length && (SpiDescriptor[sSpiSlaveDescriptor[Slave].Spi].Mutex != NULL)) {
+        eSpi_t Spi = sSpiSlaveDescriptor[Slave].Spi;
 #ifndef BYPASS_MUTEX
-        if (xSemaphoreTake(SpiDescriptor[sSpiSlaveDescriptor[Slave].Spi].Mutex, portMAX_DELAY) == pdTRUE) {
+        if (xSemaphoreTake(SpiDescriptor[Spi].Mutex, SPI_MUTEX_TIMEOUT) == pdTRUE) {
 #endif
-            SpiEnable(sSpiSlaveDescriptor[Slave].Spi);
-            if (SelectSpiSlave (sSpiSlaveDescriptor[Slave].Spi, Slave)) {
-                if (SpiReadRequest(sSpiSlaveDescriptor[Slave].Spi, DataResponse, RegisterAddress)) {
+            SpiDescriptor[Spi].Stats.MutexAcquisitions++;
+            SpiConfigureForSlave(Slave);
+            SpiEnable(Spi);
+            if (SelectSpiSlave(Spi, Slave)) {
+                if (((Command == NULL) || SpiTransfer(Spi, Command, NULL, 1)) &&
+                    SpiTransfer(Spi, TxBuffer, RxBuffer, Length)) {
                     RetVal = true;
-                } else {
-                    //PrintToUart(eUart_1, "ERROR[SPI%d]: data request failed\r", sSpiSlaveDescriptor[Slave].Spi+1);
                 }
-            } else {
-                //PrintToUart(eUart_1, "ERROR[SPI%d]: Slave(%d) select failed\r", sSpiSlaveDescriptor[Slave].Spi+1, Slave);
             }
-            if (!DeselectSpiSlave (eSpi_1)) {
-                //PrintToUart(eUart_1, "ERROR[SPI%d]: Slave(%d) deselect failed\r", sSpiSlaveDescriptor[Slave].Spi+1, Slave);
-            }
-            SpiDisable(sSpiSlaveDescriptor[Slave].Spi);
+            DeselectSpiSlave(Spi);
+            SpiDisable(Spi);
 #ifndef BYPASS_MUTEX
-            xSemaphoreGive(SpiDescriptor[sSpiSlaveDescriptor[Slave].Spi].Mutex);
+            xSemaphoreGive(SpiDescriptor[Spi].Mutex);
         } else {
-            /* TODO: handle timeout */
+            /* Bus mutex is not held here, other tasks may count at the same time */
+            taskENTER_CRITICAL();
+            SpiDescriptor[Spi].Stats.MutexTimeouts++;
+            taskEXIT_CRITICAL();
         }
 #endif
     }
     return RetVal;
 }
 
-bool SpiWriteSlaveRegister (uint8_t WriteValue, uint8_t RegisterAddress, eSpiSlave_t Slave) {
+bool SpiReadSlaveRegister (uint8_t *DataResponse, uint8_t RegisterAddress, eSpiSlave_t Slave) {
+    return SpiReadSlaveRegisters(Slave, RegisterAddress, DataResponse, 1);
+}
+
+/* Slave auto-increments the register address while CS is held low */
+bool SpiReadSlaveRegisters (eSpiSlave_t Slave, uint8_t StartAddress, uint8_t *Buffer, uint16_t Length) {
     bool RetVal = false;
-    RegisterAddress &= SPI_WRITE_REQUEST_BIT;
+    StartAddress |= SPI_READ_REQUEST_BIT;
     /* Check input */
-    if ((Slave < eSpiSlave_Last) && (SpiDescriptor[sSpiSlaveDescriptor[Slave].Spi].Mutex != NULL)){
-#ifndef BYPASS_MUTEX
-        if (xSemaphoreTake(SpiDescriptor[sSpiSlaveDescriptor[Slave].Spi].Mutex, portMAX_DELAY) == pdTRUE) {
-#endif
-            SpiEnable(sSpiSlaveDescriptor[Slave].Spi);
-            if (SelectSpiSlave (sSpiSlaveDescriptor[Slave].Spi, Slave)) {
-                if (SpiWriteRequest(sSpiSlaveDescriptor[Slave].Spi, WriteValue, RegisterAddress)) {
-                    RetVal = true;
-                } else {
-                    //PrintToUart(eUart_1, "ERROR[SPI%d]: data request failed\r", sSpiSlaveDescriptor[Slave].Spi);
-                }
-            } else {
-                //PrintToUart(eUart_1, "ERROR[SPI%d]: Slave(%d) select failed\r", sSpiSlaveDescriptor[Slave].Spi, Slave);
-            }
-            if (!DeselectSpiSlave (eSpi_1)) {
-                //PrintToUart(eUart_1, "ERROR[SPI%d]: Slave(%d) deselect failed\r", sSpiSlaveDescriptor[Slave].Spi, Slave);
-            }
-            SpiDisable(sSpiSlaveDescriptor[Slave].Spi);
-#ifndef BYPASS_MUTEX
-            xSemaphoreGive(SpiDescriptor[sSpiSlaveDescriptor[Slave].Spi].Mutex);
+    if (Buffer != NULL) {
+        RetVal = SpiSlaveTransaction(Slave, &StartAddress, NULL, Buffer, Length);
+    }
+    return RetVal;
+}
+
+/* Register is read back in a second transaction to make sure that data has been written correctly */
+bool SpiWriteSlaveRegister (uint8_t WriteValue, uint8_t RegisterAddress, eSpiSlave_t Slave) {
+    bool RetVal = false;
+    uint8_t DataCheckBuffer = 0;
+    if (SpiWriteSlaveRegisters(Slave, RegisterAddress, &WriteValue, 1) &&
+        SpiReadSlaveRegister(&DataCheckBuffer, RegisterAddress, Slave)) {
+        if (DataCheckBuffer == WriteValue) {
+            RetVal = true;
         } else {
-            /* Handle Timeout */
+            PrintToUart(eUart_1, "ERROR[SPI]: Written value mismatch detected\r");
         }
-#endif
     }
     return RetVal;
 }
+
+/* No read-back, caller is responsible for verification if needed */
+bool SpiWriteSlaveRegisters (eSpiSlave_t Slave, uint8_t StartAddress, const uint8_t *Buffer, uint16_t Length) {
+    bool RetVal = false;
+    StartAddress &= SPI_WRITE_REQUEST_BIT;
+    /* Check input */
+    if (Buffer != NULL) {
+        RetVal = SpiSlaveTransaction(Slave, &StartAddress, Buffer, NULL, Length);
+    }
+    return RetVal;
+}
+
+/* Plain full-duplex transaction framed by chip select, for slaves without register map */
+bool SpiTransferSlave (eSpiSlave_t Slave, const uint8_t *TxBuffer, uint8_t *RxBuffer, uint16_t Length) {
+    return SpiSlaveTransaction(Slave, NULL, TxBuffer, RxBuffer, Length);
+}
+
+/* Counters are written with bus mutex held or in critical section, snapshot is taken in critical section */
+bool SpiGetStats (eSpi_t Spi, sSpiStats_t *Output) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Spi < eSpi_Last) && (Output != NULL)) {
+        taskENTER_CRITICAL();
+        *Output = SpiDescriptor[Spi].Stats;
+        taskEXIT_CRITICAL();
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+bool SpiResetStats (eSpi_t Spi) {
+    bool RetVal = false;
+    /* Input check */
+    if (Spi < eSpi_Last) {
+        taskENTER_CRITICAL();
+        memset(&SpiDescriptor[Spi].Stats, 0, sizeof(sSpiStats_t));
+        taskEXIT_CRITICAL();
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+void SpiPrintStats (eSpi_t Spi) {
+    sSpiStats_t Snapshot;
+    if (SpiGetStats(Spi, &Snapshot)) {
+        PrintToUart(eUart_1, "SPI%u bytes=%u cs=%u mutex=%u err=%u timeout=%u\r", (unsigned int)(Spi + 1),
+                    (unsigned int)Snapshot.BytesTransferred, (unsigned int)Snapshot.CsToggles,
+                    (unsigned int)Snapshot.MutexAcquisitions, (unsigned int)Snapshot.TransferErrors,
+                    (unsigned int)Snapshot.MutexTimeouts);
+    }
+}
@@ -0,0 +1,173 @@
+#include "timing_stats_api.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "main.h"
+#include "uart_api.h"
+
+
+#define US_IN_SECOND 1000000
+
+/* Histograms are updated from task context only, readers take a snapshot in a critical section */
+struct {
+    const char *Name;
+    const uint32_t BinWidthUs;
+    sTimingHistogram_t Data;
+} TimingHistogramDescriptor[eTimingHistogram_Last] = {
+    [eTimingHistogram_SampleLatency]    = { "LAT",  10, {0} },
+    [eTimingHistogram_SampleJitter]     = { "JIT",  5,  {0} },
+    [eTimingHistogram_ReadImuCost]      = { "RD",   5,  {0} },
+    [eTimingHistogram_FusionCost]       = { "FUS",  1,  {0} },
+    [eTimingHistogram_ControlCost]      = { "CTL",  25, {0} },
+};
+
+/* Written by the control task only, readers take a snapshot in a critical section */
+static sLoopStats_t g_LoopStats;
+
+
+void InitializeCycleCounter (void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t GetCycleCount (void) {
+    return DWT->CYCCNT;
+}
+
+uint32_t CyclesToUs (uint32_t Cycles) {
+    return Cycles / (SystemCoreClock / US_IN_SECOND);
+}
+
+uint32_t UsToCycles (uint32_t Us) {
+    return Us * (SystemCoreClock / US_IN_SECOND);
+}
+
+float CyclesToSeconds (uint32_t Cycles) {
+    return (float)Cycles / (float)SystemCoreClock;
+}
+
+bool TimingHistogramAdd (eTimingHistogram_t Histogram, uint32_t ValueUs) {
+    bool RetVal = false;
+    /* Input check */
+    if (Histogram < eTimingHistogram_Last) {
+        sTimingHistogram_t *Data = &TimingHistogramDescriptor[Histogram].Data;
+        uint32_t Bin = ValueUs / TimingHistogramDescriptor[Histogram].BinWidthUs;
+        /* Last bin collects everything out of range */
+        if (Bin >= TIMING_HISTOGRAM_BINS) {
+            Bin = TIMING_HISTOGRAM_BINS - 1;
+        }
+        taskENTER_CRITICAL();
+        if ((Data->Count == 0) || (ValueUs < Data->MinUs)) {
+            Data->MinUs = ValueUs;
+        }
+        if (ValueUs > Data->MaxUs) {
+            Data->MaxUs = ValueUs;
+        }
+        Data->Count++;
+        Data->SumUs += ValueUs;
+        Data->Bins[Bin]++;
+        taskEXIT_CRITICAL();
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+bool TimingHistogramGet (eTimingHistogram_t Histogram, sTimingHistogram_t *Output) {
+    bool RetVal = false;
+    /* Input check */
+    if ((Histogram < eTimingHistogram_Last) && (Output != NULL)) {
+        taskENTER_CRITICAL();
+        *Output = TimingHistogramDescriptor[Histogram].Data;
+        taskEXIT_CRITICAL();
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+bool TimingHistogramReset (eTimingHistogram_t Histogram) {
+    bool RetVal = false;
+    /* Input check */
+    if (Histogram < eTimingHistogram_Last) {
+        taskENTER_CRITICAL();
+        memset(&TimingHistogramDescriptor[Histogram].Data, 0, sizeof(sTimingHistogram_t));
+        taskEXIT_CRITICAL();
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+void TimingHistogramPrint (eTimingHistogram_t Histogram) {
+    #define MAX_LINE_LENGTH 200
+    sTimingHistogram_t Snapshot;
+    char Line[MAX_LINE_LENGTH];
+    int Length = 0;
+    if (TimingHistogramGet(Histogram, &Snapshot)) {
+        Length = snprintf(Line, MAX_LINE_LENGTH, "%s[%uus/bin] n=%u min=%u avg=%u max=%u |",
+                          TimingHistogramDescriptor[Histogram].Name, (unsigned int)TimingHistogramDescriptor[Histogram].BinWidthUs,
+                          (unsigned int)Snapshot.Count, (unsigned int)Snapshot.MinUs,
+                          (unsigned int)(Snapshot.Count ? (Snapshot.SumUs / Snapshot.Count) : 0), (unsigned int)Snapshot.MaxUs);
+        for (unsigned int i = 0; (i < TIMING_HISTOGRAM_BINS) && (Length > 0) && (Length < MAX_LINE_LENGTH); i++) {
+            Length += snprintf(&Line[Length], MAX_LINE_LENGTH - Length, " %u", (unsigned int)Snapshot.Bins[i]);
+        }
+        PrintToUart(eUart_1, "%s\r", Line);
+    }
+    #undef MAX_LINE_LENGTH
+}
+
+/* Called once per control period: execution time is Start..End, start jitter Trigger..Start,
+ * deadline is missed when work ends later than one period after Trigger */
+void LoopStatsRecord (uint32_t TriggerCycles, uint32_t StartCycles, uint32_t EndCycles, uint32_t PeriodUs, uint32_t Skipped) {
+    uint32_t ExecutionUs = CyclesToUs(EndCycles - StartCycles);
+    uint32_t StartJitterUs = CyclesToUs(StartCycles - TriggerCycles);
+    bool Missed = (CyclesToUs(EndCycles - TriggerCycles) > PeriodUs) || (Skipped > 0);
+    TimingHistogramAdd(eTimingHistogram_ControlCost, ExecutionUs);
+    taskENTER_CRITICAL();
+    g_LoopStats.Periods++;
+    g_LoopStats.SkippedPeriods += Skipped;
+    if (Missed) {
+        g_LoopStats.DeadlineMisses++;
+    }
+    g_LoopStats.LastExecutionUs = ExecutionUs;
+    if (ExecutionUs > g_LoopStats.MaxExecutionUs) {
+        g_LoopStats.MaxExecutionUs = ExecutionUs;
+    }
+    g_LoopStats.LastStartJitterUs = StartJitterUs;
+    if (StartJitterUs > g_LoopStats.MaxStartJitterUs) {
+        g_LoopStats.MaxStartJitterUs = StartJitterUs;
+    }
+    taskEXIT_CRITICAL();
+}
+
+bool LoopStatsGet (sLoopStats_t *Output) {
+    bool RetVal = false;
+    /* Input check */
+    if (Output != NULL) {
+        taskENTER_CRITICAL();
+        *Output = g_LoopStats;
+        taskEXIT_CRITICAL();
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+void LoopStatsReset (void) {
+    taskENTER_CRITICAL();
+    memset(&g_LoopStats, 0, sizeof(sLoopStats_t));
+    taskEXIT_CRITICAL();
+    TimingHistogramReset(eTimingHistogram_ControlCost);
+}
+
+void LoopStatsPrint (void) {
+    sLoopStats_t Snapshot;
+    if (LoopStatsGet(&Snapshot)) {
+        PrintToUart(eUart_1, "LOOP n=%u miss=%u skip=%u exec=%u/%uus jit=%u/%uus\r",
+                    (unsigned int)Snapshot.Periods, (unsigned int)Snapshot.DeadlineMisses, (unsigned int)Snapshot.SkippedPeriods,
+                    (unsigned int)Snapshot.LastExecutionUs, (unsigned int)Snapshot.MaxExecutionUs,
+                    (unsigned int)Snapshot.LastStartJitterUs, (unsigned int)Snapshot.MaxStartJitterUs);
+    }
+}
@@ -167,6 +167,7 @@ standard names. */
 
 /* USER CODE BEGIN Defines */   	      
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+#define INCLUDE_xTaskGetCurrentTaskHandle   1
 /* USER CODE END Defines */ 
 
 #endif /* FREERTOS_CONFIG_H */
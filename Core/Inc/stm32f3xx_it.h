@@ -72,14 +72,16 @@ void EXTI3_IRQHandler(void);
 void USB_HP_CAN_TX_IRQHandler(void);
 void CAN_RX1_IRQHandler(void);
 void CAN_SCE_IRQHandler(void);
-void TIM1_UP_TIM16_IRQHandler(void);
 void I2C1_EV_IRQHandler(void);
 void I2C1_ER_IRQHandler(void);
 void SPI1_IRQHandler(void);
 void SPI2_IRQHandler(void);
 void USART1_IRQHandler(void);
 void USART3_IRQHandler(void);
+void TIM6_DAC_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void DMA1_Channel2_IRQHandler(void);
+void DMA1_Channel4_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -62,6 +62,17 @@
 #include "spi_api.h"
 #include "mpu9250_api.h"
 #include "MahonyAHRS.h"
+#include "MahonyAHRSFixed.h"
+#include "MahonyAHRSBenchmark.h"
+#include "attitude_estimator_api.h"
+#include "gyro_bias_api.h"
+#include "attitude_controller_api.h"
+#include "motor_api.h"
+#include "encoder_api.h"
+#include "foc_api.h"
+#include "fusion_math_api.h"
+#include "timing_stats_api.h"
+#include <string.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -71,6 +82,33 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define IMU_FIFO_BATCH_SIZE     32
+#define IMU_FIFO_POLL_PERIOD    10
+#define IMU_DATA_READY_TIMEOUT  100
+/* Housekeeping prints one console item per period, so UART buffer is not overrun */
+#define CONSOLE_PRINT_PERIOD    500
+#define CONSOLE_COMMAND_LENGTH  32
+#define CONTROL_TASK_STACK      512
+/* Gaps longer than this (e.g. after data ready timeout) are integrated as one nominal period */
+#define IMU_MAX_DT              0.01f
+#define DEG_TO_RAD              0.0174532925f
+#define TWO_PI                  6.28318531f
+/* Motors stay off while boot gyro bias calibration runs, their vibration fails its stationarity test. If it has not
+ * finished after this long the loop closes on the estimate so far and housekeeping reports the timeout. */
+#define GYRO_BIAS_TIMEOUT       10.0f   // s
+/* Rotors are held on the d axis this long before encoder offsets are read */
+#define FOC_ALIGN_TIME          700
+/* Open loop drive, fallback without encoders: controller output of 1 turns the field at MOTOR_MAX_SPEED, winding voltage is fixed at MOTOR_POWER */
+#define MOTOR_POWER             0.3f
+#define MOTOR_MAX_SPEED         (TWO_PI * 20.0f)  // rad/s electrical
+#define OPEN_LOOP_RATE_FEED_FORWARD 0.0f
+/* Mahony, Madgwick, MEKF or MultiRate, cost of each is visible in FUS histogram */
+#define IMU_ESTIMATOR           eAttitudeEstimator_Mahony
+/* Streams every IMU_LOG_DECIMATION-th sample as CSV for offline replay, 115200 baud fits ~100 lines/s */
+//#define IMU_LOG_OUTPUT
+#define IMU_LOG_DECIMATION      10
+/* Prints fusion math cycle/accuracy table once at startup */
+//#define RUN_MATH_BENCHMARK
 
 /* USER CODE END PD */
 
@@ -81,13 +119,41 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
+#ifdef USE_FIFO
+static sImuData_t g_ImuBatch[IMU_FIFO_BATCH_SIZE];
+static MahonyAHRSsample_t g_AhrsBatch[IMU_FIFO_BATCH_SIZE];
+#endif
+/* Camera IMU estimator, other IMUs get their own instance */
+static sAttitudeEstimator_t g_ImuEstimator;
+static sGyroBias_t g_ImuGyroBias;
+/* Published by control task after every update for housekeeping to print, guarded by critical section */
+static sQuaternion_t g_ImuAttitude = {1.0f, 0.0f, 0.0f, 0.0f};
+/* Holds the attitude captured when estimator boot finished */
+static sAttitudeController_t g_AttitudeController;
+static sQuaternion_t g_AttitudeSetpoint;
+static bool g_AttitudeSetpointValid = false;
+/* Per axis command for motor output, guarded by critical section */
+static sData3D_t g_ControlOutput;
+/* rad, electrical field angle of each motor in open loop drive, owned by control task */
+static float g_MotorAngle[eMotor_Last];
+/* Set once at boot when every encoder answered and every rotor aligned */
+static sFoc_t g_Foc;
+static bool g_FocActive = false;
 
 /* USER CODE END Variables */
 osThreadId defaultTaskHandle;
+osThreadId controlTaskHandle;
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN FunctionPrototypes */
-   
+void StartControlTask(void const * argument);
+static void ControlTask_PublishAttitude(void);
+static bool ControlTask_GyroBiasSettled(const sGyroBias_t *GyroBias);
+static void ControlTask_Stabilise(const sData3D_t *Rate);
+static void ControlTask_DriveMotors(const sData3D_t *Output, bool Enabled);
+static void MotorDrive_Init(void);
+static void Housekeeping_PrintNext(void);
+static void Housekeeping_HandleCommand(const char *Command);
 /* USER CODE END FunctionPrototypes */
 
 void StartDefaultTask(void const * argument);
@@ -101,12 +167,13 @@ void MX_FREERTOS_Init(void); /* (MISRA C 2004 rule 8.1) */
   */
 void MX_FREERTOS_Init(void) {
   /* USER CODE BEGIN Init */
-       
+  InitializeCycleCounter();
   /* USER CODE END Init */
 
   /* USER CODE BEGIN RTOS_MUTEX */
   InitializeUartMutexes();
   InitializeSpiMutexes();
+  InitializeSpiSlaves();
   /* USER CODE END RTOS_MUTEX */
 
   /* USER CODE BEGIN RTOS_SEMAPHORES */
@@ -135,13 +202,14 @@ void MX_FREERTOS_Init(void) {
 /* USER CODE BEGIN Header_StartDefaultTask */
 /**
   * @brief  Function implementing the defaultTask thread.
+  *         Brings up sensors and fusion, starts the control task and then
+  *         runs housekeeping: staggered console output and console commands.
   * @param  argument: Not used 
   * @retval None
   */
 /* USER CODE END Header_StartDefaultTask */
 void StartDefaultTask(void const * argument)
 {
-  sImuData_t ImuData;
   /* USER CODE BEGIN StartDefaultTask */
   if (!PrintToUart(eUart_1, "Serial communication is online\r")) {
     RepportErrorByLed();
@@ -149,26 +217,334 @@ void StartDefaultTask(void const * argument)
   if (!Mpu_Init()) {
     PrintToUart(eUart_1, "MPU9250 initialization failed\r");
   }
+  AttitudeEstimator_Init(&g_ImuEstimator, IMU_ESTIMATOR);
+  sGyroBiasConfig_t GyroBiasConfig;
+  GyroBias_GetDefaultConfig(&GyroBiasConfig);
+  GyroBias_Init(&g_ImuGyroBias, &GyroBiasConfig);
+  if (!Motor_Init()) {
+    PrintToUart(eUart_1, "Motor PWM initialization failed\r");
+  }
+#ifdef RUN_MATH_BENCHMARK
+  MathBenchmark_Run();
+  MpuBenchmark_Run();
+  MahonyFixedBenchmark_Run();
+  MahonyBenchmark_Run();
+  ControllerBenchmark_Run();
+  MotorBenchmark_Run();
+  FocBenchmark_Run();
+#endif
+  MotorDrive_Init();
+  /* Feed-forward default is for FOC, where output is torque; open loop output is field speed and closes on the same rate */
+  sAttitudeControllerConfig_t ControllerConfig;
+  AttitudeController_GetDefaultConfig(&ControllerConfig);
+  ControllerConfig.Dt = Mpu_GetSamplePeriodUs() * 1e-6f;
+  if (!g_FocActive) {
+    for (eControlAxis_t i = eControlAxis_First; i < eControlAxis_Last; i++) {
+      ControllerConfig.Axis[i].RateFeedForward = OPEN_LOOP_RATE_FEED_FORWARD;
+    }
+  }
+  AttitudeController_Init(&g_AttitudeController, &ControllerConfig);
+#ifdef IMU_LOG_OUTPUT
+  Mpu_PrintCsvHeader();
+#endif
+  /* Created last, data ready notifications before this point would count as skipped periods */
+  osThreadDef(controlTask, StartControlTask, osPriorityRealtime, 0, CONTROL_TASK_STACK);
+  controlTaskHandle = osThreadCreate(osThread(controlTask), NULL);
+  if (controlTaskHandle == NULL) {
+    PrintToUart(eUart_1, "ERROR: control task creation failed\r");
+  }
   PrintToUart(eUart_1, "Device initialization complete\r");
-  /* TODO: transfer this to dedicated control loop task */
+  char Command[CONSOLE_COMMAND_LENGTH];
+  TickType_t LastPrintTime = xTaskGetTickCount();
   for(;;)
   {
-    /* TODO: fix MPU INT */
-    /* TODO: test magnetometer data */
-    //ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-    vTaskDelay(500); // for demonstration purpouses
-    ReadIMU(&ImuData);
-    MahonyAHRSupdate(ImuData.G.X, ImuData.G.Y, ImuData.G.Z,
-                     ImuData.A.X, ImuData.A.Y, ImuData.A.Z,
-                     ImuData.M.X, ImuData.M.Y, ImuData.M.Z);
-    printQuaternion(); // for demonstration purpouses
+    /* Blocks for up to queue timeout, which also paces the print schedule */
+    memset(Command, 0, sizeof(Command));
+    if (ReceiveMessageFromUart(eUart_1, Command, sizeof(Command) - 1)) {
+      Housekeeping_HandleCommand(Command);
+    }
+    if ((xTaskGetTickCount() - LastPrintTime) >= pdMS_TO_TICKS(CONSOLE_PRINT_PERIOD)) {
+      LastPrintTime = xTaskGetTickCount();
+      Housekeeping_PrintNext();
+    }
   }
   /* USER CODE END StartDefaultTask */
 }
 
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
-     
+/**
+  * @brief  Highest priority task: sample, bias correction and fusion once per IMU data ready.
+  *         Every period records execution time, start jitter and deadline misses (LoopStats).
+  * @param  argument: Not used
+  * @retval None
+  */
+void StartControlTask(void const * argument)
+{
+  uint32_t PreviousTimestamp = 0;
+  bool PreviousTimestampValid = false;
+  float Dt = 0.0f;
+#ifdef IMU_LOG_OUTPUT
+  /* Debug only, CSV lines are printed from control context */
+  unsigned int LogCounter = 0;
+#endif
+#ifndef USE_FIFO
+  sImuData_t ImuData;
+  uint32_t PreviousSampleTime = 0;
+  bool PreviousSampleValid = false;
+#endif
+  for(;;)
+  {
+#ifdef USE_FIFO
+    unsigned int SamplesRead = 0;
+    /* FIFO holds ~40 frames, poll well before it overflows at 1 kHz ODR */
+    vTaskDelay(IMU_FIFO_POLL_PERIOD);
+    uint32_t PeriodStartTime = GetCycleCount();
+    if (ReadIMUFifo(g_ImuBatch, IMU_FIFO_BATCH_SIZE, &SamplesRead)) {
+      for (unsigned int i = 0; i < SamplesRead; i++) {
+        Dt = CyclesToSeconds(g_ImuBatch[i].Timestamp - PreviousTimestamp);
+        if (!PreviousTimestampValid || (Dt > IMU_MAX_DT)) {
+          Dt = Mpu_GetSamplePeriodUs() * 1e-6f;
+        }
+        PreviousTimestamp = g_ImuBatch[i].Timestamp;
+        PreviousTimestampValid = true;
+#ifdef IMU_LOG_OUTPUT
+        if (++LogCounter >= IMU_LOG_DECIMATION) {
+          Mpu_PrintCsv(&g_ImuBatch[i]);
+          LogCounter = 0;
+        }
+#endif
+        sData3D_t Gyro = {g_ImuBatch[i].G.X * DEG_TO_RAD, g_ImuBatch[i].G.Y * DEG_TO_RAD, g_ImuBatch[i].G.Z * DEG_TO_RAD};
+        GyroBias_Update(&g_ImuGyroBias, &Gyro, &g_ImuBatch[i].A, Dt);
+        GyroBias_Correct(&g_ImuGyroBias, &Gyro);
+        g_AhrsBatch[i] = (MahonyAHRSsample_t) {
+          Gyro.X, Gyro.Y, Gyro.Z,
+          g_ImuBatch[i].A.X, g_ImuBatch[i].A.Y, g_ImuBatch[i].A.Z, Dt
+        };
+      }
+      if (SamplesRead) {
+        /* Whole burst in one call, cost is recorded per sample to compare with single sample path */
+        uint32_t FusionStartTime = GetCycleCount();
+        /* Batch update bypasses the interface, so boot alignment and gain ramp run per sample first */
+        if ((g_ImuEstimator.Engine == eAttitudeEstimator_Mahony) && (AttitudeEstimator_GetBootPhase(&g_ImuEstimator) == eAttitudeBootPhase_Done)) {
+          MahonyAHRSupdateBatch(&g_ImuEstimator.State.Mahony, g_AhrsBatch, SamplesRead, NULL);
+        } else {
+          for (unsigned int i = 0; i < SamplesRead; i++) {
+            sData3D_t Gyro = {g_AhrsBatch[i].gx, g_AhrsBatch[i].gy, g_AhrsBatch[i].gz};
+            AttitudeEstimator_Update(&g_ImuEstimator, &Gyro, &g_ImuBatch[i].A, NULL, g_AhrsBatch[i].dt);
+          }
+        }
+        TimingHistogramAdd(eTimingHistogram_FusionCost, CyclesToUs(GetCycleCount() - FusionStartTime) / SamplesRead);
+        ControlTask_PublishAttitude();
+        /* One control step per burst, on the newest sample */
+        sData3D_t LatestRate = {g_AhrsBatch[SamplesRead - 1].gx, g_AhrsBatch[SamplesRead - 1].gy, g_AhrsBatch[SamplesRead - 1].gz};
+        ControlTask_Stabilise(&LatestRate);
+      }
+    }
+    /* Polled period has no trigger of its own, jitter is not meaningful here */
+    LoopStatsRecord(PeriodStartTime, PeriodStartTime, GetCycleCount(), IMU_FIFO_POLL_PERIOD * 1000, 0);
+#else
+    /* Woken by MPU data ready interrupt, more than one pending notification means periods were skipped */
+    uint32_t Notifications = ulTaskNotifyTake(pdTRUE, IMU_DATA_READY_TIMEOUT);
+    if (Notifications == 0) {
+      PrintToUart(eUart_1, "ERROR: MPU data ready timeout\r");
+      PreviousSampleValid = false;
+      PreviousTimestampValid = false;
+    } else {
+      uint32_t PeriodStartTime = GetCycleCount();
+      uint32_t TriggerTime = Mpu_GetDataReadyTimestamp();
+      if (ReadIMU(&ImuData)) {
+        uint32_t SampleTime = GetCycleCount();
+        TimingHistogramAdd(eTimingHistogram_ReadImuCost, CyclesToUs(SampleTime - PeriodStartTime));
+        TimingHistogramAdd(eTimingHistogram_SampleLatency, CyclesToUs(SampleTime - TriggerTime));
+        if (PreviousSampleValid) {
+          int32_t Deviation = (int32_t)CyclesToUs(SampleTime - PreviousSampleTime) - (int32_t)Mpu_GetSamplePeriodUs();
+          TimingHistogramAdd(eTimingHistogram_SampleJitter, (Deviation < 0) ? -Deviation : Deviation);
+        }
+        PreviousSampleTime = SampleTime;
+        PreviousSampleValid = true;
+        /* Integrate over measured interval between data ready timestamps */
+        Dt = CyclesToSeconds(ImuData.Timestamp - PreviousTimestamp);
+        if (!PreviousTimestampValid || (Dt > IMU_MAX_DT)) {
+          Dt = Mpu_GetSamplePeriodUs() * 1e-6f;
+        }
+        PreviousTimestamp = ImuData.Timestamp;
+        PreviousTimestampValid = true;
+        /* Magnetometer runs at 100 Hz, 9-DOF correction only when it delivered new data */
+        uint32_t FusionStartTime = GetCycleCount();
+        sData3D_t Gyro = {ImuData.G.X * DEG_TO_RAD, ImuData.G.Y * DEG_TO_RAD, ImuData.G.Z * DEG_TO_RAD};
+        GyroBias_Update(&g_ImuGyroBias, &Gyro, &ImuData.A, Dt);
+        GyroBias_Correct(&g_ImuGyroBias, &Gyro);
+        AttitudeEstimator_Update(&g_ImuEstimator, &Gyro, &ImuData.A, ImuData.MagFresh ? &ImuData.M : NULL, Dt);
+        TimingHistogramAdd(eTimingHistogram_FusionCost, CyclesToUs(GetCycleCount() - FusionStartTime));
+        ControlTask_PublishAttitude();
+        ControlTask_Stabilise(&Gyro);
+#ifdef IMU_LOG_OUTPUT
+        if (++LogCounter >= IMU_LOG_DECIMATION) {
+          Mpu_PrintCsv(&ImuData);
+          LogCounter = 0;
+        }
+#endif
+      }
+      LoopStatsRecord(TriggerTime, PeriodStartTime, GetCycleCount(), Mpu_GetSamplePeriodUs(), Notifications - 1);
+    }
+#endif
+  }
+}
+
+static void ControlTask_PublishAttitude(void)
+{
+  sQuaternion_t Attitude;
+  if (AttitudeEstimator_GetQuaternion(&g_ImuEstimator, &Attitude)) {
+    taskENTER_CRITICAL();
+    g_ImuAttitude = Attitude;
+    taskEXIT_CRITICAL();
+  }
+}
+
+/* Boot gyro bias calibration finished or gave up */
+static bool ControlTask_GyroBiasSettled(const sGyroBias_t *GyroBias)
+{
+  return GyroBias_IsCalibrated(GyroBias) || (GyroBias->Elapsed >= GYRO_BIAS_TIMEOUT);
+}
+
+/* Closes the attitude loop once the estimator is out of its boot phase and the gyro bias has settled, until then
+ * output stays zero and the motors unpowered */
+static void ControlTask_Stabilise(const sData3D_t *Rate)
+{
+  sQuaternion_t Attitude;
+  sData3D_t Output = {0.0f, 0.0f, 0.0f};
+  if ((AttitudeEstimator_GetBootPhase(&g_ImuEstimator) == eAttitudeBootPhase_Done) &&
+      ControlTask_GyroBiasSettled(&g_ImuGyroBias) &&
+      AttitudeEstimator_GetQuaternion(&g_ImuEstimator, &Attitude)) {
+    if (!g_AttitudeSetpointValid) {
+      g_AttitudeSetpoint = Attitude;
+      g_AttitudeSetpointValid = true;
+      AttitudeController_Reset(&g_AttitudeController);
+    }
+    AttitudeController_Update(&g_AttitudeController, &g_AttitudeSetpoint, &Attitude, Rate, &Output);
+  }
+  ControlTask_DriveMotors(&Output, g_AttitudeSetpointValid);
+  taskENTER_CRITICAL();
+  g_ControlOutput = Output;
+  taskEXIT_CRITICAL();
+}
+
+/* FOC: output is q axis current, one encoder chain read per period. Open loop: output moves the field angle.
+ * Either way motors stay unpowered until the loop is closed. */
+static void ControlTask_DriveMotors(const sData3D_t *Output, bool Enabled)
+{
+  const float Command[eMotor_Last] = {Output->X, Output->Y, Output->Z};
+  if (g_FocActive) {
+    const float NoCommand[eMotor_Last] = {0.0f, 0.0f, 0.0f};
+    sEncoderSample_t Samples[eMotor_Last];
+    /* Failed read leaves samples invalid, FOC bridges a few periods by extrapolation */
+    Encoder_Read(Samples);
+    Foc_Update(&g_Foc, Samples, Enabled ? Command : NoCommand, NULL);
+    return;
+  }
+  float Step = MOTOR_MAX_SPEED * Mpu_GetSamplePeriodUs() * 1e-6f;
+  for (eMotor_t i = eMotor_First; i < eMotor_Last; i++) {
+    g_MotorAngle[i] += Command[i] * Step;
+    if (g_MotorAngle[i] > 0.5f * TWO_PI) {
+      g_MotorAngle[i] -= TWO_PI;
+    } else if (g_MotorAngle[i] < -0.5f * TWO_PI) {
+      g_MotorAngle[i] += TWO_PI;
+    }
+    Motor_Set(i, g_MotorAngle[i], Enabled ? MOTOR_POWER : 0.0f);
+  }
+}
+
+/* Runs before the control task exists, so nothing else drives the motors or uses SPI2 meanwhile */
+static void MotorDrive_Init(void)
+{
+  sFocConfig_t FocConfig;
+  sEncoderSample_t Samples[eMotor_Last];
+  Foc_GetDefaultConfig(&FocConfig);
+  FocConfig.Dt = Mpu_GetSamplePeriodUs() * 1e-6f;
+  Foc_Init(&g_Foc, &FocConfig);
+  if (Encoder_Init()) {
+    Foc_AlignStart(&g_Foc);
+    osDelay(FOC_ALIGN_TIME);
+    /* Encoder answers one read late, first read latches the settled angle and the second returns it */
+    g_FocActive = Encoder_Read(Samples) && Encoder_Read(Samples) && Foc_AlignFinish(&g_Foc, Samples);
+    Foc_Release(&g_Foc);
+  }
+  PrintToUart(eUart_1, "Motor drive: %s\r", g_FocActive ? "FOC" : "open loop");
+}
+
+/* One item per call, state owned by control task is copied out in a critical section */
+static void Housekeeping_PrintNext(void)
+{
+  static unsigned int PrintIndex = 0;
+  static bool GyroBiasReported = false;
+  sGyroBias_t GyroBias;
+  sQuaternion_t Attitude;
+  sData3D_t ControlOutput;
+  taskENTER_CRITICAL();
+  GyroBias = g_ImuGyroBias;
+  Attitude = g_ImuAttitude;
+  ControlOutput = g_ControlOutput;
+  taskEXIT_CRITICAL();
+  if (!GyroBiasReported && ControlTask_GyroBiasSettled(&GyroBias)) {
+    if (!GyroBias_IsCalibrated(&GyroBias)) {
+      PrintToUart(eUart_1, "BIAS timeout, attitude loop closed on uncalibrated estimate\r");
+    }
+    GyroBias_Print(&GyroBias);
+    GyroBiasReported = true;
+    return;
+  }
+  switch (PrintIndex) {
+    case 0:
+      PrintToUart(eUart_1, "%s q0: %f\tq1: %f\tq2: %f\t q3: %f\r", AttitudeEstimator_GetName(IMU_ESTIMATOR),
+                  Attitude.W, Attitude.X, Attitude.Y, Attitude.Z); // for demonstration purpouses
+      break;
+    case 1:
+      TimingHistogramPrint(eTimingHistogram_SampleLatency);
+      break;
+    case 2:
+      TimingHistogramPrint(eTimingHistogram_SampleJitter);
+      break;
+    case 3:
+      TimingHistogramPrint(eTimingHistogram_ReadImuCost);
+      break;
+    case 4:
+      SpiPrintStats(eSpi_1);
+      break;
+    case 5:
+      TimingHistogramPrint(eTimingHistogram_FusionCost);
+      break;
+    case 6:
+      PrintToUart(eUart_1, "CTRL u: %f\t%f\t%f\r", ControlOutput.X, ControlOutput.Y, ControlOutput.Z);
+      break;
+    case 7:
+      Encoder_PrintStats();
+      break;
+    default:
+      LoopStatsPrint();
+      break;
+  }
+  PrintIndex = (PrintIndex + 1) % 9;
+}
+
+/* "loop" prints control loop counters and cost histogram, "loop reset" clears them.
+ * The UART RX buffer drops blanks, so the reset command arrives as "loopreset". */
+static void Housekeeping_HandleCommand(const char *Command)
+{
+  if (strstr(Command, "loopreset") != NULL) {
+    LoopStatsReset();
+    PrintToUart(eUart_1, "LOOP counters cleared\r");
+  } else if (strstr(Command, "loop") != NULL) {
+    LoopStatsPrint();
+    TimingHistogramPrint(eTimingHistogram_ControlCost);
+  } else if (strstr(Command, "bias") != NULL) {
+    sGyroBias_t GyroBias;
+    taskENTER_CRITICAL();
+    GyroBias = g_ImuGyroBias;
+    taskEXIT_CRITICAL();
+    GyroBias_Print(&GyroBias);
+  }
+}
 /* USER CODE END Application */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
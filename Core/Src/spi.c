@@ -105,6 +105,10 @@ void HAL_SPI_MspInit(SPI_HandleTypeDef* spiHandle)
     HAL_NVIC_SetPriority(SPI1_IRQn, 5, 0);
     HAL_NVIC_EnableIRQ(SPI1_IRQn);
   /* USER CODE BEGIN SPI1_MspInit 1 */
+    /* SPI1 DMA Init: RX on DMA1 channel 2, TX on DMA1 channel 3 */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
 
   /* USER CODE END SPI1_MspInit 1 */
   }
@@ -133,6 +137,10 @@ void HAL_SPI_MspInit(SPI_HandleTypeDef* spiHandle)
     HAL_NVIC_SetPriority(SPI2_IRQn, 5, 0);
     HAL_NVIC_EnableIRQ(SPI2_IRQn);
   /* USER CODE BEGIN SPI2_MspInit 1 */
+    /* SPI2 DMA Init: RX on DMA1 channel 4, TX on DMA1 channel 5 */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
 
   /* USER CODE END SPI2_MspInit 1 */
   }
@@ -159,6 +167,7 @@ void HAL_SPI_MspDeInit(SPI_HandleTypeDef* spiHandle)
     /* SPI1 interrupt Deinit */
     HAL_NVIC_DisableIRQ(SPI1_IRQn);
   /* USER CODE BEGIN SPI1_MspDeInit 1 */
+    HAL_NVIC_DisableIRQ(DMA1_Channel2_IRQn);
 
   /* USER CODE END SPI1_MspDeInit 1 */
   }
@@ -180,6 +189,7 @@ void HAL_SPI_MspDeInit(SPI_HandleTypeDef* spiHandle)
     /* SPI2 interrupt Deinit */
     HAL_NVIC_DisableIRQ(SPI2_IRQn);
   /* USER CODE BEGIN SPI2_MspDeInit 1 */
+    HAL_NVIC_DisableIRQ(DMA1_Channel4_IRQn);
 
   /* USER CODE END SPI2_MspDeInit 1 */
   }
@@ -81,7 +81,7 @@ extern SPI_HandleTypeDef hspi1;
 extern SPI_HandleTypeDef hspi2;
 extern UART_HandleTypeDef huart1;
 extern UART_HandleTypeDef huart3;
-extern TIM_HandleTypeDef htim1;
+extern TIM_HandleTypeDef htim6;
 
 /* USER CODE BEGIN EV */
 
@@ -189,13 +189,12 @@ void DebugMon_Handler(void)
 void EXTI3_IRQHandler(void)
 {
   /* USER CODE BEGIN EXTI3_IRQn 0 */
-#ifndef NOT_USING_CUSTOM_DRIVERS
+
   /* USER CODE END EXTI3_IRQn 0 */
   HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_3);
   /* USER CODE BEGIN EXTI3_IRQn 1 */
-#else
-  /* TODO: fix MPU INT */
-  //HandleExt3IRQ();
+#ifndef NOT_USING_CUSTOM_DRIVERS
+  HandleExt3IRQ();
 #endif
   /* USER CODE END EXTI3_IRQn 1 */
 }
@@ -242,20 +241,6 @@ void CAN_SCE_IRQHandler(void)
   /* USER CODE END CAN_SCE_IRQn 1 */
 }
 
-/**
-  * @brief This function handles TIM1 update and TIM16 interrupts.
-  */
-void TIM1_UP_TIM16_IRQHandler(void)
-{
-  /* USER CODE BEGIN TIM1_UP_TIM16_IRQn 0 */
-
-  /* USER CODE END TIM1_UP_TIM16_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim1);
-  /* USER CODE BEGIN TIM1_UP_TIM16_IRQn 1 */
-
-  /* USER CODE END TIM1_UP_TIM16_IRQn 1 */
-}
-
 /**
   * @brief This function handles I2C1 event global interrupt / I2C1 wake-up interrupt through EXTI line 23.
   */
@@ -312,7 +297,8 @@ void SPI2_IRQHandler(void)
   HAL_SPI_IRQHandler(&hspi2);
   /* USER CODE BEGIN SPI2_IRQn 1 */
   #else
-
+  HandleSpiRxIRQ (eSpi_2);
+  HandleSpiTxIRQ (eSpi_2);
   #endif
   /* USER CODE END SPI2_IRQn 1 */
 }
@@ -350,7 +336,37 @@ void USART3_IRQHandler(void)
   /* USER CODE END USART3_IRQn 1 */
 }
 
+/**
+  * @brief This function handles Timer 6 interrupt and DAC underrun interrupts.
+  */
+void TIM6_DAC_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM6_DAC_IRQn 0 */
+
+  /* USER CODE END TIM6_DAC_IRQn 0 */
+  HAL_TIM_IRQHandler(&htim6);
+  /* USER CODE BEGIN TIM6_DAC_IRQn 1 */
+
+  /* USER CODE END TIM6_DAC_IRQn 1 */
+}
+
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 channel2 global interrupt (SPI1 RX).
+  */
+void DMA1_Channel2_IRQHandler(void)
+{
+  HandleSpiDmaRxIRQ (eSpi_1);
+}
+
+/**
+  * @brief This function handles DMA1 channel4 global interrupt (SPI2 RX).
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  HandleSpiDmaRxIRQ (eSpi_2);
+}
+
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,102 @@
+/* Cost per transferred byte of the SPI1 driver, built once per transfer mode (see Makefile). The bus model runs
+ * synchronously, so host time is driver plus model; kernel calls and interrupt entries per byte are what the
+ * target pays on top of the wire time. */
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "spi_api.h"
+#include "message_queue_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_spi.h"
+#include "host_test.h"
+
+
+#define BENCH_REPEATS               2000
+#define BENCH_MAX_LENGTH            192     // 16 FIFO frames
+
+#ifdef SPI1_TRANSFER_MODE
+#define BENCH_MODE_NAME             "queue"
+#else
+#define BENCH_MODE_NAME             "dma"
+#endif
+
+static uint8_t g_Memory[256];
+static unsigned int g_Position;
+
+static void SlaveSelect (void *Context, bool Selected) {
+    (void)Context;
+    if (Selected) {
+        g_Position = 0;
+    }
+}
+
+/* Read-only register file, enough to check data comes back in order */
+static uint16_t SlaveExchange (void *Context, uint16_t Mosi, const sHostSpiFormat_t *Format) {
+    static uint8_t Address;
+    uint16_t Miso = 0;
+    (void)Context;
+    (void)Format;
+    if (g_Position++ == 0) {
+        Address = Mosi & 0x7F;
+    } else {
+        Miso = g_Memory[Address++];
+    }
+    return Miso;
+}
+
+static void RunLength (uint16_t Length) {
+    static uint8_t Buffer[BENCH_MAX_LENGTH];
+    sHostRtosStats_t Rtos;
+    sHostSpiStats_t Before;
+    sHostSpiStats_t After;
+    bool Ok = true;
+    HostRtos_ResetStats();
+    HostSpi_GetStats(SPI1, &Before);
+    double Start = HostTest_NowNs();
+    for (unsigned int i = 0; (i < BENCH_REPEATS) && Ok; i++) {
+        Ok = SpiReadSlaveRegisters(eSpiSlave_MPU, 0x00, Buffer, Length);
+    }
+    double Elapsed = HostTest_NowNs() - Start;
+    HostSpi_GetStats(SPI1, &After);
+    HostRtos_GetStats(&Rtos);
+    CHECK(Ok);
+    CHECK(memcmp(Buffer, g_Memory, Length) == 0);
+    /* Command byte is part of every transaction */
+    double Bytes = (double)BENCH_REPEATS * (Length + 1);
+    double Interrupts = (double)(After.TxInterrupts - Before.TxInterrupts) + (double)(After.RxInterrupts - Before.RxInterrupts) +
+                        (double)(After.DmaInterrupts - Before.DmaInterrupts);
+    double KernelCalls = (double)Rtos.QueueSends + (double)Rtos.QueueReceives + (double)Rtos.SemaphoreTakes;
+    printf("SPI %-5s len=%3u host=%6.1f ns/B irq=%5.2f /B kernel=%5.2f /B wire=%llu cyc/B\n", BENCH_MODE_NAME,
+           (unsigned int)Length, Elapsed / Bytes, Interrupts / Bytes, KernelCalls / Bytes,
+           (unsigned long long)((After.BusCycles - Before.BusCycles) / (uint64_t)Bytes));
+#ifdef SPI1_TRANSFER_MODE
+    /* Every byte is a TX and an RX interrupt plus a queue send and receive on each side */
+    CHECK(Interrupts / Bytes >= 2.0);
+    CHECK(KernelCalls / Bytes >= 4.0);
+#else
+    /* One completion interrupt for the command and one for the data, no per-byte kernel work */
+    CHECK(After.DmaInterrupts - Before.DmaInterrupts == 2 * BENCH_REPEATS);
+    CHECK(Rtos.QueueSends + Rtos.QueueReceives == 0);
+#endif
+}
+
+int TestMain (int argc, char **argv) {
+    static const uint16_t Lengths[] = {1, 22, 64, BENCH_MAX_LENGTH};
+    const sHostSpiSlave_t Slave = { SPI1, GPIOA, GPIO_PIN_4, SlaveSelect, SlaveExchange, NULL };
+    (void)argc;
+    (void)argv;
+    for (unsigned int i = 0; i < sizeof(g_Memory); i++) {
+        g_Memory[i] = (uint8_t)(i * 7 + 3);
+    }
+    HostSpi_Reset();
+    HostSpi_Attach(&Slave);
+    InitializeMessageQueues();
+    InitializeSpiMutexes();
+    InitializeSpiSlaves();
+    for (unsigned int i = 0; i < sizeof(Lengths) / sizeof(Lengths[0]); i++) {
+        RunLength(Lengths[i]);
+    }
+    return HostTest_Result("spi_transfer_" BENCH_MODE_NAME);
+}
@@ -0,0 +1,462 @@
+/* Grid search of estimator gains over a directory of IMU logs. Every combination of the -g values is replayed over
+ * every log on a work-stealing pool with one estimator instance per run, then ranked by attitude error and time to
+ * convergence, pooled over the logs.
+ *
+ *   gain_sweep [-e engine] -g name=v1,v2,... [-g ...] [-n] [-s settle] [-t threshold] [-j workers]
+ *              [-k angle|tilt|convergence] [-N rows] directory
+ *
+ * Names are the sAttitudeEstimatorConfig_t fields (TwoKp, TwoKi, Beta, ...), fields not swept keep their defaults.
+ * Logs are the Mpu_PrintCsv CSV or binary files in the directory; "<log>.att.csv" next to "<log>.csv" is its
+ * reference attitude, as written by replay_imu -o or a simulator. Logs without one are scored against a MEKF replay
+ * of themselves with magnetometer, the most accurate engine on the bench stream (0.12 deg rms against truth). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <math.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "attitude_estimator_api.h"
+#include "host_imu_log.h"
+#include "host_imu_replay.h"
+#include "host_work_pool.h"
+#include "host_test.h"
+
+
+#define SWEEP_MAX_AXES              9
+#define SWEEP_MAX_VALUES            32
+#define SWEEP_MAX_COMBINATIONS      100000
+#define SWEEP_DEFAULT_ROWS          20
+#define SWEEP_REFERENCE_SUFFIX      ".att.csv"
+
+typedef enum {
+    eSweepType_Float,
+    eSweepType_Unsigned,
+} eSweepType_t;
+
+typedef enum {
+    eSweepKey_First,
+    eSweepKey_Angle = eSweepKey_First,
+    eSweepKey_Tilt,
+    eSweepKey_Convergence,
+    eSweepKey_Last,
+} eSweepKey_t;
+
+typedef struct {
+    const char *Name;
+    size_t Offset;
+    eSweepType_t Type;
+} sSweepParameterDesc_t;
+
+typedef struct {
+    const sSweepParameterDesc_t *Desc;
+    unsigned int Count;
+    float Values[SWEEP_MAX_VALUES];
+} sSweepAxis_t;
+
+typedef struct {
+    char *Path;
+    sHostImuLog_t Log;
+    sHostAttitudeTrack_t Reference;
+    bool FromMekf;
+} sSweepLog_t;
+
+typedef struct {
+    sHostImuReplayConfig_t Base;
+    sSweepAxis_t Axes[SWEEP_MAX_AXES];
+    unsigned int AxisCount;
+    sSweepLog_t *Logs;
+    unsigned int LogCount;
+    unsigned int Combinations;
+    sHostImuReplayResult_t *Results;    // Combinations x LogCount
+    bool *Ran;
+} sSweep_t;
+
+typedef struct {
+    unsigned int Combination;
+    float AngleRms;                     // deg, pooled over every compared sample of every log
+    float TiltRms;
+    float AngleMax;
+    float ConvergenceTime;              // s, worst log; INFINITY if tilt never settles in one of them
+    bool Finite;
+} sSweepScore_t;
+
+static const sSweepParameterDesc_t g_Parameters[] = {
+    {"TwoKp",                   offsetof(sAttitudeEstimatorConfig_t, TwoKp),                    eSweepType_Float},
+    {"TwoKi",                   offsetof(sAttitudeEstimatorConfig_t, TwoKi),                    eSweepType_Float},
+    {"Beta",                    offsetof(sAttitudeEstimatorConfig_t, Beta),                     eSweepType_Float},
+    {"AccVariance",             offsetof(sAttitudeEstimatorConfig_t, AccVariance),              eSweepType_Float},
+    {"MagVariance",             offsetof(sAttitudeEstimatorConfig_t, MagVariance),              eSweepType_Float},
+    {"CorrectionDecimation",    offsetof(sAttitudeEstimatorConfig_t, CorrectionDecimation),     eSweepType_Unsigned},
+    {"BootAlignSamples",        offsetof(sAttitudeEstimatorConfig_t, BootAlignSamples),         eSweepType_Unsigned},
+    {"BootGainScale",           offsetof(sAttitudeEstimatorConfig_t, BootGainScale),            eSweepType_Float},
+    {"BootRampTime",            offsetof(sAttitudeEstimatorConfig_t, BootRampTime),             eSweepType_Float},
+};
+
+static const char *g_KeyNames[eSweepKey_Last] = {"angle", "tilt", "convergence"};
+static eSweepKey_t g_Key = eSweepKey_Angle;
+
+
+static void Usage (void) {
+    fprintf(stderr, "usage: gain_sweep [-e Mahony|Madgwick|MEKF|MultiRate] -g name=v1,v2,... [-g ...] [-n] [-s settle]\n"
+                    "                  [-t threshold] [-j workers] [-k angle|tilt|convergence] [-N rows] directory\n"
+                    "names:");
+    for (unsigned int i = 0; i < sizeof(g_Parameters) / sizeof(g_Parameters[0]); i++) {
+        fprintf(stderr, " %s", g_Parameters[i].Name);
+    }
+    fprintf(stderr, "\n");
+}
+
+static bool ParseEngine (const char *Name, eAttitudeEstimator_t *Engine) {
+    for (eAttitudeEstimator_t i = eAttitudeEstimator_First; i < eAttitudeEstimator_Last; i++) {
+        if (strcasecmp(Name, AttitudeEstimator_GetName(i)) == 0) {
+            *Engine = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseKey (const char *Name, eSweepKey_t *Key) {
+    for (eSweepKey_t i = eSweepKey_First; i < eSweepKey_Last; i++) {
+        if (strcasecmp(Name, g_KeyNames[i]) == 0) {
+            *Key = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* "name=v1,v2,..." */
+static bool ParseAxis (const char *Text, sSweepAxis_t *Axis) {
+    const char *Equals = strchr(Text, '=');
+    if (Equals == NULL) {
+        return false;
+    }
+    Axis->Desc = NULL;
+    for (unsigned int i = 0; i < sizeof(g_Parameters) / sizeof(g_Parameters[0]); i++) {
+        if ((strlen(g_Parameters[i].Name) == (size_t)(Equals - Text)) && (strncasecmp(Text, g_Parameters[i].Name, (size_t)(Equals - Text)) == 0)) {
+            Axis->Desc = &g_Parameters[i];
+        }
+    }
+    if (Axis->Desc == NULL) {
+        return false;
+    }
+    Axis->Count = 0;
+    const char *Value = Equals + 1;
+    for (;;) {
+        char *End;
+        float Parsed = strtof(Value, &End);
+        if ((End == Value) || (Axis->Count == SWEEP_MAX_VALUES) || ((Axis->Desc->Type == eSweepType_Unsigned) && (Parsed < 0.0f))) {
+            return false;
+        }
+        Axis->Values[Axis->Count++] = Parsed;
+        if (*End == '\0') {
+            return true;
+        }
+        if (*End != ',') {
+            return false;
+        }
+        Value = End + 1;
+    }
+}
+
+/* Mixed radix over the axes, last axis fastest */
+static void SetCombination (const sSweep_t *Sweep, unsigned int Combination, sAttitudeEstimatorConfig_t *Config, unsigned int Index[]) {
+    for (unsigned int i = Sweep->AxisCount; i-- > 0;) {
+        const sSweepAxis_t *Axis = &Sweep->Axes[i];
+        unsigned int Value = Combination % Axis->Count;
+        Combination /= Axis->Count;
+        if (Index != NULL) {
+            Index[i] = Value;
+        }
+        if (Axis->Desc->Type == eSweepType_Float) {
+            *(float *)((char *)Config + Axis->Desc->Offset) = Axis->Values[Value];
+        } else {
+            *(unsigned int *)((char *)Config + Axis->Desc->Offset) = (unsigned int)Axis->Values[Value];
+        }
+    }
+}
+
+/* One combination on one log; the estimator lives on this worker's stack inside HostImuReplay_Run */
+static void RunTask (unsigned int Task, unsigned int Worker, void *Context) {
+    sSweep_t *Sweep = Context;
+    const unsigned int Combination = Task / Sweep->LogCount;
+    const sSweepLog_t *Log = &Sweep->Logs[Task % Sweep->LogCount];
+    sHostImuReplayConfig_t Config = Sweep->Base;
+    (void)Worker;
+    SetCombination(Sweep, Combination, &Config.Config, NULL);
+    Sweep->Ran[Task] = HostImuReplay_Run(&Config, &Log->Log, &Log->Reference, NULL, &Sweep->Results[Task]);
+}
+
+static bool IsReference (const char *Name) {
+    size_t Length = strlen(Name);
+    size_t Suffix = strlen(SWEEP_REFERENCE_SUFFIX);
+    return (Length >= Suffix) && (strcmp(&Name[Length - Suffix], SWEEP_REFERENCE_SUFFIX) == 0);
+}
+
+/* Logs in name order, so the output does not depend on directory order */
+static bool LoadLogs (const char *Directory, sSweep_t *Sweep) {
+    struct dirent **Names;
+    int Count = scandir(Directory, &Names, NULL, alphasort);
+    if (Count < 0) {
+        perror(Directory);
+        return false;
+    }
+    Sweep->Logs = calloc((size_t)Count + 1, sizeof(sSweepLog_t));
+    Sweep->LogCount = 0;
+    for (int i = 0; i < Count; i++) {
+        const char *Name = Names[i]->d_name;
+        size_t Length = strlen(Directory) + strlen(Name) + sizeof(SWEEP_REFERENCE_SUFFIX) + 2;
+        char *Path = malloc(Length);
+        struct stat Info;
+        snprintf(Path, Length, "%s/%s", Directory, Name);
+        sSweepLog_t *Log = &Sweep->Logs[Sweep->LogCount];
+        if ((Name[0] == '.') || IsReference(Name) || (stat(Path, &Info) != 0) || !S_ISREG(Info.st_mode)) {
+            free(Path);
+        } else if (!HostImuLog_Load(&Log->Log, Path) || (Log->Log.Count == 0)) {
+            fprintf(stderr, "%s: not an IMU log, skipped\n", Path);
+            HostImuLog_Free(&Log->Log);
+            free(Path);
+        } else {
+            /* "run.csv" and "run.bin" both look for "run.att.csv" */
+            char *Reference = malloc(Length);
+            const char *Extension = strrchr(Name, '.');
+            int Stem = (Extension != NULL) ? (int)(Extension - Name) : (int)strlen(Name);
+            snprintf(Reference, Length, "%s/%.*s" SWEEP_REFERENCE_SUFFIX, Directory, Stem, Name);
+            Log->Path = Path;
+            if (!HostAttitudeTrack_Load(&Log->Reference, Reference)) {
+                sHostImuReplayConfig_t Mekf;
+                sHostImuReplayResult_t Result;
+                HostAttitudeTrack_Free(&Log->Reference);
+                HostImuReplay_GetDefaultConfig(&Mekf);
+                Mekf.Engine = eAttitudeEstimator_Mekf;
+                HostAttitudeTrack_Init(&Log->Reference, Log->Log.Clock);
+                HostImuReplay_Run(&Mekf, &Log->Log, NULL, &Log->Reference, &Result);
+                Log->FromMekf = true;
+            }
+            free(Reference);
+            Sweep->LogCount++;
+        }
+        free(Names[i]);
+    }
+    free(Names);
+    return true;
+}
+
+static int CompareConvergence (const sSweepScore_t *A, const sSweepScore_t *B) {
+    return (A->ConvergenceTime < B->ConvergenceTime) ? -1 : (A->ConvergenceTime > B->ConvergenceTime) ? 1 : 0;
+}
+
+/* Chosen key first, convergence (or angle, when ranking by convergence) breaks ties, combination order after that */
+static int CompareScores (const void *Left, const void *Right) {
+    const sSweepScore_t *A = Left;
+    const sSweepScore_t *B = Right;
+    int Order = 0;
+    if (A->Finite != B->Finite) {
+        return A->Finite ? -1 : 1;
+    }
+    switch (g_Key) {
+        case eSweepKey_Tilt:
+            Order = (A->TiltRms < B->TiltRms) ? -1 : (A->TiltRms > B->TiltRms) ? 1 : CompareConvergence(A, B);
+            break;
+        case eSweepKey_Convergence:
+            Order = CompareConvergence(A, B);
+            if (Order == 0) {
+                Order = (A->AngleRms < B->AngleRms) ? -1 : (A->AngleRms > B->AngleRms) ? 1 : 0;
+            }
+            break;
+        default:
+            Order = (A->AngleRms < B->AngleRms) ? -1 : (A->AngleRms > B->AngleRms) ? 1 : CompareConvergence(A, B);
+            break;
+    }
+    if (Order == 0) {
+        Order = (A->Combination < B->Combination) ? -1 : (A->Combination > B->Combination) ? 1 : 0;
+    }
+    return Order;
+}
+
+static void Score (const sSweep_t *Sweep, unsigned int Combination, sSweepScore_t *Score) {
+    double AngleSq = 0.0;
+    double TiltSq = 0.0;
+    unsigned int Compared = 0;
+    memset(Score, 0, sizeof(sSweepScore_t));
+    Score->Combination = Combination;
+    Score->Finite = true;
+    for (unsigned int i = 0; i < Sweep->LogCount; i++) {
+        const sHostImuReplayResult_t *Result = &Sweep->Results[Combination * Sweep->LogCount + i];
+        AngleSq += (double)Result->AngleRms * Result->AngleRms * Result->Compared;
+        TiltSq += (double)Result->TiltRms * Result->TiltRms * Result->Compared;
+        Compared += Result->Compared;
+        Score->AngleMax = fmaxf(Score->AngleMax, Result->AngleMax);
+        Score->ConvergenceTime = (Result->ConvergenceTime < 0.0f) ? INFINITY : fmaxf(Score->ConvergenceTime, Result->ConvergenceTime);
+        Score->Finite = Score->Finite && Sweep->Ran[Combination * Sweep->LogCount + i] && Result->Finite;
+    }
+    Score->AngleRms = (Compared != 0) ? (float)sqrt(AngleSq / Compared) : INFINITY;
+    Score->TiltRms = (Compared != 0) ? (float)sqrt(TiltSq / Compared) : INFINITY;
+    if (!Score->Finite) {
+        Score->AngleRms = INFINITY;
+        Score->TiltRms = INFINITY;
+    }
+}
+
+static void PrintScores (const sSweep_t *Sweep, const sSweepScore_t *Scores, unsigned int Rows) {
+    unsigned int Index[SWEEP_MAX_AXES];
+    sAttitudeEstimatorConfig_t Config;
+    printf("rank ");
+    for (unsigned int i = 0; i < Sweep->AxisCount; i++) {
+        printf(" %12s", Sweep->Axes[i].Desc->Name);
+    }
+    printf("    rms deg   tilt deg    max deg  converged s\n");
+    for (unsigned int Row = 0; Row < Rows; Row++) {
+        SetCombination(Sweep, Scores[Row].Combination, &Config, Index);
+        printf("%4u ", Row + 1);
+        for (unsigned int i = 0; i < Sweep->AxisCount; i++) {
+            printf(" %12g", (double)Sweep->Axes[i].Values[Index[i]]);
+        }
+        if (!Scores[Row].Finite) {
+            printf("  attitude not finite\n");
+        } else if (isinf(Scores[Row].ConvergenceTime)) {
+            printf(" %10.4f %10.4f %10.4f        never\n", (double)Scores[Row].AngleRms, (double)Scores[Row].TiltRms,
+                   (double)Scores[Row].AngleMax);
+        } else {
+            printf(" %10.4f %10.4f %10.4f %12.3f\n", (double)Scores[Row].AngleRms, (double)Scores[Row].TiltRms,
+                   (double)Scores[Row].AngleMax, (double)Scores[Row].ConvergenceTime);
+        }
+    }
+}
+
+int TestMain (int argc, char **argv) {
+    sSweep_t Sweep;
+    const char *Directory = NULL;
+    unsigned int Workers = HostWorkPool_GetCoreCount();
+    unsigned int Rows = SWEEP_DEFAULT_ROWS;
+    memset(&Sweep, 0, sizeof(sSweep_t));
+    HostImuReplay_GetDefaultConfig(&Sweep.Base);
+    for (int i = 1; i < argc; i++) {
+        const char *Value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        bool Used = true;
+        if (strcmp(argv[i], "-n") == 0) {
+            Sweep.Base.UseMag = false;
+            Used = false;
+        } else if ((argv[i][0] != '-') && (Directory == NULL)) {
+            Directory = argv[i];
+            Used = false;
+        } else if (Value == NULL) {
+            Usage();
+            return EXIT_FAILURE;
+        } else if (strcmp(argv[i], "-e") == 0) {
+            if (!ParseEngine(Value, &Sweep.Base.Engine)) {
+                fprintf(stderr, "unknown engine %s\n", Value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-g") == 0) {
+            if ((Sweep.AxisCount == SWEEP_MAX_AXES) || !ParseAxis(Value, &Sweep.Axes[Sweep.AxisCount])) {
+                fprintf(stderr, "bad grid %s\n", Value);
+                Usage();
+                return EXIT_FAILURE;
+            }
+            Sweep.AxisCount++;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            Sweep.Base.SettleTime = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            Sweep.Base.ConvergenceThreshold = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            Workers = (unsigned int)strtoul(Value, NULL, 10);
+        } else if (strcmp(argv[i], "-k") == 0) {
+            if (!ParseKey(Value, &g_Key)) {
+                fprintf(stderr, "unknown key %s\n", Value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-N") == 0) {
+            Rows = (unsigned int)strtoul(Value, NULL, 10);
+        } else {
+            Usage();
+            return EXIT_FAILURE;
+        }
+        if (Used) {
+            i++;
+        }
+    }
+    if ((Directory == NULL) || (Sweep.AxisCount == 0) || (Workers == 0)) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+    Sweep.Combinations = 1;
+    for (unsigned int i = 0; i < Sweep.AxisCount; i++) {
+        Sweep.Combinations *= Sweep.Axes[i].Count;
+        if (Sweep.Combinations > SWEEP_MAX_COMBINATIONS) {
+            fprintf(stderr, "more than %u combinations\n", SWEEP_MAX_COMBINATIONS);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!LoadLogs(Directory, &Sweep)) {
+        return EXIT_FAILURE;
+    }
+    if (Sweep.LogCount == 0) {
+        fprintf(stderr, "%s: no IMU logs\n", Directory);
+        return EXIT_FAILURE;
+    }
+    double Seconds = 0.0;
+    unsigned int FromMekf = 0;
+    for (unsigned int i = 0; i < Sweep.LogCount; i++) {
+        Seconds += (double)(Sweep.Logs[i].Log.Cycles[Sweep.Logs[i].Log.Count - 1] - Sweep.Logs[i].Log.Cycles[0]) / Sweep.Logs[i].Log.Clock;
+        FromMekf += Sweep.Logs[i].FromMekf ? 1 : 0;
+    }
+    printf("%s: %u logs, %.2f s of data, %u scored against MEKF\n", Directory, Sweep.LogCount, Seconds, FromMekf);
+
+    const unsigned int Runs = Sweep.Combinations * Sweep.LogCount;
+    sHostWorkPoolStats_t *Stats = calloc(Workers, sizeof(sHostWorkPoolStats_t));
+    sSweepScore_t *Scores = calloc(Sweep.Combinations, sizeof(sSweepScore_t));
+    Sweep.Results = calloc(Runs, sizeof(sHostImuReplayResult_t));
+    Sweep.Ran = calloc(Runs, sizeof(bool));
+    if ((Stats == NULL) || (Scores == NULL) || (Sweep.Results == NULL) || (Sweep.Ran == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    double Wall = HostTest_NowNs();
+    if (!HostWorkPool_Run(Workers, Runs, RunTask, &Sweep, Stats)) {
+        fprintf(stderr, "could not start %u workers\n", Workers);
+    }
+    Wall = HostTest_NowNs() - Wall;
+
+    /* Replay runs every sample twice, once timed alone and once scored */
+    double Updates = 0.0;
+    double Samples = 0.0;
+    double Elapsed = 0.0;
+    unsigned int Steals = 0;
+    for (unsigned int i = 0; i < Runs; i++) {
+        Updates += 2.0 * Sweep.Results[i].Samples;
+        Samples += Sweep.Results[i].Samples;
+        Elapsed += Sweep.Results[i].ElapsedNs;
+    }
+    for (unsigned int i = 0; i < Workers; i++) {
+        Steals += Stats[i].Steals;
+    }
+    printf("%s%s: %u combinations x %u logs = %u runs on %u workers in %.2f s, %u steals\n",
+           AttitudeEstimator_GetName(Sweep.Base.Engine), Sweep.Base.UseMag ? "" : " (no magnetometer)", Sweep.Combinations,
+           Sweep.LogCount, Runs, Workers, Wall * 1e-9, Steals);
+    printf("throughput: %.3g sample-updates/s wall clock, %.3g per worker in the estimator alone\n",
+           (Wall > 0.0) ? Updates * 1e9 / Wall : 0.0, (Elapsed > 0.0) ? Samples * 1e9 / Elapsed : 0.0);
+    printf("ranked by %s, error after %.1f s, converged when tilt stays within %.2f deg\n", g_KeyNames[g_Key],
+           (double)Sweep.Base.SettleTime, (double)Sweep.Base.ConvergenceThreshold);
+    for (unsigned int i = 0; i < Sweep.Combinations; i++) {
+        Score(&Sweep, i, &Scores[i]);
+    }
+    qsort(Scores, Sweep.Combinations, sizeof(sSweepScore_t), CompareScores);
+    PrintScores(&Sweep, Scores, ((Rows == 0) || (Rows > Sweep.Combinations)) ? Sweep.Combinations : Rows);
+
+    for (unsigned int i = 0; i < Sweep.LogCount; i++) {
+        HostImuLog_Free(&Sweep.Logs[i].Log);
+        HostAttitudeTrack_Free(&Sweep.Logs[i].Reference);
+        free(Sweep.Logs[i].Path);
+    }
+    free(Sweep.Logs);
+    free(Sweep.Results);
+    free(Sweep.Ran);
+    free(Scores);
+    free(Stats);
+    return EXIT_SUCCESS;
+}
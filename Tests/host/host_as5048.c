@@ -0,0 +1,81 @@
+#include "host_as5048.h"
+
+#include <string.h>
+
+
+#define AS5048_REG_ERROR            0x0001
+#define AS5048_REG_ANGLE            0x3FFF
+#define AS5048_READ                 0x4000
+#define AS5048_ERROR_FLAG           0x4000
+#define AS5048_PARITY               0x8000
+#define AS5048_DATA_MASK            0x3FFF
+#define AS5048_ERROR_PARITY         0x0004
+#define AS5048_MAX_CLOCK_HZ         10000000
+
+
+/* Even parity over all 16 bits */
+uint16_t HostAs5048_AddParity (uint16_t Frame) {
+    uint16_t Bits = Frame & (uint16_t)~AS5048_PARITY;
+    unsigned int Ones = 0;
+    for (; Bits; Bits &= (uint16_t)(Bits - 1)) {
+        Ones++;
+    }
+    return (Ones & 1) ? (Frame | AS5048_PARITY) : (Frame & (uint16_t)~AS5048_PARITY);
+}
+
+void HostAs5048_Init (sHostAs5048_t *Chain, unsigned int Count) {
+    memset(Chain, 0, sizeof(*Chain));
+    Chain->Count = (Count <= HOST_AS5048_MAX_CHAIN) ? Count : HOST_AS5048_MAX_CHAIN;
+}
+
+/* Command takes effect when chip select is released, response is what the next transaction shifts out */
+static void HostAs5048_Execute (sHostAs5048Device_t *Device, uint16_t Command) {
+    uint16_t Data = 0;
+    Device->LastCommand = Command;
+    if (HostAs5048_AddParity(Command) != Command) {
+        Device->ErrorFlag = true;
+    } else if ((Command & AS5048_READ) && ((Command & AS5048_DATA_MASK) == AS5048_REG_ANGLE)) {
+        Data = Device->Angle & AS5048_DATA_MASK;
+    } else if ((Command & AS5048_READ) && ((Command & AS5048_DATA_MASK) == AS5048_REG_ERROR)) {
+        Data = Device->ErrorFlag ? AS5048_ERROR_PARITY : 0;
+        Device->ErrorFlag = false;
+    }
+    Device->Response = HostAs5048_AddParity((uint16_t)(Data | (Device->ErrorFlag ? AS5048_ERROR_FLAG : 0)));
+    if (Device->CorruptNextResponse) {
+        Device->Response ^= 0x0001;
+        Device->CorruptNextResponse = false;
+    }
+}
+
+static void HostAs5048_Select (void *Context, bool Selected) {
+    sHostAs5048_t *Chain = Context;
+    if (Selected) {
+        Chain->Position = 0;
+        Chain->Transactions++;
+    } else if (Chain->Position == Chain->Count) {
+        for (unsigned int p = 0; p < Chain->Count; p++) {
+            HostAs5048_Execute(&Chain->Device[Chain->Count - 1 - p], Chain->Shift[p]);
+        }
+    } else if (Chain->Position) {
+        Chain->LengthErrors++;
+    }
+}
+
+static uint16_t HostAs5048_Exchange (void *Context, uint16_t Mosi, const sHostSpiFormat_t *Format) {
+    sHostAs5048_t *Chain = Context;
+    uint16_t Miso = 0;
+    if ((Format->Bits != 16) || Format->Cpol || !Format->Cpha || (Format->ClockHz > AS5048_MAX_CLOCK_HZ)) {
+        Chain->FormatErrors++;
+    }
+    if (Chain->Position < Chain->Count) {
+        Miso = Chain->Device[Chain->Count - 1 - Chain->Position].Response;
+        Chain->Shift[Chain->Position] = Mosi;
+    }
+    Chain->Position++;
+    return Miso;
+}
+
+bool HostAs5048_Attach (sHostAs5048_t *Chain, SPI_TypeDef *Spi, GPIO_TypeDef *CsPort, uint16_t CsPin) {
+    const sHostSpiSlave_t Slave = { Spi, CsPort, CsPin, HostAs5048_Select, HostAs5048_Exchange, Chain };
+    return HostSpi_Attach(&Slave);
+}
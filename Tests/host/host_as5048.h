@@ -0,0 +1,35 @@
+#ifndef _HOST_AS5048_
+#define _HOST_AS5048_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "host_spi.h"
+
+
+#define HOST_AS5048_MAX_CHAIN       4
+
+/* AS5048A daisy chain on one chip select: 16-bit frames, each device answers a command in the next transaction.
+ * Device 0 takes MOSI, the last device drives MISO, so buffer position p talks to device Count - 1 - p. */
+typedef struct {
+    uint16_t Angle;                     // 14 bit, what the next angle read latches
+    bool ErrorFlag;                     // set by a bad command, cleared by reading the error register
+    bool CorruptNextResponse;           // flip one bit of the next response, parity then fails
+    uint16_t Response;                  // output register, shifted out in the next transaction
+    uint16_t LastCommand;
+} sHostAs5048Device_t;
+
+typedef struct {
+    sHostAs5048Device_t Device[HOST_AS5048_MAX_CHAIN];
+    unsigned int Count;
+    uint16_t Shift[HOST_AS5048_MAX_CHAIN];
+    unsigned int Position;
+    uint32_t Transactions;
+    uint32_t FormatErrors;              // not 16-bit mode 1 at 10 MHz or less
+    uint32_t LengthErrors;              // transaction was not one frame per device
+} sHostAs5048_t;
+
+void            HostAs5048_Init             (sHostAs5048_t *Chain, unsigned int Count);
+bool            HostAs5048_Attach           (sHostAs5048_t *Chain, SPI_TypeDef *Spi, GPIO_TypeDef *CsPort, uint16_t CsPin);
+uint16_t        HostAs5048_AddParity        (uint16_t Frame);
+
+#endif /* _HOST_AS5048_ */
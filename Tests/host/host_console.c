@@ -0,0 +1,28 @@
+#include "host_console.h"
+
+#include <stdint.h>
+#include "uart_api.h"
+#include "buffer_api.h"
+#include "message_queue_api.h"
+
+
+/* Output is written whole by PrintToUart, there is nothing to lock */
+void InitializeUartMutexes (void) {
+}
+
+bool ReceiveMessageFromUart (eUart_t InputUart, char *OutputBuffer, unsigned int MaxLength) {
+    return (InputUart == eUart_1) && ReceiveMessageFromQueue(eQueue_Uart1, OutputBuffer, MaxLength);
+}
+
+/* Same steps as HandleUartRxIRQ, one interrupt per byte */
+bool HostConsole_Type (const char *Line) {
+    bool RetVal = true;
+    for (const char *Byte = Line; RetVal && (*Byte != '\0'); Byte++) {
+        uint8_t CurrentWriteIndex = BufferWriteIndex_Get(eBuffer_Uart1Rx);
+        RetVal = WriteByteToBuffer(eBuffer_Uart1Rx, *Byte);
+        if (RetVal && (*Byte == '\r')) {
+            RetVal = SendMessageToQueueFromISR(eQueue_Uart1, eBuffer_Uart1Rx, CurrentWriteIndex);
+        }
+    }
+    return RetVal;
+}
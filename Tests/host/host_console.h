@@ -0,0 +1,11 @@
+#ifndef _HOST_CONSOLE_
+#define _HOST_CONSOLE_
+
+#include <stdbool.h>
+
+
+/* Receive side of the UART1 console as uart_api.c has it: bytes go into the RX buffer and a line ending in \r is
+ * queued for ReceiveMessageFromUart. Transmit is PrintToUart in host_hal.c. */
+bool            HostConsole_Type            (const char *Line);
+
+#endif /* _HOST_CONSOLE_ */
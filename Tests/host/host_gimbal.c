@@ -0,0 +1,94 @@
+#include "host_gimbal.h"
+
+#include <math.h>
+#include <string.h>
+
+
+#define HOST_GIMBAL_SUBSTEPS        16
+#define RAD_TO_DEG                  (180.0 / M_PI)
+
+
+/* Q = Q * exp(Rate * Dt / 2) */
+static void HostGimbal_Rotate (double Q[4], const double Rate[3], double Dt) {
+    double Angle = sqrt(Rate[0] * Rate[0] + Rate[1] * Rate[1] + Rate[2] * Rate[2]) * Dt;
+    double C = cos(0.5 * Angle);
+    double S = (Angle > 0.0) ? sin(0.5 * Angle) / Angle * Dt : 0.0;
+    double D[4] = {C, Rate[0] * S, Rate[1] * S, Rate[2] * S};
+    double P[4] = {Q[0], Q[1], Q[2], Q[3]};
+    double Norm;
+    Q[0] = P[0] * D[0] - P[1] * D[1] - P[2] * D[2] - P[3] * D[3];
+    Q[1] = P[0] * D[1] + P[1] * D[0] + P[2] * D[3] - P[3] * D[2];
+    Q[2] = P[0] * D[2] - P[1] * D[3] + P[2] * D[0] + P[3] * D[1];
+    Q[3] = P[0] * D[3] + P[1] * D[2] - P[2] * D[1] + P[3] * D[0];
+    Norm = sqrt(Q[0] * Q[0] + Q[1] * Q[1] + Q[2] * Q[2] + Q[3] * Q[3]);
+    for (unsigned int i = 0; i < 4; i++) {
+        Q[i] /= Norm;
+    }
+}
+
+/* Q^-1 * Setpoint on the short way round */
+static void HostGimbal_Difference (const sHostGimbal_t *Gimbal, const sQuaternion_t *Setpoint, double D[4]) {
+    const double *Q = Gimbal->Q;
+    const double S[4] = {Setpoint->W, Setpoint->X, Setpoint->Y, Setpoint->Z};
+    D[0] = Q[0] * S[0] + Q[1] * S[1] + Q[2] * S[2] + Q[3] * S[3];
+    D[1] = Q[0] * S[1] - Q[1] * S[0] - Q[2] * S[3] + Q[3] * S[2];
+    D[2] = Q[0] * S[2] + Q[1] * S[3] - Q[2] * S[0] - Q[3] * S[1];
+    D[3] = Q[0] * S[3] - Q[1] * S[2] + Q[2] * S[1] - Q[3] * S[0];
+    if (D[0] < 0.0) {
+        for (unsigned int i = 0; i < 4; i++) {
+            D[i] = -D[i];
+        }
+    }
+}
+
+/* 2804 class motor under FOC at its 0.5 A limit: 1.5 * 0.25 V s/rad * 0.5 A, see foc_api.c; camera and arm inertia */
+void HostGimbal_Init (sHostGimbal_t *Gimbal) {
+    memset(Gimbal, 0, sizeof(sHostGimbal_t));
+    Gimbal->Dt = 0.001f;
+    Gimbal->Inertia = 2.0e-4f;
+    Gimbal->TorquePerCommand = 0.1875f;
+    Gimbal->Damping = 0.002f;
+    Gimbal->DelayPeriods = 1;
+    Gimbal->Q[0] = 1.0;
+}
+
+void HostGimbal_Step (sHostGimbal_t *Gimbal, const sData3D_t *Command) {
+    const unsigned int Delay = (Gimbal->DelayPeriods > HOST_GIMBAL_MAX_DELAY) ? HOST_GIMBAL_MAX_DELAY : Gimbal->DelayPeriods;
+    const double Step = (double)Gimbal->Dt / HOST_GIMBAL_SUBSTEPS;
+    float Applied[3];
+    Gimbal->Pending[Delay][0] = Command->X;
+    Gimbal->Pending[Delay][1] = Command->Y;
+    Gimbal->Pending[Delay][2] = Command->Z;
+    memcpy(Applied, Gimbal->Pending[0], sizeof(Applied));
+    for (unsigned int i = 0; i < Delay; i++) {
+        memcpy(Gimbal->Pending[i], Gimbal->Pending[i + 1], sizeof(Applied));
+    }
+    for (unsigned int s = 0; s < HOST_GIMBAL_SUBSTEPS; s++) {
+        for (unsigned int i = 0; i < 3; i++) {
+            double Torque = (double)Applied[i] * Gimbal->TorquePerCommand + Gimbal->Disturbance[i] - Gimbal->Damping * Gimbal->Rate[i];
+            Gimbal->Rate[i] += Torque / Gimbal->Inertia * Step;
+        }
+        HostGimbal_Rotate(Gimbal->Q, Gimbal->Rate, Step);
+    }
+    Gimbal->Time += Gimbal->Dt;
+}
+
+void HostGimbal_GetAttitude (const sHostGimbal_t *Gimbal, sQuaternion_t *Attitude) {
+    *Attitude = (sQuaternion_t) {(float)Gimbal->Q[0], (float)Gimbal->Q[1], (float)Gimbal->Q[2], (float)Gimbal->Q[3]};
+}
+
+void HostGimbal_GetRate (const sHostGimbal_t *Gimbal, sData3D_t *Rate) {
+    *Rate = (sData3D_t) {(float)Gimbal->Rate[0], (float)Gimbal->Rate[1], (float)Gimbal->Rate[2]};
+}
+
+float HostGimbal_AngleError (const sHostGimbal_t *Gimbal, const sQuaternion_t *Setpoint) {
+    double D[4];
+    HostGimbal_Difference(Gimbal, Setpoint, D);
+    return (float)(2.0 * atan2(sqrt(D[1] * D[1] + D[2] * D[2] + D[3] * D[3]), D[0]) * RAD_TO_DEG);
+}
+
+float HostGimbal_AxisError (const sHostGimbal_t *Gimbal, const sQuaternion_t *Setpoint, unsigned int Axis) {
+    double D[4];
+    HostGimbal_Difference(Gimbal, Setpoint, D);
+    return (float)(2.0 * atan2(D[1 + Axis], D[0]) * RAD_TO_DEG);
+}
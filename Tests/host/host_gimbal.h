@@ -0,0 +1,41 @@
+#ifndef _HOST_GIMBAL_
+#define _HOST_GIMBAL_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpu9250_api.h"
+#include "attitude_estimator_api.h"
+
+
+#define HOST_GIMBAL_MAX_DELAY       4
+
+/* Camera on a direct drive gimbal as the attitude controller sees it: a rigid body with the same inertia about every
+ * axis (so the axes do not couple), a torque per unit of controller output on each sensor axis, bearing drag and an
+ * external torque. Output of one control period acts for the whole of a later period (zero order hold). Truth is kept
+ * in double precision; frames as in host_imu_stream. */
+typedef struct {
+    /* Profile, set by HostGimbal_Init and free to change before the first step */
+    float Dt;                           // s, control period
+    float Inertia;                      // kg m^2
+    float TorquePerCommand;             // Nm for an output of 1
+    float Damping;                      // Nm s/rad
+    unsigned int DelayPeriods;          // periods between computing an output and it acting, up to HOST_GIMBAL_MAX_DELAY
+    float Disturbance[3];               // Nm, external torque in sensor frame, may change between steps
+    /* State */
+    double Q[4];                        // W, X, Y, Z; sensor frame relative to earth frame
+    double Rate[3];                     // rad/s, sensor frame
+    double Time;
+    float Pending[HOST_GIMBAL_MAX_DELAY + 1][3];
+} sHostGimbal_t;
+
+void            HostGimbal_Init             (sHostGimbal_t *Gimbal);
+/* Takes this period's controller output and advances truth by Dt under the output due now */
+void            HostGimbal_Step             (sHostGimbal_t *Gimbal, const sData3D_t *Command);
+void            HostGimbal_GetAttitude      (const sHostGimbal_t *Gimbal, sQuaternion_t *Attitude);
+/* rad/s, what an ideal bias free gyro reads */
+void            HostGimbal_GetRate          (const sHostGimbal_t *Gimbal, sData3D_t *Rate);
+/* Degrees, rotation from the attitude to Setpoint, signed about one sensor axis when that is all there is */
+float           HostGimbal_AngleError       (const sHostGimbal_t *Gimbal, const sQuaternion_t *Setpoint);
+float           HostGimbal_AxisError        (const sHostGimbal_t *Gimbal, const sQuaternion_t *Setpoint, unsigned int Axis);
+
+#endif /* _HOST_GIMBAL_ */
@@ -0,0 +1,180 @@
+#include "host_hal.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "uart_api.h"
+#include "host_test.h"
+
+
+#define HOST_CAPTURE_SIZE           (4 * 1024 * 1024)
+#define HOST_TEST_STACK_SIZE        (8 * 1024 * 1024)
+
+uint32_t SystemCoreClock = 72000000;
+GPIO_TypeDef HostGpio[3];
+SPI_TypeDef HostSpi[3];
+DMA_TypeDef HostDma[1];
+TIM_TypeDef HostTim[3];
+DWT_Type HostDwt;
+CoreDebug_Type HostCoreDebug;
+
+static HostHal_GpioHook_t g_GpioHook;
+static bool g_Quiet;
+static char *g_Capture;
+static size_t g_CaptureLength;
+static unsigned int g_Checks;
+static unsigned int g_Failures;
+
+
+void HostHal_AdvanceCycles (uint32_t Cycles) {
+    HostDwt.CYCCNT += Cycles;
+}
+
+void HostHal_SetGpioHook (HostHal_GpioHook_t Hook) {
+    g_GpioHook = Hook;
+}
+
+void HostHal_SetQuiet (bool Quiet) {
+    g_Quiet = Quiet;
+}
+
+void HostHal_CaptureStart (void) {
+    if (g_Capture == NULL) {
+        g_Capture = malloc(HOST_CAPTURE_SIZE);
+    }
+    g_CaptureLength = 0;
+    g_Capture[0] = '\0';
+}
+
+const char *HostHal_CaptureGet (void) {
+    return (g_Capture != NULL) ? g_Capture : "";
+}
+
+void HostHal_CaptureStop (void) {
+    free(g_Capture);
+    g_Capture = NULL;
+    g_CaptureLength = 0;
+}
+
+void HAL_GPIO_Init (GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+    (void)GPIOx;
+    (void)GPIO_Init;
+}
+
+void HAL_GPIO_WritePin (GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    if (PinState == GPIO_PIN_SET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+    if (g_GpioHook != NULL) {
+        g_GpioHook(GPIOx, GPIO_Pin, PinState);
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin (GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void Error_Handler (void) {
+    fprintf(stderr, "Error_Handler called\n");
+    abort();
+}
+
+/* Stands in for the UART driver, whole message is written at once */
+bool PrintToUart (eUart_t OutputUart, char *Format, ...) {
+    char Line[1024];
+    va_list Arguments;
+    (void)OutputUart;
+    va_start(Arguments, Format);
+    int Length = vsnprintf(Line, sizeof(Line), Format, Arguments);
+    va_end(Arguments);
+    if (Length < 0) {
+        return false;
+    }
+    if ((size_t)Length >= sizeof(Line)) {
+        Length = sizeof(Line) - 1;
+    }
+    for (int i = 0; i < Length; i++) {
+        if (Line[i] == '\r') {
+            Line[i] = '\n';
+        }
+    }
+    if ((g_Capture != NULL) && ((g_CaptureLength + (size_t)Length) < HOST_CAPTURE_SIZE)) {
+        memcpy(&g_Capture[g_CaptureLength], Line, (size_t)Length + 1);
+        g_CaptureLength += (size_t)Length;
+    }
+    if (!g_Quiet) {
+        fputs(Line, stdout);
+    }
+    return true;
+}
+
+bool HostTest_Check (bool Condition, const char *Text, const char *File, int Line) {
+    g_Checks++;
+    if (!Condition) {
+        g_Failures++;
+        fprintf(stderr, "%s:%d: check failed: %s\n", File, Line, Text);
+    }
+    return Condition;
+}
+
+bool HostTest_CheckNear (double Value, double Expected, double Tolerance, const char *Text, const char *File, int Line) {
+    bool Condition = (fabs(Value - Expected) <= Tolerance);
+    g_Checks++;
+    if (!Condition) {
+        g_Failures++;
+        fprintf(stderr, "%s:%d: check failed: %s = %g, expected %g +- %g\n", File, Line, Text, Value, Expected, Tolerance);
+    }
+    return Condition;
+}
+
+int HostTest_Result (const char *Name) {
+    printf("%s: %u checks, %u failed\n", Name, g_Checks, g_Failures);
+    return (g_Failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+double HostTest_NowNs (void) {
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (double)Now.tv_sec * 1e9 + (double)Now.tv_nsec;
+}
+
+typedef struct {
+    int argc;
+    char **argv;
+    int Result;
+} sHostTestArgs_t;
+
+static void *HostTest_Thread (void *Argument) {
+    sHostTestArgs_t *Args = Argument;
+    Args->Result = TestMain(Args->argc, Args->argv);
+    return NULL;
+}
+
+/* Drivers hand buffer addresses to DMA as uint32_t, test code runs on a stack mapped below 4 GB (globals are
+ * there too, the tests are linked without PIE) so the round trip through the register is lossless */
+int main (int argc, char **argv) {
+    sHostTestArgs_t Args = {argc, argv, EXIT_FAILURE};
+    pthread_attr_t Attributes;
+    pthread_t Thread;
+    void *Stack = mmap(NULL, HOST_TEST_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (Stack == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    pthread_attr_init(&Attributes);
+    pthread_attr_setstack(&Attributes, Stack, HOST_TEST_STACK_SIZE);
+    if (pthread_create(&Thread, &Attributes, HostTest_Thread, &Args) != 0) {
+        perror("pthread_create");
+        return EXIT_FAILURE;
+    }
+    pthread_join(Thread, NULL);
+    return Args.Result;
+}
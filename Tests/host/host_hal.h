@@ -0,0 +1,20 @@
+#ifndef _HOST_HAL_
+#define _HOST_HAL_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+typedef void (*HostHal_GpioHook_t) (GPIO_TypeDef *Port, uint16_t Pin, GPIO_PinState State);
+
+/* DWT->CYCCNT only moves when a model says time has passed */
+void            HostHal_AdvanceCycles       (uint32_t Cycles);
+void            HostHal_SetGpioHook         (HostHal_GpioHook_t Hook);
+/* UART output goes to stdout with \r turned into \n; capture keeps a copy for the test to parse */
+void            HostHal_SetQuiet            (bool Quiet);
+void            HostHal_CaptureStart        (void);
+const char     *HostHal_CaptureGet          (void);
+void            HostHal_CaptureStop         (void);
+
+#endif /* _HOST_HAL_ */
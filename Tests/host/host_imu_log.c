@@ -0,0 +1,231 @@
+#include "host_imu_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define HOST_IMU_LOG_LINE           256
+#define HOST_IMU_LOG_MAGIC          "IMUB"
+#define HOST_IMU_LOG_VERSION        1
+#define HOST_IMU_LOG_RECORD_WORDS   11  // timestamp, 9 floats, mag fresh
+
+
+static bool HostImuLog_Grow (void **Array, unsigned int *Capacity, unsigned int Count, size_t Size, void **Second, size_t SecondSize) {
+    if (Count < *Capacity) {
+        return true;
+    }
+    unsigned int NewCapacity = (*Capacity != 0) ? 2 * *Capacity : 4096;
+    void *NewArray = realloc(*Array, (size_t)NewCapacity * Size);
+    if (NewArray == NULL) {
+        return false;
+    }
+    *Array = NewArray;
+    void *NewSecond = realloc(*Second, (size_t)NewCapacity * SecondSize);
+    if (NewSecond == NULL) {
+        return false;
+    }
+    *Second = NewSecond;
+    *Capacity = NewCapacity;
+    return true;
+}
+
+/* Unwraps a 32 bit cycle count against the previous unwrapped value */
+static uint64_t HostImuLog_Unwrap (bool First, uint64_t Previous, uint32_t Timestamp) {
+    return First ? Timestamp : Previous + (uint32_t)(Timestamp - (uint32_t)Previous);
+}
+
+/* Reads one line ended by \r, \n or both; false at end of file */
+static bool HostImuLog_ReadLine (FILE *File, char *Line, size_t Size) {
+    size_t Length = 0;
+    int Character;
+    while ((Character = fgetc(File)) != EOF) {
+        if ((Character == '\r') || (Character == '\n')) {
+            if (Length != 0) {
+                break;
+            }
+            continue;
+        }
+        if (Length + 1 < Size) {
+            Line[Length++] = (char)Character;
+        }
+    }
+    Line[Length] = '\0';
+    return (Length != 0) || (Character != EOF);
+}
+
+static uint32_t HostImuLog_ParseClock (const char *Line) {
+    const char *Clock = strstr(Line, "clock=");
+    return (Clock != NULL) ? (uint32_t)strtoul(Clock + 6, NULL, 10) : 0;
+}
+
+void HostImuLog_Init (sHostImuLog_t *Log, uint32_t Clock) {
+    memset(Log, 0, sizeof(sHostImuLog_t));
+    Log->Clock = Clock;
+}
+
+bool HostImuLog_Append (sHostImuLog_t *Log, const sImuData_t *Sample) {
+    if (!HostImuLog_Grow((void **)&Log->Samples, &Log->Capacity, Log->Count, sizeof(sImuData_t), (void **)&Log->Cycles, sizeof(uint64_t))) {
+        return false;
+    }
+    Log->Cycles[Log->Count] = HostImuLog_Unwrap(Log->Count == 0, (Log->Count != 0) ? Log->Cycles[Log->Count - 1] : 0, Sample->Timestamp);
+    Log->Samples[Log->Count++] = *Sample;
+    return true;
+}
+
+bool HostImuLog_ParseCsv (sHostImuLog_t *Log, FILE *File) {
+    char Line[HOST_IMU_LOG_LINE];
+    bool RetVal = true;
+    while (RetVal && HostImuLog_ReadLine(File, Line, sizeof(Line))) {
+        if (strncmp(Line, "IMUCSV,", 7) == 0) {
+            Log->Clock = HostImuLog_ParseClock(Line);
+        } else if (strncmp(Line, "IMU,", 4) == 0) {
+            sImuData_t Sample;
+            unsigned int Timestamp;
+            unsigned int MagFresh;
+            if (sscanf(Line, "IMU,%u,%f,%f,%f,%f,%f,%f,%f,%f,%f,%u", &Timestamp, &Sample.A.X, &Sample.A.Y, &Sample.A.Z,
+                       &Sample.G.X, &Sample.G.Y, &Sample.G.Z, &Sample.M.X, &Sample.M.Y, &Sample.M.Z, &MagFresh) == 11) {
+                Sample.Timestamp = Timestamp;
+                Sample.MagFresh = (MagFresh != 0);
+                RetVal = HostImuLog_Append(Log, &Sample);
+            } else {
+                Log->SkippedLines++;
+            }
+        }
+    }
+    return RetVal && (Log->Clock != 0);
+}
+
+bool HostImuLog_ReadBinary (sHostImuLog_t *Log, FILE *File) {
+    char Magic[4];
+    uint32_t Header[3];
+    uint32_t Record[HOST_IMU_LOG_RECORD_WORDS];
+    if ((fread(Magic, 1, sizeof(Magic), File) != sizeof(Magic)) || (memcmp(Magic, HOST_IMU_LOG_MAGIC, sizeof(Magic)) != 0) ||
+        (fread(Header, sizeof(uint32_t), 3, File) != 3) || (Header[0] != HOST_IMU_LOG_VERSION)) {
+        return false;
+    }
+    Log->Clock = Header[1];
+    for (uint32_t i = 0; i < Header[2]; i++) {
+        sImuData_t Sample;
+        float Values[9];
+        if (fread(Record, sizeof(uint32_t), HOST_IMU_LOG_RECORD_WORDS, File) != HOST_IMU_LOG_RECORD_WORDS) {
+            return false;
+        }
+        memcpy(Values, &Record[1], sizeof(Values));
+        Sample.Timestamp = Record[0];
+        Sample.A = (sData3D_t) {Values[0], Values[1], Values[2]};
+        Sample.G = (sData3D_t) {Values[3], Values[4], Values[5]};
+        Sample.M = (sData3D_t) {Values[6], Values[7], Values[8]};
+        Sample.MagFresh = (Record[10] != 0);
+        if (!HostImuLog_Append(Log, &Sample)) {
+            return false;
+        }
+    }
+    return Log->Clock != 0;
+}
+
+bool HostImuLog_WriteBinary (const sHostImuLog_t *Log, FILE *File) {
+    const uint32_t Header[3] = {HOST_IMU_LOG_VERSION, Log->Clock, Log->Count};
+    bool RetVal = (fwrite(HOST_IMU_LOG_MAGIC, 1, 4, File) == 4) && (fwrite(Header, sizeof(uint32_t), 3, File) == 3);
+    for (unsigned int i = 0; RetVal && (i < Log->Count); i++) {
+        const sImuData_t *Sample = &Log->Samples[i];
+        const float Values[9] = {Sample->A.X, Sample->A.Y, Sample->A.Z, Sample->G.X, Sample->G.Y, Sample->G.Z, Sample->M.X, Sample->M.Y, Sample->M.Z};
+        uint32_t Record[HOST_IMU_LOG_RECORD_WORDS];
+        Record[0] = Sample->Timestamp;
+        memcpy(&Record[1], Values, sizeof(Values));
+        Record[10] = Sample->MagFresh ? 1 : 0;
+        RetVal = (fwrite(Record, sizeof(uint32_t), HOST_IMU_LOG_RECORD_WORDS, File) == HOST_IMU_LOG_RECORD_WORDS);
+    }
+    return RetVal;
+}
+
+bool HostImuLog_Load (sHostImuLog_t *Log, const char *Path) {
+    char Magic[4] = {0};
+    bool RetVal = false;
+    FILE *File = fopen(Path, "rb");
+    HostImuLog_Init(Log, 0);
+    if (File != NULL) {
+        size_t Length = fread(Magic, 1, sizeof(Magic), File);
+        rewind(File);
+        if ((Length == sizeof(Magic)) && (memcmp(Magic, HOST_IMU_LOG_MAGIC, sizeof(Magic)) == 0)) {
+            RetVal = HostImuLog_ReadBinary(Log, File);
+        } else {
+            RetVal = HostImuLog_ParseCsv(Log, File);
+        }
+        fclose(File);
+    }
+    return RetVal;
+}
+
+void HostImuLog_Free (sHostImuLog_t *Log) {
+    free(Log->Samples);
+    free(Log->Cycles);
+    HostImuLog_Init(Log, 0);
+}
+
+void HostAttitudeTrack_Init (sHostAttitudeTrack_t *Track, uint32_t Clock) {
+    memset(Track, 0, sizeof(sHostAttitudeTrack_t));
+    Track->Clock = Clock;
+}
+
+bool HostAttitudeTrack_Append (sHostAttitudeTrack_t *Track, uint64_t Cycles, const float Q[4]) {
+    if (!HostImuLog_Grow((void **)&Track->Q, &Track->Capacity, Track->Count, sizeof(Track->Q[0]), (void **)&Track->Cycles, sizeof(uint64_t))) {
+        return false;
+    }
+    Track->Cycles[Track->Count] = Cycles;
+    memcpy(Track->Q[Track->Count++], Q, sizeof(Track->Q[0]));
+    return true;
+}
+
+bool HostAttitudeTrack_ParseCsv (sHostAttitudeTrack_t *Track, FILE *File) {
+    char Line[HOST_IMU_LOG_LINE];
+    bool RetVal = true;
+    while (RetVal && HostImuLog_ReadLine(File, Line, sizeof(Line))) {
+        unsigned int Timestamp;
+        float Q[4];
+        if (strncmp(Line, "ATTCSV,", 7) == 0) {
+            Track->Clock = HostImuLog_ParseClock(Line);
+        } else if (sscanf(Line, "ATT,%u,%f,%f,%f,%f", &Timestamp, &Q[0], &Q[1], &Q[2], &Q[3]) == 5) {
+            uint64_t Previous = (Track->Count != 0) ? Track->Cycles[Track->Count - 1] : 0;
+            RetVal = HostAttitudeTrack_Append(Track, HostImuLog_Unwrap(Track->Count == 0, Previous, Timestamp), Q);
+        }
+    }
+    return RetVal && (Track->Clock != 0);
+}
+
+bool HostAttitudeTrack_WriteCsv (const sHostAttitudeTrack_t *Track, FILE *File) {
+    bool RetVal = fprintf(File, "ATTCSV,clock=%u,t,q0,q1,q2,q3\n", (unsigned int)Track->Clock) > 0;
+    for (unsigned int i = 0; RetVal && (i < Track->Count); i++) {
+        RetVal = fprintf(File, "ATT,%u,%.7f,%.7f,%.7f,%.7f\n", (unsigned int)(uint32_t)Track->Cycles[i],
+                         (double)Track->Q[i][0], (double)Track->Q[i][1], (double)Track->Q[i][2], (double)Track->Q[i][3]) > 0;
+    }
+    return RetVal;
+}
+
+bool HostAttitudeTrack_Load (sHostAttitudeTrack_t *Track, const char *Path) {
+    bool RetVal = false;
+    FILE *File = fopen(Path, "r");
+    HostAttitudeTrack_Init(Track, 0);
+    if (File != NULL) {
+        RetVal = HostAttitudeTrack_ParseCsv(Track, File);
+        fclose(File);
+    }
+    return RetVal;
+}
+
+int HostAttitudeTrack_Find (const sHostAttitudeTrack_t *Track, uint64_t Cycles, unsigned int Hint) {
+    for (unsigned int i = Hint; i < Track->Count; i++) {
+        if (Track->Cycles[i] == Cycles) {
+            return (int)i;
+        }
+        if (Track->Cycles[i] > Cycles) {
+            break;
+        }
+    }
+    return -1;
+}
+
+void HostAttitudeTrack_Free (sHostAttitudeTrack_t *Track) {
+    free(Track->Cycles);
+    free(Track->Q);
+    HostAttitudeTrack_Init(Track, 0);
+}
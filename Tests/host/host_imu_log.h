@@ -0,0 +1,52 @@
+#ifndef _HOST_IMU_LOG_
+#define _HOST_IMU_LOG_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "mpu9250_api.h"
+
+
+/* IMU log as streamed by Mpu_PrintCsvHeader / Mpu_PrintCsv: "IMUCSV,clock=<Hz>,..." then one "IMU,<cycles>,ax,...,magfresh"
+ * line per sample, \r or \n terminated, anything else on the UART in between is skipped. The binary form is the same
+ * samples packed little endian for fast reloads: "IMUB", version, clock, count, then per sample the timestamp,
+ * nine floats and the mag fresh flag as uint32. Timestamps are DWT cycles and wrap every 2^32 cycles (~60 s at
+ * 72 MHz), Cycles holds them unwrapped from the first sample. */
+typedef struct {
+    uint32_t Clock;                     // Hz, DWT cycles per second
+    unsigned int Count;
+    unsigned int Capacity;
+    sImuData_t *Samples;
+    uint64_t *Cycles;
+    unsigned int SkippedLines;          // lines starting with "IMU," that did not parse
+} sHostImuLog_t;
+
+/* Attitude per sample, "ATTCSV,clock=<Hz>,t,q0,q1,q2,q3" then "ATT,<cycles>,q0,q1,q2,q3"; replay writes it and reads it
+ * back as reference track, so a run can be compared against a simulator's truth or an earlier run */
+typedef struct {
+    uint32_t Clock;
+    unsigned int Count;
+    unsigned int Capacity;
+    uint64_t *Cycles;
+    float (*Q)[4];
+} sHostAttitudeTrack_t;
+
+void            HostImuLog_Init             (sHostImuLog_t *Log, uint32_t Clock);
+bool            HostImuLog_Append           (sHostImuLog_t *Log, const sImuData_t *Sample);
+bool            HostImuLog_ParseCsv         (sHostImuLog_t *Log, FILE *File);
+bool            HostImuLog_ReadBinary       (sHostImuLog_t *Log, FILE *File);
+bool            HostImuLog_WriteBinary      (const sHostImuLog_t *Log, FILE *File);
+/* CSV or binary, picked from the first bytes */
+bool            HostImuLog_Load             (sHostImuLog_t *Log, const char *Path);
+void            HostImuLog_Free             (sHostImuLog_t *Log);
+
+void            HostAttitudeTrack_Init      (sHostAttitudeTrack_t *Track, uint32_t Clock);
+bool            HostAttitudeTrack_Append    (sHostAttitudeTrack_t *Track, uint64_t Cycles, const float Q[4]);
+bool            HostAttitudeTrack_ParseCsv  (sHostAttitudeTrack_t *Track, FILE *File);
+bool            HostAttitudeTrack_WriteCsv  (const sHostAttitudeTrack_t *Track, FILE *File);
+bool            HostAttitudeTrack_Load      (sHostAttitudeTrack_t *Track, const char *Path);
+/* Index of the entry at Cycles, searching forward from Hint; -1 if there is none */
+int             HostAttitudeTrack_Find      (const sHostAttitudeTrack_t *Track, uint64_t Cycles, unsigned int Hint);
+void            HostAttitudeTrack_Free      (sHostAttitudeTrack_t *Track);
+
+#endif /* _HOST_IMU_LOG_ */
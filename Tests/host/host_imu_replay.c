@@ -0,0 +1,95 @@
+#include "host_imu_replay.h"
+
+#include <math.h>
+#include <string.h>
+#include "host_imu_stream.h"
+#include "host_test.h"
+
+
+#define DEG_TO_RAD                  0.0174532925f
+
+
+void HostImuReplay_GetDefaultConfig (sHostImuReplayConfig_t *Config) {
+    memset(Config, 0, sizeof(sHostImuReplayConfig_t));
+    Config->Engine = eAttitudeEstimator_Mahony;
+    AttitudeEstimator_GetDefaultConfig(&Config->Config);
+    Config->UseMag = true;
+    Config->NominalDt = 0.001f;
+    Config->MaxDt = 0.01f;              // IMU_MAX_DT in freertos.c
+    Config->SettleTime = 5.0f;
+    Config->ConvergenceThreshold = 1.0f;
+}
+
+static void HostImuReplay_Feed (const sHostImuReplayConfig_t *Config, const sHostImuLog_t *Log, unsigned int Index, sAttitudeEstimator_t *Estimator) {
+    const sImuData_t *S = &Log->Samples[Index];
+    float Dt = (Index > 0) ? (float)((double)(Log->Cycles[Index] - Log->Cycles[Index - 1]) / Log->Clock) : 0.0f;
+    if ((Index == 0) || (Dt > Config->MaxDt)) {
+        Dt = Config->NominalDt;
+    }
+    sData3D_t Gyro = {S->G.X * DEG_TO_RAD, S->G.Y * DEG_TO_RAD, S->G.Z * DEG_TO_RAD};
+    AttitudeEstimator_Update(Estimator, &Gyro, &S->A, (Config->UseMag && S->MagFresh) ? &S->M : NULL, Dt);
+}
+
+/* Timed pass only feeds the estimator, so the figure is not diluted by scoring; scored pass repeats it sample by sample */
+bool HostImuReplay_Run (const sHostImuReplayConfig_t *Config, const sHostImuLog_t *Log, const sHostAttitudeTrack_t *Reference,
+                        sHostAttitudeTrack_t *Output, sHostImuReplayResult_t *Result) {
+    sAttitudeEstimator_t Estimator;
+    double AngleSq = 0.0;
+    double TiltSq = 0.0;
+    double Elapsed;
+    bool Above = true;
+    unsigned int Hint = 0;
+    memset(Result, 0, sizeof(sHostImuReplayResult_t));
+    Result->Finite = true;
+    if ((Log->Count == 0) || (Log->Clock == 0) || !AttitudeEstimator_InitWithConfig(&Estimator, Config->Engine, &Config->Config)) {
+        return false;
+    }
+    Elapsed = HostTest_NowNs();
+    for (unsigned int i = 0; i < Log->Count; i++) {
+        HostImuReplay_Feed(Config, Log, i, &Estimator);
+    }
+    Elapsed = HostTest_NowNs() - Elapsed;
+    AttitudeEstimator_InitWithConfig(&Estimator, Config->Engine, &Config->Config);
+    for (unsigned int i = 0; i < Log->Count; i++) {
+        const double Time = (double)(Log->Cycles[i] - Log->Cycles[0]) / Log->Clock;
+        HostImuReplay_Feed(Config, Log, i, &Estimator);
+        sQuaternion_t Q;
+        AttitudeEstimator_GetQuaternion(&Estimator, &Q);
+        const float Estimate[4] = {Q.W, Q.X, Q.Y, Q.Z};
+        Result->Finite = Result->Finite && isfinite(Q.W) && isfinite(Q.X) && isfinite(Q.Y) && isfinite(Q.Z);
+        if ((Output != NULL) && !HostAttitudeTrack_Append(Output, Log->Cycles[i], Estimate)) {
+            return false;
+        }
+        int Match = (Reference != NULL) ? HostAttitudeTrack_Find(Reference, Log->Cycles[i], Hint) : -1;
+        if (Match >= 0) {
+            Hint = (unsigned int)Match;
+            float Tilt = HostImuStream_TiltError(Reference->Q[Match], Estimate);
+            if (!(Tilt < Config->ConvergenceThreshold)) {
+                Above = true;
+            } else if (Above) {
+                Above = false;
+                Result->ConvergenceTime = (float)Time;
+            }
+            if (Time >= Config->SettleTime) {
+                float Angle = HostImuStream_AngleError(Reference->Q[Match], Estimate);
+                AngleSq += (double)Angle * Angle;
+                TiltSq += (double)Tilt * Tilt;
+                Result->AngleMax = fmaxf(Result->AngleMax, Angle);
+                Result->TiltMax = fmaxf(Result->TiltMax, Tilt);
+                Result->Compared++;
+            }
+        }
+    }
+    if (Above && (Reference != NULL)) {
+        Result->ConvergenceTime = -1.0f;
+    }
+    if (Result->Compared != 0) {
+        Result->AngleRms = (float)sqrt(AngleSq / Result->Compared);
+        Result->TiltRms = (float)sqrt(TiltSq / Result->Compared);
+    }
+    Result->Samples = Log->Count;
+    Result->LogSeconds = (double)(Log->Cycles[Log->Count - 1] - Log->Cycles[0]) / Log->Clock;
+    Result->ElapsedNs = Elapsed;
+    Result->UpdatesPerSecond = (Elapsed > 0.0) ? Log->Count * 1e9 / Elapsed : 0.0;
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef _HOST_IMU_REPLAY_
+#define _HOST_IMU_REPLAY_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "attitude_estimator_api.h"
+#include "host_imu_log.h"
+
+
+typedef struct {
+    eAttitudeEstimator_t Engine;
+    sAttitudeEstimatorConfig_t Config;
+    bool UseMag;                        // false feeds no magnetometer, as the FIFO path does
+    float NominalDt;                    // s, used for the first sample and after gaps longer than MaxDt
+    float MaxDt;
+    float SettleTime;                   // s from the start of the log before errors are accumulated
+    float ConvergenceThreshold;         // deg of tilt error
+} sHostImuReplayConfig_t;
+
+typedef struct {
+    unsigned int Samples;
+    double LogSeconds;                  // span of the log
+    double ElapsedNs;                   // host time spent in AttitudeEstimator_Update
+    double UpdatesPerSecond;
+    /* Against the reference, zero when there is none */
+    unsigned int Compared;              // samples after SettleTime with a reference entry
+    float AngleRms;                     // deg
+    float AngleMax;
+    float TiltRms;
+    float TiltMax;
+    float ConvergenceTime;              // s from the first sample until tilt error stays below threshold, -1 if it never does
+    bool Finite;
+} sHostImuReplayResult_t;
+
+void            HostImuReplay_GetDefaultConfig  (sHostImuReplayConfig_t *Config);
+/* Runs the log through one estimator the way StartDefaultTask does: gyro dps to rad/s, magnetometer only when fresh,
+ * dt from timestamps. Reference and Output may be NULL; Output receives the attitude after every sample. */
+bool            HostImuReplay_Run               (const sHostImuReplayConfig_t *Config, const sHostImuLog_t *Log,
+                                                 const sHostAttitudeTrack_t *Reference, sHostAttitudeTrack_t *Output,
+                                                 sHostImuReplayResult_t *Result);
+
+#endif /* _HOST_IMU_REPLAY_ */
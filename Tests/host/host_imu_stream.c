@@ -0,0 +1,173 @@
+#include "host_imu_stream.h"
+
+#include <math.h>
+#include <string.h>
+
+
+#define HOST_IMU_SUBSTEPS           16
+#define HOST_IMU_GRAVITY_MG         1000.0
+#define HOST_IMU_FIELD_UT           48.0
+#define HOST_IMU_INCLINATION        (-60.0 * M_PI / 180.0)  // field points down and north
+#define HOST_IMU_CLOCK_HZ           72.0e6
+#define RAD_TO_DEG                  (180.0 / M_PI)
+
+
+/* xorshift32, with Box-Muller on top for noise */
+static float HostImuStream_Uniform (sHostImuStream_t *Stream) {
+    uint32_t X = Stream->Random;
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+    Stream->Random = X;
+    return ((float)(X >> 8) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+static float HostImuStream_Gaussian (sHostImuStream_t *Stream) {
+    float U1 = HostImuStream_Uniform(Stream);
+    float U2 = HostImuStream_Uniform(Stream);
+    return sqrtf(-2.0f * logf(U1)) * cosf(6.2831853f * U2);
+}
+
+static void HostImuStream_Rate (const sHostImuStream_t *Stream, double Time, double Rate[3]) {
+    double Moving = Time - Stream->StillTime;
+    for (unsigned int i = 0; i < 3; i++) {
+        Rate[i] = (Moving > 0.0) ? Stream->RateAmplitude[i] * sin(2.0 * M_PI * Stream->RateFrequency[i] * Moving) : 0.0;
+    }
+}
+
+/* Q = Q * exp(Rate * Dt / 2) */
+static void HostImuStream_Rotate (double Q[4], const double Rate[3], double Dt) {
+    double Angle = sqrt(Rate[0] * Rate[0] + Rate[1] * Rate[1] + Rate[2] * Rate[2]) * Dt;
+    double C = cos(0.5 * Angle);
+    double S = (Angle > 0.0) ? sin(0.5 * Angle) / Angle * Dt : 0.0;
+    double D[4] = {C, Rate[0] * S, Rate[1] * S, Rate[2] * S};
+    double P[4] = {Q[0], Q[1], Q[2], Q[3]};
+    double Norm;
+    Q[0] = P[0] * D[0] - P[1] * D[1] - P[2] * D[2] - P[3] * D[3];
+    Q[1] = P[0] * D[1] + P[1] * D[0] + P[2] * D[3] - P[3] * D[2];
+    Q[2] = P[0] * D[2] - P[1] * D[3] + P[2] * D[0] + P[3] * D[1];
+    Q[3] = P[0] * D[3] + P[1] * D[2] - P[2] * D[1] + P[3] * D[0];
+    Norm = sqrt(Q[0] * Q[0] + Q[1] * Q[1] + Q[2] * Q[2] + Q[3] * Q[3]);
+    for (unsigned int i = 0; i < 4; i++) {
+        Q[i] /= Norm;
+    }
+}
+
+/* Earth vector seen in sensor frame, R(Q)^T * Earth */
+static void HostImuStream_ToSensor (const double Q[4], const double Earth[3], double Sensor[3]) {
+    double W = Q[0], X = Q[1], Y = Q[2], Z = Q[3];
+    Sensor[0] = (1.0 - 2.0 * (Y * Y + Z * Z)) * Earth[0] + 2.0 * (X * Y + W * Z) * Earth[1] + 2.0 * (X * Z - W * Y) * Earth[2];
+    Sensor[1] = 2.0 * (X * Y - W * Z) * Earth[0] + (1.0 - 2.0 * (X * X + Z * Z)) * Earth[1] + 2.0 * (Y * Z + W * X) * Earth[2];
+    Sensor[2] = 2.0 * (X * Z + W * Y) * Earth[0] + 2.0 * (Y * Z - W * X) * Earth[1] + (1.0 - 2.0 * (X * X + Y * Y)) * Earth[2];
+}
+
+void HostImuStream_Init (sHostImuStream_t *Stream) {
+    memset(Stream, 0, sizeof(sHostImuStream_t));
+    Stream->Dt = 0.001f;
+    Stream->MagDecimation = 10;
+    Stream->StillTime = 0.5f;
+    Stream->RateAmplitude[0] = 0.8f;
+    Stream->RateAmplitude[1] = 0.6f;
+    Stream->RateAmplitude[2] = 0.5f;
+    Stream->RateFrequency[0] = 0.31f;
+    Stream->RateFrequency[1] = 0.47f;
+    Stream->RateFrequency[2] = 0.23f;
+    Stream->InitialEuler[0] = 0.17f;
+    Stream->InitialEuler[1] = -0.09f;
+    Stream->InitialEuler[2] = 0.52f;
+    Stream->GyroBias[0] = 0.3f;
+    Stream->GyroBias[1] = -0.2f;
+    Stream->GyroBias[2] = 0.25f;
+    Stream->GyroNoise = 0.1f;
+    Stream->AccNoise = 8.0f;
+    Stream->MagNoise = 0.6f;
+    Stream->Vibration = 20.0f;
+    Stream->VibrationFrequency = 83.0f;
+    Stream->Seed = 0x2545F491u;
+}
+
+void HostImuStream_Next (sHostImuStream_t *Stream, sImuData_t *Sample) {
+    const double Gravity[3] = {0.0, 0.0, HOST_IMU_GRAVITY_MG};
+    const double Field[3] = {HOST_IMU_FIELD_UT * cos(HOST_IMU_INCLINATION), 0.0, HOST_IMU_FIELD_UT * sin(HOST_IMU_INCLINATION)};
+    double Rate[3];
+    double Acc[3];
+    double Mag[3];
+    if (!Stream->Started) {
+        double Cr = cos(0.5 * Stream->InitialEuler[0]), Sr = sin(0.5 * Stream->InitialEuler[0]);
+        double Cp = cos(0.5 * Stream->InitialEuler[1]), Sp = sin(0.5 * Stream->InitialEuler[1]);
+        double Cy = cos(0.5 * Stream->InitialEuler[2]), Sy = sin(0.5 * Stream->InitialEuler[2]);
+        Stream->Q[0] = Cr * Cp * Cy + Sr * Sp * Sy;
+        Stream->Q[1] = Sr * Cp * Cy - Cr * Sp * Sy;
+        Stream->Q[2] = Cr * Sp * Cy + Sr * Cp * Sy;
+        Stream->Q[3] = Cr * Cp * Sy - Sr * Sp * Cy;
+        Stream->Random = (Stream->Seed != 0) ? Stream->Seed : 1;
+        Stream->Started = true;
+    } else {
+        double Step = (double)Stream->Dt / HOST_IMU_SUBSTEPS;
+        for (unsigned int i = 0; i < HOST_IMU_SUBSTEPS; i++) {
+            HostImuStream_Rate(Stream, Stream->Time + (i + 0.5) * Step, Rate);
+            HostImuStream_Rotate(Stream->Q, Rate, Step);
+        }
+        Stream->Time += Stream->Dt;
+        Stream->Index++;
+    }
+    HostImuStream_Rate(Stream, Stream->Time, Rate);
+    HostImuStream_ToSensor(Stream->Q, Gravity, Acc);
+    HostImuStream_ToSensor(Stream->Q, Field, Mag);
+    double Shake = Stream->Vibration * sin(2.0 * M_PI * Stream->VibrationFrequency * Stream->Time);
+    Sample->A = (sData3D_t) {
+        (float)(Acc[0] + Shake) + Stream->AccNoise * HostImuStream_Gaussian(Stream),
+        (float)(Acc[1] + Shake) + Stream->AccNoise * HostImuStream_Gaussian(Stream),
+        (float)(Acc[2] + Shake) + Stream->AccNoise * HostImuStream_Gaussian(Stream)
+    };
+    Sample->G = (sData3D_t) {
+        (float)(Rate[0] * RAD_TO_DEG) + Stream->GyroBias[0] + Stream->GyroNoise * HostImuStream_Gaussian(Stream),
+        (float)(Rate[1] * RAD_TO_DEG) + Stream->GyroBias[1] + Stream->GyroNoise * HostImuStream_Gaussian(Stream),
+        (float)(Rate[2] * RAD_TO_DEG) + Stream->GyroBias[2] + Stream->GyroNoise * HostImuStream_Gaussian(Stream)
+    };
+    Sample->MagFresh = (Stream->MagDecimation != 0) && ((Stream->Index % Stream->MagDecimation) == 0);
+    if (Sample->MagFresh) {
+        Sample->M = (sData3D_t) {
+            (float)Mag[0] + Stream->MagNoise * HostImuStream_Gaussian(Stream),
+            (float)Mag[1] + Stream->MagNoise * HostImuStream_Gaussian(Stream),
+            (float)Mag[2] + Stream->MagNoise * HostImuStream_Gaussian(Stream)
+        };
+    }
+    Sample->Timestamp = (uint32_t)(uint64_t)llround(Stream->Time * HOST_IMU_CLOCK_HZ);
+}
+
+void HostImuStream_GetTruth (const sHostImuStream_t *Stream, float Q[4]) {
+    for (unsigned int i = 0; i < 4; i++) {
+        Q[i] = (float)Stream->Q[i];
+    }
+}
+
+float HostImuStream_AngleError (const float Truth[4], const float Estimate[4]) {
+    double Dot = fabs((double)Truth[0] * Estimate[0] + (double)Truth[1] * Estimate[1] + (double)Truth[2] * Estimate[2] + (double)Truth[3] * Estimate[3]);
+    double Norm = sqrt((double)Estimate[0] * Estimate[0] + (double)Estimate[1] * Estimate[1] + (double)Estimate[2] * Estimate[2] + (double)Estimate[3] * Estimate[3]);
+    if (!(Norm > 0.0)) {
+        return 180.0f;
+    }
+    Dot /= Norm;
+    return (float)(2.0 * acos((Dot < 1.0) ? Dot : 1.0) * RAD_TO_DEG);
+}
+
+float HostImuStream_TiltError (const float Truth[4], const float Estimate[4]) {
+    const double Up[3] = {0.0, 0.0, 1.0};
+    double T[4] = {Truth[0], Truth[1], Truth[2], Truth[3]};
+    double E[4] = {Estimate[0], Estimate[1], Estimate[2], Estimate[3]};
+    double A[3];
+    double B[3];
+    double Norm = sqrt(E[0] * E[0] + E[1] * E[1] + E[2] * E[2] + E[3] * E[3]);
+    if (!(Norm > 0.0)) {
+        return 180.0f;
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+        E[i] /= Norm;
+    }
+    HostImuStream_ToSensor(T, Up, A);
+    HostImuStream_ToSensor(E, Up, B);
+    double Dot = A[0] * B[0] + A[1] * B[1] + A[2] * B[2];
+    Dot = (Dot > 1.0) ? 1.0 : ((Dot < -1.0) ? -1.0 : Dot);
+    return (float)(acos(Dot) * RAD_TO_DEG);
+}
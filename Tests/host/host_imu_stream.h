@@ -0,0 +1,43 @@
+#ifndef _HOST_IMU_STREAM_
+#define _HOST_IMU_STREAM_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mpu9250_api.h"
+
+
+/* Synthetic recording of a handheld gimbal: still for StillTime, then each body rate is a sine of its own amplitude
+ * and frequency. Samples are in sImuData_t units (mg, dps, uT, DWT cycles) with truth kept in double precision, so
+ * every engine sees the same stream and is scored against the same attitude. Earth frame is NWU. */
+typedef struct {
+    /* Profile, set by HostImuStream_Init and free to change before the first sample */
+    float Dt;                           // s, sample period
+    unsigned int MagDecimation;         // magnetometer is fresh on every Nth sample
+    float StillTime;                    // s
+    float RateAmplitude[3];             // rad/s
+    float RateFrequency[3];             // Hz
+    float InitialEuler[3];              // rad, roll, pitch, yaw
+    float GyroBias[3];                  // dps
+    float GyroNoise;                    // dps, standard deviation
+    float AccNoise;                     // mg
+    float MagNoise;                     // uT
+    float Vibration;                    // mg, sinusoidal linear acceleration on all axes
+    float VibrationFrequency;           // Hz
+    uint32_t Seed;
+    /* State */
+    bool Started;
+    double Q[4];                        // truth, W, X, Y, Z; sensor frame relative to earth frame
+    double Time;
+    unsigned int Index;
+    uint32_t Random;
+} sHostImuStream_t;
+
+void            HostImuStream_Init          (sHostImuStream_t *Stream);
+/* Advances truth by Dt (nothing on the first call) and returns the sample at the new time */
+void            HostImuStream_Next          (sHostImuStream_t *Stream, sImuData_t *Sample);
+void            HostImuStream_GetTruth      (const sHostImuStream_t *Stream, float Q[4]);
+/* Degrees, full rotation between the two attitudes and angle between the gravity directions they imply */
+float           HostImuStream_AngleError    (const float Truth[4], const float Estimate[4]);
+float           HostImuStream_TiltError     (const float Truth[4], const float Estimate[4]);
+
+#endif /* _HOST_IMU_STREAM_ */
@@ -0,0 +1,217 @@
+#include "host_mpu9250.h"
+
+#include <string.h>
+#include "main.h"
+
+
+#define MPU_REG_SLV4_ADDR           0x31
+#define MPU_REG_SLV4_REG            0x32
+#define MPU_REG_SLV4_DO             0x33
+#define MPU_REG_SLV4_CTRL           0x34
+#define MPU_REG_SLV4_DI             0x35
+#define MPU_REG_I2C_MST_STATUS      0x36
+#define MPU_REG_DATA_FIRST          0x3B
+#define MPU_REG_EXT_SENS_DATA       0x49
+#define MPU_REG_USER_CTRL           0x6A
+#define MPU_REG_FIFO_COUNTH         0x72
+#define MPU_REG_FIFO_COUNTL         0x73
+#define MPU_REG_FIFO_R_W            0x74
+#define MPU_REG_WHO_AM_I            0x75
+#define MPU_WHO_AM_I                0x71
+#define MPU_USER_CTRL_FIFO_RST      0x04
+#define MPU_SLV_EN                  0x80
+#define MPU_SLV_READ                0x80
+#define MPU_SLV4_DONE               0x40
+#define MPU_SLV4_NACK               0x10
+#define MPU_SPI_MAX_CLOCK_HZ        20000000
+
+#define AKM_I2C_ADDRESS             0x0C
+#define AKM_REG_WIA                 0x00
+#define AKM_REG_CNTL2               0x0B
+#define AKM_REG_ASAX                0x10
+#define AKM_DEVICE_ID               0x48
+
+
+static void HostMpu_PutBigEndian (uint8_t *Buffer, int16_t Value) {
+    Buffer[0] = (uint8_t)((uint16_t)Value >> 8);
+    Buffer[1] = (uint8_t)Value;
+}
+
+/* Sensitivity adjustment is fuse ROM and survives soft reset */
+static void HostMpu_AkmReset (sHostMpu_t *Mpu) {
+    uint8_t Asa[3];
+    memcpy(Asa, &Mpu->Akm[AKM_REG_ASAX], sizeof(Asa));
+    memset(Mpu->Akm, 0, sizeof(Mpu->Akm));
+    Mpu->Akm[AKM_REG_WIA] = AKM_DEVICE_ID;
+    memcpy(&Mpu->Akm[AKM_REG_ASAX], Asa, sizeof(Asa));
+}
+
+void HostMpu_Init (sHostMpu_t *Mpu) {
+    memset(Mpu, 0, sizeof(*Mpu));
+    Mpu->Registers[MPU_REG_WHO_AM_I] = MPU_WHO_AM_I;
+    Mpu->Akm[AKM_REG_ASAX + 0] = 128;
+    Mpu->Akm[AKM_REG_ASAX + 1] = 128;
+    Mpu->Akm[AKM_REG_ASAX + 2] = 128;
+    HostMpu_AkmReset(Mpu);
+}
+
+uint16_t HostMpu_FifoCount (const sHostMpu_t *Mpu) {
+    return Mpu->FifoOverflow ? HOST_MPU_FIFO_SIZE : Mpu->FifoLevel;
+}
+
+void HostMpu_FifoPushBytes (sHostMpu_t *Mpu, const uint8_t *Bytes, unsigned int Length) {
+    for (unsigned int i = 0; i < Length; i++) {
+        Mpu->Fifo[(Mpu->FifoHead + Mpu->FifoLevel) % HOST_MPU_FIFO_SIZE] = Bytes[i];
+        if (Mpu->FifoLevel < HOST_MPU_FIFO_SIZE) {
+            Mpu->FifoLevel++;
+        } else {
+            Mpu->FifoHead = (Mpu->FifoHead + 1) % HOST_MPU_FIFO_SIZE;
+            Mpu->FifoOverflow = true;
+        }
+    }
+}
+
+void HostMpu_FifoPush (sHostMpu_t *Mpu, const int16_t Acc[3], const int16_t Gyr[3]) {
+    uint8_t Frame[HOST_MPU_FIFO_FRAME_LENGTH];
+    for (unsigned int i = 0; i < 3; i++) {
+        HostMpu_PutBigEndian(&Frame[2 * i], Acc[i]);
+        HostMpu_PutBigEndian(&Frame[6 + 2 * i], Gyr[i]);
+    }
+    HostMpu_FifoPushBytes(Mpu, Frame, sizeof(Frame));
+}
+
+void HostMpu_SetSample (sHostMpu_t *Mpu, const int16_t Acc[3], const int16_t Gyr[3], const int16_t MagAkm[3],
+                        bool MagReady, bool MagOverflow) {
+    uint8_t *Data = &Mpu->Registers[MPU_REG_DATA_FIRST];
+    for (unsigned int i = 0; i < 3; i++) {
+        HostMpu_PutBigEndian(&Data[2 * i], Acc[i]);
+        HostMpu_PutBigEndian(&Data[8 + 2 * i], Gyr[i]);
+    }
+    /* Temperature sits between accel and gyro */
+    HostMpu_PutBigEndian(&Data[6], 0x1234);
+    /* Slave0 copies AK8963 ST1, HXL..HZH, ST2 */
+    uint8_t *Ext = &Mpu->Registers[MPU_REG_EXT_SENS_DATA];
+    Ext[0] = MagReady ? 0x01 : 0x00;
+    for (unsigned int i = 0; i < 3; i++) {
+        Ext[1 + 2 * i] = (uint8_t)MagAkm[i];
+        Ext[2 + 2 * i] = (uint8_t)((uint16_t)MagAkm[i] >> 8);
+    }
+    Ext[7] = MagOverflow ? 0x08 : 0x00;
+}
+
+/* Slave4 access completes within one sample period, the driver polls for DONE after a tick */
+static void HostMpu_RunSlave4 (sHostMpu_t *Mpu) {
+    uint8_t Address = Mpu->Registers[MPU_REG_SLV4_ADDR];
+    uint8_t Register = Mpu->Registers[MPU_REG_SLV4_REG] % sizeof(Mpu->Akm);
+    Mpu->Registers[MPU_REG_SLV4_CTRL] &= (uint8_t)~MPU_SLV_EN;
+    if ((Address & (uint8_t)~MPU_SLV_READ) != AKM_I2C_ADDRESS) {
+        Mpu->Registers[MPU_REG_I2C_MST_STATUS] = MPU_SLV4_DONE | MPU_SLV4_NACK;
+    } else {
+        if (Address & MPU_SLV_READ) {
+            Mpu->Registers[MPU_REG_SLV4_DI] = Mpu->Akm[Register];
+        } else if ((Register == AKM_REG_CNTL2) && (Mpu->Registers[MPU_REG_SLV4_DO] & 0x01)) {
+            HostMpu_AkmReset(Mpu);
+        } else {
+            Mpu->Akm[Register] = Mpu->Registers[MPU_REG_SLV4_DO];
+        }
+        Mpu->Registers[MPU_REG_I2C_MST_STATUS] = MPU_SLV4_DONE;
+    }
+}
+
+static uint8_t HostMpu_ReadRegister (sHostMpu_t *Mpu, uint8_t Address) {
+    uint8_t Value = Mpu->Registers[Address];
+    switch (Address) {
+        case MPU_REG_FIFO_COUNTH:
+            Value = (uint8_t)(HostMpu_FifoCount(Mpu) >> 8);
+            break;
+        case MPU_REG_FIFO_COUNTL:
+            Value = (uint8_t)HostMpu_FifoCount(Mpu);
+            break;
+        case MPU_REG_FIFO_R_W:
+            Value = 0;
+            if (Mpu->FifoLevel) {
+                Value = Mpu->Fifo[Mpu->FifoHead];
+                Mpu->FifoHead = (Mpu->FifoHead + 1) % HOST_MPU_FIFO_SIZE;
+                Mpu->FifoLevel--;
+            }
+            break;
+        case MPU_REG_I2C_MST_STATUS:
+            /* Status bits clear on read */
+            Mpu->Registers[Address] = 0;
+            break;
+        default:
+            break;
+    }
+    return Value;
+}
+
+static void HostMpu_WriteRegister (sHostMpu_t *Mpu, uint8_t Address, uint8_t Value) {
+    switch (Address) {
+        case MPU_REG_USER_CTRL:
+            if (Value & MPU_USER_CTRL_FIFO_RST) {
+                Mpu->FifoHead = 0;
+                Mpu->FifoLevel = 0;
+                Mpu->FifoOverflow = false;
+                Mpu->FifoResets++;
+            }
+            Mpu->Registers[Address] = Value & (uint8_t)~MPU_USER_CTRL_FIFO_RST;
+            break;
+        case MPU_REG_SLV4_CTRL:
+            Mpu->Registers[Address] = Value;
+            if (Value & MPU_SLV_EN) {
+                HostMpu_RunSlave4(Mpu);
+            }
+            break;
+        case MPU_REG_WHO_AM_I:
+        case MPU_REG_FIFO_COUNTH:
+        case MPU_REG_FIFO_COUNTL:
+            break;
+        case MPU_REG_FIFO_R_W:
+            HostMpu_FifoPushBytes(Mpu, &Value, 1);
+            break;
+        default:
+            Mpu->Registers[Address] = Value;
+            break;
+    }
+}
+
+static void HostMpu_Select (void *Context, bool Selected) {
+    sHostMpu_t *Mpu = Context;
+    Mpu->Selected = Selected;
+    if (Selected) {
+        Mpu->Position = 0;
+        Mpu->Transactions++;
+    }
+}
+
+static uint16_t HostMpu_Exchange (void *Context, uint16_t Mosi, const sHostSpiFormat_t *Format) {
+    sHostMpu_t *Mpu = Context;
+    uint8_t Miso = 0;
+    if ((Format->Bits != 8) || (Format->Cpol != Format->Cpha) || (Format->ClockHz > MPU_SPI_MAX_CLOCK_HZ)) {
+        Mpu->FormatErrors++;
+    }
+    Mpu->Bytes++;
+    if (Mpu->Position == 0) {
+        Mpu->Read = (Mosi & 0x80) != 0;
+        Mpu->Address = Mosi & 0x7F;
+        Mpu->LastStartAddress = Mpu->Address;
+        Mpu->LastLength = 0;
+    } else {
+        if (Mpu->Read) {
+            Miso = HostMpu_ReadRegister(Mpu, Mpu->Address);
+        } else {
+            HostMpu_WriteRegister(Mpu, Mpu->Address, (uint8_t)Mosi);
+        }
+        if (Mpu->Address != MPU_REG_FIFO_R_W) {
+            Mpu->Address = (Mpu->Address + 1) & 0x7F;
+        }
+        Mpu->LastLength++;
+    }
+    Mpu->Position++;
+    return Miso;
+}
+
+bool HostMpu_Attach (sHostMpu_t *Mpu, SPI_TypeDef *Spi, GPIO_TypeDef *CsPort, uint16_t CsPin) {
+    const sHostSpiSlave_t Slave = { Spi, CsPort, CsPin, HostMpu_Select, HostMpu_Exchange, Mpu };
+    return HostSpi_Attach(&Slave);
+}
@@ -0,0 +1,45 @@
+#ifndef _HOST_MPU9250_
+#define _HOST_MPU9250_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "host_spi.h"
+
+
+#define HOST_MPU_FIFO_SIZE          512
+#define HOST_MPU_FIFO_FRAME_LENGTH  12
+
+/* MPU9250 register file as seen over SPI: address byte with read bit, then auto-increment. FIFO_R_W pops the
+ * FIFO instead of incrementing, FIFO_RST in USER_CTRL empties it, slave4 runs AK8963 accesses immediately. */
+typedef struct {
+    uint8_t Registers[128];
+    uint8_t Akm[0x20];                  // AK8963 register file behind the I2C master
+    uint8_t Fifo[HOST_MPU_FIFO_SIZE];
+    uint16_t FifoHead;
+    uint16_t FifoLevel;                 // bytes held
+    bool FifoOverflow;                  // count reads back as the size, as the part does once it wrapped
+    /* Current transaction */
+    bool Selected;
+    bool Read;
+    uint8_t Address;
+    unsigned int Position;
+    /* Counters */
+    uint32_t Transactions;
+    uint32_t Bytes;
+    uint32_t FifoResets;
+    uint32_t FormatErrors;              // frames not clocked as 8-bit mode 0/3 at 20 MHz or less
+    uint8_t LastStartAddress;
+    unsigned int LastLength;            // data bytes of the last transaction, command excluded
+} sHostMpu_t;
+
+void            HostMpu_Init                (sHostMpu_t *Mpu);
+bool            HostMpu_Attach              (sHostMpu_t *Mpu, SPI_TypeDef *Spi, GPIO_TypeDef *CsPort, uint16_t CsPin);
+/* Raw counts as the sensor reports them: acc and gyro big endian in MPU axes, mag little endian in AK8963 axes */
+void            HostMpu_SetSample           (sHostMpu_t *Mpu, const int16_t Acc[3], const int16_t Gyr[3],
+                                             const int16_t MagAkm[3], bool MagReady, bool MagOverflow);
+/* Appends one ACCEL XYZ, GYRO XYZ frame, oldest data is overwritten once full */
+void            HostMpu_FifoPush            (sHostMpu_t *Mpu, const int16_t Acc[3], const int16_t Gyr[3]);
+void            HostMpu_FifoPushBytes       (sHostMpu_t *Mpu, const uint8_t *Bytes, unsigned int Length);
+uint16_t        HostMpu_FifoCount           (const sHostMpu_t *Mpu);
+
+#endif /* _HOST_MPU9250_ */
@@ -0,0 +1,97 @@
+#include "host_mpu_playback.h"
+
+#include <math.h>
+#include <string.h>
+#include "main.h"
+#include "timing_stats_api.h"
+#include "host_hal.h"
+
+
+#define MPU_REG_SMPLRT_DIV          0x19
+#define MPU_REG_GYRO_CONFIG         0x1B
+#define MPU_REG_ACCEL_CONFIG        0x1C
+#define MPU_REG_FIFO_EN             0x23
+#define MPU_REG_INT_ENABLE          0x38
+#define MPU_REG_USER_CTRL           0x6A
+#define MPU_FS_SEL_SHIFT            3
+#define MPU_FS_SEL_MASK             0x03
+#define MPU_FIFO_EN_ACC_GYR         0x78
+#define MPU_USER_CTRL_FIFO_EN       0x40
+#define MPU_INT_RAW_RDY_EN          0x01
+#define MPU_INTERNAL_RATE           1000    // Hz, DLPF_CFG 1..6
+#define AKM_REG_ASAX                0x10
+#define AKM_UT_PER_LSB              0.15f
+
+static const float g_AccLsbPerMg[MPU_FS_SEL_MASK + 1] = {16.384f, 8.192f, 4.096f, 2.048f};
+static const float g_GyrLsbPerDps[MPU_FS_SEL_MASK + 1] = {131.0f, 65.5f, 32.8f, 16.4f};
+
+
+static int16_t HostMpuPlayback_ToRaw (sHostMpuPlayback_t *Playback, float Value) {
+    float Rounded = roundf(Value);
+    if (Rounded > INT16_MAX) {
+        Playback->Saturated++;
+        return INT16_MAX;
+    }
+    if (Rounded < INT16_MIN) {
+        Playback->Saturated++;
+        return INT16_MIN;
+    }
+    return (int16_t)Rounded;
+}
+
+/* Inverse of Mpu_ParseMagRaw3D and the ASA adjustment: MPU X/Y are AK8963 Y/X, Z points the other way */
+static float HostMpuPlayback_MagLsbPerUt (const sHostMpu_t *Mpu, unsigned int AkmAxis) {
+    return 1.0f / (AKM_UT_PER_LSB * (((float)Mpu->Akm[AKM_REG_ASAX + AkmAxis] - 128.0f) / 256.0f + 1.0f));
+}
+
+void HostMpuPlayback_Init (sHostMpuPlayback_t *Playback, sHostMpu_t *Mpu, const sHostImuLog_t *Log, unsigned int Rate) {
+    memset(Playback, 0, sizeof(sHostMpuPlayback_t));
+    Playback->Mpu = Mpu;
+    Playback->Log = Log;
+    Playback->Rate = (Rate != 0) ? Rate : MPU_INTERNAL_RATE / (1u + Mpu->Registers[MPU_REG_SMPLRT_DIV]);
+    Playback->Period = SystemCoreClock / Playback->Rate;
+    Playback->NextEdge = GetCycleCount() + Playback->Period;
+}
+
+bool HostMpuPlayback_Next (sHostMpuPlayback_t *Playback) {
+    sHostMpu_t *Mpu = Playback->Mpu;
+    if (Playback->Index >= Playback->Log->Count) {
+        return false;
+    }
+    const sImuData_t *Sample = &Playback->Log->Samples[Playback->Index++];
+    const float AccScale = g_AccLsbPerMg[(Mpu->Registers[MPU_REG_ACCEL_CONFIG] >> MPU_FS_SEL_SHIFT) & MPU_FS_SEL_MASK];
+    const float GyrScale = g_GyrLsbPerDps[(Mpu->Registers[MPU_REG_GYRO_CONFIG] >> MPU_FS_SEL_SHIFT) & MPU_FS_SEL_MASK];
+    const int16_t Acc[3] = {
+        HostMpuPlayback_ToRaw(Playback, Sample->A.X * AccScale),
+        HostMpuPlayback_ToRaw(Playback, Sample->A.Y * AccScale),
+        HostMpuPlayback_ToRaw(Playback, Sample->A.Z * AccScale)
+    };
+    const int16_t Gyr[3] = {
+        HostMpuPlayback_ToRaw(Playback, Sample->G.X * GyrScale),
+        HostMpuPlayback_ToRaw(Playback, Sample->G.Y * GyrScale),
+        HostMpuPlayback_ToRaw(Playback, Sample->G.Z * GyrScale)
+    };
+    const int16_t MagAkm[3] = {
+        HostMpuPlayback_ToRaw(Playback, Sample->M.Y * HostMpuPlayback_MagLsbPerUt(Mpu, 0)),
+        HostMpuPlayback_ToRaw(Playback, Sample->M.X * HostMpuPlayback_MagLsbPerUt(Mpu, 1)),
+        HostMpuPlayback_ToRaw(Playback, -Sample->M.Z * HostMpuPlayback_MagLsbPerUt(Mpu, 2))
+    };
+    int32_t Wait = (int32_t)(Playback->NextEdge - GetCycleCount());
+    if (Wait >= 0) {
+        HostHal_AdvanceCycles((uint32_t)Wait);
+    } else {
+        Playback->Overruns++;
+    }
+    Playback->NextEdge += Playback->Period;
+    HostMpu_SetSample(Mpu, Acc, Gyr, MagAkm, Sample->MagFresh, false);
+    if ((Mpu->Registers[MPU_REG_USER_CTRL] & MPU_USER_CTRL_FIFO_EN) &&
+        ((Mpu->Registers[MPU_REG_FIFO_EN] & MPU_FIFO_EN_ACC_GYR) == MPU_FIFO_EN_ACC_GYR)) {
+        HostMpu_FifoPush(Mpu, Acc, Gyr);
+        Playback->FifoFrames++;
+    }
+    if (Mpu->Registers[MPU_REG_INT_ENABLE] & MPU_INT_RAW_RDY_EN) {
+        HandleExt3IRQ();
+        Playback->DataReady++;
+    }
+    return true;
+}
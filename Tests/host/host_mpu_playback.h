@@ -0,0 +1,35 @@
+#ifndef _HOST_MPU_PLAYBACK_
+#define _HOST_MPU_PLAYBACK_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "host_mpu9250.h"
+#include "host_imu_log.h"
+
+
+/* Plays an IMU log back through the simulated MPU9250 at a fixed output data rate. The DWT is run forward to the next
+ * data ready edge, which stays on the ODR grid however long the reader took in between; the next sample is converted
+ * to raw counts at the full scale and AK8963 sensitivity the model is configured for and loaded into the data
+ * registers, appended to the FIFO when it is enabled for accel and gyro, and data ready is raised through
+ * HandleExt3IRQ when RAW_RDY_EN is set - as the part does at SMPLRT_DIV. Values beyond full scale saturate as the ADC
+ * would. */
+typedef struct {
+    sHostMpu_t *Mpu;
+    const sHostImuLog_t *Log;
+    unsigned int Rate;                  // Hz, output data rate
+    uint32_t Period;                    // DWT cycles between data ready edges
+    uint32_t NextEdge;                  // DWT cycle count of the next data ready edge
+    unsigned int Index;                 // next sample of the log
+    uint32_t DataReady;                 // interrupts raised
+    uint32_t FifoFrames;                // frames appended to the FIFO
+    uint32_t Saturated;                 // axes clipped to int16
+    uint32_t Overruns;                  // edges the reader was still busy at, the sample is then presented late
+} sHostMpuPlayback_t;
+
+/* Rate 0 takes the ODR programmed in SMPLRT_DIV, so call it after Mpu_Init */
+void            HostMpuPlayback_Init        (sHostMpuPlayback_t *Playback, sHostMpu_t *Mpu, const sHostImuLog_t *Log,
+                                             unsigned int Rate);
+/* One ODR period: false once the log is exhausted */
+bool            HostMpuPlayback_Next        (sHostMpuPlayback_t *Playback);
+
+#endif /* _HOST_MPU_PLAYBACK_ */
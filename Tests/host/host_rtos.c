@@ -0,0 +1,271 @@
+#include "host_rtos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "cmsis_os.h"
+#include "host_hal.h"
+
+
+typedef enum {
+    eHostQueueKind_Queue,
+    eHostQueueKind_Mutex,
+    eHostQueueKind_Binary,
+} eHostQueueKind_t;
+
+struct HostQueue {
+    eHostQueueKind_t Kind;
+    UBaseType_t Length;
+    UBaseType_t ItemSize;
+    UBaseType_t Count;
+    UBaseType_t Head;
+    uint8_t *Storage;
+};
+
+struct HostTask {
+    const char *Name;
+    uint32_t NotifyCount;
+};
+
+/* Task context of the test program itself, whatever it calls runs as this task */
+static struct HostTask g_MainTask = { "main", 0 };
+static TickType_t g_TickCount;
+static unsigned int g_CriticalNesting;
+static bool g_MutexesBusy;
+static HostRtos_BlockHook_t g_BlockHook;
+static sHostRtosStats_t g_Stats;
+
+
+void HostRtos_AdvanceTicks (TickType_t Ticks) {
+    if (Ticks == portMAX_DELAY) {
+        fprintf(stderr, "host: wait forever would never return\n");
+        abort();
+    }
+    g_TickCount += Ticks;
+    HostHal_AdvanceCycles(Ticks * (SystemCoreClock / configTICK_RATE_HZ));
+}
+
+void HostRtos_SetBlockHook (HostRtos_BlockHook_t Hook) {
+    g_BlockHook = Hook;
+}
+
+void HostRtos_SetMutexesBusy (bool Busy) {
+    g_MutexesBusy = Busy;
+}
+
+unsigned int HostRtos_GetCriticalNesting (void) {
+    return g_CriticalNesting;
+}
+
+void HostRtos_GetStats (sHostRtosStats_t *Output) {
+    *Output = g_Stats;
+}
+
+void HostRtos_ResetStats (void) {
+    memset(&g_Stats, 0, sizeof(g_Stats));
+}
+
+static void HostRtos_Block (TickType_t Ticks) {
+    if (g_BlockHook != NULL) {
+        g_BlockHook(Ticks);
+    }
+}
+
+void HostRtos_EnterCritical (void) {
+    g_CriticalNesting++;
+}
+
+void HostRtos_ExitCritical (void) {
+    if (g_CriticalNesting == 0) {
+        fprintf(stderr, "host: critical section exit without entry\n");
+        abort();
+    }
+    g_CriticalNesting--;
+}
+
+static QueueHandle_t HostRtos_Create (eHostQueueKind_t Kind, UBaseType_t Length, UBaseType_t ItemSize) {
+    QueueHandle_t Queue = calloc(1, sizeof(struct HostQueue));
+    if (Queue != NULL) {
+        Queue->Kind = Kind;
+        Queue->Length = Length;
+        Queue->ItemSize = ItemSize;
+        if (ItemSize) {
+            Queue->Storage = calloc(Length, ItemSize);
+        }
+    }
+    return Queue;
+}
+
+QueueHandle_t xQueueCreate (UBaseType_t Length, UBaseType_t ItemSize) {
+    return HostRtos_Create(eHostQueueKind_Queue, Length, ItemSize);
+}
+
+static BaseType_t HostRtos_Push (QueueHandle_t Queue, const void *Item) {
+    BaseType_t RetVal = pdFALSE;
+    if (Queue->Count < Queue->Length) {
+        if ((Queue->ItemSize != 0) && (Item != NULL)) {
+            UBaseType_t Tail = (Queue->Head + Queue->Count) % Queue->Length;
+            memcpy(&Queue->Storage[Tail * Queue->ItemSize], Item, Queue->ItemSize);
+        }
+        Queue->Count++;
+        RetVal = pdTRUE;
+    }
+    return RetVal;
+}
+
+static BaseType_t HostRtos_Pop (QueueHandle_t Queue, void *Item) {
+    BaseType_t RetVal = pdFALSE;
+    if (Queue->Count) {
+        if ((Queue->ItemSize != 0) && (Item != NULL)) {
+            memcpy(Item, &Queue->Storage[Queue->Head * Queue->ItemSize], Queue->ItemSize);
+        }
+        Queue->Head = (Queue->Head + 1) % Queue->Length;
+        Queue->Count--;
+        RetVal = pdTRUE;
+    }
+    return RetVal;
+}
+
+BaseType_t xQueueSend (QueueHandle_t Queue, const void *Item, TickType_t Ticks) {
+    g_Stats.QueueSends++;
+    if (Queue->Count >= Queue->Length) {
+        HostRtos_Block(Ticks);
+    }
+    BaseType_t RetVal = HostRtos_Push(Queue, Item);
+    if (!RetVal) {
+        g_Stats.QueueTimeouts++;
+        HostRtos_AdvanceTicks(Ticks);
+    }
+    return RetVal;
+}
+
+BaseType_t xQueueSendFromISR (QueueHandle_t Queue, const void *Item, BaseType_t *HigherPriorityTaskWoken) {
+    g_Stats.QueueSends++;
+    if (HigherPriorityTaskWoken != NULL) {
+        *HigherPriorityTaskWoken = pdFALSE;
+    }
+    return HostRtos_Push(Queue, Item);
+}
+
+BaseType_t xQueueReceive (QueueHandle_t Queue, void *Item, TickType_t Ticks) {
+    g_Stats.QueueReceives++;
+    if (Queue->Count == 0) {
+        HostRtos_Block(Ticks);
+    }
+    BaseType_t RetVal = HostRtos_Pop(Queue, Item);
+    if (!RetVal) {
+        g_Stats.QueueTimeouts++;
+        HostRtos_AdvanceTicks(Ticks);
+    }
+    return RetVal;
+}
+
+BaseType_t xQueueReceiveFromISR (QueueHandle_t Queue, void *Item, BaseType_t *HigherPriorityTaskWoken) {
+    g_Stats.QueueReceives++;
+    if (HigherPriorityTaskWoken != NULL) {
+        *HigherPriorityTaskWoken = pdFALSE;
+    }
+    return HostRtos_Pop(Queue, Item);
+}
+
+UBaseType_t uxQueueMessagesWaiting (QueueHandle_t Queue) {
+    return Queue->Count;
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR (QueueHandle_t Queue) {
+    return Queue->Count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex (void) {
+    SemaphoreHandle_t Semaphore = HostRtos_Create(eHostQueueKind_Mutex, 1, 0);
+    if (Semaphore != NULL) {
+        Semaphore->Count = 1;
+    }
+    return Semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary (void) {
+    return HostRtos_Create(eHostQueueKind_Binary, 1, 0);
+}
+
+BaseType_t xSemaphoreTake (SemaphoreHandle_t Semaphore, TickType_t Ticks) {
+    BaseType_t RetVal = pdFALSE;
+    bool Busy = (Semaphore->Kind == eHostQueueKind_Mutex) && g_MutexesBusy;
+    g_Stats.SemaphoreTakes++;
+    if ((Semaphore->Count == 0) && !Busy) {
+        HostRtos_Block(Ticks);
+    }
+    if (!Busy && Semaphore->Count) {
+        Semaphore->Count--;
+        RetVal = pdTRUE;
+    } else {
+        g_Stats.SemaphoreTimeouts++;
+        HostRtos_AdvanceTicks(Ticks);
+    }
+    return RetVal;
+}
+
+BaseType_t xSemaphoreGive (SemaphoreHandle_t Semaphore) {
+    return HostRtos_Push(Semaphore, NULL);
+}
+
+BaseType_t xSemaphoreGiveFromISR (SemaphoreHandle_t Semaphore, BaseType_t *HigherPriorityTaskWoken) {
+    if (HigherPriorityTaskWoken != NULL) {
+        *HigherPriorityTaskWoken = pdFALSE;
+    }
+    return HostRtos_Push(Semaphore, NULL);
+}
+
+void vTaskDelay (TickType_t Ticks) {
+    HostRtos_Block(Ticks);
+    HostRtos_AdvanceTicks(Ticks);
+}
+
+TickType_t xTaskGetTickCount (void) {
+    return g_TickCount;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle (void) {
+    return &g_MainTask;
+}
+
+/* Block hook gets the chance to raise the interrupt that gives the notification, otherwise the wait times out */
+uint32_t ulTaskNotifyTake (BaseType_t ClearCountOnExit, TickType_t Ticks) {
+    uint32_t RetVal = 0;
+    if (g_MainTask.NotifyCount == 0) {
+        HostRtos_Block(Ticks);
+    }
+    RetVal = g_MainTask.NotifyCount;
+    if (RetVal == 0) {
+        HostRtos_AdvanceTicks(Ticks);
+    } else if (ClearCountOnExit) {
+        g_MainTask.NotifyCount = 0;
+    } else {
+        g_MainTask.NotifyCount--;
+    }
+    return RetVal;
+}
+
+/* Every created task is the test program's own context, see g_MainTask */
+void vTaskNotifyGiveFromISR (TaskHandle_t Task, BaseType_t *HigherPriorityTaskWoken) {
+    g_Stats.NotifyGives++;
+    Task->NotifyCount++;
+    if (HigherPriorityTaskWoken != NULL) {
+        *HigherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+osThreadId osThreadCreate (const osThreadDef_t *thread_def, void *argument) {
+    (void)thread_def;
+    (void)argument;
+    return &g_MainTask;
+}
+
+osStatus osDelay (uint32_t millisec) {
+    vTaskDelay(pdMS_TO_TICKS(millisec));
+    return osEventTimeout;
+}
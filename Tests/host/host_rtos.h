@@ -0,0 +1,30 @@
+#ifndef _HOST_RTOS_
+#define _HOST_RTOS_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+
+/* Single threaded kernel model: nothing ever blocks, a wait that cannot be satisfied runs the block hook (which
+ * may raise interrupts) and then lets the full timeout pass */
+typedef void (*HostRtos_BlockHook_t) (TickType_t Ticks);
+
+typedef struct {
+    uint32_t QueueSends;
+    uint32_t QueueReceives;
+    uint32_t QueueTimeouts;
+    uint32_t SemaphoreTakes;
+    uint32_t SemaphoreTimeouts;
+    uint32_t NotifyGives;
+} sHostRtosStats_t;
+
+void            HostRtos_AdvanceTicks       (TickType_t Ticks);
+void            HostRtos_SetBlockHook       (HostRtos_BlockHook_t Hook);
+/* Every mutex take fails, as if another task held the bus */
+void            HostRtos_SetMutexesBusy     (bool Busy);
+unsigned int    HostRtos_GetCriticalNesting (void);
+void            HostRtos_GetStats           (sHostRtosStats_t *Output);
+void            HostRtos_ResetStats         (void);
+
+#endif /* _HOST_RTOS_ */
@@ -0,0 +1,230 @@
+#include "host_spi.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "stm32f3xx_ll_spi.h"
+#include "stm32f3xx_ll_dma.h"
+#include "spi_api.h"
+#include "host_hal.h"
+
+
+#define HOST_SPI_MAX_SLAVES         8
+#define HOST_SPI_COUNT              (sizeof(HostSpi) / sizeof(HostSpi[0]))
+#define HOST_SPI_FLOATING_MISO      0xFFFF
+
+/* DMA1 request mapping of the F302: SPI1 RX/TX on channels 2/3, SPI2 on 4/5, SPI3 sits on DMA2 */
+static const struct {
+    uint32_t RxChannel;
+    uint32_t TxChannel;
+} g_HostSpiDmaMap[] = {
+    { LL_DMA_CHANNEL_2, LL_DMA_CHANNEL_3 },
+    { LL_DMA_CHANNEL_4, LL_DMA_CHANNEL_5 },
+    { 0, 0 },
+};
+
+/* SPI1 is on APB2 at the core clock, SPI2 and SPI3 on APB1 at half of it */
+static const uint32_t g_HostSpiBusClockDivider[] = {1, 2, 2};
+
+static sHostSpiSlave_t g_Slaves[HOST_SPI_MAX_SLAVES];
+static bool g_SlaveSelected[HOST_SPI_MAX_SLAVES];
+static unsigned int g_SlaveCount;
+static sHostSpiStats_t g_Stats[sizeof(HostSpi) / sizeof(HostSpi[0])];
+static unsigned int g_DropDmaCompletions;
+static bool g_TxInterruptsRunning;
+static void (*g_FrameHook) (SPI_TypeDef *Spi);
+
+
+static unsigned int HostSpi_Index (SPI_TypeDef *Spi) {
+    return (unsigned int)(Spi - HostSpi);
+}
+
+/* Chip selects are active low, a falling edge selects and a rising edge releases */
+static void HostSpi_GpioHook (GPIO_TypeDef *Port, uint16_t Pin, GPIO_PinState State) {
+    for (unsigned int i = 0; i < g_SlaveCount; i++) {
+        bool Selected = (State == GPIO_PIN_RESET);
+        if ((g_Slaves[i].CsPort == Port) && (g_Slaves[i].CsPin & Pin) && (g_SlaveSelected[i] != Selected)) {
+            if (Selected) {
+                for (unsigned int j = 0; j < g_SlaveCount; j++) {
+                    if ((j != i) && g_SlaveSelected[j] && (g_Slaves[j].Spi == g_Slaves[i].Spi)) {
+                        g_Stats[HostSpi_Index(g_Slaves[i].Spi)].OverlappingSelects++;
+                    }
+                }
+            }
+            g_SlaveSelected[i] = Selected;
+            if (g_Slaves[i].Select != NULL) {
+                g_Slaves[i].Select(g_Slaves[i].Context, Selected);
+            }
+        }
+    }
+}
+
+void HostSpi_Reset (void) {
+    memset(g_Slaves, 0, sizeof(g_Slaves));
+    memset(g_SlaveSelected, 0, sizeof(g_SlaveSelected));
+    memset(g_Stats, 0, sizeof(g_Stats));
+    memset(HostSpi, 0, sizeof(HostSpi));
+    memset(HostDma, 0, sizeof(HostDma));
+    g_SlaveCount = 0;
+    g_DropDmaCompletions = 0;
+    g_FrameHook = NULL;
+    HostHal_SetGpioHook(HostSpi_GpioHook);
+}
+
+bool HostSpi_Attach (const sHostSpiSlave_t *Slave) {
+    bool RetVal = false;
+    if ((g_SlaveCount < HOST_SPI_MAX_SLAVES) && (Slave != NULL) && (Slave->Exchange != NULL)) {
+        g_Slaves[g_SlaveCount] = *Slave;
+        /* Pin may already be driven low by GPIO init */
+        g_SlaveSelected[g_SlaveCount] = !(Slave->CsPort->ODR & Slave->CsPin);
+        g_SlaveCount++;
+        HostHal_SetGpioHook(HostSpi_GpioHook);
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+bool HostSpi_GetStats (SPI_TypeDef *Spi, sHostSpiStats_t *Output) {
+    bool RetVal = false;
+    if ((HostSpi_Index(Spi) < HOST_SPI_COUNT) && (Output != NULL)) {
+        *Output = g_Stats[HostSpi_Index(Spi)];
+        RetVal = true;
+    }
+    return RetVal;
+}
+
+void HostSpi_DropDmaCompletions (unsigned int Count) {
+    g_DropDmaCompletions = Count;
+}
+
+void HostSpi_SetFrameHook (void (*Hook) (SPI_TypeDef *Spi)) {
+    g_FrameHook = Hook;
+}
+
+void HostSpi_ConfigWrite (SPI_TypeDef *SPIx) {
+    if (READ_BIT(SPIx->CR1, SPI_CR1_SPE)) {
+        g_Stats[HostSpi_Index(SPIx)].ConfigWritesWhileEnabled++;
+    }
+}
+
+/* One frame on the wire: whichever slave on this bus is selected answers, bus time is Bits SPI clocks */
+static uint16_t HostSpi_Clock (SPI_TypeDef *SPIx, uint16_t Mosi) {
+    sHostSpiStats_t *Stats = &g_Stats[HostSpi_Index(SPIx)];
+    uint32_t Prescaler = 2UL << ((SPIx->CR1 & SPI_CR1_BR) >> 3);
+    uint32_t CyclesPerBit = Prescaler * g_HostSpiBusClockDivider[HostSpi_Index(SPIx)];
+    sHostSpiFormat_t Format = {
+        .Prescaler = Prescaler,
+        .ClockHz = SystemCoreClock / CyclesPerBit,
+        .Cpol = (SPIx->CR1 & SPI_CR1_CPOL) != 0,
+        .Cpha = (SPIx->CR1 & SPI_CR1_CPHA) != 0,
+        .Bits = ((SPIx->CR2 & SPI_CR2_DS) >> 8) + 1,
+    };
+    uint16_t Miso = HOST_SPI_FLOATING_MISO;
+    bool Answered = false;
+    for (unsigned int i = 0; i < g_SlaveCount; i++) {
+        if ((g_Slaves[i].Spi == SPIx) && g_SlaveSelected[i]) {
+            Miso = g_Slaves[i].Exchange(g_Slaves[i].Context, Mosi, &Format);
+            Answered = true;
+        }
+    }
+    if (!Answered) {
+        Stats->UnselectedFrames++;
+    }
+    if (Format.Bits < 16) {
+        Miso &= (uint16_t)((1U << Format.Bits) - 1);
+    }
+    Stats->Frames++;
+    Stats->BusCycles += (uint64_t)Format.Bits * CyclesPerBit;
+    HostHal_AdvanceCycles(Format.Bits * CyclesPerBit);
+    if (g_FrameHook != NULL) {
+        g_FrameHook(SPIx);
+    }
+    return Miso;
+}
+
+/* Received frame lands in DR, RXNE interrupt is taken straight away */
+void HostSpi_Transmit (SPI_TypeDef *SPIx, uint16_t Frame) {
+    if (READ_BIT(SPIx->CR1, SPI_CR1_SPE)) {
+        SPIx->DR = HostSpi_Clock(SPIx, Frame);
+        SET_BIT(SPIx->SR, SPI_SR_RXNE);
+        if (READ_BIT(SPIx->CR2, SPI_CR2_RXNEIE)) {
+            g_Stats[HostSpi_Index(SPIx)].RxInterrupts++;
+            HandleSpiRxIRQ((eSpi_t)HostSpi_Index(SPIx));
+        }
+    }
+}
+
+/* TXE stays set while the transmit buffer is empty, so the interrupt keeps firing until the driver masks it */
+void HostSpi_StartTxInterrupts (SPI_TypeDef *SPIx) {
+    if (!g_TxInterruptsRunning) {
+        g_TxInterruptsRunning = true;
+        while (READ_BIT(SPIx->CR2, SPI_CR2_TXEIE) && READ_BIT(SPIx->CR1, SPI_CR1_SPE) && READ_BIT(SPIx->SR, SPI_SR_TXE)) {
+            g_Stats[HostSpi_Index(SPIx)].TxInterrupts++;
+            HandleSpiTxIRQ((eSpi_t)HostSpi_Index(SPIx));
+        }
+        g_TxInterruptsRunning = false;
+    }
+}
+
+/* Flag clear register is write-only on the device, its effect is applied here */
+static void HostSpi_ApplyDmaFlagClear (DMA_TypeDef *Dma) {
+    for (unsigned int Channel = 0; Channel < 7; Channel++) {
+        if (Dma->IFCR & (DMA_IFCR_CGIF1 << (Channel * 4))) {
+            Dma->ISR &= ~(0xFUL << (Channel * 4));
+        }
+    }
+    Dma->IFCR = 0;
+}
+
+static uint16_t HostSpi_DmaRead (const DMA_Channel_TypeDef *Channel, uint32_t Index) {
+    bool Wide = (Channel->CCR & DMA_CCR_MSIZE) != 0;
+    uintptr_t Address = (uintptr_t)Channel->CMAR + ((Channel->CCR & DMA_CCR_MINC) ? Index * (Wide ? 2 : 1) : 0);
+    return Wide ? *(const uint16_t *)Address : *(const uint8_t *)Address;
+}
+
+static void HostSpi_DmaWrite (const DMA_Channel_TypeDef *Channel, uint32_t Index, uint16_t Value) {
+    bool Wide = (Channel->CCR & DMA_CCR_MSIZE) != 0;
+    uintptr_t Address = (uintptr_t)Channel->CMAR + ((Channel->CCR & DMA_CCR_MINC) ? Index * (Wide ? 2 : 1) : 0);
+    if (Wide) {
+        *(uint16_t *)Address = Value;
+    } else {
+        *(uint8_t *)Address = (uint8_t)Value;
+    }
+}
+
+/* TX request starts the transfer: TX channel feeds DR, RX channel drains it, completion is raised by RX channel */
+void HostSpi_StartDma (SPI_TypeDef *SPIx) {
+    unsigned int Index = HostSpi_Index(SPIx);
+    DMA_TypeDef *Dma = DMA1;
+    sHostSpiStats_t *Stats = &g_Stats[Index];
+    HostSpi_ApplyDmaFlagClear(Dma);
+    if ((g_HostSpiDmaMap[Index].TxChannel != 0) && READ_BIT(SPIx->CR1, SPI_CR1_SPE)) {
+        uint32_t RxChannel = g_HostSpiDmaMap[Index].RxChannel;
+        DMA_Channel_TypeDef *Rx = &Dma->Channel[RxChannel - 1];
+        DMA_Channel_TypeDef *Tx = &Dma->Channel[g_HostSpiDmaMap[Index].TxChannel - 1];
+        bool RxEnabled = READ_BIT(SPIx->CR2, SPI_CR2_RXDMAEN) && (Rx->CCR & DMA_CCR_EN);
+        if (Tx->CCR & DMA_CCR_EN) {
+            uint32_t Frames = Tx->CNDTR;
+            Stats->DmaTransfers++;
+            for (uint32_t i = 0; i < Frames; i++) {
+                uint16_t Miso = HostSpi_Clock(SPIx, HostSpi_DmaRead(Tx, i));
+                Tx->CNDTR--;
+                if (RxEnabled && Rx->CNDTR) {
+                    HostSpi_DmaWrite(Rx, i, Miso);
+                    Rx->CNDTR--;
+                }
+            }
+            if (RxEnabled && (Rx->CNDTR == 0)) {
+                Dma->ISR |= (DMA_ISR_TCIF1 << ((RxChannel - 1) * 4));
+                if (g_DropDmaCompletions) {
+                    g_DropDmaCompletions--;
+                    Stats->DroppedDmaCompletions++;
+                } else if (Rx->CCR & DMA_CCR_TCIE) {
+                    Stats->DmaInterrupts++;
+                    HandleSpiDmaRxIRQ((eSpi_t)Index);
+                    HostSpi_ApplyDmaFlagClear(Dma);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef _HOST_SPI_
+#define _HOST_SPI_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+/* Bus settings the frame was clocked with, taken from CR1/CR2 at the time */
+typedef struct {
+    uint32_t Prescaler;                 // SPI clock divider, 2..256
+    uint32_t ClockHz;                   // SCK, prescaler applied to the bus clock of this SPI
+    bool Cpol;
+    bool Cpha;
+    unsigned int Bits;
+} sHostSpiFormat_t;
+
+/* Slave model: Select is called on chip select edges, Exchange once per frame while selected */
+typedef struct {
+    SPI_TypeDef *Spi;
+    GPIO_TypeDef *CsPort;
+    uint16_t CsPin;
+    void (*Select) (void *Context, bool Selected);
+    uint16_t (*Exchange) (void *Context, uint16_t Mosi, const sHostSpiFormat_t *Format);
+    void *Context;
+} sHostSpiSlave_t;
+
+typedef struct {
+    uint32_t Frames;
+    uint32_t UnselectedFrames;          // clocked with no chip select asserted
+    uint32_t OverlappingSelects;        // second chip select asserted on a busy bus
+    uint32_t ConfigWritesWhileEnabled;  // format changed with SPE set
+    uint32_t TxInterrupts;
+    uint32_t RxInterrupts;
+    uint32_t DmaTransfers;
+    uint32_t DmaInterrupts;
+    uint32_t DroppedDmaCompletions;
+    uint64_t BusCycles;                 // core cycles spent clocking bits
+} sHostSpiStats_t;
+
+void            HostSpi_Reset               (void);
+bool            HostSpi_Attach              (const sHostSpiSlave_t *Slave);
+bool            HostSpi_GetStats            (SPI_TypeDef *Spi, sHostSpiStats_t *Output);
+/* Next Count DMA transfers finish without raising the transfer complete interrupt */
+void            HostSpi_DropDmaCompletions  (unsigned int Count);
+/* Called after every frame, stands in for a higher priority task getting the CPU mid-transaction */
+void            HostSpi_SetFrameHook        (void (*Hook) (SPI_TypeDef *Spi));
+
+#endif /* _HOST_SPI_ */
@@ -0,0 +1,23 @@
+#ifndef _HOST_TEST_
+#define _HOST_TEST_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+
+/* Failed checks are printed and counted, test keeps going so one run shows every mismatch */
+#define CHECK(Condition)                HostTest_Check((Condition), #Condition, __FILE__, __LINE__)
+#define CHECK_NEAR(Value, Expected, Tolerance) \
+    HostTest_CheckNear((double)(Value), (double)(Expected), (double)(Tolerance), #Value, __FILE__, __LINE__)
+
+bool            HostTest_Check              (bool Condition, const char *Text, const char *File, int Line);
+bool            HostTest_CheckNear          (double Value, double Expected, double Tolerance, const char *Text,
+                                             const char *File, int Line);
+int             HostTest_Result             (const char *Name);
+double          HostTest_NowNs              (void);
+
+/* Each test program provides this, it runs on a stack mapped below 4 GB so DMA addresses fit 32 bits */
+int             TestMain                    (int argc, char **argv);
+
+#endif /* _HOST_TEST_ */
@@ -0,0 +1,136 @@
+#include "host_work_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+
+/* Tasks are plain indices, so a worker's deque is the range [Begin, End): the owner pops End, thieves move Begin */
+typedef struct {
+    pthread_mutex_t Lock;
+    unsigned int Begin;
+    unsigned int End;
+} sHostWorkDeque_t;
+
+typedef struct {
+    unsigned int Workers;
+    sHostWorkDeque_t *Deques;
+    HostWorkPool_Task_t Task;
+    void *Context;
+    sHostWorkPoolStats_t *Stats;
+} sHostWorkPool_t;
+
+typedef struct {
+    sHostWorkPool_t *Pool;
+    unsigned int Index;
+} sHostWorker_t;
+
+
+unsigned int HostWorkPool_GetCoreCount (void) {
+    long Cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return (Cores > 0) ? (unsigned int)Cores : 1;
+}
+
+static bool HostWorkPool_Pop (sHostWorkDeque_t *Deque, unsigned int *Task) {
+    bool RetVal = false;
+    pthread_mutex_lock(&Deque->Lock);
+    if (Deque->Begin < Deque->End) {
+        *Task = --Deque->End;
+        RetVal = true;
+    }
+    pthread_mutex_unlock(&Deque->Lock);
+    return RetVal;
+}
+
+/* Takes the front half (rounded up) of the first non empty deque after Self. Tasks never spawn tasks, so once a full
+ * scan finds nothing the only work left is already owned by running workers and this one can stop. */
+static bool HostWorkPool_Steal (sHostWorkPool_t *Pool, unsigned int Self) {
+    for (unsigned int i = 1; i < Pool->Workers; i++) {
+        sHostWorkDeque_t *Victim = &Pool->Deques[(Self + i) % Pool->Workers];
+        unsigned int Begin = 0;
+        unsigned int End = 0;
+        pthread_mutex_lock(&Victim->Lock);
+        if (Victim->Begin < Victim->End) {
+            Begin = Victim->Begin;
+            End = Begin + (Victim->End - Victim->Begin + 1) / 2;
+            Victim->Begin = End;
+        }
+        pthread_mutex_unlock(&Victim->Lock);
+        if (Begin < End) {
+            sHostWorkDeque_t *Own = &Pool->Deques[Self];
+            pthread_mutex_lock(&Own->Lock);
+            Own->Begin = Begin;
+            Own->End = End;
+            pthread_mutex_unlock(&Own->Lock);
+            Pool->Stats[Self].Steals++;
+            Pool->Stats[Self].Stolen += End - Begin;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *HostWorkPool_Worker (void *Argument) {
+    sHostWorker_t *Worker = Argument;
+    sHostWorkPool_t *Pool = Worker->Pool;
+    unsigned int Task;
+    do {
+        while (HostWorkPool_Pop(&Pool->Deques[Worker->Index], &Task)) {
+            Pool->Task(Task, Worker->Index, Pool->Context);
+            Pool->Stats[Worker->Index].Tasks++;
+        }
+    } while (HostWorkPool_Steal(Pool, Worker->Index));
+    return NULL;
+}
+
+bool HostWorkPool_Run (unsigned int Workers, unsigned int Count, HostWorkPool_Task_t Task, void *Context, sHostWorkPoolStats_t *Stats) {
+    sHostWorkPool_t Pool = {Workers, NULL, Task, Context, Stats};
+    sHostWorker_t *Threads = NULL;
+    pthread_t *Handles = NULL;
+    unsigned int Started = 0;
+    bool RetVal = false;
+    /* Input check */
+    if ((Workers == 0) || (Task == NULL)) {
+        return false;
+    }
+    Pool.Deques = calloc(Workers, sizeof(sHostWorkDeque_t));
+    Threads = calloc(Workers, sizeof(sHostWorker_t));
+    Handles = calloc(Workers, sizeof(pthread_t));
+    if (Stats == NULL) {
+        Pool.Stats = calloc(Workers, sizeof(sHostWorkPoolStats_t));
+    } else {
+        memset(Stats, 0, Workers * sizeof(sHostWorkPoolStats_t));
+    }
+    if ((Pool.Deques != NULL) && (Threads != NULL) && (Handles != NULL) && (Pool.Stats != NULL)) {
+        for (unsigned int i = 0; i < Workers; i++) {
+            pthread_mutex_init(&Pool.Deques[i].Lock, NULL);
+            Pool.Deques[i].Begin = (unsigned int)((uint64_t)Count * i / Workers);
+            Pool.Deques[i].End = (unsigned int)((uint64_t)Count * (i + 1) / Workers);
+            Threads[i].Pool = &Pool;
+            Threads[i].Index = i;
+        }
+        /* The calling thread is worker 0 */
+        for (Started = 1; Started < Workers; Started++) {
+            if (pthread_create(&Handles[Started], NULL, HostWorkPool_Worker, &Threads[Started]) != 0) {
+                break;
+            }
+        }
+        HostWorkPool_Worker(&Threads[0]);
+        for (unsigned int i = 1; i < Started; i++) {
+            pthread_join(Handles[i], NULL);
+        }
+        /* Deques of workers that failed to start were stolen by the others, so every task still ran */
+        RetVal = (Started == Workers);
+        for (unsigned int i = 0; i < Workers; i++) {
+            pthread_mutex_destroy(&Pool.Deques[i].Lock);
+        }
+    }
+    if (Stats == NULL) {
+        free(Pool.Stats);
+    }
+    free(Handles);
+    free(Threads);
+    free(Pool.Deques);
+    return RetVal;
+}
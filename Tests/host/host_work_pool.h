@@ -0,0 +1,24 @@
+#ifndef _HOST_WORK_POOL_
+#define _HOST_WORK_POOL_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Runs tasks 0 .. Count - 1 on a pool of threads. Every worker starts with an even slice of the indices and takes
+ * from the back of its own; once that is empty it steals half of what is left at the front of another worker's, so
+ * uneven tasks (a long log, a slow engine) do not leave cores idle at the end. Tasks must not share mutable state. */
+typedef void (*HostWorkPool_Task_t) (unsigned int Task, unsigned int Worker, void *Context);
+
+typedef struct {
+    unsigned int Tasks;                 // run by this worker
+    unsigned int Steals;                // successful steals from other workers
+    unsigned int Stolen;                // tasks taken over by those steals
+} sHostWorkPoolStats_t;
+
+unsigned int    HostWorkPool_GetCoreCount   (void);
+/* Stats holds one entry per worker and may be NULL; false if the threads could not be started */
+bool            HostWorkPool_Run            (unsigned int Workers, unsigned int Count, HostWorkPool_Task_t Task, void *Context,
+                                             sHostWorkPoolStats_t *Stats);
+
+#endif /* _HOST_WORK_POOL_ */
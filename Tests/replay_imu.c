@@ -0,0 +1,146 @@
+/* Replays an IMU log recorded with IMU_LOG_OUTPUT (Mpu_PrintCsv) or its binary form through one estimator engine as
+ * fast as the host allows, and reports throughput and, given a reference track, attitude error and convergence time.
+ *
+ *   replay_imu [-e engine] [-p twoKp] [-i twoKi] [-b beta] [-a accVariance] [-m magVariance] [-d decimation]
+ *              [-n] [-s settle] [-t threshold] [-r reference.csv] [-o attitude.csv] [-w log.bin] log
+ *
+ * Engines are Mahony, Madgwick, MEKF and MultiRate; -n replays without magnetometer. -o writes the attitude after
+ * every sample in the reference format, so one run can be the reference of the next. -w converts the log to binary. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "attitude_estimator_api.h"
+#include "host_imu_log.h"
+#include "host_imu_replay.h"
+#include "host_test.h"
+
+
+static void Usage (void) {
+    fprintf(stderr, "usage: replay_imu [-e Mahony|Madgwick|MEKF|MultiRate] [-p twoKp] [-i twoKi] [-b beta] [-a accVariance]\n"
+                    "                  [-m magVariance] [-d decimation] [-n] [-s settle] [-t threshold] [-r reference.csv]\n"
+                    "                  [-o attitude.csv] [-w log.bin] log\n");
+}
+
+static bool ParseEngine (const char *Name, eAttitudeEstimator_t *Engine) {
+    for (eAttitudeEstimator_t i = eAttitudeEstimator_First; i < eAttitudeEstimator_Last; i++) {
+        if (strcasecmp(Name, AttitudeEstimator_GetName(i)) == 0) {
+            *Engine = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int TestMain (int argc, char **argv) {
+    sHostImuReplayConfig_t Config;
+    sHostImuReplayResult_t Result;
+    sHostImuLog_t Log;
+    sHostAttitudeTrack_t Reference;
+    sHostAttitudeTrack_t Output;
+    const char *ReferencePath = NULL;
+    const char *OutputPath = NULL;
+    const char *BinaryPath = NULL;
+    const char *LogPath = NULL;
+    HostImuReplay_GetDefaultConfig(&Config);
+    for (int i = 1; i < argc; i++) {
+        const char *Value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        bool Used = true;
+        if (strcmp(argv[i], "-n") == 0) {
+            Config.UseMag = false;
+            Used = false;
+        } else if ((argv[i][0] != '-') && (LogPath == NULL)) {
+            LogPath = argv[i];
+            Used = false;
+        } else if (Value == NULL) {
+            Usage();
+            return EXIT_FAILURE;
+        } else if (strcmp(argv[i], "-e") == 0) {
+            if (!ParseEngine(Value, &Config.Engine)) {
+                fprintf(stderr, "unknown engine %s\n", Value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-p") == 0) {
+            Config.Config.TwoKp = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            Config.Config.TwoKi = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            Config.Config.Beta = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            Config.Config.AccVariance = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-m") == 0) {
+            Config.Config.MagVariance = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-d") == 0) {
+            Config.Config.CorrectionDecimation = (unsigned int)strtoul(Value, NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            Config.SettleTime = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            Config.ConvergenceThreshold = strtof(Value, NULL);
+        } else if (strcmp(argv[i], "-r") == 0) {
+            ReferencePath = Value;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            OutputPath = Value;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            BinaryPath = Value;
+        } else {
+            Usage();
+            return EXIT_FAILURE;
+        }
+        if (Used) {
+            i++;
+        }
+    }
+    if (LogPath == NULL) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+    if (!HostImuLog_Load(&Log, LogPath)) {
+        fprintf(stderr, "%s: not an IMU log\n", LogPath);
+        return EXIT_FAILURE;
+    }
+    if ((ReferencePath != NULL) && !HostAttitudeTrack_Load(&Reference, ReferencePath)) {
+        fprintf(stderr, "%s: not an attitude track\n", ReferencePath);
+        return EXIT_FAILURE;
+    }
+    if (BinaryPath != NULL) {
+        FILE *File = fopen(BinaryPath, "wb");
+        if ((File == NULL) || !HostImuLog_WriteBinary(&Log, File)) {
+            perror(BinaryPath);
+            return EXIT_FAILURE;
+        }
+        fclose(File);
+    }
+    HostAttitudeTrack_Init(&Output, Log.Clock);
+    if (!HostImuReplay_Run(&Config, &Log, (ReferencePath != NULL) ? &Reference : NULL, (OutputPath != NULL) ? &Output : NULL, &Result)) {
+        fprintf(stderr, "%s: replay failed\n", LogPath);
+        return EXIT_FAILURE;
+    }
+    if (OutputPath != NULL) {
+        FILE *File = fopen(OutputPath, "w");
+        if ((File == NULL) || !HostAttitudeTrack_WriteCsv(&Output, File)) {
+            perror(OutputPath);
+            return EXIT_FAILURE;
+        }
+        fclose(File);
+    }
+    printf("%s: %u samples, %.2f s at %u Hz clock, %u lines skipped\n", LogPath, Result.Samples, Result.LogSeconds,
+           (unsigned int)Log.Clock, Log.SkippedLines);
+    printf("%s%s: %.1f ns per update, %.0f updates/s, %.0fx real time%s\n", AttitudeEstimator_GetName(Config.Engine),
+           Config.UseMag ? "" : " (no magnetometer)", Result.ElapsedNs / Result.Samples, Result.UpdatesPerSecond,
+           (Result.ElapsedNs > 0.0) ? Result.LogSeconds * 1e9 / Result.ElapsedNs : 0.0, Result.Finite ? "" : ", attitude not finite");
+    if (ReferencePath != NULL) {
+        printf("against %s after %.1f s (%u samples): rms %.3f deg, max %.3f deg, tilt rms %.3f deg, tilt max %.3f deg\n",
+               ReferencePath, (double)Config.SettleTime, Result.Compared, (double)Result.AngleRms, (double)Result.AngleMax,
+               (double)Result.TiltRms, (double)Result.TiltMax);
+        if (Result.ConvergenceTime >= 0.0f) {
+            printf("tilt within %.2f deg from %.3f s\n", (double)Config.ConvergenceThreshold, (double)Result.ConvergenceTime);
+        } else {
+            printf("tilt never stays within %.2f deg\n", (double)Config.ConvergenceThreshold);
+        }
+        HostAttitudeTrack_Free(&Reference);
+    }
+    HostAttitudeTrack_Free(&Output);
+    HostImuLog_Free(&Log);
+    return Result.Finite ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,35 @@
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+/* Host stand-in for the FreeRTOS kernel headers: same names and types, implemented by host/host_rtos.c on one thread */
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+typedef struct HostQueue *QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef struct HostTask *TaskHandle_t;
+
+#define pdFALSE                     ((BaseType_t)0)
+#define pdTRUE                      ((BaseType_t)1)
+#define pdPASS                      pdTRUE
+#define pdFAIL                      pdFALSE
+#define portMAX_DELAY               ((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ          1000
+#define pdMS_TO_TICKS(Ms)           ((TickType_t)(((TickType_t)(Ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000))
+#define portYIELD_FROM_ISR(Woken)   ((void)(Woken))
+
+#define taskENTER_CRITICAL()        HostRtos_EnterCritical()
+#define taskEXIT_CRITICAL()         HostRtos_ExitCritical()
+
+extern uint32_t SystemCoreClock;
+
+void HostRtos_EnterCritical (void);
+void HostRtos_ExitCritical (void);
+
+#endif /* INC_FREERTOS_H */
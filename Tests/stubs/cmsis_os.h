@@ -0,0 +1,43 @@
+#ifndef _CMSIS_OS_H
+#define _CMSIS_OS_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+typedef TaskHandle_t osThreadId;
+
+typedef enum {
+    osPriorityIdle          = -3,
+    osPriorityLow           = -2,
+    osPriorityBelowNormal   = -1,
+    osPriorityNormal        =  0,
+    osPriorityAboveNormal   = +1,
+    osPriorityHigh          = +2,
+    osPriorityRealtime      = +3,
+} osPriority;
+
+typedef enum {
+    osOK                    = 0,
+    osEventTimeout          = 0x40,
+} osStatus;
+
+typedef void (*os_pthread) (void const *argument);
+
+typedef struct os_thread_def {
+    const char *name;
+    os_pthread pthread;
+    osPriority tpriority;
+    uint32_t instances;
+    uint32_t stacksize;
+} osThreadDef_t;
+
+#define osThreadDef(name, thread, priority, instances, stacksz) \
+    const osThreadDef_t os_thread_def_##name = { #name, (thread), (priority), (instances), (stacksz) }
+#define osThread(name)              &os_thread_def_##name
+
+/* Host tasks are not run, see host_rtos.h */
+osThreadId osThreadCreate (const osThreadDef_t *thread_def, void *argument);
+osStatus osDelay (uint32_t millisec);
+
+#endif /* _CMSIS_OS_H */
@@ -0,0 +1,6 @@
+#ifndef __GPIO_H
+#define __GPIO_H
+
+#include "main.h"
+
+#endif /* __GPIO_H */
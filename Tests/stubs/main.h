@@ -0,0 +1,142 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/* Host stand-in for the Cube generated main.h and the device header: register blocks are plain structs in RAM,
+ * peripheral behaviour is modelled in host/host_spi.c and host/host_hal.c */
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+
+#define __IO volatile
+
+#define READ_BIT(REG, BIT)      ((REG) & (BIT))
+#define SET_BIT(REG, BIT)       ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)     ((REG) &= ~(BIT))
+#define WRITE_REG(REG, VAL)     ((REG) = (VAL))
+#define READ_REG(REG)           ((REG))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)  WRITE_REG((REG), (((READ_REG(REG)) & (~(CLEARMASK))) | (SETMASK)))
+
+/* GPIO */
+typedef struct {
+    __IO uint32_t ODR;
+    __IO uint32_t IDR;
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+extern GPIO_TypeDef HostGpio[3];
+#define GPIOA                   (&HostGpio[0])
+#define GPIOB                   (&HostGpio[1])
+#define GPIOC                   (&HostGpio[2])
+
+#define GPIO_PIN_0              ((uint16_t)0x0001)
+#define GPIO_PIN_1              ((uint16_t)0x0002)
+#define GPIO_PIN_2              ((uint16_t)0x0004)
+#define GPIO_PIN_3              ((uint16_t)0x0008)
+#define GPIO_PIN_4              ((uint16_t)0x0010)
+#define GPIO_PIN_5              ((uint16_t)0x0020)
+#define GPIO_PIN_6              ((uint16_t)0x0040)
+#define GPIO_PIN_7              ((uint16_t)0x0080)
+#define GPIO_PIN_8              ((uint16_t)0x0100)
+#define GPIO_PIN_12             ((uint16_t)0x1000)
+#define GPIO_AF1_TIM2           1
+#define GPIO_AF2_TIM1           2
+#define GPIO_AF2_TIM3           2
+#define GPIO_MODE_AF_PP         2
+#define GPIO_NOPULL             0
+#define GPIO_SPEED_FREQ_LOW     0
+
+void HAL_GPIO_Init (GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin (GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin (GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE()
+#define __HAL_RCC_GPIOB_CLK_ENABLE()
+#define __HAL_RCC_GPIOC_CLK_ENABLE()
+#define __HAL_RCC_TIM1_CLK_ENABLE()
+#define __HAL_RCC_TIM2_CLK_ENABLE()
+#define __HAL_RCC_TIM3_CLK_ENABLE()
+
+/* SPI, DMA and timers: only the registers the LL stand-ins touch */
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SR;
+    __IO uint32_t DR;
+} SPI_TypeDef;
+
+typedef struct {
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+    __IO uint32_t CPAR;
+    __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    __IO uint32_t ISR;
+    __IO uint32_t IFCR;
+    DMA_Channel_TypeDef Channel[7];
+} DMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t ARR;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+} TIM_TypeDef;
+
+extern SPI_TypeDef HostSpi[3];
+extern DMA_TypeDef HostDma[1];
+extern TIM_TypeDef HostTim[3];
+#define SPI1                    (&HostSpi[0])
+#define SPI2                    (&HostSpi[1])
+#define SPI3                    (&HostSpi[2])
+#define DMA1                    (&HostDma[0])
+#define TIM1                    (&HostTim[0])
+#define TIM2                    (&HostTim[1])
+#define TIM3                    (&HostTim[2])
+
+#define DMA_ISR_TCIF1           (1UL << 1)
+#define DMA_IFCR_CGIF1          (1UL << 0)
+
+typedef struct {
+    SPI_TypeDef *Instance;
+} SPI_HandleTypeDef;
+
+/* Cycle counter is advanced by the bus and tick models, not by code execution */
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type HostDwt;
+extern CoreDebug_Type HostCoreDebug;
+#define DWT                     (&HostDwt)
+#define CoreDebug               (&HostCoreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk  (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+
+void Error_Handler (void);
+
+#endif /* __MAIN_H */
@@ -0,0 +1,15 @@
+#ifndef INC_QUEUE_H
+#define INC_QUEUE_H
+
+#include "FreeRTOS.h"
+
+
+QueueHandle_t xQueueCreate (UBaseType_t Length, UBaseType_t ItemSize);
+BaseType_t xQueueSend (QueueHandle_t Queue, const void *Item, TickType_t Ticks);
+BaseType_t xQueueSendFromISR (QueueHandle_t Queue, const void *Item, BaseType_t *HigherPriorityTaskWoken);
+BaseType_t xQueueReceive (QueueHandle_t Queue, void *Item, TickType_t Ticks);
+BaseType_t xQueueReceiveFromISR (QueueHandle_t Queue, void *Item, BaseType_t *HigherPriorityTaskWoken);
+UBaseType_t uxQueueMessagesWaiting (QueueHandle_t Queue);
+UBaseType_t uxQueueMessagesWaitingFromISR (QueueHandle_t Queue);
+
+#endif /* INC_QUEUE_H */
@@ -0,0 +1,14 @@
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex (void);
+SemaphoreHandle_t xSemaphoreCreateBinary (void);
+BaseType_t xSemaphoreTake (SemaphoreHandle_t Semaphore, TickType_t Ticks);
+BaseType_t xSemaphoreGive (SemaphoreHandle_t Semaphore);
+BaseType_t xSemaphoreGiveFromISR (SemaphoreHandle_t Semaphore, BaseType_t *HigherPriorityTaskWoken);
+
+#endif /* SEMAPHORE_H */
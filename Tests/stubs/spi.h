@@ -0,0 +1,6 @@
+#ifndef __SPI_H
+#define __SPI_H
+
+#include "main.h"
+
+#endif /* __SPI_H */
@@ -0,0 +1,6 @@
+#ifndef __STM32F3XX_H
+#define __STM32F3XX_H
+
+#include "main.h"
+
+#endif /* __STM32F3XX_H */
@@ -0,0 +1,6 @@
+#ifndef __STM32F3xx_IT_H
+#define __STM32F3xx_IT_H
+
+/* Interrupt entry points are called by the host peripheral models instead */
+
+#endif /* __STM32F3xx_IT_H */
@@ -0,0 +1,79 @@
+#ifndef __STM32F3xx_LL_DMA_H
+#define __STM32F3xx_LL_DMA_H
+
+/* Host stand-in for the LL DMA driver, channels are numbered from 1 as on the device; transfers are run by
+ * host/host_spi.c when the SPI raises its TX request */
+
+#include "main.h"
+
+
+#define DMA_CCR_EN                      (1UL << 0)
+#define DMA_CCR_TCIE                    (1UL << 1)
+#define DMA_CCR_DIR                     (1UL << 4)
+#define DMA_CCR_CIRC                    (1UL << 5)
+#define DMA_CCR_PINC                    (1UL << 6)
+#define DMA_CCR_MINC                    (1UL << 7)
+#define DMA_CCR_PSIZE                   (3UL << 8)
+#define DMA_CCR_MSIZE                   (3UL << 10)
+#define DMA_CCR_PL                      (3UL << 12)
+
+#define LL_DMA_CHANNEL_1                1UL
+#define LL_DMA_CHANNEL_2                2UL
+#define LL_DMA_CHANNEL_3                3UL
+#define LL_DMA_CHANNEL_4                4UL
+#define LL_DMA_CHANNEL_5                5UL
+#define LL_DMA_CHANNEL_6                6UL
+#define LL_DMA_CHANNEL_7                7UL
+
+#define LL_DMA_DIRECTION_PERIPH_TO_MEMORY   0UL
+#define LL_DMA_DIRECTION_MEMORY_TO_PERIPH   DMA_CCR_DIR
+#define LL_DMA_MODE_NORMAL              0UL
+#define LL_DMA_PERIPH_NOINCREMENT       0UL
+#define LL_DMA_MEMORY_NOINCREMENT       0UL
+#define LL_DMA_MEMORY_INCREMENT         DMA_CCR_MINC
+#define LL_DMA_PDATAALIGN_BYTE          0UL
+#define LL_DMA_PDATAALIGN_HALFWORD      (1UL << 8)
+#define LL_DMA_MDATAALIGN_BYTE          0UL
+#define LL_DMA_MDATAALIGN_HALFWORD      (1UL << 10)
+#define LL_DMA_PRIORITY_MEDIUM          (1UL << 12)
+#define LL_DMA_PRIORITY_HIGH            (2UL << 12)
+
+
+static inline void LL_DMA_ConfigTransfer (DMA_TypeDef *DMAx, uint32_t Channel, uint32_t Configuration) {
+    MODIFY_REG(DMAx->Channel[Channel - 1].CCR,
+               DMA_CCR_DIR | DMA_CCR_CIRC | DMA_CCR_PINC | DMA_CCR_MINC | DMA_CCR_PSIZE | DMA_CCR_MSIZE | DMA_CCR_PL,
+               Configuration);
+}
+
+static inline void LL_DMA_ConfigAddresses (DMA_TypeDef *DMAx, uint32_t Channel, uint32_t SrcAddress, uint32_t DstAddress,
+                                           uint32_t Direction) {
+    if (Direction == LL_DMA_DIRECTION_MEMORY_TO_PERIPH) {
+        DMAx->Channel[Channel - 1].CMAR = SrcAddress;
+        DMAx->Channel[Channel - 1].CPAR = DstAddress;
+    } else {
+        DMAx->Channel[Channel - 1].CPAR = SrcAddress;
+        DMAx->Channel[Channel - 1].CMAR = DstAddress;
+    }
+}
+
+static inline void LL_DMA_SetDataLength (DMA_TypeDef *DMAx, uint32_t Channel, uint32_t NbData) {
+    DMAx->Channel[Channel - 1].CNDTR = NbData;
+}
+
+static inline void LL_DMA_EnableChannel (DMA_TypeDef *DMAx, uint32_t Channel) {
+    SET_BIT(DMAx->Channel[Channel - 1].CCR, DMA_CCR_EN);
+}
+
+static inline void LL_DMA_DisableChannel (DMA_TypeDef *DMAx, uint32_t Channel) {
+    CLEAR_BIT(DMAx->Channel[Channel - 1].CCR, DMA_CCR_EN);
+}
+
+static inline void LL_DMA_EnableIT_TC (DMA_TypeDef *DMAx, uint32_t Channel) {
+    SET_BIT(DMAx->Channel[Channel - 1].CCR, DMA_CCR_TCIE);
+}
+
+static inline void LL_DMA_DisableIT_TC (DMA_TypeDef *DMAx, uint32_t Channel) {
+    CLEAR_BIT(DMAx->Channel[Channel - 1].CCR, DMA_CCR_TCIE);
+}
+
+#endif /* __STM32F3xx_LL_DMA_H */
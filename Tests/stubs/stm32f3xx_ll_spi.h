@@ -0,0 +1,135 @@
+#ifndef __STM32F3xx_LL_SPI_H
+#define __STM32F3xx_LL_SPI_H
+
+/* Host stand-in for the LL SPI driver: register bits as on the device, side effects that start bus activity are
+ * forwarded to host/host_spi.c */
+
+#include "main.h"
+
+
+#define SPI_CR1_CPHA                    (1UL << 0)
+#define SPI_CR1_CPOL                    (1UL << 1)
+#define SPI_CR1_BR                      (7UL << 3)
+#define SPI_CR1_SPE                     (1UL << 6)
+#define SPI_CR2_RXDMAEN                 (1UL << 0)
+#define SPI_CR2_TXDMAEN                 (1UL << 1)
+#define SPI_CR2_RXNEIE                  (1UL << 6)
+#define SPI_CR2_TXEIE                   (1UL << 7)
+#define SPI_CR2_DS                      (15UL << 8)
+#define SPI_CR2_FRXTH                   (1UL << 12)
+#define SPI_SR_RXNE                     (1UL << 0)
+#define SPI_SR_TXE                      (1UL << 1)
+
+#define LL_SPI_PHASE_1EDGE              0UL
+#define LL_SPI_PHASE_2EDGE              SPI_CR1_CPHA
+#define LL_SPI_POLARITY_LOW             0UL
+#define LL_SPI_POLARITY_HIGH            SPI_CR1_CPOL
+#define LL_SPI_BAUDRATEPRESCALER_DIV2   (0UL << 3)
+#define LL_SPI_BAUDRATEPRESCALER_DIV4   (1UL << 3)
+#define LL_SPI_BAUDRATEPRESCALER_DIV8   (2UL << 3)
+#define LL_SPI_BAUDRATEPRESCALER_DIV16  (3UL << 3)
+#define LL_SPI_DATAWIDTH_8BIT           (7UL << 8)
+#define LL_SPI_DATAWIDTH_16BIT          (15UL << 8)
+#define LL_SPI_RX_FIFO_TH_HALF          0UL
+#define LL_SPI_RX_FIFO_TH_QUARTER       SPI_CR2_FRXTH
+
+/* host/host_spi.c */
+void HostSpi_ConfigWrite (SPI_TypeDef *SPIx);
+void HostSpi_StartTxInterrupts (SPI_TypeDef *SPIx);
+void HostSpi_Transmit (SPI_TypeDef *SPIx, uint16_t Frame);
+void HostSpi_StartDma (SPI_TypeDef *SPIx);
+
+
+static inline void LL_SPI_Enable (SPI_TypeDef *SPIx) {
+    SET_BIT(SPIx->CR1, SPI_CR1_SPE);
+    SET_BIT(SPIx->SR, SPI_SR_TXE);
+}
+
+static inline void LL_SPI_Disable (SPI_TypeDef *SPIx) {
+    CLEAR_BIT(SPIx->CR1, SPI_CR1_SPE);
+}
+
+static inline void LL_SPI_SetBaudRatePrescaler (SPI_TypeDef *SPIx, uint32_t BaudRate) {
+    HostSpi_ConfigWrite(SPIx);
+    MODIFY_REG(SPIx->CR1, SPI_CR1_BR, BaudRate);
+}
+
+static inline void LL_SPI_SetClockPolarity (SPI_TypeDef *SPIx, uint32_t ClockPolarity) {
+    HostSpi_ConfigWrite(SPIx);
+    MODIFY_REG(SPIx->CR1, SPI_CR1_CPOL, ClockPolarity);
+}
+
+static inline void LL_SPI_SetClockPhase (SPI_TypeDef *SPIx, uint32_t ClockPhase) {
+    HostSpi_ConfigWrite(SPIx);
+    MODIFY_REG(SPIx->CR1, SPI_CR1_CPHA, ClockPhase);
+}
+
+static inline void LL_SPI_SetDataWidth (SPI_TypeDef *SPIx, uint32_t DataWidth) {
+    HostSpi_ConfigWrite(SPIx);
+    MODIFY_REG(SPIx->CR2, SPI_CR2_DS, DataWidth);
+}
+
+static inline void LL_SPI_SetRxFIFOThreshold (SPI_TypeDef *SPIx, uint32_t Threshold) {
+    MODIFY_REG(SPIx->CR2, SPI_CR2_FRXTH, Threshold);
+}
+
+static inline uint32_t LL_SPI_IsActiveFlag_RXNE (SPI_TypeDef *SPIx) {
+    return (READ_BIT(SPIx->SR, SPI_SR_RXNE) != 0);
+}
+
+static inline uint32_t LL_SPI_IsActiveFlag_TXE (SPI_TypeDef *SPIx) {
+    return (READ_BIT(SPIx->SR, SPI_SR_TXE) != 0);
+}
+
+static inline uint8_t LL_SPI_ReceiveData8 (SPI_TypeDef *SPIx) {
+    CLEAR_BIT(SPIx->SR, SPI_SR_RXNE);
+    return (uint8_t)SPIx->DR;
+}
+
+static inline void LL_SPI_TransmitData8 (SPI_TypeDef *SPIx, uint8_t TxData) {
+    HostSpi_Transmit(SPIx, TxData);
+}
+
+static inline void LL_SPI_EnableIT_RXNE (SPI_TypeDef *SPIx) {
+    SET_BIT(SPIx->CR2, SPI_CR2_RXNEIE);
+}
+
+static inline void LL_SPI_DisableIT_RXNE (SPI_TypeDef *SPIx) {
+    CLEAR_BIT(SPIx->CR2, SPI_CR2_RXNEIE);
+}
+
+static inline uint32_t LL_SPI_IsEnabledIT_TXE (SPI_TypeDef *SPIx) {
+    return (READ_BIT(SPIx->CR2, SPI_CR2_TXEIE) != 0);
+}
+
+static inline void LL_SPI_EnableIT_TXE (SPI_TypeDef *SPIx) {
+    SET_BIT(SPIx->CR2, SPI_CR2_TXEIE);
+    HostSpi_StartTxInterrupts(SPIx);
+}
+
+static inline void LL_SPI_DisableIT_TXE (SPI_TypeDef *SPIx) {
+    CLEAR_BIT(SPIx->CR2, SPI_CR2_TXEIE);
+}
+
+static inline void LL_SPI_EnableDMAReq_RX (SPI_TypeDef *SPIx) {
+    SET_BIT(SPIx->CR2, SPI_CR2_RXDMAEN);
+}
+
+static inline void LL_SPI_DisableDMAReq_RX (SPI_TypeDef *SPIx) {
+    CLEAR_BIT(SPIx->CR2, SPI_CR2_RXDMAEN);
+}
+
+static inline void LL_SPI_EnableDMAReq_TX (SPI_TypeDef *SPIx) {
+    SET_BIT(SPIx->CR2, SPI_CR2_TXDMAEN);
+    HostSpi_StartDma(SPIx);
+}
+
+static inline void LL_SPI_DisableDMAReq_TX (SPI_TypeDef *SPIx) {
+    CLEAR_BIT(SPIx->CR2, SPI_CR2_TXDMAEN);
+}
+
+static inline uint32_t LL_SPI_DMA_GetRegAddr (SPI_TypeDef *SPIx) {
+    return (uint32_t)(uintptr_t)&(SPIx->DR);
+}
+
+#endif /* __STM32F3xx_LL_SPI_H */
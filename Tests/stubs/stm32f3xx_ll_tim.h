@@ -0,0 +1,123 @@
+#ifndef __STM32F3xx_LL_TIM_H
+#define __STM32F3xx_LL_TIM_H
+
+/* Host stand-in for the LL TIM driver: counter, compare and slave mode registers only, channel and output enables
+ * have no register here. A counter started with trigger output enabled starts every timer in trigger slave mode,
+ * which is how TIM1 starts TIM2 and TIM3 over ITR0. */
+
+#include "main.h"
+
+
+#define TIM_CR1_CEN                     (1UL << 0)
+#define TIM_CR1_CMS                     (3UL << 5)
+#define TIM_CR2_MMS                     (7UL << 4)
+#define TIM_SMCR_SMS                    (7UL << 0)
+#define TIM_SMCR_TS                     (7UL << 4)
+
+#define LL_TIM_CHANNEL_CH1              (1UL << 0)
+#define LL_TIM_CHANNEL_CH2              (1UL << 4)
+#define LL_TIM_CHANNEL_CH3              (1UL << 8)
+#define LL_TIM_COUNTERMODE_CENTER_UP    (2UL << 5)
+#define LL_TIM_OCMODE_PWM1              (6UL << 4)
+#define LL_TIM_OCPOLARITY_HIGH          0UL
+#define LL_TIM_TS_ITR0                  (0UL << 4)
+#define LL_TIM_SLAVEMODE_TRIGGER        (6UL << 0)
+#define LL_TIM_TRGO_ENABLE              (1UL << 4)
+
+#define IS_TIM_BREAK_INSTANCE(INSTANCE) ((INSTANCE) == TIM1)
+
+static inline void LL_TIM_OC_SetCompareCH1 (TIM_TypeDef *TIMx, uint32_t CompareValue) {
+    TIMx->CCR1 = CompareValue;
+}
+
+static inline void LL_TIM_OC_SetCompareCH2 (TIM_TypeDef *TIMx, uint32_t CompareValue) {
+    TIMx->CCR2 = CompareValue;
+}
+
+static inline void LL_TIM_OC_SetCompareCH3 (TIM_TypeDef *TIMx, uint32_t CompareValue) {
+    TIMx->CCR3 = CompareValue;
+}
+
+static inline void LL_TIM_EnableCounter (TIM_TypeDef *TIMx) {
+    SET_BIT(TIMx->CR1, TIM_CR1_CEN);
+    if (READ_BIT(TIMx->CR2, TIM_CR2_MMS) == LL_TIM_TRGO_ENABLE) {
+        for (unsigned int i = 0; i < sizeof(HostTim) / sizeof(HostTim[0]); i++) {
+            if (READ_BIT(HostTim[i].SMCR, TIM_SMCR_SMS) == LL_TIM_SLAVEMODE_TRIGGER) {
+                SET_BIT(HostTim[i].CR1, TIM_CR1_CEN);
+            }
+        }
+    }
+}
+
+static inline void LL_TIM_DisableCounter (TIM_TypeDef *TIMx) {
+    CLEAR_BIT(TIMx->CR1, TIM_CR1_CEN);
+}
+
+static inline uint32_t LL_TIM_IsEnabledCounter (TIM_TypeDef *TIMx) {
+    return (READ_BIT(TIMx->CR1, TIM_CR1_CEN) == TIM_CR1_CEN) ? 1UL : 0UL;
+}
+
+static inline void LL_TIM_SetCounterMode (TIM_TypeDef *TIMx, uint32_t CounterMode) {
+    MODIFY_REG(TIMx->CR1, TIM_CR1_CMS, CounterMode);
+}
+
+static inline void LL_TIM_SetPrescaler (TIM_TypeDef *TIMx, uint32_t Prescaler) {
+    TIMx->PSC = Prescaler;
+}
+
+static inline void LL_TIM_SetAutoReload (TIM_TypeDef *TIMx, uint32_t AutoReload) {
+    TIMx->ARR = AutoReload;
+}
+
+static inline void LL_TIM_SetCounter (TIM_TypeDef *TIMx, uint32_t Counter) {
+    TIMx->CNT = Counter;
+}
+
+static inline void LL_TIM_SetTriggerInput (TIM_TypeDef *TIMx, uint32_t TriggerInput) {
+    MODIFY_REG(TIMx->SMCR, TIM_SMCR_TS, TriggerInput);
+}
+
+static inline void LL_TIM_SetSlaveMode (TIM_TypeDef *TIMx, uint32_t SlaveMode) {
+    MODIFY_REG(TIMx->SMCR, TIM_SMCR_SMS, SlaveMode);
+}
+
+static inline void LL_TIM_SetTriggerOutput (TIM_TypeDef *TIMx, uint32_t TimerSynchronization) {
+    MODIFY_REG(TIMx->CR2, TIM_CR2_MMS, TimerSynchronization);
+}
+
+/* No register behind these on host */
+static inline void LL_TIM_EnableARRPreload (TIM_TypeDef *TIMx) {
+    (void)TIMx;
+}
+
+static inline void LL_TIM_OC_SetMode (TIM_TypeDef *TIMx, uint32_t Channel, uint32_t Mode) {
+    (void)TIMx;
+    (void)Channel;
+    (void)Mode;
+}
+
+static inline void LL_TIM_OC_SetPolarity (TIM_TypeDef *TIMx, uint32_t Channel, uint32_t Polarity) {
+    (void)TIMx;
+    (void)Channel;
+    (void)Polarity;
+}
+
+static inline void LL_TIM_OC_EnablePreload (TIM_TypeDef *TIMx, uint32_t Channel) {
+    (void)TIMx;
+    (void)Channel;
+}
+
+static inline void LL_TIM_GenerateEvent_UPDATE (TIM_TypeDef *TIMx) {
+    (void)TIMx;
+}
+
+static inline void LL_TIM_CC_EnableChannel (TIM_TypeDef *TIMx, uint32_t Channels) {
+    (void)TIMx;
+    (void)Channels;
+}
+
+static inline void LL_TIM_EnableAllOutputs (TIM_TypeDef *TIMx) {
+    (void)TIMx;
+}
+
+#endif /* __STM32F3xx_LL_TIM_H */
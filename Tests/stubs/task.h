@@ -0,0 +1,13 @@
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+#include "FreeRTOS.h"
+
+
+void vTaskDelay (TickType_t Ticks);
+TickType_t xTaskGetTickCount (void);
+TaskHandle_t xTaskGetCurrentTaskHandle (void);
+uint32_t ulTaskNotifyTake (BaseType_t ClearCountOnExit, TickType_t Ticks);
+void vTaskNotifyGiveFromISR (TaskHandle_t Task, BaseType_t *HigherPriorityTaskWoken);
+
+#endif /* INC_TASK_H */
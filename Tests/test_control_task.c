@@ -0,0 +1,196 @@
+/* Core/Src/freertos.c on the host kernel model: StartDefaultTask brings the device up and waits on the console, and
+ * while it waits the control task runs off MPU data ready at 1 kHz, which is what its realtime priority gives it on
+ * target. The FreeRTOS POSIX port is not in the tree (Middlewares has the RVDS ARM_CM4F port and MemMang only), so
+ * both tasks run on this thread: the block hook starts the control task and serves its data ready waits, the task
+ * loops are left with longjmp. Periods with two data ready, a late start and a missing interrupt are injected and
+ * LoopStats is read back directly and over the "loop" console command. */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "mpu9250_api.h"
+#include "timing_stats_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_spi.h"
+#include "host_mpu9250.h"
+#include "host_as5048.h"
+#include "host_console.h"
+#include "host_test.h"
+
+
+#define PERIODS                     2000        // data ready interrupts raised, 2 s at 1 kHz
+#define SKIP_AT                     500         // period that sees a second data ready before it runs
+#define LATE_AT                     1000        // period that starts this late after its data ready
+#define LATE_US                     1200
+#define TIMEOUT_AT                  1500        // no data ready, the wait runs into IMU_DATA_READY_TIMEOUT
+#define DATA_READY_TIMEOUT          100         // ticks, IMU_DATA_READY_TIMEOUT in freertos.c
+#define ACC_ONE_G                   4096        // +-8 g range
+
+typedef enum {
+    eTaskPhase_First,
+    eTaskPhase_Boot = eTaskPhase_First,     // default task bring-up, waits just let time pass
+    eTaskPhase_Control,                     // control task running from the default task's console wait
+    eTaskPhase_LoopCommand,                 // "loop" typed, next console wait checks its output
+    eTaskPhase_ResetCommand,                // "loop reset" typed, next console wait ends the default task
+    eTaskPhase_Last,
+} eTaskPhase_t;
+
+void MX_FREERTOS_Init(void);
+void StartDefaultTask(void const * argument);
+void StartControlTask(void const * argument);
+extern osThreadId controlTaskHandle;
+
+static sHostMpu_t g_Mpu;
+static sHostAs5048_t g_Chain;
+static jmp_buf g_DefaultTaskExit;
+static jmp_buf g_ControlTaskExit;
+static eTaskPhase_t g_Phase;
+static unsigned int g_Waits;                // control task data ready waits so far
+static unsigned int g_OtherWaits;           // control task blocking on anything else
+static sLoopStats_t g_AfterControl;
+static sLoopStats_t g_AfterReset;
+static char g_StartOutput[4096];           // bring-up and control task output
+static char g_LoopOutput[512];
+
+
+/* Still, level, gravity on Z */
+static void SetImuSample (void) {
+    const int16_t Acc[3] = {0, 0, ACC_ONE_G};
+    const int16_t Gyr[3] = {0, 0, 0};
+    const int16_t Mag[3] = {0, 0, 0};
+    HostMpu_SetSample(&g_Mpu, Acc, Gyr, Mag, false, false);
+}
+
+/* Next period's data ready comes one tick after the previous period's work, the interval is a tick plus the modelled
+ * bus time of that work */
+static void ServeControlWait (TickType_t Ticks) {
+    if (Ticks != DATA_READY_TIMEOUT) {
+        g_OtherWaits++;
+        return;
+    }
+    unsigned int Period = g_Waits++;
+    if (Period == PERIODS + 1) {
+        longjmp(g_ControlTaskExit, 1);
+    }
+    if (Period == TIMEOUT_AT) {
+        return;
+    }
+    HostRtos_AdvanceTicks(1);
+    SetImuSample();
+    HandleExt3IRQ();
+    if (Period == SKIP_AT) {
+        HostRtos_AdvanceTicks(1);
+        HandleExt3IRQ();
+    }
+    if (Period == LATE_AT) {
+        HostHal_AdvanceCycles(UsToCycles(LATE_US));
+    }
+}
+
+static void BlockHook (TickType_t Ticks) {
+    switch (g_Phase) {
+        case eTaskPhase_Boot:
+            if (controlTaskHandle != NULL) {
+                /* First console wait, the control task takes over until it is stopped */
+                g_Phase = eTaskPhase_Control;
+                if (setjmp(g_ControlTaskExit) == 0) {
+                    StartControlTask(NULL);
+                }
+                LoopStatsGet(&g_AfterControl);
+                snprintf(g_StartOutput, sizeof(g_StartOutput), "%s", HostHal_CaptureGet());
+                HostHal_CaptureStart();
+                g_Phase = eTaskPhase_LoopCommand;
+                HostConsole_Type("loop\r");
+            }
+            break;
+        case eTaskPhase_Control:
+            ServeControlWait(Ticks);
+            break;
+        case eTaskPhase_LoopCommand:
+            snprintf(g_LoopOutput, sizeof(g_LoopOutput), "%s", HostHal_CaptureGet());
+            g_Phase = eTaskPhase_ResetCommand;
+            HostConsole_Type("loop reset\r");
+            break;
+        default:
+            LoopStatsGet(&g_AfterReset);
+            longjmp(g_DefaultTaskExit, 1);
+            break;
+    }
+}
+
+static void Setup (void) {
+    HostSpi_Reset();
+    HostMpu_Init(&g_Mpu);
+    HostMpu_Attach(&g_Mpu, SPI1, GPIOA, GPIO_PIN_4);
+    HostAs5048_Init(&g_Chain, 3);
+    HostAs5048_Attach(&g_Chain, SPI2, GPIOB, GPIO_PIN_12);
+    for (unsigned int i = 0; i < g_Chain.Count; i++) {
+        g_Chain.Device[i].Angle = (uint16_t)(1000 + 3000 * i);
+    }
+    HostRtos_SetBlockHook(BlockHook);
+}
+
+static void TestTasks (void) {
+    sHostRtosStats_t Rtos;
+    HostHal_SetQuiet(true);
+    HostHal_CaptureStart();
+    MX_FREERTOS_Init();
+    if (setjmp(g_DefaultTaskExit) == 0) {
+        StartDefaultTask(NULL);
+    }
+    HostHal_SetQuiet(false);
+    HostRtos_GetStats(&Rtos);
+    CHECK(g_Phase == eTaskPhase_ResetCommand);
+    CHECK(HostRtos_GetCriticalNesting() == 0);
+    CHECK(strstr(g_StartOutput, "Serial communication is online\n") != NULL);
+    CHECK(strstr(g_StartOutput, "initialization failed") == NULL);
+    CHECK(strstr(g_StartOutput, "Motor drive: FOC\n") != NULL);
+    CHECK(strstr(g_StartOutput, "Device initialization complete\n") != NULL);
+    CHECK(strstr(g_StartOutput, "ERROR: MPU data ready timeout\n") != NULL);
+
+    /* Every period ran from a data ready wait, nothing else in the control path blocked */
+    CHECK(g_Waits == PERIODS + 2);
+    CHECK(g_OtherWaits == 0);
+    CHECK(Rtos.NotifyGives == PERIODS + 1);
+    printf("LOOP after %u periods: n=%u miss=%u skip=%u exec=%u/%uus jit=%u/%uus\n", PERIODS,
+           (unsigned int)g_AfterControl.Periods, (unsigned int)g_AfterControl.DeadlineMisses,
+           (unsigned int)g_AfterControl.SkippedPeriods, (unsigned int)g_AfterControl.LastExecutionUs,
+           (unsigned int)g_AfterControl.MaxExecutionUs, (unsigned int)g_AfterControl.LastStartJitterUs,
+           (unsigned int)g_AfterControl.MaxStartJitterUs);
+    /* Timed out wait records no period; the skip and the late start are the only misses */
+    CHECK(g_AfterControl.Periods == PERIODS);
+    CHECK(g_AfterControl.SkippedPeriods == 1);
+    CHECK(g_AfterControl.DeadlineMisses == 2);
+    CHECK((g_AfterControl.MaxStartJitterUs >= LATE_US) && (g_AfterControl.MaxStartJitterUs < LATE_US + 10));
+    CHECK(g_AfterControl.LastStartJitterUs < 10);
+    /* Host time only moves with the bus models: IMU burst and one encoder chain read per period */
+    CHECK((g_AfterControl.MaxExecutionUs > 0) && (g_AfterControl.MaxExecutionUs < 1000));
+
+    /* Console: the same counters and the cost histogram, then cleared */
+    char Expected[128];
+    snprintf(Expected, sizeof(Expected), "LOOP n=%u miss=2 skip=1 exec=%u/%uus jit=%u/%uus\n", PERIODS,
+             (unsigned int)g_AfterControl.LastExecutionUs, (unsigned int)g_AfterControl.MaxExecutionUs,
+             (unsigned int)g_AfterControl.LastStartJitterUs, (unsigned int)g_AfterControl.MaxStartJitterUs);
+    printf("%s", g_LoopOutput);
+    CHECK(strstr(g_LoopOutput, Expected) != NULL);
+    CHECK(strstr(g_LoopOutput, "CTL") != NULL);
+    /* Still at boot: the gyro bias calibrates well before the timeout that would close the loop without it */
+    CHECK(strstr(g_LoopOutput, "BIAS done") != NULL);
+    CHECK(strstr(g_LoopOutput, "BIAS timeout") == NULL);
+    CHECK(strstr(HostHal_CaptureGet(), "LOOP counters cleared\n") != NULL);
+    CHECK((g_AfterReset.Periods == 0) && (g_AfterReset.DeadlineMisses == 0) && (g_AfterReset.MaxExecutionUs == 0));
+    sTimingHistogram_t ControlCost;
+    CHECK(TimingHistogramGet(eTimingHistogram_ControlCost, &ControlCost) && (ControlCost.Count == 0));
+    HostHal_CaptureStop();
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    Setup();
+    TestTasks();
+    return HostTest_Result("control_task");
+}
@@ -0,0 +1,432 @@
+/* Field oriented drive of foc_api.c on three simulated gimbal motors, angles read back through encoder_api.c and the
+ * AS5048A chain model on SPI2 so every sample is one read old as on target, voltages taken from the HostTim compare
+ * registers motor_api.c writes. Covers the encoder pipeline on its own (late frames, parity errors, error flag clear),
+ * alignment, torque in voltage and current mode, the torque angle against speed, latency compensation and control
+ * rate, the current loop step, bridging of missing samples, and the cost of one update. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "spi_api.h"
+#include "message_queue_api.h"
+#include "motor_api.h"
+#include "encoder_api.h"
+#include "foc_api.h"
+#include "host_hal.h"
+#include "host_spi.h"
+#include "host_as5048.h"
+#include "host_test.h"
+
+
+#define TWO_PI                      6.283185307179586
+#define RAD_TO_DEG                  57.29577951308232
+#define POLE_PAIRS                  7           // HARDCODED_POLE_PAIRS
+#define RESISTANCE                  5.0         // ohm, HARDCODED_PHASE_RESISTANCE
+#define INDUCTANCE                  1.5e-3      // H, not in the controller config, voltage mode does not use it
+#define BACK_EMF                    0.25        // V s/rad, HARDCODED_BACK_EMF
+#define BUS_VOLTAGE                 12.0
+#define INERTIA                     2.0e-4      // kg m^2, same stage as host_gimbal
+#define DAMPING                     0.002       // N m s/rad
+#define PWM_PERIOD                  1800.0
+#define SUBSTEPS                    40          // electrical time constant is 0.3 ms
+#define ENCODER_COUNTS              16384.0
+#define BENCHMARK_STEPS             100000
+
+/* Chain position of each motor, mirrors encoder_api.c */
+static const unsigned int g_Position[eMotor_Last] = {2, 1, 0};
+static TIM_TypeDef *const g_Timer[eMotor_Last] = {TIM1, TIM2, TIM3};
+
+typedef struct {
+    double Angle;                       // rad, mechanical
+    double Velocity;                    // rad/s, mechanical
+    double Current[2];                  // A, alpha and beta
+    double Offset;                      // rad, electrical angle at encoder zero
+    double Resistance;                  // ohm
+    bool Free;                          // turns under its own torque, otherwise velocity is held
+} sMotorPlant_t;
+
+typedef struct {
+    sFocConfig_t Config;
+    sFoc_t Foc;
+    sMotorPlant_t Plant[eMotor_Last];
+    sEncoderSample_t Samples[eMotor_Last];
+    float Command[eMotor_Last];
+    bool CurrentMode;
+} sDrive_t;
+
+static sHostAs5048_t g_Chain;
+
+
+static sHostAs5048Device_t *MotorDevice (eMotor_t Motor) {
+    return &g_Chain.Device[g_Chain.Count - 1 - g_Position[Motor]];
+}
+
+static double WrapPi (double Angle) {
+    return Angle - TWO_PI * floor(Angle / TWO_PI + 0.5);
+}
+
+static double ElectricalAngle (const sMotorPlant_t *Plant) {
+    return POLE_PAIRS * Plant->Angle + Plant->Offset;
+}
+
+static void DqCurrents (const sMotorPlant_t *Plant, double *Id, double *Iq) {
+    double Theta = ElectricalAngle(Plant);
+    *Id = Plant->Current[0] * cos(Theta) + Plant->Current[1] * sin(Theta);
+    *Iq = -Plant->Current[0] * sin(Theta) + Plant->Current[1] * cos(Theta);
+}
+
+/* Average phase voltages of a PWM period, star point removed: alpha is phase A, amplitude invariant */
+static void PhaseVoltages (eMotor_t Motor, double *Alpha, double *Beta) {
+    double A = g_Timer[Motor]->CCR1 / PWM_PERIOD * BUS_VOLTAGE;
+    double B = g_Timer[Motor]->CCR2 / PWM_PERIOD * BUS_VOLTAGE;
+    double C = g_Timer[Motor]->CCR3 / PWM_PERIOD * BUS_VOLTAGE;
+    *Alpha = A - (A + B + C) / 3.0;
+    *Beta = (B - C) / sqrt(3.0);
+}
+
+/* One control period at the compare values written last */
+static void PlantStep (eMotor_t Motor, sMotorPlant_t *Plant, double Dt) {
+    double Alpha, Beta;
+    double H = Dt / SUBSTEPS;
+    PhaseVoltages(Motor, &Alpha, &Beta);
+    for (unsigned int i = 0; i < SUBSTEPS; i++) {
+        double Theta = ElectricalAngle(Plant);
+        double Emf = BACK_EMF * Plant->Velocity;
+        Plant->Current[0] += (Alpha - Plant->Resistance * Plant->Current[0] + Emf * sin(Theta)) / INDUCTANCE * H;
+        Plant->Current[1] += (Beta - Plant->Resistance * Plant->Current[1] - Emf * cos(Theta)) / INDUCTANCE * H;
+        if (Plant->Free) {
+            double Id, Iq;
+            DqCurrents(Plant, &Id, &Iq);
+            Plant->Velocity += (1.5 * BACK_EMF * Iq - DAMPING * Plant->Velocity) / INERTIA * H;
+        }
+        Plant->Angle += Plant->Velocity * H;
+    }
+    Plant->Angle -= TWO_PI * floor(Plant->Angle / TWO_PI);
+}
+
+/* Device latches the shaft angle when the read command reaches it, at the start of the period */
+static void LatchAngles (const sDrive_t *Drive) {
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        MotorDevice(Motor)->Angle = (uint16_t)((unsigned int)(Drive->Plant[Motor].Angle / TWO_PI * ENCODER_COUNTS) & 0x3FFF);
+    }
+}
+
+static void DriveInit (sDrive_t *Drive, float Dt) {
+    static const double Offset[eMotor_Last] = {1.234, -2.5, 0.4};
+    memset(Drive, 0, sizeof(sDrive_t));
+    Foc_GetDefaultConfig(&Drive->Config);
+    Drive->Config.Dt = Dt;
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        Drive->Plant[Motor].Offset = Offset[Motor];
+        Drive->Plant[Motor].Resistance = RESISTANCE;
+        Drive->Plant[Motor].Free = true;
+        /* A quarter electrical turn off the d axis, pulled in without passing the unstable point */
+        Drive->Plant[Motor].Angle = (TWO_PI - Offset[Motor] + 1.0) / POLE_PAIRS;
+    }
+}
+
+static void Period (sDrive_t *Drive, bool Align) {
+    float Currents[eMotor_Last][2];
+    LatchAngles(Drive);
+    Encoder_Read(Drive->Samples);
+    if (!Align) {
+        for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+            const sMotorPlant_t *Plant = &Drive->Plant[Motor];
+            Currents[Motor][0] = (float)Plant->Current[0];
+            Currents[Motor][1] = (float)(-0.5 * Plant->Current[0] + 0.5 * sqrt(3.0) * Plant->Current[1]);
+        }
+        Foc_Update(&Drive->Foc, Drive->Samples, Drive->Command, Drive->CurrentMode ? (const float (*)[2])Currents : NULL);
+    }
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        PlantStep(Motor, &Drive->Plant[Motor], Drive->Config.Dt);
+    }
+}
+
+/* Rotor pulled onto the d axis for 0.5 s, electrical offsets read from where it settled */
+static bool DriveAlign (sDrive_t *Drive) {
+    Foc_Init(&Drive->Foc, &Drive->Config);
+    Foc_AlignStart(&Drive->Foc);
+    for (unsigned int i = 0; i < (unsigned int)(0.5f / Drive->Config.Dt); i++) {
+        Period(Drive, true);
+    }
+    /* Finish with a sample of the settled rotor */
+    LatchAngles(Drive);
+    Encoder_Read(Drive->Samples);
+    return Foc_AlignFinish(&Drive->Foc, Drive->Samples);
+}
+
+/* Electrical offset the controller measured against the true one */
+static double AlignmentError (const sDrive_t *Drive, eMotor_t Motor) {
+    return WrapPi(Drive->Foc.Motor[Motor].ElectricalOffset - Drive->Plant[Motor].Offset) * RAD_TO_DEG;
+}
+
+/* Velocity held, command 1 on every motor; current angle from the q axis and q current averaged over the last 0.1 s */
+static void TorqueAngle (float Dt, float Velocity, float Latency, bool CurrentMode, double Resistance, double *Angle,
+                         double *Iq) {
+    sDrive_t Drive;
+    unsigned int Steps = (unsigned int)(0.4f / Dt);
+    unsigned int Averaged = 0;
+    DriveInit(&Drive, Dt);
+    Drive.Config.LatencyPeriods = Latency;
+    DriveAlign(&Drive);
+    *Angle = 0.0;
+    *Iq = 0.0;
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        Drive.Plant[Motor].Free = false;
+        Drive.Plant[Motor].Velocity = Velocity;
+        Drive.Plant[Motor].Resistance = Resistance;
+        Drive.Command[Motor] = 1.0f;
+    }
+    Drive.CurrentMode = CurrentMode;
+    for (unsigned int i = 0; i < Steps; i++) {
+        Period(&Drive, false);
+        if (i >= Steps - (unsigned int)(0.1f / Dt)) {
+            double Id, Q;
+            DqCurrents(&Drive.Plant[eMotor_Roll], &Id, &Q);
+            *Angle += atan2(Id, Q) * RAD_TO_DEG;
+            *Iq += Q;
+            Averaged++;
+        }
+    }
+    *Angle /= Averaged;
+    *Iq /= Averaged;
+}
+
+static void Setup (void) {
+    HostSpi_Reset();
+    HostAs5048_Init(&g_Chain, eMotor_Last);
+    HostAs5048_Attach(&g_Chain, SPI2, GPIOB, GPIO_PIN_12);
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        MotorDevice(Motor)->Angle = (uint16_t)(1000 + 1000 * Motor);
+    }
+    InitializeMessageQueues();
+    InitializeSpiMutexes();
+    InitializeSpiSlaves();
+    CHECK(Encoder_Init());
+    CHECK(Motor_Init());
+}
+
+/* A read returns the angle latched by the read before it. A parity error costs that motor one sample. An error flag
+ * costs three: the flagged frame, the one answering the read that went out alongside the clear, and the error register
+ * itself; the clear goes out once and the flag is counted once. */
+static void TestEncoder (void) {
+    sEncoderSample_t Samples[eMotor_Last];
+    sEncoderStats_t Before;
+    sEncoderStats_t After;
+    bool Valid[8];
+    CHECK(Encoder_Read(Samples));
+    MotorDevice(eMotor_Pitch)->Angle = 5000;
+    CHECK(Encoder_Read(Samples) && Samples[eMotor_Pitch].Valid && (Samples[eMotor_Pitch].Raw == 2000));
+    CHECK(Encoder_Read(Samples) && Samples[eMotor_Pitch].Valid && (Samples[eMotor_Pitch].Raw == 5000));
+    CHECK_NEAR(Samples[eMotor_Pitch].Angle, 5000 * TWO_PI / ENCODER_COUNTS, 1e-5);
+
+    Encoder_GetStats(&Before);
+    MotorDevice(eMotor_Yaw)->CorruptNextResponse = true;
+    Encoder_Read(Samples);
+    Encoder_Read(Samples);
+    CHECK(!Samples[eMotor_Yaw].Valid && Samples[eMotor_Roll].Valid && Samples[eMotor_Pitch].Valid);
+    Encoder_Read(Samples);
+    CHECK(Samples[eMotor_Yaw].Valid && (Samples[eMotor_Yaw].Raw == 3000));
+    Encoder_GetStats(&After);
+    CHECK((After.ParityErrors == Before.ParityErrors + 1) && (After.ErrorFlags == Before.ErrorFlags));
+
+    Before = After;
+    MotorDevice(eMotor_Roll)->ErrorFlag = true;
+    for (unsigned int i = 0; i < 8; i++) {
+        Encoder_Read(Samples);
+        Valid[i] = Samples[eMotor_Roll].Valid;
+        CHECK(Samples[eMotor_Pitch].Valid && Samples[eMotor_Yaw].Valid);
+    }
+    Encoder_GetStats(&After);
+    printf("Error flag on roll, valid samples from the read it is raised on: %d %d %d %d %d %d %d %d\n", Valid[0],
+           Valid[1], Valid[2], Valid[3], Valid[4], Valid[5], Valid[6], Valid[7]);
+    CHECK(Valid[0] && !Valid[1] && !Valid[2] && !Valid[3] && Valid[4] && Valid[5] && Valid[6] && Valid[7]);
+    CHECK(Samples[eMotor_Roll].Raw == 1000);
+    CHECK(!MotorDevice(eMotor_Roll)->ErrorFlag);
+    CHECK((After.ErrorFlags == Before.ErrorFlags + 1) && (After.ParityErrors == Before.ParityErrors));
+    CHECK((After.Reads == Before.Reads + 8) && (After.BusErrors == 0));
+}
+
+/* Alignment within encoder resolution (0.15 deg electrical at 7 pole pairs), then full command on a held rotor gives
+ * CurrentLimit on q in both modes; in voltage mode the q current follows the resistance the model assumes */
+static void TestAlignAndTorque (void) {
+    sDrive_t Drive;
+    double Angle[3];
+    double Iq[3];
+    DriveInit(&Drive, 0.001f);
+    CHECK(DriveAlign(&Drive));
+    double Worst = 0.0;
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        Worst = fmax(Worst, fabs(AlignmentError(&Drive, Motor)));
+        CHECK(Drive.Foc.Motor[Motor].Aligned);
+    }
+    printf("Alignment: worst %.3f deg electrical\n", Worst);
+    CHECK(Worst < 0.2);
+    TorqueAngle(0.001f, 0.0f, 1.5f, false, RESISTANCE, &Angle[0], &Iq[0]);
+    TorqueAngle(0.001f, 0.0f, 1.5f, true, RESISTANCE, &Angle[1], &Iq[1]);
+    TorqueAngle(0.001f, 0.0f, 1.5f, false, 1.2 * RESISTANCE, &Angle[2], &Iq[2]);
+    printf("Held rotor, command 1: voltage mode Iq %.3f A at %.2f deg, current mode %.3f A at %.2f deg, voltage mode "
+           "on 20%% more resistance %.3f A\n", Iq[0], Angle[0], Iq[1], Angle[1], Iq[2]);
+    CHECK_NEAR(Iq[0], 0.5, 0.005);
+    CHECK_NEAR(Iq[1], 0.5, 0.005);
+    CHECK((fabs(Angle[0]) < 0.5) && (fabs(Angle[1]) < 0.5));
+    CHECK_NEAR(Iq[2], 0.5 / 1.2, 0.005);
+}
+
+/* Voltage mode at speed: without latency compensation the 1.5 periods between sample and applied voltage turn the
+ * current off the q axis by 1.5 * Dt * 7 * velocity; what compensation leaves is the winding inductance, which
+ * voltage mode does not model */
+static void TestSpeed (void) {
+    static const float Rate[] = {500.0f, 1000.0f, 2000.0f};
+    double Angle[3][2];
+    double Iq[3][2];
+    printf("Torque angle at 10 rad/s, voltage mode, deg: rate, without compensation, with it\n");
+    for (unsigned int i = 0; i < 3; i++) {
+        TorqueAngle(1.0f / Rate[i], 10.0f, 0.0f, false, RESISTANCE, &Angle[i][0], &Iq[i][0]);
+        TorqueAngle(1.0f / Rate[i], 10.0f, 1.5f, false, RESISTANCE, &Angle[i][1], &Iq[i][1]);
+        printf("%6.0f Hz %8.2f %8.2f   Iq %.3f %.3f A\n", (double)Rate[i], Angle[i][0], Angle[i][1], Iq[i][0], Iq[i][1]);
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+        CHECK(fabs(Angle[i][1]) < 0.3 * fabs(Angle[i][0]));
+        CHECK(Iq[i][1] > 0.48);
+    }
+    /* Uncompensated error halves with the period */
+    CHECK_NEAR(Angle[0][0] / Angle[1][0], 2.0, 0.3);
+    CHECK_NEAR(Angle[1][0] / Angle[2][0], 2.0, 0.3);
+}
+
+/* Held rotor, q current step from zero to CurrentLimit with the PI loops: default gains against higher ones, which the
+ * one period between current sample and applied voltage turns into overshoot and then into ringing */
+static void TestCurrentStep (void) {
+    static const float Kp[] = {1.5f, 3.0f, 5.0f};
+    double Overshoot[3];
+    double Settle[3];
+    printf("Iq step to 0.5 A at 1 kHz: Kp V/A, Ki V/(A s), overshoot %%, settle to 2%% ms\n");
+    for (unsigned int k = 0; k < 3; k++) {
+        sDrive_t Drive;
+        int LastOutside = -1;
+        DriveInit(&Drive, 0.001f);
+        for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+            Drive.Config.Motor[Motor].CurrentKp = Kp[k];
+            Drive.Config.Motor[Motor].CurrentKi = 1000.0f * Kp[k];
+        }
+        DriveAlign(&Drive);
+        for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+            Drive.Plant[Motor].Free = false;
+            Drive.Command[Motor] = 1.0f;
+        }
+        Drive.CurrentMode = true;
+        Overshoot[k] = 0.0;
+        for (unsigned int i = 0; i < 100; i++) {
+            double Id, Iq;
+            Period(&Drive, false);
+            DqCurrents(&Drive.Plant[eMotor_Roll], &Id, &Iq);
+            Overshoot[k] = fmax(Overshoot[k], (Iq - 0.5) / 0.5 * 100.0);
+            if (fabs(Iq - 0.5) > 0.01) {
+                LastOutside = (int)i;
+            }
+        }
+        Settle[k] = (LastOutside == 99) ? -1.0 : (double)(LastOutside + 1);
+        printf("%8.1f %8.0f %8.1f %8.0f\n", (double)Kp[k], 1000.0 * Kp[k], Overshoot[k], Settle[k]);
+    }
+    CHECK((Overshoot[0] < 5.0) && (Settle[0] > 0.0) && (Settle[0] <= 20.0));
+    CHECK(Overshoot[1] > 10.0);
+    CHECK(Settle[2] < 0.0);
+}
+
+/* Spinning at 10 rad/s: an error flag on roll costs three samples, bridged by extrapolation with no visible change of
+ * torque angle; four bad reads in a row switch the motor off until a sample comes back */
+static void TestMissedSamples (void) {
+    sDrive_t Drive;
+    double Steady = 0.0;
+    double Around = 0.0;
+    bool Off = false;
+    bool OffBeforeFourth = false;
+    DriveInit(&Drive, 0.001f);
+    DriveAlign(&Drive);
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        Drive.Plant[Motor].Free = false;
+        Drive.Plant[Motor].Velocity = 10.0;
+        Drive.Command[Motor] = 1.0f;
+    }
+    for (unsigned int i = 0; i < 600; i++) {
+        double Id, Iq;
+        if (i == 300) {
+            MotorDevice(eMotor_Roll)->ErrorFlag = true;
+        }
+        if ((i >= 450) && (i < 454)) {
+            MotorDevice(eMotor_Roll)->CorruptNextResponse = true;
+        }
+        Period(&Drive, false);
+        DqCurrents(&Drive.Plant[eMotor_Roll], &Id, &Iq);
+        if ((i >= 200) && (i < 300)) {
+            Steady = fmax(Steady, fabs(atan2(Id, Iq)) * RAD_TO_DEG);
+        } else if ((i >= 300) && (i < 400)) {
+            Around = fmax(Around, fabs(atan2(Id, Iq)) * RAD_TO_DEG);
+        }
+        if ((i >= 200) && (i < 400)) {
+            OffBeforeFourth = OffBeforeFourth || (Drive.Foc.Motor[eMotor_Roll].Vq == 0.0f);
+        }
+        if (i == 454) {
+            Off = !Drive.Foc.Motor[eMotor_Roll].AngleValid && (Drive.Foc.Motor[eMotor_Roll].Vq == 0.0f) &&
+                  (TIM1->CCR1 == 900) && (TIM1->CCR2 == 900) && (TIM1->CCR3 == 900);
+        }
+    }
+    printf("Error flag while spinning: worst torque angle %.2f deg before it, %.2f deg around it\n", Steady, Around);
+    CHECK(!OffBeforeFourth);
+    CHECK(Around < Steady + 0.5);
+    CHECK(Off);
+    CHECK(Drive.Foc.Motor[eMotor_Roll].AngleValid && (Drive.Foc.Motor[eMotor_Roll].Vq > 0.0f));
+}
+
+/* Host time per three motor update for reference; the target figures are what FocBenchmark_Run prints there */
+static void TestCost (void) {
+    static sFoc_t Foc;
+    sFocConfig_t Config;
+    sEncoderSample_t Samples[eMotor_Last];
+    const float Command[eMotor_Last] = {0.3f, -0.2f, 0.1f};
+    const float Currents[eMotor_Last][2] = {{0.1f, -0.05f}, {0.0f, 0.02f}, {-0.1f, 0.05f}};
+    unsigned int Updates, Voltage, Current, Rate, Budget;
+    double Ns[2];
+    Foc_GetDefaultConfig(&Config);
+    for (unsigned int Mode = 0; Mode < 2; Mode++) {
+        Foc_Init(&Foc, &Config);
+        for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+            Samples[Motor] = (sEncoderSample_t) {4096, 1.57079637f, true};
+        }
+        Foc_AlignFinish(&Foc, Samples);
+        double Start = HostTest_NowNs();
+        for (unsigned int i = 0; i < BENCHMARK_STEPS; i++) {
+            for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+                Samples[Motor].Angle = 1.0e-3f * (float)(i & 0x3FF);
+            }
+            Foc_Update(&Foc, Samples, Command, (Mode == 0) ? NULL : Currents);
+        }
+        Ns[Mode] = (HostTest_NowNs() - Start) / BENCHMARK_STEPS;
+    }
+    Foc_Release(&Foc);
+    printf("host: %.1f ns per three motor update in voltage mode, %.1f in current mode\n", Ns[0], Ns[1]);
+    HostHal_SetQuiet(true);
+    HostHal_CaptureStart();
+    FocBenchmark_Run();
+    HostHal_SetQuiet(false);
+    printf("%s", HostHal_CaptureGet());
+    CHECK(sscanf(HostHal_CaptureGet(), "FOC update x%u[cyc] voltage %u current %u budget@%uHz[cyc] %u", &Updates,
+                 &Voltage, &Current, &Rate, &Budget) == 5);
+    CHECK((Updates == eMotor_Last) && (Rate == 2000) && (Budget == 36000));
+    HostHal_CaptureStop();
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    Setup();
+    TestEncoder();
+    TestAlignAndTorque();
+    TestSpeed();
+    TestCurrentStep();
+    TestMissedSamples();
+    TestCost();
+    return HostTest_Result("foc");
+}
@@ -0,0 +1,230 @@
+/* Work-stealing pool of host_work_pool and the gain_sweep tool: every task runs exactly once whatever the imbalance,
+ * and the sweep ranks the same on any number of workers as a serial replay of the same grid does */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "main.h"
+#include "host_imu_stream.h"
+#include "host_imu_log.h"
+#include "host_imu_replay.h"
+#include "host_work_pool.h"
+#include "host_test.h"
+
+
+#define POOL_TASKS                  1000
+#define POOL_WORKERS                4
+#define LOG_SAMPLES                 10000       // 10 s at 1 kHz
+#define TOOL                        "./build/gain_sweep"
+
+static const float g_TwoKp[] = {0.25f, 1.0f, 4.0f};
+static const float g_TwoKi[] = {0.0f, 0.05f};
+
+static unsigned int g_Runs[POOL_TASKS];
+static unsigned int g_RunBy[POOL_TASKS];
+
+
+/* First worker's slice is slow, the others run out early and have to steal from it */
+static void PoolTask (unsigned int Task, unsigned int Worker, void *Context) {
+    (void)Context;
+    if (Task < POOL_TASKS / POOL_WORKERS) {
+        usleep(100);
+    }
+    __atomic_fetch_add(&g_Runs[Task], 1, __ATOMIC_RELAXED);
+    g_RunBy[Task] = Worker;
+}
+
+static void TestPool (void) {
+    sHostWorkPoolStats_t Stats[POOL_WORKERS];
+    unsigned int Tasks = 0;
+    unsigned int Steals = 0;
+    unsigned int Stolen = 0;
+    bool Once = true;
+    CHECK(HostWorkPool_GetCoreCount() >= 1);
+    CHECK(!HostWorkPool_Run(0, POOL_TASKS, PoolTask, NULL, NULL));
+    CHECK(!HostWorkPool_Run(POOL_WORKERS, POOL_TASKS, NULL, NULL, NULL));
+    CHECK(HostWorkPool_Run(POOL_WORKERS, 0, PoolTask, NULL, Stats));
+    CHECK(HostWorkPool_Run(POOL_WORKERS, POOL_TASKS, PoolTask, NULL, Stats));
+    for (unsigned int i = 0; i < POOL_TASKS; i++) {
+        Once = Once && (g_Runs[i] == 1);
+    }
+    CHECK(Once);
+    for (unsigned int i = 0; i < POOL_WORKERS; i++) {
+        Tasks += Stats[i].Tasks;
+        Steals += Stats[i].Steals;
+        Stolen += Stats[i].Stolen;
+    }
+    printf("pool: %u tasks on %u workers, %u steals took %u tasks, first worker ran %u\n", Tasks, POOL_WORKERS, Steals,
+           Stolen, Stats[0].Tasks);
+    CHECK(Tasks == POOL_TASKS);
+    CHECK((Steals > 0) && (Stolen >= Steals));
+    /* Slow slice was shared out */
+    CHECK(Stats[0].Tasks < POOL_TASKS / POOL_WORKERS);
+    unsigned int Foreign = 0;
+    for (unsigned int i = 0; i < POOL_TASKS / POOL_WORKERS; i++) {
+        Foreign += (g_RunBy[i] != 0) ? 1 : 0;
+    }
+    CHECK(Foreign > 0);
+    /* One worker is plain serial */
+    memset(g_Runs, 0, sizeof(g_Runs));
+    CHECK(HostWorkPool_Run(1, POOL_TASKS, PoolTask, NULL, Stats));
+    CHECK((Stats[0].Tasks == POOL_TASKS) && (Stats[0].Steals == 0));
+}
+
+static bool WriteLog (const char *Path, const sHostImuLog_t *Log) {
+    FILE *File = fopen(Path, "wb");
+    bool RetVal = (File != NULL) && HostImuLog_WriteBinary(Log, File);
+    if (File != NULL) {
+        fclose(File);
+    }
+    return RetVal;
+}
+
+/* Two recordings: the bench stream with its truth next to it, and a stiller one with another bias and no reference */
+static void WriteLogs (const char *Directory) {
+    char Path[128];
+    for (unsigned int Run = 0; Run < 2; Run++) {
+        sHostImuStream_t Stream;
+        sHostImuLog_t Log;
+        sHostAttitudeTrack_t Truth;
+        HostImuStream_Init(&Stream);
+        if (Run == 1) {
+            Stream.Seed = 0x9E3779B9;
+            Stream.RateAmplitude[0] = 0.3f;
+            Stream.RateAmplitude[1] = 0.2f;
+            Stream.GyroBias[0] = -0.4f;
+            Stream.GyroBias[2] = 0.1f;
+        }
+        bool Appended = true;
+        HostImuLog_Init(&Log, SystemCoreClock);
+        HostAttitudeTrack_Init(&Truth, SystemCoreClock);
+        for (unsigned int i = 0; i < LOG_SAMPLES; i++) {
+            sImuData_t Sample;
+            float Q[4];
+            HostImuStream_Next(&Stream, &Sample);
+            HostImuStream_GetTruth(&Stream, Q);
+            Appended = Appended && HostImuLog_Append(&Log, &Sample) && HostAttitudeTrack_Append(&Truth, Log.Cycles[Log.Count - 1], Q);
+        }
+        CHECK(Appended);
+        snprintf(Path, sizeof(Path), "%s/%s", Directory, (Run == 0) ? "bench.bin" : "still.bin");
+        CHECK(WriteLog(Path, &Log));
+        if (Run == 0) {
+            snprintf(Path, sizeof(Path), "%s/bench.att.csv", Directory);
+            FILE *File = fopen(Path, "w");
+            CHECK((File != NULL) && HostAttitudeTrack_WriteCsv(&Truth, File));
+            fclose(File);
+        }
+        HostAttitudeTrack_Free(&Truth);
+        HostImuLog_Free(&Log);
+    }
+    snprintf(Path, sizeof(Path), "%s/notes.txt", Directory);
+    FILE *File = fopen(Path, "w");
+    CHECK((File != NULL) && (fputs("not a log\n", File) >= 0));
+    fclose(File);
+}
+
+/* The grid one combination at a time on this thread, from the same files, pooled the way the tool pools */
+static unsigned int BestCombination (const char *Directory, float *BestRms) {
+    char Path[128];
+    sHostImuLog_t Logs[2];
+    sHostAttitudeTrack_t References[2];
+    sHostImuReplayConfig_t Config;
+    sHostImuReplayResult_t Result;
+    unsigned int Best = 0;
+    snprintf(Path, sizeof(Path), "%s/bench.bin", Directory);
+    CHECK(HostImuLog_Load(&Logs[0], Path));
+    snprintf(Path, sizeof(Path), "%s/bench.att.csv", Directory);
+    CHECK(HostAttitudeTrack_Load(&References[0], Path));
+    snprintf(Path, sizeof(Path), "%s/still.bin", Directory);
+    CHECK(HostImuLog_Load(&Logs[1], Path));
+    HostImuReplay_GetDefaultConfig(&Config);
+    Config.Engine = eAttitudeEstimator_Mekf;
+    HostAttitudeTrack_Init(&References[1], Logs[1].Clock);
+    CHECK(HostImuReplay_Run(&Config, &Logs[1], NULL, &References[1], &Result));
+    *BestRms = INFINITY;
+    for (unsigned int Kp = 0; Kp < 3; Kp++) {
+        for (unsigned int Ki = 0; Ki < 2; Ki++) {
+            double AngleSq = 0.0;
+            unsigned int Compared = 0;
+            HostImuReplay_GetDefaultConfig(&Config);
+            Config.Config.TwoKp = g_TwoKp[Kp];
+            Config.Config.TwoKi = g_TwoKi[Ki];
+            for (unsigned int i = 0; i < 2; i++) {
+                CHECK(HostImuReplay_Run(&Config, &Logs[i], &References[i], NULL, &Result));
+                AngleSq += (double)Result.AngleRms * Result.AngleRms * Result.Compared;
+                Compared += Result.Compared;
+            }
+            float Rms = (float)sqrt(AngleSq / Compared);
+            if (Rms < *BestRms) {
+                *BestRms = Rms;
+                Best = Kp * 2 + Ki;
+            }
+        }
+    }
+    for (unsigned int i = 0; i < 2; i++) {
+        HostImuLog_Free(&Logs[i]);
+        HostAttitudeTrack_Free(&References[i]);
+    }
+    return Best;
+}
+
+static bool RunTool (const char *Arguments, char *Output, size_t Size) {
+    char Command[256];
+    snprintf(Command, sizeof(Command), TOOL " %s 2>&1", Arguments);
+    FILE *Pipe = popen(Command, "r");
+    size_t Length = (Pipe != NULL) ? fread(Output, 1, Size - 1, Pipe) : 0;
+    Output[Length] = '\0';
+    return (Pipe != NULL) && (pclose(Pipe) == 0);
+}
+
+static void TestSweep (void) {
+    char Directory[] = "/tmp/gain_sweep_XXXXXX";
+    char Arguments[192];
+    char Output[4096];
+    char Serial[4096];
+    char Expected[128];
+    float BestRms;
+    CHECK(mkdtemp(Directory) != NULL);
+    WriteLogs(Directory);
+    unsigned int Best = BestCombination(Directory, &BestRms);
+
+    snprintf(Arguments, sizeof(Arguments), "-g TwoKp=0.25,1,4 -g twoki=0,0.05 -j %u -N 0 %s", POOL_WORKERS, Directory);
+    CHECK(RunTool(Arguments, Output, sizeof(Output)));
+    printf("%s", Output);
+    CHECK(strstr(Output, "notes.txt: not an IMU log, skipped") != NULL);
+    CHECK(strstr(Output, ": 2 logs, 20.00 s of data, 1 scored against MEKF") != NULL);
+    CHECK(strstr(Output, "Mahony: 6 combinations x 2 logs = 12 runs on 4 workers") != NULL);
+    CHECK(strstr(Output, "sample-updates/s") != NULL);
+    snprintf(Expected, sizeof(Expected), "\n   1  %12g %12g %10.4f", (double)g_TwoKp[Best / 2], (double)g_TwoKi[Best % 2], (double)BestRms);
+    CHECK(strstr(Output, Expected) != NULL);
+    CHECK(strstr(Output, "\n   6 ") != NULL);
+
+    /* Same table from one worker: runs do not share estimator state */
+    snprintf(Arguments, sizeof(Arguments), "-g TwoKp=0.25,1,4 -g twoki=0,0.05 -j 1 -N 0 %s", Directory);
+    CHECK(RunTool(Arguments, Serial, sizeof(Serial)));
+    CHECK((strstr(Output, "rank ") != NULL) && (strstr(Serial, "rank ") != NULL) &&
+          (strcmp(strstr(Output, "rank "), strstr(Serial, "rank ")) == 0));
+
+    snprintf(Arguments, sizeof(Arguments), "-g TwoKp=0.25,1,4 -k convergence -t 0.5 -N 1 %s", Directory);
+    CHECK(RunTool(Arguments, Output, sizeof(Output)));
+    CHECK(strstr(Output, "ranked by convergence") != NULL);
+    CHECK((strstr(Output, "\n   1 ") != NULL) && (strstr(Output, "\n   2 ") == NULL));
+    snprintf(Arguments, sizeof(Arguments), "-g Gain=1 %s", Directory);
+    CHECK(!RunTool(Arguments, Output, sizeof(Output)));
+
+    const char *Files[] = {"bench.bin", "bench.att.csv", "still.bin", "notes.txt"};
+    for (unsigned int i = 0; i < sizeof(Files) / sizeof(Files[0]); i++) {
+        snprintf(Arguments, sizeof(Arguments), "%s/%s", Directory, Files[i]);
+        unlink(Arguments);
+    }
+    rmdir(Directory);
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    TestPool();
+    TestSweep();
+    return HostTest_Result("gain_sweep");
+}
@@ -0,0 +1,200 @@
+/* Boot gyro bias calibration of gyro_bias_api.c on host_imu_stream data: calibration time and residual bias against
+ * window length, for a device still from power up and for one carried around first, plus online refinement after a
+ * bias step with and without motor vibration. Inputs are fed as in StartDefaultTask: gyro in rad/s, accelerometer in mg. */
+
+#include <stdio.h>
+#include <string.h>
+#include "gyro_bias_api.h"
+#include "host_imu_stream.h"
+#include "host_test.h"
+
+
+#define DEG_TO_RAD                  0.0174532925f
+#define RAD_TO_DEG                  57.2957795f
+#define SEEDS                       20
+#define BOOT_SAMPLES                10000       // 10 s at 1 kHz
+#define MOVING_TIME                 3.0f        // s of handheld motion before the device is put down
+#define DEFAULT_WINDOW              200         // HARDCODED_WINDOW_SAMPLES
+
+typedef struct {
+    float Time;                         // s until calibrated, mean over seeds, -1 if one of them never finished
+    float WorstTime;
+    float Residual;                     // dps, worst axis, mean over seeds
+    float WorstResidual;
+} sCalibrationResult_t;
+
+static const unsigned int WindowSamples[] = {50, 100, 200, 500, 1000};
+
+
+static void Feed (sGyroBias_t *Estimator, const sImuData_t *Sample) {
+    const sData3D_t Gyro = {Sample->G.X * DEG_TO_RAD, Sample->G.Y * DEG_TO_RAD, Sample->G.Z * DEG_TO_RAD};
+    GyroBias_Update(Estimator, &Gyro, &Sample->A, 0.001f);
+}
+
+static float Residual (const sGyroBias_t *Estimator, const sHostImuStream_t *Stream) {
+    float Worst = 0.0f;
+    for (unsigned int i = 0; i < 3; i++) {
+        float Error = fabsf(Estimator->Bias[i] * RAD_TO_DEG - Stream->GyroBias[i]);
+        Worst = (Error > Worst) ? Error : Worst;
+    }
+    return Worst;
+}
+
+/* Motors off at boot: no vibration. Moving streams stop rotating after MOVING_TIME and lie still from then on. */
+static void Calibrate (unsigned int Window, bool Moving, sCalibrationResult_t *Result) {
+    sGyroBiasConfig_t Config;
+    unsigned int Finished = 0;
+    memset(Result, 0, sizeof(sCalibrationResult_t));
+    GyroBias_GetDefaultConfig(&Config);
+    Config.WindowSamples = Window;
+    for (unsigned int Seed = 0; Seed < SEEDS; Seed++) {
+        sHostImuStream_t Stream;
+        sGyroBias_t Estimator;
+        sImuData_t Sample;
+        HostImuStream_Init(&Stream);
+        Stream.Seed = 0x2545F491u + 7919u * Seed;
+        Stream.Vibration = 0.0f;
+        Stream.StillTime = Moving ? 0.0f : (float)BOOT_SAMPLES * 0.001f;
+        GyroBias_Init(&Estimator, &Config);
+        for (unsigned int i = 0; (i < BOOT_SAMPLES) && !GyroBias_IsCalibrated(&Estimator); i++) {
+            if (Moving && (i == (unsigned int)(MOVING_TIME * 1000.0f))) {
+                memset(Stream.RateAmplitude, 0, sizeof(Stream.RateAmplitude));
+            }
+            HostImuStream_Next(&Stream, &Sample);
+            Feed(&Estimator, &Sample);
+        }
+        if (GyroBias_IsCalibrated(&Estimator)) {
+            float Error = Residual(&Estimator, &Stream);
+            Finished++;
+            Result->Time += Estimator.Elapsed;
+            Result->WorstTime = (Estimator.Elapsed > Result->WorstTime) ? Estimator.Elapsed : Result->WorstTime;
+            Result->Residual += Error;
+            Result->WorstResidual = (Error > Result->WorstResidual) ? Error : Result->WorstResidual;
+        }
+    }
+    Result->Time = (Finished == SEEDS) ? Result->Time / SEEDS : -1.0f;
+    Result->Residual /= (Finished != 0) ? (float)Finished : 1.0f;
+}
+
+/* Default window: still device calibrates on its first window, one carried around first right after it is put down */
+static void TestWindowLength (void) {
+    sCalibrationResult_t Still[sizeof(WindowSamples) / sizeof(WindowSamples[0])];
+    sCalibrationResult_t Moving[sizeof(WindowSamples) / sizeof(WindowSamples[0])];
+    printf("Boot calibration over %u seeds, 0.1 dps gyro noise, 8 mg accelerometer noise; s and dps, mean / worst\n", SEEDS);
+    printf("%8s %24s %24s %24s %24s\n", "window", "still: time", "still: residual", "moved first: time", "moved first: residual");
+    for (unsigned int i = 0; i < sizeof(WindowSamples) / sizeof(WindowSamples[0]); i++) {
+        Calibrate(WindowSamples[i], false, &Still[i]);
+        Calibrate(WindowSamples[i], true, &Moving[i]);
+        printf("%8u %11.3f / %10.3f %11.4f / %10.4f %11.3f / %10.3f %11.4f / %10.4f\n", WindowSamples[i],
+               (double)Still[i].Time, (double)Still[i].WorstTime, (double)Still[i].Residual, (double)Still[i].WorstResidual,
+               (double)Moving[i].Time, (double)Moving[i].WorstTime, (double)Moving[i].Residual, (double)Moving[i].WorstResidual);
+    }
+    /* Index 2 is the default of 200 samples; the confidence threshold is a one sigma standard error, worst of three axes
+     * over 20 seeds lands near twice that */
+    CHECK(WindowSamples[2] == DEFAULT_WINDOW);
+    CHECK_NEAR(Still[2].WorstTime, 0.2, 1e-3);
+    CHECK(Still[2].Residual < 0.015f);
+    CHECK(Still[2].WorstResidual < 0.03f);
+    /* No window during motion passed as stationary at any length, or the residual would be tenths of a dps. Once put
+     * down it takes what a still start takes plus at most the window straddling the stop; below ~80 samples one window
+     * cannot reach the confidence threshold on its own, so 50 and 100 both need 100 ms. */
+    for (unsigned int i = 0; i < sizeof(WindowSamples) / sizeof(WindowSamples[0]); i++) {
+        CHECK((Moving[i].Time > MOVING_TIME) && (Moving[i].WorstTime <= MOVING_TIME + Still[i].WorstTime + WindowSamples[i] * 0.001f + 1e-3f));
+        CHECK(Moving[i].WorstResidual < 0.03f);
+    }
+    /* Longer windows only buy residual: 0.5 s halves it, at 2.5x the wait */
+    CHECK(Still[3].Residual < Still[2].Residual);
+}
+
+/* Bench stream vibration, 20 mg at 83 Hz on every axis, is ~800 mg^2 of accelerometer variance against the 300 of the
+ * boot threshold: with the motors running boot calibration never starts and the bias stays at zero, which is why the
+ * control task keeps them off until it is done */
+static void TestVibration (void) {
+    sGyroBiasConfig_t Config;
+    sHostImuStream_t Stream;
+    sGyroBias_t Estimator;
+    sImuData_t Sample;
+    HostImuStream_Init(&Stream);
+    Stream.StillTime = (float)BOOT_SAMPLES * 0.001f;
+    GyroBias_GetDefaultConfig(&Config);
+    GyroBias_Init(&Estimator, &Config);
+    for (unsigned int i = 0; i < BOOT_SAMPLES; i++) {
+        HostImuStream_Next(&Stream, &Sample);
+        Feed(&Estimator, &Sample);
+    }
+    CHECK(!GyroBias_IsCalibrated(&Estimator) && !Estimator.Valid);
+    CHECK((Estimator.Bias[0] == 0.0f) && (Estimator.Bias[1] == 0.0f) && (Estimator.Bias[2] == 0.0f));
+}
+
+/* After calibration with the motors off, a 0.1 dps step (temperature) while still is followed with RefineGain per
+ * window, a 4 s time constant at 200 ms windows, with Vibration mg of motor vibration from then on; motion in between
+ * leaves the estimate alone. Returns false if refinement never moved the estimate. */
+static bool RunRefinement (float Vibration, float After[3]) {
+    sGyroBiasConfig_t Config;
+    sHostImuStream_t Stream;
+    sGyroBias_t Estimator;
+    sImuData_t Sample;
+    float Before[3];
+    HostImuStream_Init(&Stream);
+    Stream.Vibration = 0.0f;
+    Stream.StillTime = 1000.0f;
+    GyroBias_GetDefaultConfig(&Config);
+    GyroBias_Init(&Estimator, &Config);
+    for (unsigned int i = 0; i < 30000; i++) {
+        if (i == 1000) {
+            CHECK(GyroBias_IsCalibrated(&Estimator));
+            memcpy(Before, Estimator.Bias, sizeof(Before));
+            Stream.Vibration = Vibration;
+        }
+        if (i == 2000) {
+            Stream.GyroBias[0] += 0.1f;
+        }
+        HostImuStream_Next(&Stream, &Sample);
+        Feed(&Estimator, &Sample);
+        if ((i == 5999) || (i == 11999) || (i == 29999)) {
+            After[(i == 5999) ? 0 : (i == 11999) ? 1 : 2] = Residual(&Estimator, &Stream);
+        }
+    }
+    bool Refined = (memcmp(Before, Estimator.Bias, sizeof(Before)) != 0);
+    /* Handheld motion from here, estimate must not follow the rotation */
+    memcpy(Before, Estimator.Bias, sizeof(Before));
+    HostImuStream_Init(&Stream);
+    Stream.StillTime = 0.0f;
+    Stream.Vibration = Vibration;
+    for (unsigned int i = 0; i < 10000; i++) {
+        HostImuStream_Next(&Stream, &Sample);
+        Feed(&Estimator, &Sample);
+    }
+    CHECK(memcmp(Before, Estimator.Bias, sizeof(Before)) == 0);
+    return Refined;
+}
+
+/* Motors on after calibration: the bench vibration refines exactly as a quiet device does, vibration well past the
+ * online accelerometer limit (60 mg is ~5600 mg^2) stops refinement rather than corrupting it */
+static void TestRefinement (void) {
+    const float Vibration[] = {0.0f, 20.0f, 60.0f};
+    float After[3][3];
+    bool Refined[3];
+    for (unsigned int i = 0; i < 3; i++) {
+        Refined[i] = RunRefinement(Vibration[i], After[i]);
+        printf("Refinement after a 0.1 dps step at %2.0f mg vibration: %.4f dps after 4 s, %.4f after 10 s, %.4f after "
+               "28 s\n", (double)Vibration[i], (double)After[i][0], (double)After[i][1], (double)After[i][2]);
+    }
+    for (unsigned int i = 0; i < 2; i++) {
+        CHECK(Refined[i]);
+        CHECK((After[i][0] < 0.06f) && (After[i][0] > 0.02f));
+        CHECK(After[i][1] < 0.02f);
+        CHECK(After[i][2] < 0.01f);
+    }
+    CHECK(!Refined[2]);
+    CHECK_NEAR(After[2][2], 0.1f, 0.03f);
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    TestWindowLength();
+    TestVibration();
+    TestRefinement();
+    return HostTest_Result("gyro_bias");
+}
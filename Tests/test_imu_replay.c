@@ -0,0 +1,220 @@
+/* IMU log replay: samples printed by the real Mpu_PrintCsvHeader / Mpu_PrintCsv go through the CSV parser, the binary
+ * form and the replay core against the truth of host_imu_stream, and the replay_imu tool runs end to end on them */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "uart_api.h"
+#include "mpu9250_api.h"
+#include "host_hal.h"
+#include "host_imu_stream.h"
+#include "host_imu_log.h"
+#include "host_imu_replay.h"
+#include "host_test.h"
+
+
+#define SAMPLES                     20000       // 20 s at 1 kHz
+#define TIMESTAMP_OFFSET            0xF0000000u // DWT counter wraps ~3.7 s into the log
+#define GAP_START                   12000
+#define GAP_LENGTH                  50          // samples lost, longer than IMU_MAX_DT
+#define TOOL                        "./build/replay_imu"
+
+osThreadId controlTaskHandle;
+static sImuData_t Samples[SAMPLES];
+static sHostAttitudeTrack_t Truth;
+
+
+static void Record (void) {
+    sHostImuStream_t Stream;
+    HostImuStream_Init(&Stream);
+    HostAttitudeTrack_Init(&Truth, SystemCoreClock);
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        float Q[4];
+        HostImuStream_Next(&Stream, &Samples[i]);
+        HostImuStream_GetTruth(&Stream, Q);
+        /* Truth is kept unwrapped, as the loader does */
+        HostAttitudeTrack_Append(&Truth, (uint64_t)Samples[i].Timestamp + TIMESTAMP_OFFSET, Q);
+        Samples[i].Timestamp += TIMESTAMP_OFFSET;
+    }
+}
+
+/* UART text as the firmware streams it, with other output and a garbled line mixed in */
+static void PrintLog (void) {
+    HostHal_SetQuiet(true);
+    HostHal_CaptureStart();
+    PrintToUart(eUart_1, "boot\r");
+    Mpu_PrintCsvHeader();
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        if ((i >= GAP_START) && (i < GAP_START + GAP_LENGTH)) {
+            continue;
+        }
+        Mpu_PrintCsv(&Samples[i]);
+        if (i == 100) {
+            PrintToUart(eUart_1, "FUS 12 us\rIMU,garbage\r");
+        }
+    }
+}
+
+static bool WriteFile (const char *Path, const char *Text) {
+    FILE *File = fopen(Path, "w");
+    bool RetVal = (File != NULL) && (fputs(Text, File) >= 0);
+    if (File != NULL) {
+        fclose(File);
+    }
+    return RetVal;
+}
+
+static void TestParse (sHostImuLog_t *Log) {
+    const char *Text = HostHal_CaptureGet();
+    FILE *File = fmemopen((void *)Text, strlen(Text), "r");
+    HostImuLog_Init(Log, 0);
+    CHECK(HostImuLog_ParseCsv(Log, File));
+    fclose(File);
+    CHECK(Log->Clock == SystemCoreClock);
+    CHECK(Log->Count == SAMPLES - GAP_LENGTH);
+    CHECK(Log->SkippedLines == 1);
+    bool Match = true;
+    bool Monotonic = true;
+    for (unsigned int i = 0, j = 0; i < Log->Count; i++, j++) {
+        if (j == GAP_START) {
+            j += GAP_LENGTH;
+        }
+        const sImuData_t *A = &Log->Samples[i];
+        const sImuData_t *B = &Samples[j];
+        /* Printed with 2 decimals for mg and uT, 3 for dps */
+        Match = Match && (A->Timestamp == B->Timestamp) && (A->MagFresh == B->MagFresh) &&
+                (fabsf(A->A.X - B->A.X) <= 0.0051f) && (fabsf(A->A.Y - B->A.Y) <= 0.0051f) && (fabsf(A->A.Z - B->A.Z) <= 0.0051f) &&
+                (fabsf(A->G.X - B->G.X) <= 0.00051f) && (fabsf(A->G.Y - B->G.Y) <= 0.00051f) && (fabsf(A->G.Z - B->G.Z) <= 0.00051f);
+        if (B->MagFresh) {
+            Match = Match && (fabsf(A->M.X - B->M.X) <= 0.0051f) && (fabsf(A->M.Y - B->M.Y) <= 0.0051f) && (fabsf(A->M.Z - B->M.Z) <= 0.0051f);
+        }
+        if (i > 0) {
+            Monotonic = Monotonic && (Log->Cycles[i] > Log->Cycles[i - 1]);
+        }
+    }
+    CHECK(Match);
+    CHECK(Monotonic);
+    /* Unwrapped across the DWT wrap: 20 s less one sample period of cycles from first to last */
+    CHECK(Log->Cycles[Log->Count - 1] - Log->Cycles[0] == (uint64_t)Samples[SAMPLES - 1].Timestamp + 0x100000000ull - Samples[0].Timestamp);
+}
+
+static void TestBinary (const sHostImuLog_t *Log) {
+    sHostImuLog_t Copy;
+    FILE *File = tmpfile();
+    CHECK(HostImuLog_WriteBinary(Log, File));
+    rewind(File);
+    HostImuLog_Init(&Copy, 0);
+    CHECK(HostImuLog_ReadBinary(&Copy, File));
+    fclose(File);
+    CHECK((Copy.Clock == Log->Clock) && (Copy.Count == Log->Count));
+    bool Same = true;
+    for (unsigned int i = 0; Same && (i < Copy.Count); i++) {
+        Same = (Copy.Cycles[i] == Log->Cycles[i]) && (Copy.Samples[i].Timestamp == Log->Samples[i].Timestamp) &&
+               (Copy.Samples[i].MagFresh == Log->Samples[i].MagFresh) &&
+               (memcmp(&Copy.Samples[i].A, &Log->Samples[i].A, 3 * sizeof(sData3D_t)) == 0);
+    }
+    CHECK(Same);
+    HostImuLog_Free(&Copy);
+}
+
+/* Error bounds are the bench_attitude_estimators ones for Mahony on this stream, the CSV rounding does not show */
+static void TestReplay (const sHostImuLog_t *Log) {
+    sHostImuReplayConfig_t Config;
+    sHostImuReplayResult_t Result;
+    sHostImuReplayResult_t Again;
+    sHostAttitudeTrack_t Output;
+    HostImuReplay_GetDefaultConfig(&Config);
+    HostAttitudeTrack_Init(&Output, Log->Clock);
+    CHECK(HostImuReplay_Run(&Config, Log, &Truth, &Output, &Result));
+    printf("Mahony replay: %u samples over %.2f s, %.0f updates/s, rms %.3f deg, tilt rms %.3f deg, converged at %.3f s\n",
+           Result.Samples, Result.LogSeconds, Result.UpdatesPerSecond, (double)Result.AngleRms, (double)Result.TiltRms,
+           (double)Result.ConvergenceTime);
+    CHECK(Result.Finite);
+    CHECK(Result.Compared == SAMPLES - GAP_LENGTH - 5000);
+    CHECK_NEAR(Result.LogSeconds, (SAMPLES - 1) * 0.001, 1e-6);
+    CHECK(Result.AngleRms < 3.5f);
+    CHECK(Result.TiltRms < 1.2f);
+    /* The 50 ms gap loses the rotation it spans, tilt leaves the threshold there and takes a few seconds back */
+    CHECK((Result.ConvergenceTime > GAP_START * 0.001f) && (Result.ConvergenceTime < SAMPLES * 0.001f));
+    CHECK(Output.Count == Log->Count);
+    /* A run written out and read back is the reference of the next one */
+    FILE *File = tmpfile();
+    sHostAttitudeTrack_t Previous;
+    CHECK(HostAttitudeTrack_WriteCsv(&Output, File));
+    rewind(File);
+    HostAttitudeTrack_Init(&Previous, 0);
+    CHECK(HostAttitudeTrack_ParseCsv(&Previous, File));
+    fclose(File);
+    CHECK(Previous.Count == Output.Count);
+    Config.SettleTime = 0.0f;
+    CHECK(HostImuReplay_Run(&Config, Log, &Previous, NULL, &Again));
+    CHECK(Again.Compared == Log->Count);
+    /* Only %.7f rounding of the track, which acos near 1 magnifies to a few hundredths of a degree */
+    CHECK(Again.AngleMax < 0.1f);
+    /* Without magnetometer Mahony leaves gyro bias partly uncorrected, a narrow threshold is never held */
+    Config.UseMag = false;
+    Config.ConvergenceThreshold = 0.05f;
+    CHECK(HostImuReplay_Run(&Config, Log, &Truth, NULL, &Again));
+    CHECK(Again.ConvergenceTime < 0.0f);
+    HostAttitudeTrack_Free(&Previous);
+    HostAttitudeTrack_Free(&Output);
+}
+
+/* replay_imu on files: CSV with reference, conversion to binary, binary again */
+static void TestTool (const sHostImuLog_t *Log) {
+    char Directory[] = "/tmp/imu_replay_XXXXXX";
+    char LogPath[64];
+    char ReferencePath[64];
+    char BinaryPath[64];
+    char Command[256];
+    char Output[4096];
+    CHECK(mkdtemp(Directory) != NULL);
+    snprintf(LogPath, sizeof(LogPath), "%s/log.csv", Directory);
+    snprintf(ReferencePath, sizeof(ReferencePath), "%s/truth.csv", Directory);
+    snprintf(BinaryPath, sizeof(BinaryPath), "%s/log.bin", Directory);
+    CHECK(WriteFile(LogPath, HostHal_CaptureGet()));
+    FILE *File = fopen(ReferencePath, "w");
+    CHECK((File != NULL) && HostAttitudeTrack_WriteCsv(&Truth, File));
+    fclose(File);
+    for (unsigned int Run = 0; Run < 2; Run++) {
+        if (Run == 0) {
+            snprintf(Command, sizeof(Command), TOOL " -e mekf -r %s -w %s %s", ReferencePath, BinaryPath, LogPath);
+        } else {
+            snprintf(Command, sizeof(Command), TOOL " -e MEKF -r %s %s", ReferencePath, BinaryPath);
+        }
+        FILE *Pipe = popen(Command, "r");
+        size_t Length = (Pipe != NULL) ? fread(Output, 1, sizeof(Output) - 1, Pipe) : 0;
+        Output[Length] = '\0';
+        CHECK((Pipe != NULL) && (pclose(Pipe) == 0));
+        CHECK(strstr(Output, "19950 samples, 20.00 s") != NULL);
+        CHECK(strstr(Output, "MEKF: ") != NULL);
+        CHECK(strstr(Output, "tilt within 1.00 deg from") != NULL);
+        if (Run == 0) {
+            printf("%s", Output);
+        }
+    }
+    unlink(LogPath);
+    unlink(ReferencePath);
+    unlink(BinaryPath);
+    rmdir(Directory);
+    (void)Log;
+}
+
+int TestMain (int argc, char **argv) {
+    sHostImuLog_t Log;
+    (void)argc;
+    (void)argv;
+    Record();
+    PrintLog();
+    TestParse(&Log);
+    TestBinary(&Log);
+    TestReplay(&Log);
+    TestTool(&Log);
+    HostHal_CaptureStop();
+    HostImuLog_Free(&Log);
+    HostAttitudeTrack_Free(&Truth);
+    return HostTest_Result("imu_replay");
+}
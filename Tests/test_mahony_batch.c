@@ -0,0 +1,197 @@
+/* MahonyAHRSupdateBatch against the same samples fed one at a time through MahonyAHRSupdateIMUInstance. The only
+ * intended difference is that the batch skips renormalisation while |norm^2 - 1| stays within its threshold, so
+ * outputs may be off unit length by that much and attitude by what that does to the feedback. Throughput of both on
+ * the same stream is reported as updates/s on host and cycles/sample from MahonyBenchmark_Run. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "MahonyAHRS.h"
+#include "MahonyAHRSBenchmark.h"
+#include "host_hal.h"
+#include "host_test.h"
+
+
+#define SAMPLES                     4096
+#define BURST                       32          // samples per FIFO read in the chunked run
+#define RENORM_THRESHOLD            1.0e-4f     // batchRenormThreshold in MahonyAHRS.c
+/* Components of an output that skipped renormalisation are off by up to half the norm error, 5e-5 measured on this
+ * stream with any of the gains below; the feedback acting on the scaled estimate adds nothing visible on top */
+#define ATTITUDE_TOLERANCE          RENORM_THRESHOLD
+#define BENCHMARK_RUNS              5
+
+
+static MahonyAHRSsample_t Samples[SAMPLES];
+static MahonyAHRSquaternion_t Outputs[SAMPLES];
+
+/* Coning at 2 Hz on top of a slow yaw, gravity tilted and with a vibration term, dt jittering around 1 kHz */
+static void MakeSamples (void) {
+    float t = 0.0f;
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        MahonyAHRSsample_t *S = &Samples[i];
+        S->dt = 0.001f + 0.00005f * sinf(0.37f * (float)i);
+        t += S->dt;
+        S->gx = 0.5f * sinf(12.566f * t);
+        S->gy = 0.5f * cosf(12.566f * t);
+        S->gz = 0.3f;
+        S->ax = 0.15f + 0.02f * sinf(900.0f * t);
+        S->ay = -0.1f;
+        S->az = 0.98f;
+    }
+    /* Accelerometer dropout, both paths must take the gyro only branch */
+    for (unsigned int i = 1000; i < 1010; i++) {
+        Samples[i].ax = 0.0f;
+        Samples[i].ay = 0.0f;
+        Samples[i].az = 0.0f;
+    }
+}
+
+static float Distance (float A0, float A1, float A2, float A3, float B0, float B1, float B2, float B3) {
+    float D = fabsf(A0 - B0);
+    D = fmaxf(D, fabsf(A1 - B1));
+    D = fmaxf(D, fabsf(A2 - B2));
+    return fmaxf(D, fabsf(A3 - B3));
+}
+
+static void RunAgainstSingle (float TwoKp, float TwoKi) {
+    MahonyAHRS_t Single = MAHONY_AHRS_INITIALISER(TwoKp, TwoKi);
+    MahonyAHRS_t Batch = MAHONY_AHRS_INITIALISER(TwoKp, TwoKi);
+    float MaxError = 0.0f;
+    float MaxNormError = 0.0f;
+    unsigned int Skipped = 0;
+    MahonyAHRSupdateBatch(&Batch, Samples, SAMPLES, Outputs);
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        const MahonyAHRSsample_t *S = &Samples[i];
+        const MahonyAHRSquaternion_t *Q = &Outputs[i];
+        float NormSq = Q->q0 * Q->q0 + Q->q1 * Q->q1 + Q->q2 * Q->q2 + Q->q3 * Q->q3;
+        MahonyAHRSupdateIMUInstance(&Single, S->gx, S->gy, S->gz, S->ax, S->ay, S->az, S->dt);
+        MaxError = fmaxf(MaxError, Distance(Q->q0, Q->q1, Q->q2, Q->q3, Single.q0, Single.q1, Single.q2, Single.q3));
+        MaxNormError = fmaxf(MaxNormError, fabsf(NormSq - 1.0f));
+        if (fabsf(NormSq - 1.0f) > 1.0e-6f) {
+            Skipped++;
+        }
+    }
+    printf("  twoKp %.2f twoKi %.2f: max attitude difference %.2e, max |norm^2 - 1| %.2e, %u of %u outputs not renormalised\n",
+           (double)TwoKp, (double)TwoKi, (double)MaxError, (double)MaxNormError, Skipped, SAMPLES);
+    CHECK(MaxError <= ATTITUDE_TOLERANCE);
+    CHECK(MaxNormError <= RENORM_THRESHOLD);
+    /* The threshold is actually being used, otherwise this would just be the single update */
+    CHECK(Skipped > SAMPLES / 2);
+    /* Stored state is renormalised and the integral terms follow the same path */
+    CHECK_NEAR(Batch.q0 * Batch.q0 + Batch.q1 * Batch.q1 + Batch.q2 * Batch.q2 + Batch.q3 * Batch.q3, 1.0f, 1.0e-6f);
+    CHECK(Distance(Batch.q0, Batch.q1, Batch.q2, Batch.q3, Single.q0, Single.q1, Single.q2, Single.q3) <= ATTITUDE_TOLERANCE);
+    CHECK_NEAR(Batch.integralFBx, Single.integralFBx, 1.0e-5f);
+    CHECK_NEAR(Batch.integralFBy, Single.integralFBy, 1.0e-5f);
+    CHECK_NEAR(Batch.integralFBz, Single.integralFBz, 1.0e-5f);
+    CHECK((TwoKi > 0.0f) == (Batch.integralFBx != 0.0f));
+    CHECK((Batch.twoKp == TwoKp) && (Batch.twoKi == TwoKi));
+}
+
+/* FIFO sized bursts, with and without outputs, end in the same place as one big batch up to the extra
+ * renormalisation at every burst boundary */
+static void TestBursts (void) {
+    MahonyAHRS_t Whole = MAHONY_AHRS_INITIALISER(2.0f, 0.2f);
+    MahonyAHRS_t Bursts = MAHONY_AHRS_INITIALISER(2.0f, 0.2f);
+    MahonyAHRS_t NoOutputs = MAHONY_AHRS_INITIALISER(2.0f, 0.2f);
+    MahonyAHRSupdateBatch(&Whole, Samples, SAMPLES, NULL);
+    for (unsigned int i = 0; i < SAMPLES; i += BURST) {
+        MahonyAHRSupdateBatch(&Bursts, &Samples[i], BURST, Outputs);
+        MahonyAHRSupdateBatch(&NoOutputs, &Samples[i], BURST, NULL);
+    }
+    CHECK(memcmp(&Bursts, &NoOutputs, sizeof(MahonyAHRS_t)) == 0);
+    CHECK(Distance(Whole.q0, Whole.q1, Whole.q2, Whole.q3, Bursts.q0, Bursts.q1, Bursts.q2, Bursts.q3) <= ATTITUDE_TOLERANCE);
+}
+
+/* A one sample batch is a single update */
+static void TestSingleSample (void) {
+    MahonyAHRS_t Single = MAHONY_AHRS_INITIALISER(2.0f, 0.2f);
+    MahonyAHRS_t Batch = MAHONY_AHRS_INITIALISER(2.0f, 0.2f);
+    for (unsigned int i = 0; i < 200; i++) {
+        const MahonyAHRSsample_t *S = &Samples[i];
+        MahonyAHRSupdateIMUInstance(&Single, S->gx, S->gy, S->gz, S->ax, S->ay, S->az, S->dt);
+        MahonyAHRSupdateBatch(&Batch, S, 1, NULL);
+    }
+    CHECK(Distance(Batch.q0, Batch.q1, Batch.q2, Batch.q3, Single.q0, Single.q1, Single.q2, Single.q3) <= 1.0e-6f);
+}
+
+static void TestEmpty (void) {
+    MahonyAHRS_t Batch = MAHONY_AHRS_INITIALISER(2.0f, 0.2f);
+    MahonyAHRS_t Before;
+    MahonyAHRSupdateBatch(&Batch, Samples, 100, NULL);
+    Before = Batch;
+    MahonyAHRSupdateBatch(&Batch, Samples, 0, Outputs);
+    CHECK(Distance(Batch.q0, Batch.q1, Batch.q2, Batch.q3, Before.q0, Before.q1, Before.q2, Before.q3) <= 1.0e-6f);
+    CHECK(Batch.integralFBx == Before.integralFBx);
+}
+
+static double SingleNs (MahonyAHRS_t *Ahrs) {
+    MahonyAHRSinit(Ahrs, 2.0f, 0.2f);
+    double Start = HostTest_NowNs();
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        const MahonyAHRSsample_t *S = &Samples[i];
+        MahonyAHRSupdateIMUInstance(Ahrs, S->gx, S->gy, S->gz, S->ax, S->ay, S->az, S->dt);
+    }
+    return HostTest_NowNs() - Start;
+}
+
+static double BatchNs (MahonyAHRS_t *Ahrs, unsigned int Burst, MahonyAHRSquaternion_t *Out) {
+    MahonyAHRSinit(Ahrs, 2.0f, 0.2f);
+    double Start = HostTest_NowNs();
+    for (unsigned int i = 0; i < SAMPLES; i += Burst) {
+        MahonyAHRSupdateBatch(Ahrs, &Samples[i], Burst, (Out != NULL) ? &Out[i] : NULL);
+    }
+    return HostTest_NowNs() - Start;
+}
+
+/* Best of BENCHMARK_RUNS over the whole stream on host, FIFO sized bursts and one batch, with and without outputs;
+ * the target figures are what MahonyBenchmark_Run prints there */
+static void TestThroughput (void) {
+    MahonyAHRS_t Ahrs;
+    double Best[4] = {1e30, 1e30, 1e30, 1e30};
+    const char *Names[4] = {"single", "batch x32", "batch x32 + outputs", "batch x4096"};
+    unsigned int Updates;
+    unsigned int SingleCycles;
+    unsigned int Burst;
+    unsigned int BatchCycles;
+    for (unsigned int Run = 0; Run < BENCHMARK_RUNS; Run++) {
+        const double Ns[4] = {
+            SingleNs(&Ahrs), BatchNs(&Ahrs, BURST, NULL), BatchNs(&Ahrs, BURST, Outputs), BatchNs(&Ahrs, SAMPLES, NULL)
+        };
+        for (unsigned int i = 0; i < 4; i++) {
+            Best[i] = (Ns[i] < Best[i]) ? Ns[i] : Best[i];
+        }
+    }
+    printf("IMU update x%u, host best of %u:\n", SAMPLES, BENCHMARK_RUNS);
+    for (unsigned int i = 0; i < 4; i++) {
+        printf("  %-20s %6.1f ns/sample %6.2f M updates/s %.2fx\n", Names[i], Best[i] / SAMPLES,
+               SAMPLES / Best[i] * 1e3, Best[0] / Best[i]);
+        CHECK(Best[i] > 0.0);
+    }
+    HostHal_SetQuiet(true);
+    HostHal_CaptureStart();
+    MahonyBenchmark_Run();
+    HostHal_SetQuiet(false);
+    const char *Line = strstr(HostHal_CaptureGet(), "MAHONY IMU");
+    CHECK(Line != NULL);
+    if (Line != NULL) {
+        printf("%.*s\n", (int)strcspn(Line, "\r"), Line);
+        CHECK(sscanf(Line, "MAHONY IMU x%u single[cyc] %u batch x%u[cyc] %u", &Updates, &SingleCycles, &Burst,
+                     &BatchCycles) == 4);
+        CHECK((Updates == SAMPLES) && (Burst == BURST));
+    }
+    HostHal_CaptureStop();
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    MakeSamples();
+    RunAgainstSingle(1.0f, 0.0f);
+    RunAgainstSingle(2.0f, 0.2f);
+    RunAgainstSingle(10.0f, 1.0f);
+    TestBursts();
+    TestSingleSample();
+    TestEmpty();
+    TestThroughput();
+    return HostTest_Result("mahony_batch");
+}
@@ -0,0 +1,220 @@
+/* MahonyAHRS.c instance API: two filters updated in turn end up exactly where each would alone, the legacy
+ * single-instance calls are the default instance with the old fixed gains and sample rate, and the instance update
+ * against the volatile-global filter it replaced on the same stream */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "MahonyAHRS.h"
+#include "MahonyAHRSBenchmark.h"
+#include "host_hal.h"
+#include "host_test.h"
+
+
+#define SAMPLES                     2000
+#define DT                          0.002f
+/* Mirrors the legacy defaults in MahonyAHRS.c */
+#define LEGACY_TWO_KP               (2.0f * 0.5f)
+#define LEGACY_TWO_KI               (2.0f * 0.0f)
+#define LEGACY_SAMPLE_FREQ          512.0f
+#define BENCHMARK_SAMPLES           4096
+#define BENCHMARK_RUNS              5
+#define BENCHMARK_TWO_KP            (2.0f * 0.5f)
+#define BENCHMARK_TWO_KI            (2.0f * 0.1f)
+/* Baseline keeps the one Newton step bit-hack inverse square root, up to 1.8e-3 relative error per normalisation */
+#define BASELINE_TOLERANCE          5e-3f
+
+
+typedef struct {
+    float g[3];
+    float a[3];
+    float m[3];
+} sSample_t;
+
+/* Slow coning with a tilted, noisy-looking gravity and a fixed field, Seed gives each stream its own motion */
+static void MakeSample (unsigned int i, float Seed, sSample_t *Sample) {
+    float t = (float)i * DT;
+    Sample->g[0] = 0.4f * sinf(Seed * t);
+    Sample->g[1] = 0.3f * cosf(1.7f * Seed * t);
+    Sample->g[2] = -0.2f + 0.1f * sinf(3.0f * t);
+    Sample->a[0] = 0.1f * sinf(t + Seed);
+    Sample->a[1] = -0.2f + 0.05f * cosf(5.0f * t);
+    Sample->a[2] = 0.97f;
+    Sample->m[0] = 20.0f;
+    Sample->m[1] = 5.0f * Seed;
+    Sample->m[2] = -40.0f;
+}
+
+static bool SameState (const MahonyAHRS_t *A, const MahonyAHRS_t *B) {
+    return memcmp(A, B, sizeof(MahonyAHRS_t)) == 0;
+}
+
+static void TestInit (void) {
+    MahonyAHRS_t Initialised;
+    const MahonyAHRS_t Static = MAHONY_AHRS_INITIALISER(1.5f, 0.25f);
+    memset(&Initialised, 0xA5, sizeof(Initialised));
+    MahonyAHRSinit(&Initialised, 1.5f, 0.25f);
+    CHECK(SameState(&Initialised, &Static));
+    CHECK((Static.q0 == 1.0f) && (Static.q1 == 0.0f) && (Static.integralFBz == 0.0f));
+}
+
+static void TestIndependence (void) {
+    MahonyAHRS_t A;
+    MahonyAHRS_t B;
+    MahonyAHRS_t AloneA;
+    MahonyAHRS_t AloneB;
+    sSample_t Sa;
+    sSample_t Sb;
+    MahonyAHRSinit(&A, 1.0f, 0.2f);
+    MahonyAHRSinit(&B, 4.0f, 0.0f);
+    AloneA = A;
+    AloneB = B;
+    /* Interleaved, B on the 9-axis path, A alternating between paths */
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        MakeSample(i, 1.0f, &Sa);
+        MakeSample(i, 2.5f, &Sb);
+        if (i & 1) {
+            MahonyAHRSupdateIMUInstance(&A, Sa.g[0], Sa.g[1], Sa.g[2], Sa.a[0], Sa.a[1], Sa.a[2], DT);
+        } else {
+            MahonyAHRSupdateInstance(&A, Sa.g[0], Sa.g[1], Sa.g[2], Sa.a[0], Sa.a[1], Sa.a[2], Sa.m[0], Sa.m[1], Sa.m[2], DT);
+        }
+        MahonyAHRSupdateInstance(&B, Sb.g[0], Sb.g[1], Sb.g[2], Sb.a[0], Sb.a[1], Sb.a[2], Sb.m[0], Sb.m[1], Sb.m[2], DT);
+    }
+    /* Same streams, one filter at a time */
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        MakeSample(i, 1.0f, &Sa);
+        if (i & 1) {
+            MahonyAHRSupdateIMUInstance(&AloneA, Sa.g[0], Sa.g[1], Sa.g[2], Sa.a[0], Sa.a[1], Sa.a[2], DT);
+        } else {
+            MahonyAHRSupdateInstance(&AloneA, Sa.g[0], Sa.g[1], Sa.g[2], Sa.a[0], Sa.a[1], Sa.a[2], Sa.m[0], Sa.m[1], Sa.m[2], DT);
+        }
+    }
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        MakeSample(i, 2.5f, &Sb);
+        MahonyAHRSupdateInstance(&AloneB, Sb.g[0], Sb.g[1], Sb.g[2], Sb.a[0], Sb.a[1], Sb.a[2], Sb.m[0], Sb.m[1], Sb.m[2], DT);
+    }
+    CHECK(SameState(&A, &AloneA));
+    CHECK(SameState(&B, &AloneB));
+    /* And the two really did diverge, so the comparison means something */
+    CHECK(fabsf(A.q1 - B.q1) > 1e-3f);
+    CHECK(A.integralFBx != 0.0f);
+    CHECK(B.integralFBx == 0.0f);
+}
+
+/* Default instance is static, compare what printQuaternion reports */
+static void CheckLegacyMatches (const MahonyAHRS_t *Reference) {
+    char Legacy[128];
+    HostHal_CaptureStart();
+    printQuaternion();
+    snprintf(Legacy, sizeof(Legacy), "%s", HostHal_CaptureGet());
+    HostHal_CaptureStart();
+    printQuaternionInstance(Reference);
+    CHECK(strcmp(Legacy, HostHal_CaptureGet()) == 0);
+    HostHal_CaptureStop();
+}
+
+static void TestLegacy (void) {
+    MahonyAHRS_t Reference = MAHONY_AHRS_INITIALISER(LEGACY_TWO_KP, LEGACY_TWO_KI);
+    const float LegacyDt = 1.0f / LEGACY_SAMPLE_FREQ;
+    sSample_t S;
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        MakeSample(i, 1.3f, &S);
+        switch (i % 4) {
+            case 0:
+                MahonyAHRSupdate(S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], S.m[0], S.m[1], S.m[2]);
+                MahonyAHRSupdateInstance(&Reference, S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], S.m[0], S.m[1], S.m[2], LegacyDt);
+                break;
+            case 1:
+                MahonyAHRSupdateIMU(S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2]);
+                MahonyAHRSupdateIMUInstance(&Reference, S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], LegacyDt);
+                break;
+            case 2:
+                MahonyAHRSupdateDt(S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], S.m[0], S.m[1], S.m[2], DT);
+                MahonyAHRSupdateInstance(&Reference, S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], S.m[0], S.m[1], S.m[2], DT);
+                break;
+            default:
+                MahonyAHRSupdateIMUDt(S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], DT);
+                MahonyAHRSupdateIMUInstance(&Reference, S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], DT);
+                break;
+        }
+    }
+    CheckLegacyMatches(&Reference);
+    /* A filter with other gains does not match, the print comparison can tell them apart */
+    MahonyAHRS_t Other = MAHONY_AHRS_INITIALISER(3.0f * LEGACY_TWO_KP, LEGACY_TWO_KI);
+    for (unsigned int i = 0; i < SAMPLES; i++) {
+        MakeSample(i, 1.3f, &S);
+        MahonyAHRSupdateIMUInstance(&Other, S.g[0], S.g[1], S.g[2], S.a[0], S.a[1], S.a[2], DT);
+    }
+    CHECK(fabsf(Other.q1 - Reference.q1) > 1e-5f);
+}
+
+static double BaselineNs (const sSample_t *Stream) {
+    MahonyAHRSBaselineInit(BENCHMARK_TWO_KP, BENCHMARK_TWO_KI);
+    double Start = HostTest_NowNs();
+    for (unsigned int i = 0; i < BENCHMARK_SAMPLES; i++) {
+        const sSample_t *S = &Stream[i];
+        MahonyAHRSBaselineUpdate(S->g[0], S->g[1], S->g[2], S->a[0], S->a[1], S->a[2], S->m[0], S->m[1], S->m[2], DT);
+    }
+    return (HostTest_NowNs() - Start) / BENCHMARK_SAMPLES;
+}
+
+static double InstanceNs (const sSample_t *Stream, MahonyAHRS_t *Ahrs) {
+    MahonyAHRSinit(Ahrs, BENCHMARK_TWO_KP, BENCHMARK_TWO_KI);
+    double Start = HostTest_NowNs();
+    for (unsigned int i = 0; i < BENCHMARK_SAMPLES; i++) {
+        const sSample_t *S = &Stream[i];
+        MahonyAHRSupdateInstance(Ahrs, S->g[0], S->g[1], S->g[2], S->a[0], S->a[1], S->a[2], S->m[0], S->m[1], S->m[2], DT);
+    }
+    return (HostTest_NowNs() - Start) / BENCHMARK_SAMPLES;
+}
+
+/* Same 9-axis stream through both, best of BENCHMARK_RUNS on host; the target figures are what MahonyBenchmark_Run
+ * prints there */
+static void TestAgainstBaseline (void) {
+    static sSample_t Stream[BENCHMARK_SAMPLES];
+    MahonyAHRS_t Ahrs;
+    MahonyAHRSquaternion_t Baseline;
+    double Worst = 0.0;
+    double BestBaseline = 1e30;
+    double BestInstance = 1e30;
+    unsigned int Updates;
+    unsigned int BaselineCycles;
+    unsigned int InstanceCycles;
+    float MaxError;
+    for (unsigned int i = 0; i < BENCHMARK_SAMPLES; i++) {
+        MakeSample(i, 1.1f, &Stream[i]);
+    }
+    for (unsigned int Run = 0; Run < BENCHMARK_RUNS; Run++) {
+        double Ns = BaselineNs(Stream);
+        BestBaseline = (Ns < BestBaseline) ? Ns : BestBaseline;
+        Ns = InstanceNs(Stream, &Ahrs);
+        BestInstance = (Ns < BestInstance) ? Ns : BestInstance;
+    }
+    MahonyAHRSBaselineGet(&Baseline);
+    Worst = fmax(fabs(Ahrs.q0 - Baseline.q0), fmax(fabs(Ahrs.q1 - Baseline.q1),
+                 fmax(fabs(Ahrs.q2 - Baseline.q2), fabs(Ahrs.q3 - Baseline.q3))));
+    printf("9-axis update x%u: baseline %.1f ns, instance %.1f ns (%.2fx), final max|dq| %.2e\n", BENCHMARK_SAMPLES,
+           BestBaseline, BestInstance, BestBaseline / BestInstance, Worst);
+    CHECK(Worst < BASELINE_TOLERANCE);
+    CHECK(fabsf(Ahrs.q1) > 1e-2f);
+
+    HostHal_CaptureStart();
+    MahonyBenchmark_Run();
+    printf("%s\n", HostHal_CaptureGet());
+    CHECK(sscanf(HostHal_CaptureGet(), "MAHONY x%u baseline[cyc] %u instance[cyc] %u max|dq| %e", &Updates,
+                 &BaselineCycles, &InstanceCycles, &MaxError) == 4);
+    CHECK(Updates == BENCHMARK_SAMPLES);
+    CHECK(MaxError < BASELINE_TOLERANCE);
+    HostHal_CaptureStop();
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    HostHal_SetQuiet(true);
+    TestInit();
+    TestIndependence();
+    TestLegacy();
+    TestAgainstBaseline();
+    return HostTest_Result("mahony_instances");
+}
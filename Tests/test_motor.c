@@ -0,0 +1,195 @@
+/* Three motor PWM drive of motor_api.c on the HostTim registers: timer setup and the TIM1 trigger start, the committed
+ * SVPWM table against the formula it was generated from, duty range and line to line voltage against an ideal sine
+ * over the whole 16 bit angle, Motor_SetVoltage against Motor_Set, and the cost of one update of all three motors. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "stm32f3xx_ll_tim.h"
+#include "motor_api.h"
+#include "host_hal.h"
+#include "host_test.h"
+
+
+#define PWM_PERIOD                  1800        // MOTOR_PWM_PERIOD
+#define HALF_PERIOD                 900.0
+#define TABLE_SIZE                  256         // MOTOR_TABLE_SIZE
+#define AMPLITUDE_ONE               32767
+#define PHASE_SHIFT                 21845       // MOTOR_PHASE_SHIFT
+#define TWO_PI                      6.283185307179586
+#define FULL_SCALE                  899         // (32767 * 900) >> 15, compare counts per unit of table at amplitude one
+#define TABLE_STEP                  (TWO_PI / TABLE_SIZE)
+#define MAX_SLOPE                   1.7320508   // steepest SVPWM slope, sqrt(3) where the zero sequence switches phase
+#define BENCHMARK_STEPS             100000
+
+static TIM_TypeDef *const g_Timer[eMotor_Last] = {TIM1, TIM2, TIM3};
+
+
+/* Min/max zero sequence SVPWM of phase A at angle X, full scale 1: the formula of motor_svpwm_table.py without rounding */
+static double Svpwm (double X) {
+    double A = sin(X);
+    double B = sin(X - TWO_PI / 3.0);
+    double C = sin(X + TWO_PI / 3.0);
+    double Max = fmax(A, fmax(B, C));
+    double Min = fmin(A, fmin(B, C));
+    return 2.0 / sqrt(3.0) * (A - 0.5 * (Max + Min));
+}
+
+static void ReadCompare (eMotor_t Motor, unsigned int Duty[3]) {
+    Duty[0] = g_Timer[Motor]->CCR1;
+    Duty[1] = g_Timer[Motor]->CCR2;
+    Duty[2] = g_Timer[Motor]->CCR3;
+}
+
+/* Centre aligned 20 kHz at 50 % on every phase, TIM2 and TIM3 started by TIM1 */
+static void TestInit (void) {
+    memset(HostTim, 0, sizeof(HostTim));
+    CHECK(Motor_Init());
+    CHECK(Motor_GetPwmPeriod() == PWM_PERIOD);
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        unsigned int Duty[3];
+        ReadCompare(Motor, Duty);
+        CHECK(LL_TIM_IsEnabledCounter(g_Timer[Motor]));
+        CHECK((g_Timer[Motor]->ARR == PWM_PERIOD) && (g_Timer[Motor]->PSC == 0));
+        CHECK((g_Timer[Motor]->CR1 & TIM_CR1_CMS) == LL_TIM_COUNTERMODE_CENTER_UP);
+        CHECK((Duty[0] == PWM_PERIOD / 2) && (Duty[1] == PWM_PERIOD / 2) && (Duty[2] == PWM_PERIOD / 2));
+    }
+    CHECK((TIM2->SMCR & TIM_SMCR_SMS) == LL_TIM_SLAVEMODE_TRIGGER);
+    CHECK((TIM3->SMCR & TIM_SMCR_SMS) == LL_TIM_SLAVEMODE_TRIGGER);
+    CHECK((TIM1->SMCR & TIM_SMCR_SMS) == 0);
+}
+
+/* At each table angle a full amplitude duty is the table entry times FULL_SCALE >> 15, so the compare values must be
+ * exactly what the formula of the table gives there; the Q15 scale and the truncating shift keep them within two
+ * counts of the unrounded duty. Phase B lags A and C leads it by a third of a turn. */
+static void TestTable (void) {
+    double Worst = 0.0;
+    unsigned int Mismatches = 0;
+    for (unsigned int i = 0; i < TABLE_SIZE; i++) {
+        uint16_t Angle = (uint16_t)(i << 8);
+        unsigned int Duty[3];
+        sMotorState_t State;
+        Motor_SetRaw(eMotor_Pitch, Angle, AMPLITUDE_ONE);
+        ReadCompare(eMotor_Pitch, Duty);
+        Motor_GetState(eMotor_Pitch, &State);
+        for (unsigned int Phase = 0; Phase < 3; Phase++) {
+            uint16_t PhaseAngle = (uint16_t)(Angle - ((Phase == 1) ? PHASE_SHIFT : 0) + ((Phase == 2) ? PHASE_SHIFT : 0));
+            double X = TABLE_STEP * (((PhaseAngle + 128) >> 8) & (TABLE_SIZE - 1));
+            int32_t Entry = (int32_t)lround(AMPLITUDE_ONE * Svpwm(X));
+            Mismatches += (Duty[Phase] != (unsigned int)(PWM_PERIOD / 2 + ((Entry * FULL_SCALE) >> 15)));
+            Worst = fmax(Worst, fabs((double)Duty[Phase] - HALF_PERIOD * (1.0 + Svpwm(X))));
+            CHECK(State.Duty[Phase] == Duty[Phase]);
+        }
+    }
+    printf("Table at its own angles: %u of %u compare values off the formula, worst %.2f counts from the unrounded "
+           "duty\n", Mismatches, 3 * TABLE_SIZE, Worst);
+    CHECK(Mismatches == 0);
+    CHECK(Worst < 2.0);
+}
+
+/* Every 16 bit angle at full amplitude: nearest entry quantisation against the exact formula (half a table step at the
+ * steepest slope), duty range, and the line to line voltage A - B the winding sees against the ideal
+ * sqrt(3) * 2 / sqrt(3) * sin(x + pi / 6) sine */
+static void TestSweep (void) {
+    unsigned int MinDuty = PWM_PERIOD;
+    unsigned int MaxDuty = 0;
+    double WorstPhase = 0.0;
+    double WorstLine = 0.0;
+    for (unsigned int Angle = 0; Angle < 65536; Angle++) {
+        unsigned int Duty[3];
+        double X = TWO_PI * Angle / 65536.0;
+        Motor_SetRaw(eMotor_Roll, (uint16_t)Angle, AMPLITUDE_ONE);
+        ReadCompare(eMotor_Roll, Duty);
+        for (unsigned int Phase = 0; Phase < 3; Phase++) {
+            MinDuty = (Duty[Phase] < MinDuty) ? Duty[Phase] : MinDuty;
+            MaxDuty = (Duty[Phase] > MaxDuty) ? Duty[Phase] : MaxDuty;
+        }
+        WorstPhase = fmax(WorstPhase, fabs((double)Duty[0] - HALF_PERIOD * (1.0 + Svpwm(X))));
+        double Line = ((double)Duty[0] - (double)Duty[1]) / HALF_PERIOD;
+        WorstLine = fmax(WorstLine, fabs(Line - 2.0 * sin(X + TWO_PI / 12.0)));
+    }
+    /* Line voltage full scale is 2 (two half periods) */
+    printf("Full amplitude sweep: duty %u..%u of %u, phase within %.1f counts of the formula, line to line within "
+           "%.2f%% of an ideal sine\n", MinDuty, MaxDuty, PWM_PERIOD, WorstPhase, WorstLine / 2.0 * 100.0);
+    CHECK((MinDuty >= 1) && (MaxDuty <= PWM_PERIOD - 1));
+    CHECK(WorstPhase < HALF_PERIOD * MAX_SLOPE * 0.5 * TABLE_STEP + 2.0);
+    CHECK(WorstLine / 2.0 < 0.013);
+}
+
+/* Amplitude scales about the centre, saturates at one, angles wrap; Motor_SetVoltage at angle - pi / 2 agrees with
+ * Motor_Set within the table quantisation */
+static void TestSet (void) {
+    unsigned int Duty[3];
+    unsigned int Wrapped[3];
+    Motor_Set(eMotor_Yaw, 1.0f, 0.0f);
+    ReadCompare(eMotor_Yaw, Duty);
+    CHECK((Duty[0] == PWM_PERIOD / 2) && (Duty[1] == PWM_PERIOD / 2) && (Duty[2] == PWM_PERIOD / 2));
+    Motor_Set(eMotor_Yaw, 1.0f, 2.0f);
+    ReadCompare(eMotor_Yaw, Duty);
+    Motor_Set(eMotor_Yaw, 1.0f, 1.0f);
+    ReadCompare(eMotor_Yaw, Wrapped);
+    CHECK(memcmp(Duty, Wrapped, sizeof(Duty)) == 0);
+    Motor_Set(eMotor_Yaw, -0.5f, 0.5f);
+    ReadCompare(eMotor_Yaw, Duty);
+    Motor_Set(eMotor_Yaw, (float)TWO_PI - 0.5f, 0.5f);
+    ReadCompare(eMotor_Yaw, Wrapped);
+    for (unsigned int Phase = 0; Phase < 3; Phase++) {
+        CHECK(abs((int)Duty[Phase] - (int)Wrapped[Phase]) <= 1);
+    }
+    CHECK(!Motor_Set(eMotor_Last, 0.0f, 0.0f) && !Motor_SetVoltage(eMotor_Last, 0.0f, 0.0f));
+    double Worst = 0.0;
+    for (unsigned int i = 0; i < 360; i++) {
+        float Angle = (float)(TWO_PI * i / 360.0);
+        Motor_Set(eMotor_Yaw, Angle, 0.8f);
+        ReadCompare(eMotor_Yaw, Duty);
+        Motor_SetVoltage(eMotor_Yaw, 0.8f * cosf(Angle - (float)TWO_PI / 4.0f), 0.8f * sinf(Angle - (float)TWO_PI / 4.0f));
+        ReadCompare(eMotor_Yaw, Wrapped);
+        for (unsigned int Phase = 0; Phase < 3; Phase++) {
+            Worst = fmax(Worst, fabs((double)Duty[Phase] - (double)Wrapped[Phase]));
+        }
+    }
+    printf("Motor_SetVoltage against Motor_Set at 0.8: worst phase %.0f counts\n", Worst);
+    CHECK(Worst < 0.8 * HALF_PERIOD * MAX_SLOPE * 0.5 * TABLE_STEP + 2.0);
+}
+
+/* Host time per update of all three motors for reference; the target figure is what MotorBenchmark_Run prints there */
+static void TestCost (void) {
+    unsigned int Cycles;
+    unsigned int Updates;
+    unsigned int Rate;
+    unsigned int Budget;
+    double Start = HostTest_NowNs();
+    for (unsigned int i = 0; i < BENCHMARK_STEPS; i++) {
+        for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+            Motor_Set(Motor, 0.01f * (float)i, 0.5f);
+        }
+    }
+    double Ns = (HostTest_NowNs() - Start) / BENCHMARK_STEPS;
+    printf("host: %.1f ns per update of three motors\n", Ns);
+    HostHal_SetQuiet(true);
+    HostHal_CaptureStart();
+    MotorBenchmark_Run();
+    HostHal_SetQuiet(false);
+    printf("%s", HostHal_CaptureGet());
+    CHECK(sscanf(HostHal_CaptureGet(), "MOTOR update x%u[cyc] %u budget@%uHz[cyc] %u", &Updates, &Cycles, &Rate,
+                 &Budget) == 4);
+    CHECK((Updates == eMotor_Last) && (Rate == 2000) && (Budget == 36000));
+    HostHal_CaptureStop();
+    /* Benchmark runs at zero amplitude */
+    unsigned int Duty[3];
+    ReadCompare(eMotor_Roll, Duty);
+    CHECK((Duty[0] == PWM_PERIOD / 2) && (Duty[1] == PWM_PERIOD / 2) && (Duty[2] == PWM_PERIOD / 2));
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    TestInit();
+    TestTable();
+    TestSweep();
+    TestSet();
+    TestCost();
+    return HostTest_Result("motor");
+}
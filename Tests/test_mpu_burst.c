@@ -0,0 +1,214 @@
+/* ReadIMU against a simulated MPU9250: one chip select frame per sample covering 0x3B..0x50, byte order and axis
+ * mapping of every field, compared with reading the same block one register at a time, and a recorded stream played
+ * back at the configured ODR with host time per ReadIMU next to its bus and kernel counters */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "spi_api.h"
+#include "message_queue_api.h"
+#include "mpu9250_api.h"
+#include "timing_stats_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_spi.h"
+#include "host_mpu9250.h"
+#include "host_imu_stream.h"
+#include "host_imu_log.h"
+#include "host_mpu_playback.h"
+#include "host_test.h"
+
+
+#define MPU_DATA_FIRST              0x3B
+#define MPU_DATA_LENGTH             (0x50 - 0x3B + 1)
+#define ACC_LSB_PER_MG              4.096f  // +-8 g
+#define GYR_LSB_PER_DPS             32.8f   // GYRO_CONFIG 0x10
+#define MAG_UT_PER_LSB              0.15f
+#define PLAYBACK_SAMPLES            4096
+#define PLAYBACK_SLOW_RATE          200     // Hz
+
+osThreadId controlTaskHandle;
+static sHostMpu_t g_Mpu;
+
+
+static void Setup (void) {
+    HostSpi_Reset();
+    HostMpu_Init(&g_Mpu);
+    /* Non-neutral sensitivity adjustment shows whether it is applied to the right axis */
+    g_Mpu.Akm[0x10] = 144;
+    g_Mpu.Akm[0x11] = 112;
+    HostMpu_Attach(&g_Mpu, SPI1, GPIOA, GPIO_PIN_4);
+    InitializeMessageQueues();
+    InitializeSpiMutexes();
+    InitializeSpiSlaves();
+    controlTaskHandle = xTaskGetCurrentTaskHandle();
+    CHECK(Mpu_Init());
+    CHECK(g_Mpu.Akm[0x0A] == 0x16);
+    CHECK(g_Mpu.FormatErrors == 0);
+}
+
+static void TestSingleFrame (void) {
+    /* High and low bytes differ everywhere so a swapped or shifted byte shows */
+    const int16_t Acc[3] = {0x1234, -0x0FED, 0x0102};
+    const int16_t Gyr[3] = {0x0148, -0x7F00, 0x7FFF};
+    const int16_t MagAkm[3] = {0x0164, -0x00C8, 0x012C};
+    sImuData_t Data;
+    HostMpu_SetSample(&g_Mpu, Acc, Gyr, MagAkm, true, false);
+    HostHal_AdvanceCycles(1000);
+    HandleExt3IRQ();
+    uint32_t DataReady = GetCycleCount();
+    uint32_t Transactions = g_Mpu.Transactions;
+    uint32_t Bytes = g_Mpu.Bytes;
+    CHECK(ReadIMU(&Data));
+    CHECK(g_Mpu.Transactions - Transactions == 1);
+    CHECK(g_Mpu.Bytes - Bytes == 1 + MPU_DATA_LENGTH);
+    CHECK(g_Mpu.LastStartAddress == MPU_DATA_FIRST);
+    CHECK(g_Mpu.LastLength == MPU_DATA_LENGTH);
+    CHECK(HostGpio[0].ODR & GPIO_PIN_4);
+    CHECK(Data.Timestamp == DataReady);
+
+    CHECK_NEAR(Data.A.X, 0x1234 / ACC_LSB_PER_MG, 1e-3);
+    CHECK_NEAR(Data.A.Y, -0x0FED / ACC_LSB_PER_MG, 1e-3);
+    CHECK_NEAR(Data.A.Z, 0x0102 / ACC_LSB_PER_MG, 1e-3);
+    CHECK_NEAR(Data.G.X, 0x0148 / GYR_LSB_PER_DPS, 1e-3);
+    CHECK_NEAR(Data.G.Y, -0x7F00 / GYR_LSB_PER_DPS, 1e-2);
+    CHECK_NEAR(Data.G.Z, 0x7FFF / GYR_LSB_PER_DPS, 1e-2);
+    /* AK8963 X/Y are MPU Y/X, Z points the other way; ASA of the AK8963 axis goes with it */
+    CHECK_NEAR(Data.M.X, -0x00C8 * MAG_UT_PER_LSB * (112.0f - 128.0f + 256.0f) / 256.0f, 1e-3);
+    CHECK_NEAR(Data.M.Y, 0x0164 * MAG_UT_PER_LSB * (144.0f - 128.0f + 256.0f) / 256.0f, 1e-3);
+    CHECK_NEAR(Data.M.Z, -0x012C * MAG_UT_PER_LSB, 1e-3);
+    CHECK(Data.MagFresh);
+
+    HostMpu_SetSample(&g_Mpu, Acc, Gyr, MagAkm, true, true);
+    CHECK(ReadIMU(&Data));
+    CHECK(!Data.MagFresh);
+    HostMpu_SetSample(&g_Mpu, Acc, Gyr, MagAkm, false, false);
+    CHECK(ReadIMU(&Data));
+    CHECK(!Data.MagFresh);
+}
+
+/* Same block read register by register, as the driver did before the burst read */
+static void TestAgainstSingleReads (void) {
+    const int16_t Acc[3] = {-1, 2, -3};
+    const int16_t Gyr[3] = {400, -500, 600};
+    const int16_t MagAkm[3] = {7, -8, 9};
+    uint8_t Burst[MPU_DATA_LENGTH];
+    uint8_t Single[MPU_DATA_LENGTH];
+    HostMpu_SetSample(&g_Mpu, Acc, Gyr, MagAkm, true, false);
+    uint32_t Transactions = g_Mpu.Transactions;
+    uint32_t Bytes = g_Mpu.Bytes;
+    CHECK(SpiReadSlaveRegisters(eSpiSlave_MPU, MPU_DATA_FIRST, Burst, sizeof(Burst)));
+    uint32_t BurstTransactions = g_Mpu.Transactions - Transactions;
+    uint32_t BurstBytes = g_Mpu.Bytes - Bytes;
+    Transactions = g_Mpu.Transactions;
+    Bytes = g_Mpu.Bytes;
+    for (unsigned int i = 0; i < MPU_DATA_LENGTH; i++) {
+        CHECK(SpiReadSlaveRegister(&Single[i], (uint8_t)(MPU_DATA_FIRST + i), eSpiSlave_MPU));
+    }
+    uint32_t SingleTransactions = g_Mpu.Transactions - Transactions;
+    uint32_t SingleBytes = g_Mpu.Bytes - Bytes;
+    CHECK(memcmp(Burst, Single, sizeof(Burst)) == 0);
+    CHECK(memcmp(Burst, &g_Mpu.Registers[MPU_DATA_FIRST], sizeof(Burst)) == 0);
+    CHECK(BurstTransactions == 1);
+    CHECK(SingleTransactions == MPU_DATA_LENGTH);
+    printf("per sample: register reads %u transactions %u bytes, burst %u transaction %u bytes\n",
+           (unsigned int)SingleTransactions, (unsigned int)SingleBytes, (unsigned int)BurstTransactions,
+           (unsigned int)BurstBytes);
+}
+
+/* Half a count of each full scale, magnetometer at the coarser of the two adjusted X/Y sensitivities */
+static void CheckSample (const sImuData_t *Data, const sImuData_t *Logged, float *WorstAcc, float *WorstGyr, float *WorstMag) {
+    *WorstAcc = fmaxf(*WorstAcc, fmaxf(fabsf(Data->A.X - Logged->A.X), fmaxf(fabsf(Data->A.Y - Logged->A.Y), fabsf(Data->A.Z - Logged->A.Z))));
+    *WorstGyr = fmaxf(*WorstGyr, fmaxf(fabsf(Data->G.X - Logged->G.X), fmaxf(fabsf(Data->G.Y - Logged->G.Y), fabsf(Data->G.Z - Logged->G.Z))));
+    if (Logged->MagFresh) {
+        *WorstMag = fmaxf(*WorstMag, fmaxf(fabsf(Data->M.X - Logged->M.X), fmaxf(fabsf(Data->M.Y - Logged->M.Y), fabsf(Data->M.Z - Logged->M.Z))));
+    }
+}
+
+/* Synthetic handheld recording through the register file at the ODR Mpu_Init programmed: one data ready per sample,
+ * samples back within quantisation, timestamps one period apart; then the same log at a slower configured rate */
+static void TestPlayback (void) {
+    sHostImuStream_t Stream;
+    sHostImuLog_t Log;
+    sHostMpuPlayback_t Playback;
+    sImuData_t Sample;
+    sImuData_t Data;
+    sSpiStats_t Spi;
+    sHostRtosStats_t Rtos;
+    float WorstAcc = 0.0f;
+    float WorstGyr = 0.0f;
+    float WorstMag = 0.0f;
+    unsigned int Missed = 0;
+    unsigned int Mismatched = 0;
+    unsigned int Failed = 0;
+    double ElapsedNs = 0.0;
+
+    HostImuStream_Init(&Stream);
+    HostImuLog_Init(&Log, SystemCoreClock);
+    for (unsigned int i = 0; i < PLAYBACK_SAMPLES; i++) {
+        HostImuStream_Next(&Stream, &Sample);
+        CHECK(HostImuLog_Append(&Log, &Sample));
+    }
+    HostMpuPlayback_Init(&Playback, &g_Mpu, &Log, 0);
+    CHECK(Playback.Rate == 1000000 / Mpu_GetSamplePeriodUs());
+    CHECK(Playback.Period == SystemCoreClock / Playback.Rate);
+    (void)ulTaskNotifyTake(pdTRUE, 0);
+    SpiResetStats(eSpi_1);
+    HostRtos_ResetStats();
+    uint32_t Transactions = g_Mpu.Transactions;
+    uint32_t Previous = 0;
+    while (HostMpuPlayback_Next(&Playback)) {
+        Missed += (ulTaskNotifyTake(pdTRUE, 0) != 1);
+        double Start = HostTest_NowNs();
+        bool Read = ReadIMU(&Data);
+        ElapsedNs += HostTest_NowNs() - Start;
+        Failed += !Read;
+        const sImuData_t *Logged = &Log.Samples[Playback.Index - 1];
+        CheckSample(&Data, Logged, &WorstAcc, &WorstGyr, &WorstMag);
+        Mismatched += (Data.MagFresh != Logged->MagFresh) ||
+                      ((Playback.Index > 1) && ((uint32_t)(Data.Timestamp - Previous) != Playback.Period));
+        Previous = Data.Timestamp;
+    }
+    CHECK(SpiGetStats(eSpi_1, &Spi));
+    HostRtos_GetStats(&Rtos);
+    printf("playback of %u samples at %u Hz: acc within %.3f mg, gyro %.4f dps, mag %.3f uT, %u saturated\n",
+           Log.Count, Playback.Rate, WorstAcc, WorstGyr, WorstMag, (unsigned int)Playback.Saturated);
+    printf("ReadIMU: host %.0f ns/sample, per sample %.1f bytes %.1f CS edges %.1f mutex takes %.1f data ready\n",
+           ElapsedNs / Log.Count, (double)Spi.BytesTransferred / Log.Count, (double)Spi.CsToggles / Log.Count,
+           (double)Spi.MutexAcquisitions / Log.Count, (double)Rtos.NotifyGives / Log.Count);
+    CHECK((Missed == 0) && (Mismatched == 0) && (Failed == 0));
+    CHECK(Playback.DataReady == Log.Count);
+    CHECK(Playback.FifoFrames == 0);
+    CHECK((Playback.Saturated == 0) && (Playback.Overruns == 0));
+    CHECK(WorstAcc <= 0.5f / ACC_LSB_PER_MG + 1e-3f);
+    CHECK(WorstGyr <= 0.5f / GYR_LSB_PER_DPS + 1e-4f);
+    CHECK(WorstMag <= 0.5f * MAG_UT_PER_LSB * (144.0f - 128.0f + 256.0f) / 256.0f + 1e-3f);
+    CHECK(g_Mpu.Transactions - Transactions == Log.Count);
+    CHECK(Spi.BytesTransferred == Log.Count * (1 + MPU_DATA_LENGTH));
+    CHECK(Spi.CsToggles == 2 * Log.Count);
+    CHECK(Spi.MutexAcquisitions == Log.Count);
+    CHECK((Spi.TransferErrors == 0) && (Spi.MutexTimeouts == 0));
+
+    HostMpuPlayback_Init(&Playback, &g_Mpu, &Log, PLAYBACK_SLOW_RATE);
+    CHECK(Playback.Period == SystemCoreClock / PLAYBACK_SLOW_RATE);
+    CHECK(HostMpuPlayback_Next(&Playback) && ReadIMU(&Data));
+    Previous = Data.Timestamp;
+    CHECK(HostMpuPlayback_Next(&Playback) && ReadIMU(&Data));
+    CHECK((uint32_t)(Data.Timestamp - Previous) == SystemCoreClock / PLAYBACK_SLOW_RATE);
+    CHECK(ulTaskNotifyTake(pdTRUE, 0) == 2);
+    HostImuLog_Free(&Log);
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    Setup();
+    TestSingleFrame();
+    TestAgainstSingleReads();
+    TestPlayback();
+    CHECK(g_Mpu.FormatErrors == 0);
+    CHECK(HostRtos_GetCriticalNesting() == 0);
+    return HostTest_Result("mpu_burst");
+}
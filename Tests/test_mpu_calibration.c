@@ -0,0 +1,159 @@
+/* Calibrated conversion of mpu9250_api.c: Gain * Raw - Offset folded from Matrix * (Raw * Scale - Bias), checked
+ * through ReadIMU on the simulated MPU9250 against a double precision reference */
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "spi_api.h"
+#include "message_queue_api.h"
+#include "mpu9250_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_spi.h"
+#include "host_mpu9250.h"
+#include "host_test.h"
+
+
+#define ACC_MG_PER_LSB              (1000.0 / 4096.0)   // ACCEL_CONFIG 0x10, +-8 g
+#define GYR_DPS_PER_LSB             (1.0 / 32.8)        // GYRO_CONFIG 0x10, +-1000 dps
+#define MAG_UT_PER_LSB              0.15
+#define BENCHMARK_SAMPLES           1000000
+
+/* Mirrors the private raw sample type of mpu9250_api.c */
+typedef struct {
+    int16_t X;
+    int16_t Y;
+    int16_t Z;
+} sRawData3D_t;
+
+typedef struct {
+    sRawData3D_t A;
+    sRawData3D_t G;
+    sRawData3D_t M;
+    bool MagFresh;
+} sImuRawData_t;
+
+void Mpu_ConvertData (sImuData_t *ImuData, sImuRawData_t *ImuRawData);
+
+osThreadId controlTaskHandle;
+static sHostMpu_t g_Mpu;
+
+static const sSensorCalibration_t g_Identity = {
+    {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, {0.0f, 0.0f, 0.0f}
+};
+
+
+static void Reference (const sSensorCalibration_t *Calibration, const double Scale[3], const int16_t Raw[3], double Out[3]) {
+    const double Bias[3] = {Calibration->Bias.X, Calibration->Bias.Y, Calibration->Bias.Z};
+    for (unsigned int i = 0; i < 3; i++) {
+        Out[i] = 0.0;
+        for (unsigned int j = 0; j < 3; j++) {
+            Out[i] += Calibration->Matrix[i][j] * ((double)Raw[j] * Scale[j] - Bias[j]);
+        }
+    }
+}
+
+static void CheckVector (const sData3D_t *Value, const double Expected[3], double Tolerance) {
+    CHECK_NEAR(Value->X, Expected[0], Tolerance);
+    CHECK_NEAR(Value->Y, Expected[1], Tolerance);
+    CHECK_NEAR(Value->Z, Expected[2], Tolerance);
+}
+
+static void Setup (void) {
+    HostSpi_Reset();
+    HostMpu_Init(&g_Mpu);
+    HostMpu_Attach(&g_Mpu, SPI1, GPIOA, GPIO_PIN_4);
+    InitializeMessageQueues();
+    InitializeSpiMutexes();
+    InitializeSpiSlaves();
+    controlTaskHandle = xTaskGetCurrentTaskHandle();
+}
+
+static void TestCalibration (void) {
+    /* Small misalignment plus scale error and bias, as a six-position calibration would give */
+    const sSensorCalibration_t Acc = {
+        {{1.02f, 0.01f, -0.02f}, {-0.01f, 0.98f, 0.03f}, {0.02f, -0.03f, 1.01f}}, {12.0f, -7.5f, 30.0f}
+    };
+    const sSensorCalibration_t Gyr = {
+        {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, {0.35f, -1.2f, 0.05f}
+    };
+    /* Hard and soft iron */
+    const sSensorCalibration_t Mag = {
+        {{1.1f, 0.05f, 0.0f}, {0.05f, 0.9f, 0.0f}, {0.0f, 0.0f, 1.0f}}, {20.0f, -15.0f, 5.0f}
+    };
+    const int16_t RawAcc[3] = {1234, -4321, 4000};
+    const int16_t RawGyr[3] = {100, -2000, 32767};
+    const int16_t RawMagAkm[3] = {-300, 200, 150};
+    /* MPU axes of the magnetometer sample, see Mpu_ParseMagRaw3D */
+    const int16_t RawMag[3] = {200, -300, -150};
+    const double AccScale[3] = {ACC_MG_PER_LSB, ACC_MG_PER_LSB, ACC_MG_PER_LSB};
+    const double GyrScale[3] = {GYR_DPS_PER_LSB, GYR_DPS_PER_LSB, GYR_DPS_PER_LSB};
+    const double MagScale[3] = {MAG_UT_PER_LSB, MAG_UT_PER_LSB, MAG_UT_PER_LSB};
+    double Expected[3];
+    sImuData_t Data;
+
+    CHECK(!Mpu_SetCalibration(eMpuSensor_Last, &Acc));
+    CHECK(!Mpu_SetCalibration(eMpuSensor_Acc, NULL));
+    /* Set before init: full scale configured by init must be combined with it, not replace it */
+    CHECK(Mpu_SetCalibration(eMpuSensor_Acc, &Acc));
+    CHECK(Mpu_Init());
+    CHECK(Mpu_SetCalibration(eMpuSensor_Gyr, &Gyr));
+    CHECK(Mpu_SetCalibration(eMpuSensor_Mag, &Mag));
+    HostMpu_SetSample(&g_Mpu, RawAcc, RawGyr, RawMagAkm, true, false);
+    CHECK(ReadIMU(&Data));
+    Reference(&Acc, AccScale, RawAcc, Expected);
+    CheckVector(&Data.A, Expected, 1e-2);
+    Reference(&Gyr, GyrScale, RawGyr, Expected);
+    CheckVector(&Data.G, Expected, 1e-3);
+    Reference(&Mag, MagScale, RawMag, Expected);
+    CheckVector(&Data.M, Expected, 1e-3);
+
+    /* Back to identity gives plain sensitivity scaling */
+    CHECK(Mpu_SetCalibration(eMpuSensor_Acc, &g_Identity));
+    CHECK(ReadIMU(&Data));
+    CHECK_NEAR(Data.A.X, RawAcc[0] * ACC_MG_PER_LSB, 1e-3);
+    CHECK_NEAR(Data.A.Y, RawAcc[1] * ACC_MG_PER_LSB, 1e-3);
+    CHECK_NEAR(Data.A.Z, RawAcc[2] * ACC_MG_PER_LSB, 1e-3);
+    /* Other sensors keep theirs */
+    Reference(&Gyr, GyrScale, RawGyr, Expected);
+    CheckVector(&Data.G, Expected, 1e-3);
+    CHECK(HostRtos_GetCriticalNesting() == 0);
+}
+
+/* Per sample cost of the float stage alone, the host build of the same code as on target; the target figure is what
+ * MpuBenchmark_Run prints there */
+static void BenchmarkConversion (void) {
+    unsigned int Cycles;
+    unsigned int Rate;
+    unsigned int Budget;
+    sImuRawData_t Raw = { {1, -2, 3}, {4, -5, 6}, {7, -8, 9}, true };
+    sImuData_t Data;
+    float Sink = 0.0f;
+    double Start = HostTest_NowNs();
+    for (unsigned int i = 0; i < BENCHMARK_SAMPLES; i++) {
+        Raw.A.X = (int16_t)i;
+        Mpu_ConvertData(&Data, &Raw);
+        Sink += Data.A.X + Data.G.Y + Data.M.Z;
+    }
+    double Elapsed = HostTest_NowNs() - Start;
+    CHECK(Sink == Sink);
+    printf("Mpu_ConvertData: host %.2f ns/sample (27 multiply-adds, 9 subtractions)\n", Elapsed / BENCHMARK_SAMPLES);
+    HostHal_SetQuiet(true);
+    HostHal_CaptureStart();
+    MpuBenchmark_Run();
+    HostHal_SetQuiet(false);
+    printf("%s", HostHal_CaptureGet());
+    CHECK(sscanf(HostHal_CaptureGet(), "MPU convert[cyc] %u budget@%uHz[cyc] %u", &Cycles, &Rate, &Budget) == 3);
+    CHECK((Rate == 1000) && (Budget == 72000));
+    HostHal_CaptureStop();
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    Setup();
+    TestCalibration();
+    BenchmarkConversion();
+    return HostTest_Result("mpu_calibration");
+}
@@ -0,0 +1,216 @@
+/* ReadIMUFifo (mpu9250_api.c built with USE_FIFO) against the simulated FIFO: frame parsing, partial drains,
+ * timestamp reconstruction back from the count read, overflow and torn frame recovery, drain throughput */
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "spi_api.h"
+#include "message_queue_api.h"
+#include "mpu9250_api.h"
+#include "timing_stats_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_spi.h"
+#include "host_mpu9250.h"
+#include "host_test.h"
+
+
+#define FIFO_MAX_FRAMES             (HOST_MPU_FIFO_SIZE / HOST_MPU_FIFO_FRAME_LENGTH)
+#define ACC_LSB_PER_MG              4.096f
+#define GYR_LSB_PER_DPS             32.8f
+#define THROUGHPUT_BATCHES          2000
+
+osThreadId controlTaskHandle;
+static sHostMpu_t g_Mpu;
+static uint32_t g_FramesPushed;
+
+
+/* Frame n carries n in every axis with a different sign and offset, so order and axis mix-ups show */
+static void PushFrames (unsigned int Count) {
+    for (unsigned int i = 0; i < Count; i++) {
+        int16_t n = (int16_t)g_FramesPushed++;
+        const int16_t Acc[3] = {n, (int16_t)-n, (int16_t)(n + 1000)};
+        const int16_t Gyr[3] = {(int16_t)(2 * n), (int16_t)(-2 * n), (int16_t)(n - 1000)};
+        HostMpu_FifoPush(&g_Mpu, Acc, Gyr);
+    }
+}
+
+static bool FrameMatches (const sImuData_t *Data, uint32_t n) {
+    return (fabsf(Data->A.X - (float)n / ACC_LSB_PER_MG) < 1e-3f) &&
+           (fabsf(Data->A.Y + (float)n / ACC_LSB_PER_MG) < 1e-3f) &&
+           (fabsf(Data->A.Z - (float)(n + 1000) / ACC_LSB_PER_MG) < 1e-3f) &&
+           (fabsf(Data->G.X - (float)(2 * n) / GYR_LSB_PER_DPS) < 1e-3f) &&
+           (fabsf(Data->G.Y + (float)(2 * n) / GYR_LSB_PER_DPS) < 1e-3f) &&
+           (fabsf(Data->G.Z - ((float)n - 1000.0f) / GYR_LSB_PER_DPS) < 1e-3f) &&
+           !Data->MagFresh;
+}
+
+static void ResetFifo (void) {
+    g_Mpu.FifoHead = 0;
+    g_Mpu.FifoLevel = 0;
+    g_Mpu.FifoOverflow = false;
+    g_FramesPushed = 0;
+}
+
+static void Setup (void) {
+    HostSpi_Reset();
+    HostMpu_Init(&g_Mpu);
+    HostMpu_Attach(&g_Mpu, SPI1, GPIOA, GPIO_PIN_4);
+    InitializeMessageQueues();
+    InitializeSpiMutexes();
+    InitializeSpiSlaves();
+    controlTaskHandle = xTaskGetCurrentTaskHandle();
+    CHECK(Mpu_Init());
+    /* FIFO takes accel and gyro, interrupt is off in FIFO mode */
+    CHECK(g_Mpu.Registers[0x23] == 0x78);
+    CHECK(g_Mpu.Registers[0x38] == 0x00);
+    CHECK(g_Mpu.Registers[0x6A] & 0x40);
+}
+
+static void TestDrain (void) {
+    sImuData_t Data[FIFO_MAX_FRAMES];
+    unsigned int Read = 0;
+    const uint32_t Period = UsToCycles(Mpu_GetSamplePeriodUs());
+    ResetFifo();
+    CHECK(ReadIMUFifo(Data, FIFO_MAX_FRAMES, &Read));
+    CHECK(Read == 0);
+
+    PushFrames(5);
+    uint32_t Transactions = g_Mpu.Transactions;
+    uint32_t Before = GetCycleCount();
+    CHECK(ReadIMUFifo(Data, FIFO_MAX_FRAMES, &Read));
+    uint32_t After = GetCycleCount();
+    CHECK(Read == 5);
+    /* Count read plus one burst for the whole batch */
+    CHECK(g_Mpu.Transactions - Transactions == 2);
+    CHECK(g_Mpu.LastLength == 5 * HOST_MPU_FIFO_FRAME_LENGTH);
+    CHECK(HostMpu_FifoCount(&g_Mpu) == 0);
+    for (unsigned int i = 0; i < Read; i++) {
+        CHECK(FrameMatches(&Data[i], i));
+    }
+    /* Newest frame is stamped at the count read, older ones one ODR period apart */
+    CHECK((Data[4].Timestamp - Before) <= (After - Before));
+    for (unsigned int i = 1; i < Read; i++) {
+        CHECK(Data[i].Timestamp - Data[i - 1].Timestamp == Period);
+    }
+}
+
+/* Caller takes fewer samples than queued: oldest come first and keep their place in time */
+static void TestPartialDrain (void) {
+    sImuData_t First[3];
+    sImuData_t Rest[FIFO_MAX_FRAMES];
+    unsigned int Read = 0;
+    const uint32_t Period = UsToCycles(Mpu_GetSamplePeriodUs());
+    ResetFifo();
+    PushFrames(7);
+    uint32_t Before = GetCycleCount();
+    CHECK(ReadIMUFifo(First, 3, &Read));
+    uint32_t After = GetCycleCount();
+    CHECK(Read == 3);
+    CHECK(HostMpu_FifoCount(&g_Mpu) == 4 * HOST_MPU_FIFO_FRAME_LENGTH);
+    /* Seven frames were queued at the count read, the third oldest is four periods before it */
+    CHECK(First[2].Timestamp + 4 * Period - Before <= After - Before);
+    CHECK(First[1].Timestamp + Period == First[2].Timestamp);
+    Before = GetCycleCount();
+    CHECK(ReadIMUFifo(Rest, FIFO_MAX_FRAMES, &Read));
+    After = GetCycleCount();
+    CHECK(Read == 4);
+    CHECK(Rest[3].Timestamp - Before <= After - Before);
+    for (unsigned int i = 0; i < 3; i++) {
+        CHECK(FrameMatches(&First[i], i));
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+        CHECK(FrameMatches(&Rest[i], 3 + i));
+    }
+}
+
+static void TestTimestampWrap (void) {
+    sImuData_t Data[FIFO_MAX_FRAMES];
+    unsigned int Read = 0;
+    const uint32_t Period = UsToCycles(Mpu_GetSamplePeriodUs());
+    ResetFifo();
+    PushFrames(FIFO_MAX_FRAMES);
+    HostDwt.CYCCNT = 1000;
+    CHECK(ReadIMUFifo(Data, FIFO_MAX_FRAMES, &Read));
+    CHECK(Read == FIFO_MAX_FRAMES);
+    CHECK(Data[0].Timestamp > 0x80000000u);
+    CHECK(Data[FIFO_MAX_FRAMES - 1].Timestamp < 0x10000u);
+    CHECK(Data[FIFO_MAX_FRAMES - 1].Timestamp - Data[0].Timestamp == (FIFO_MAX_FRAMES - 1) * Period);
+}
+
+static void TestOverflow (void) {
+    sImuData_t Data[FIFO_MAX_FRAMES];
+    unsigned int Read = 1;
+    ResetFifo();
+    unsigned int Overflows = Mpu_GetFifoOverflowCount();
+    uint32_t Resets = g_Mpu.FifoResets;
+    /* 50 frames do not fit, oldest bytes are overwritten and the count sticks at the size */
+    PushFrames(50);
+    CHECK(HostMpu_FifoCount(&g_Mpu) == HOST_MPU_FIFO_SIZE);
+    CHECK(!ReadIMUFifo(Data, FIFO_MAX_FRAMES, &Read));
+    CHECK(Read == 0);
+    CHECK(Mpu_GetFifoOverflowCount() == Overflows + 1);
+    CHECK(g_Mpu.FifoResets == Resets + 1);
+    CHECK(HostMpu_FifoCount(&g_Mpu) == 0);
+    /* FIFO stays enabled after the reset */
+    CHECK(g_Mpu.Registers[0x6A] & 0x40);
+    /* Clean frames after the reset are read normally */
+    g_FramesPushed = 0;
+    PushFrames(2);
+    CHECK(ReadIMUFifo(Data, FIFO_MAX_FRAMES, &Read));
+    CHECK((Read == 2) && FrameMatches(&Data[0], 0) && FrameMatches(&Data[1], 1));
+}
+
+/* Count that is not a whole number of frames means the boundary is lost */
+static void TestTornFrame (void) {
+    static const uint8_t Partial[5] = {1, 2, 3, 4, 5};
+    sImuData_t Data[FIFO_MAX_FRAMES];
+    unsigned int Read = 1;
+    ResetFifo();
+    unsigned int Overflows = Mpu_GetFifoOverflowCount();
+    PushFrames(5);
+    HostMpu_FifoPushBytes(&g_Mpu, Partial, sizeof(Partial));
+    uint32_t Transactions = g_Mpu.Transactions;
+    CHECK(!ReadIMUFifo(Data, FIFO_MAX_FRAMES, &Read));
+    CHECK(Read == 0);
+    CHECK(Mpu_GetFifoOverflowCount() == Overflows + 1);
+    /* Count read and reset, nothing drained */
+    CHECK(g_Mpu.Transactions - Transactions == 2);
+    CHECK(HostMpu_FifoCount(&g_Mpu) == 0);
+}
+
+static void TestThroughput (void) {
+    sImuData_t Data[FIFO_MAX_FRAMES];
+    unsigned int Read = 0;
+    unsigned int Samples = 0;
+    double Elapsed = 0.0;
+    bool Ok = true;
+    for (unsigned int Batch = 0; (Batch < THROUGHPUT_BATCHES) && Ok; Batch++) {
+        ResetFifo();
+        PushFrames(FIFO_MAX_FRAMES);
+        double Start = HostTest_NowNs();
+        Ok = ReadIMUFifo(Data, FIFO_MAX_FRAMES, &Read);
+        Elapsed += HostTest_NowNs() - Start;
+        Samples += Read;
+    }
+    CHECK(Ok);
+    CHECK(Samples == THROUGHPUT_BATCHES * FIFO_MAX_FRAMES);
+    printf("FIFO drain %u frames/batch: host %.1f ns/sample including bus model, 2 transactions/batch\n",
+           (unsigned int)FIFO_MAX_FRAMES, Elapsed / Samples);
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    Setup();
+    TestDrain();
+    TestPartialDrain();
+    TestTimestampWrap();
+    TestOverflow();
+    TestTornFrame();
+    TestThroughput();
+    CHECK(g_Mpu.FormatErrors == 0);
+    CHECK(HostRtos_GetCriticalNesting() == 0);
+    return HostTest_Result("mpu_fifo");
+}
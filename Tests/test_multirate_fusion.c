@@ -0,0 +1,155 @@
+/* multirate_fusion_api.c: the coning compensated integrator against a plain first order quaternion update on pure
+ * coning motion, and correction decimation against attitude error and cost on the bench_attitude_estimators stream */
+
+#include <stdio.h>
+#include <string.h>
+#include "multirate_fusion_api.h"
+#include "MahonyAHRS.h"
+#include "host_imu_stream.h"
+#include "host_test.h"
+
+
+#define CONING_RATE                 5.0f        // rad/s, amplitude of each rotating axis
+#define CONING_DT                   0.001f
+#define CONING_SAMPLES              10000
+#define CONING_SUBSTEPS             256
+#define STREAM_SAMPLES              30000
+#define SETTLE_SAMPLES              5000
+#define TIMING_RUNS                 5
+#define TILT_BUDGET                 0.1f        // deg RMS, what the stabilisation loop can tolerate
+#define DEG_TO_RAD                  0.0174532925f
+
+
+typedef struct {
+    unsigned int Decimation;
+    float TiltRms;
+    float NsPerSecond;
+} sDecimationResult_t;
+
+static sImuData_t Samples[STREAM_SAMPLES];
+static float Truth[STREAM_SAMPLES][4];
+static float TrueBias[3];
+
+
+static void Rotate (double Q[4], const double Rate[3], double Dt) {
+    double Angle = sqrt(Rate[0] * Rate[0] + Rate[1] * Rate[1] + Rate[2] * Rate[2]) * Dt;
+    double S = (Angle > 0.0) ? sin(0.5 * Angle) / Angle * Dt : 0.0;
+    double D[4] = {cos(0.5 * Angle), Rate[0] * S, Rate[1] * S, Rate[2] * S};
+    double P[4] = {Q[0], Q[1], Q[2], Q[3]};
+    Q[0] = P[0] * D[0] - P[1] * D[1] - P[2] * D[2] - P[3] * D[3];
+    Q[1] = P[0] * D[1] + P[1] * D[0] + P[2] * D[3] - P[3] * D[2];
+    Q[2] = P[0] * D[2] - P[1] * D[3] + P[2] * D[0] + P[3] * D[1];
+    Q[3] = P[0] * D[3] + P[1] * D[2] - P[2] * D[1] + P[3] * D[0];
+}
+
+/* Body rates rotating at CONING_FREQUENCY in the XY plane: no net rate on any axis, but the attitude drifts about Z.
+ * Gyro reports the mean rate over each sample period, as with the MPU9250 low pass filter set well above the motion. */
+static void TestConing (float Frequency) {
+    const double Omega = 2.0 * M_PI * Frequency;
+    double Q[4] = {1.0, 0.0, 0.0, 0.0};
+    sMultiRateFusion_t Fusion;
+    MahonyAHRS_t Mahony = MAHONY_AHRS_INITIALISER(0.0f, 0.0f);
+    MultiRateFusion_Init(&Fusion, 0.0f, 0.0f, 1);
+    for (unsigned int i = 0; i < CONING_SAMPLES; i++) {
+        double Start = i * (double)CONING_DT;
+        double End = Start + CONING_DT;
+        double Step = (double)CONING_DT / CONING_SUBSTEPS;
+        for (unsigned int j = 0; j < CONING_SUBSTEPS; j++) {
+            double t = Start + (j + 0.5) * Step;
+            double Rate[3] = {CONING_RATE * cos(Omega * t), CONING_RATE * sin(Omega * t), 0.0};
+            Rotate(Q, Rate, Step);
+        }
+        sData3D_t Gyro = {
+            (float)(CONING_RATE * (sin(Omega * End) - sin(Omega * Start)) / (Omega * CONING_DT)),
+            (float)(CONING_RATE * (cos(Omega * Start) - cos(Omega * End)) / (Omega * CONING_DT)),
+            0.0f
+        };
+        MultiRateFusion_Update(&Fusion, &Gyro, NULL, NULL, CONING_DT);
+        /* Zero accelerometer takes the gyro only branch */
+        MahonyAHRSupdateIMUInstance(&Mahony, Gyro.X, Gyro.Y, Gyro.Z, 0.0f, 0.0f, 0.0f, CONING_DT);
+    }
+    const float Final[4] = {(float)Q[0], (float)Q[1], (float)Q[2], (float)Q[3]};
+    const float Compensated[4] = {Fusion.Q[0], Fusion.Q[1], Fusion.Q[2], Fusion.Q[3]};
+    const float Plain[4] = {Mahony.q0, Mahony.q1, Mahony.q2, Mahony.q3};
+    float CompensatedError = HostImuStream_AngleError(Final, Compensated);
+    float PlainError = HostImuStream_AngleError(Final, Plain);
+    float Drift = (float)(2.0 * atan2(Q[3], Q[0]) / DEG_TO_RAD);
+    printf("  %3.0f Hz %5.2f %7.2f %7.3f %7.4f\n", (double)Frequency, CONING_RATE / Omega / DEG_TO_RAD, (double)Drift,
+           (double)PlainError, (double)CompensatedError);
+    CHECK(fabsf(Drift) > 1.0f);
+    CHECK(CompensatedError < PlainError);
+    /* Up to a tenth of the sample rate the compensation takes out most of the error */
+    if (Frequency * CONING_DT <= 0.1f) {
+        CHECK(CompensatedError < 0.1f * PlainError);
+    }
+}
+
+static void Record (void) {
+    sHostImuStream_t Stream;
+    HostImuStream_Init(&Stream);
+    for (unsigned int i = 0; i < STREAM_SAMPLES; i++) {
+        HostImuStream_Next(&Stream, &Samples[i]);
+        HostImuStream_GetTruth(&Stream, Truth[i]);
+    }
+    memcpy(TrueBias, Stream.GyroBias, sizeof(TrueBias));
+}
+
+/* Gyro bias is removed as GyroBias does on target, no magnetometer as on the FIFO path. Starts from truth so the
+ * result is the decimation alone, without boot alignment. */
+static void RunDecimation (sDecimationResult_t *Result) {
+    sMultiRateFusion_t Fusion;
+    double TiltSq = 0.0;
+    double Best = 0.0;
+    for (unsigned int Run = 0; Run < TIMING_RUNS; Run++) {
+        MultiRateFusion_Init(&Fusion, 1.0f, 0.0f, Result->Decimation);
+        memcpy(Fusion.Q, Truth[0], sizeof(Fusion.Q));
+        double Start = HostTest_NowNs();
+        for (unsigned int i = 0; i < STREAM_SAMPLES; i++) {
+            const sImuData_t *S = &Samples[i];
+            sData3D_t Gyro = {(S->G.X - TrueBias[0]) * DEG_TO_RAD, (S->G.Y - TrueBias[1]) * DEG_TO_RAD, (S->G.Z - TrueBias[2]) * DEG_TO_RAD};
+            MultiRateFusion_Update(&Fusion, &Gyro, &S->A, NULL, 0.001f);
+            if ((Run == 0) && (i >= SETTLE_SAMPLES)) {
+                float Tilt = HostImuStream_TiltError(Truth[i], Fusion.Q);
+                TiltSq += (double)Tilt * Tilt;
+            }
+        }
+        double Elapsed = HostTest_NowNs() - Start;
+        if ((Run == 0) || (Elapsed < Best)) {
+            Best = Elapsed;
+        }
+    }
+    Result->TiltRms = (float)sqrt(TiltSq / (STREAM_SAMPLES - SETTLE_SAMPLES));
+    Result->NsPerSecond = (float)(Best / (STREAM_SAMPLES * 0.001));
+}
+
+static void TestDecimation (void) {
+    sDecimationResult_t Results[] = {{1, 0, 0}, {2, 0, 0}, {5, 0, 0}, {10, 0, 0}, {20, 0, 0}, {50, 0, 0}};
+    const unsigned int Count = sizeof(Results) / sizeof(Results[0]);
+    printf("Decimation at 1 kHz, bias removed, no magnetometer: tilt RMS in deg, host us of fusion per second of data\n");
+    for (unsigned int i = 0; i < Count; i++) {
+        RunDecimation(&Results[i]);
+        printf("  %2u (%4.0f Hz correction) %7.3f %9.1f\n", Results[i].Decimation, 1000.0 / Results[i].Decimation,
+               (double)Results[i].TiltRms, Results[i].NsPerSecond * 1e-3);
+        CHECK(isfinite(Results[i].TiltRms));
+        if (Results[i].Decimation <= 10) {
+            CHECK(Results[i].TiltRms < TILT_BUDGET);
+        }
+    }
+    /* Error grows with decimation and cost falls, the budget decides where to stop */
+    CHECK(Results[Count - 1].TiltRms > Results[0].TiltRms);
+    CHECK(Results[3].NsPerSecond < Results[0].NsPerSecond);
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    printf("Coning, %.0f s at %.0f Hz: frequency, half angle, true drift, error plain, error compensated in deg\n",
+           CONING_SAMPLES * (double)CONING_DT, 1.0 / CONING_DT);
+    TestConing(20.0f);
+    TestConing(50.0f);
+    TestConing(100.0f);
+    TestConing(200.0f);
+    Record();
+    TestDecimation();
+    return HostTest_Result("multirate_fusion");
+}
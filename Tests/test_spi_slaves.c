@@ -0,0 +1,176 @@
+/* Two slaves on separate buses with different settings: MPU9250 on SPI1 (8-bit, mode 0, 9 MHz) and an AS5048A chain
+ * on SPI2 (16-bit, mode 1, 9 MHz). Transactions alternate and also nest, an encoder read taking the CPU in the middle
+ * of an IMU burst, the way the control loop can preempt a lower priority task on the other bus. */
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "stm32f3xx_ll_spi.h"
+#include "spi_api.h"
+#include "message_queue_api.h"
+#include "mpu9250_api.h"
+#include "encoder_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_spi.h"
+#include "host_mpu9250.h"
+#include "host_as5048.h"
+#include "host_test.h"
+
+
+#define ACC_LSB_PER_MG              4.096f
+#define INTERLEAVED_ROUNDS          100
+#define PREEMPT_AT_FRAME            10
+
+osThreadId controlTaskHandle;
+static sHostMpu_t g_Mpu;
+static sHostAs5048_t g_Chain;
+
+/* Chain position of each motor, mirrors encoder_api.c */
+static const unsigned int g_Position[eMotor_Last] = {2, 1, 0};
+
+static unsigned int g_FramesIntoImuRead;
+static bool g_PreemptDone;
+static bool g_PreemptOk;
+static uint32_t g_ImuCsDuringPreempt;
+static uint32_t g_ImuCr1BeforePreempt;
+static uint32_t g_ImuCr2BeforePreempt;
+static sEncoderSample_t g_PreemptSamples[eMotor_Last];
+static bool g_NestedImuAccessOk;
+
+
+static sHostAs5048Device_t *MotorDevice (eMotor_t Motor) {
+    return &g_Chain.Device[g_Chain.Count - 1 - g_Position[Motor]];
+}
+
+static void SetImuSample (int16_t Value) {
+    const int16_t Acc[3] = {Value, (int16_t)(Value + 1), (int16_t)(Value + 2)};
+    const int16_t Gyr[3] = {0, 0, 0};
+    const int16_t Mag[3] = {0, 0, 0};
+    HostMpu_SetSample(&g_Mpu, Acc, Gyr, Mag, false, false);
+}
+
+static void SetAngles (uint16_t Base) {
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        MotorDevice(Motor)->Angle = (uint16_t)((Base + 1000 * Motor) & 0x3FFF);
+    }
+}
+
+static void Setup (void) {
+    HostSpi_Reset();
+    HostMpu_Init(&g_Mpu);
+    HostMpu_Attach(&g_Mpu, SPI1, GPIOA, GPIO_PIN_4);
+    HostAs5048_Init(&g_Chain, eMotor_Last);
+    HostAs5048_Attach(&g_Chain, SPI2, GPIOB, GPIO_PIN_12);
+    SetAngles(100);
+    InitializeMessageQueues();
+    InitializeSpiMutexes();
+    InitializeSpiSlaves();
+    controlTaskHandle = xTaskGetCurrentTaskHandle();
+    CHECK(Mpu_Init());
+    CHECK(Encoder_Init());
+}
+
+/* Encoder read returns the angle latched by the previous read */
+static bool EncoderReadMatches (const sEncoderSample_t Samples[eMotor_Last], uint16_t Base) {
+    bool RetVal = true;
+    for (eMotor_t Motor = eMotor_First; Motor < eMotor_Last; Motor++) {
+        RetVal = RetVal && Samples[Motor].Valid && (Samples[Motor].Raw == ((Base + 1000 * Motor) & 0x3FFF));
+    }
+    return RetVal;
+}
+
+static void TestInterleaved (void) {
+    sImuData_t Imu;
+    sEncoderSample_t Samples[eMotor_Last];
+    bool ImuOk = true;
+    bool EncoderOk = true;
+    uint16_t Previous = 100;
+    for (unsigned int i = 0; i < INTERLEAVED_ROUNDS; i++) {
+        uint16_t Base = (uint16_t)(200 + 37 * i);
+        SetImuSample((int16_t)(i * 3));
+        ImuOk = ImuOk && ReadIMU(&Imu) && (fabsf(Imu.A.Y - (float)(i * 3 + 1) / ACC_LSB_PER_MG) < 1e-3f);
+        SetAngles(Base);
+        EncoderOk = EncoderOk && Encoder_Read(Samples) && EncoderReadMatches(Samples, Previous);
+        Previous = Base;
+    }
+    CHECK(ImuOk);
+    CHECK(EncoderOk);
+}
+
+/* Runs after every frame on either bus: a few frames into the IMU burst, the encoder read takes the CPU */
+static void PreemptHook (SPI_TypeDef *Spi) {
+    if ((Spi == SPI1) && !g_PreemptDone && (g_Mpu.LastStartAddress == 0x3B) && (++g_FramesIntoImuRead == PREEMPT_AT_FRAME)) {
+        uint8_t Value = 0;
+        g_PreemptDone = true;
+        g_ImuCsDuringPreempt = HostGpio[0].ODR & GPIO_PIN_4;
+        g_ImuCr1BeforePreempt = SPI1->CR1;
+        g_ImuCr2BeforePreempt = SPI1->CR2;
+        g_PreemptOk = Encoder_Read(g_PreemptSamples);
+        /* IMU bus is held by the interrupted burst, a second IMU access has to wait for it */
+        g_NestedImuAccessOk = SpiReadSlaveRegister(&Value, 0x75, eSpiSlave_MPU);
+        g_PreemptOk = g_PreemptOk && (SPI1->CR1 == g_ImuCr1BeforePreempt) && (SPI1->CR2 == g_ImuCr2BeforePreempt);
+    }
+}
+
+static void TestPreempted (void) {
+    sImuData_t Imu;
+    sEncoderSample_t Samples[eMotor_Last];
+    sSpiStats_t Spi1;
+    sSpiStats_t Spi2;
+    CHECK(Encoder_Read(Samples));
+    SetAngles(3000);
+    CHECK(Encoder_Read(Samples));
+    SetAngles(4000);
+    SetImuSample(-1234);
+    SpiResetStats(eSpi_1);
+    SpiResetStats(eSpi_2);
+    g_Mpu.LastStartAddress = 0;
+    HostSpi_SetFrameHook(PreemptHook);
+    CHECK(ReadIMU(&Imu));
+    HostSpi_SetFrameHook(NULL);
+    CHECK(g_PreemptDone);
+    CHECK(g_PreemptOk);
+    /* IMU chip select stayed asserted and its bus settings untouched while SPI2 ran */
+    CHECK(g_ImuCsDuringPreempt == 0);
+    CHECK((g_ImuCr2BeforePreempt & SPI_CR2_DS) == LL_SPI_DATAWIDTH_8BIT);
+    CHECK(EncoderReadMatches(g_PreemptSamples, 3000));
+    CHECK_NEAR(Imu.A.X, -1234 / ACC_LSB_PER_MG, 1e-3);
+    CHECK_NEAR(Imu.A.Z, -1232 / ACC_LSB_PER_MG, 1e-3);
+    CHECK(!g_NestedImuAccessOk);
+    CHECK(SpiGetStats(eSpi_1, &Spi1));
+    CHECK(SpiGetStats(eSpi_2, &Spi2));
+    CHECK(Spi1.MutexAcquisitions == 1);
+    CHECK(Spi1.MutexTimeouts == 1);
+    CHECK(Spi2.MutexAcquisitions == 1);
+    CHECK(Spi2.MutexTimeouts == 0);
+    CHECK(Spi2.BytesTransferred == 2 * eMotor_Last);
+}
+
+static void TestFormats (void) {
+    sHostSpiStats_t Bus;
+    CHECK(g_Mpu.FormatErrors == 0);
+    CHECK(g_Chain.FormatErrors == 0);
+    CHECK(g_Chain.LengthErrors == 0);
+    for (SPI_TypeDef *Spi = SPI1; Spi <= SPI2; Spi++) {
+        CHECK(HostSpi_GetStats(Spi, &Bus));
+        CHECK(Bus.ConfigWritesWhileEnabled == 0);
+        CHECK(Bus.OverlappingSelects == 0);
+        CHECK(Bus.UnselectedFrames == 0);
+    }
+    /* Both buses are left disabled between transactions */
+    CHECK(!(SPI1->CR1 & SPI_CR1_SPE));
+    CHECK(!(SPI2->CR1 & SPI_CR1_SPE));
+    CHECK(HostRtos_GetCriticalNesting() == 0);
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    Setup();
+    TestInterleaved();
+    TestPreempted();
+    TestFormats();
+    return HostTest_Result("spi_slaves");
+}
@@ -0,0 +1,193 @@
+/* Bus counters of spi_api.c against a simulated bus: register file slave on SPI1, 16-bit echo slave on SPI2 */
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "spi_api.h"
+#include "message_queue_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_spi.h"
+#include "host_test.h"
+
+
+/* Mirrors spi_api.c */
+#define SPI_DMA_TIMEOUT             10
+#define SPI_MUTEX_TIMEOUT           (3 * SPI_DMA_TIMEOUT)
+
+/* First byte of a frame is the address with read bit, following bytes auto-increment */
+typedef struct {
+    uint8_t Registers[256];
+    uint8_t Address;
+    bool Read;
+    unsigned int Position;
+} sRegisterSlave_t;
+
+static sRegisterSlave_t g_RegisterSlave;
+static uint16_t g_EchoLast;
+
+static void RegisterSlaveSelect (void *Context, bool Selected) {
+    sRegisterSlave_t *Slave = Context;
+    if (Selected) {
+        Slave->Position = 0;
+    }
+}
+
+static uint16_t RegisterSlaveExchange (void *Context, uint16_t Mosi, const sHostSpiFormat_t *Format) {
+    sRegisterSlave_t *Slave = Context;
+    uint16_t Miso = 0;
+    (void)Format;
+    if (Slave->Position == 0) {
+        Slave->Read = (Mosi & 0x80) != 0;
+        Slave->Address = Mosi & 0x7F;
+    } else if (Slave->Read) {
+        Miso = Slave->Registers[Slave->Address++];
+    } else {
+        Slave->Registers[Slave->Address++] = (uint8_t)Mosi;
+    }
+    Slave->Position++;
+    return Miso;
+}
+
+/* Answers each frame with the previous one inverted */
+static uint16_t EchoSlaveExchange (void *Context, uint16_t Mosi, const sHostSpiFormat_t *Format) {
+    uint16_t Miso = (uint16_t)~g_EchoLast;
+    (void)Context;
+    (void)Format;
+    g_EchoLast = Mosi;
+    return Miso;
+}
+
+static void Setup (void) {
+    const sHostSpiSlave_t Register = { SPI1, GPIOA, GPIO_PIN_4, RegisterSlaveSelect, RegisterSlaveExchange, &g_RegisterSlave };
+    const sHostSpiSlave_t Echo = { SPI2, GPIOB, GPIO_PIN_12, NULL, EchoSlaveExchange, NULL };
+    HostSpi_Reset();
+    HostSpi_Attach(&Register);
+    HostSpi_Attach(&Echo);
+    InitializeMessageQueues();
+    InitializeSpiMutexes();
+    InitializeSpiSlaves();
+    for (unsigned int i = 0; i < 256; i++) {
+        g_RegisterSlave.Registers[i] = (uint8_t)(i ^ 0x5A);
+    }
+}
+
+static void TestCounters (void) {
+    sSpiStats_t Stats;
+    uint8_t Buffer[4] = {0};
+    CHECK(SpiResetStats(eSpi_1));
+    CHECK(SpiReadSlaveRegisters(eSpiSlave_MPU, 0x10, Buffer, sizeof(Buffer)));
+    CHECK((Buffer[0] == (0x10 ^ 0x5A)) && (Buffer[3] == (0x13 ^ 0x5A)));
+    CHECK(SpiGetStats(eSpi_1, &Stats));
+    CHECK(Stats.BytesTransferred == 5);
+    CHECK(Stats.CsToggles == 2);
+    CHECK(Stats.MutexAcquisitions == 1);
+    CHECK(Stats.TransferErrors == 0);
+    CHECK(Stats.MutexTimeouts == 0);
+
+    /* Write with read-back is two transactions */
+    CHECK(SpiWriteSlaveRegister(0xA5, 0x20, eSpiSlave_MPU));
+    CHECK(g_RegisterSlave.Registers[0x20] == 0xA5);
+    CHECK(SpiGetStats(eSpi_1, &Stats));
+    CHECK(Stats.BytesTransferred == 5 + 2 + 2);
+    CHECK(Stats.CsToggles == 6);
+    CHECK(Stats.MutexAcquisitions == 3);
+
+    CHECK(!SpiGetStats(eSpi_Last, &Stats));
+    CHECK(!SpiGetStats(eSpi_1, NULL));
+}
+
+static void TestWideFrames (void) {
+    sSpiStats_t Stats;
+    uint8_t Tx[4] = {0x34, 0x12, 0x78, 0x56};
+    uint8_t Rx[4] = {0};
+    CHECK(SpiResetStats(eSpi_2));
+    g_EchoLast = 0xFFFF;
+    CHECK(SpiTransferSlave(eSpiSlave_Encoder, Tx, Rx, sizeof(Tx)));
+    /* Second frame answers with the first one inverted, frames are little endian halfwords in memory */
+    CHECK((Rx[0] == 0x00) && (Rx[1] == 0x00) && (Rx[2] == 0xCB) && (Rx[3] == 0xED));
+    /* Odd byte count cannot be clocked as 16-bit frames */
+    CHECK(!SpiTransferSlave(eSpiSlave_Encoder, Tx, Rx, 3));
+    CHECK(SpiGetStats(eSpi_2, &Stats));
+    CHECK(Stats.BytesTransferred == 7);
+    CHECK(Stats.TransferErrors == 1);
+    CHECK(Stats.CsToggles == 4);
+}
+
+static void TestDmaTimeout (void) {
+    sSpiStats_t Stats;
+    uint8_t Buffer[2] = {0};
+    CHECK(SpiResetStats(eSpi_1));
+    TickType_t Start = xTaskGetTickCount();
+    HostSpi_DropDmaCompletions(1);
+    CHECK(!SpiReadSlaveRegisters(eSpiSlave_MPU, 0x30, Buffer, sizeof(Buffer)));
+    /* Command byte completion was lost, data phase is not started */
+    CHECK(xTaskGetTickCount() - Start == SPI_DMA_TIMEOUT);
+    CHECK(SpiGetStats(eSpi_1, &Stats));
+    CHECK(Stats.TransferErrors == 1);
+    CHECK(Stats.BytesTransferred == 1);
+    CHECK(Stats.CsToggles == 2);
+    /* Late completion must not be taken for the next transfer */
+    CHECK(SpiReadSlaveRegisters(eSpiSlave_MPU, 0x30, Buffer, sizeof(Buffer)));
+    CHECK((Buffer[0] == (0x30 ^ 0x5A)) && (Buffer[1] == (0x31 ^ 0x5A)));
+    CHECK(SpiGetStats(eSpi_1, &Stats));
+    CHECK(Stats.TransferErrors == 1);
+}
+
+static void TestMutexTimeout (void) {
+    sSpiStats_t Stats;
+    sHostSpiStats_t BusStats;
+    uint8_t Buffer = 0;
+    CHECK(SpiResetStats(eSpi_1));
+    CHECK(HostSpi_GetStats(SPI1, &BusStats));
+    uint32_t Frames = BusStats.Frames;
+    TickType_t Start = xTaskGetTickCount();
+    HostRtos_SetMutexesBusy(true);
+    CHECK(!SpiReadSlaveRegister(&Buffer, 0x00, eSpiSlave_MPU));
+    CHECK(!SpiWriteSlaveRegisters(eSpiSlave_MPU, 0x00, &Buffer, 1));
+    HostRtos_SetMutexesBusy(false);
+    CHECK(xTaskGetTickCount() - Start == 2 * SPI_MUTEX_TIMEOUT);
+    CHECK(SpiGetStats(eSpi_1, &Stats));
+    CHECK(Stats.MutexTimeouts == 2);
+    CHECK(Stats.MutexAcquisitions == 0);
+    CHECK(Stats.CsToggles == 0);
+    CHECK(Stats.BytesTransferred == 0);
+    /* Bus was not touched */
+    CHECK(HostSpi_GetStats(SPI1, &BusStats));
+    CHECK(BusStats.Frames == Frames);
+
+    HostHal_CaptureStart();
+    SpiPrintStats(eSpi_1);
+    CHECK(strcmp(HostHal_CaptureGet(), "SPI1 bytes=0 cs=0 mutex=0 err=0 timeout=2\n") == 0);
+    HostHal_CaptureStop();
+    CHECK(SpiResetStats(eSpi_1));
+    CHECK(SpiGetStats(eSpi_1, &Stats));
+    CHECK(Stats.MutexTimeouts == 0);
+}
+
+static void TestBusDiscipline (void) {
+    sHostSpiStats_t BusStats;
+    for (SPI_TypeDef *Spi = SPI1; Spi <= SPI2; Spi++) {
+        CHECK(HostSpi_GetStats(Spi, &BusStats));
+        CHECK(BusStats.Frames > 0);
+        CHECK(BusStats.UnselectedFrames == 0);
+        CHECK(BusStats.OverlappingSelects == 0);
+        CHECK(BusStats.ConfigWritesWhileEnabled == 0);
+        CHECK(BusStats.DmaTransfers > 0);
+    }
+    CHECK(HostRtos_GetCriticalNesting() == 0);
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    Setup();
+    TestCounters();
+    TestWideFrames();
+    TestDmaTimeout();
+    TestMutexTimeout();
+    TestBusDiscipline();
+    return HostTest_Result("spi_stats");
+}
@@ -0,0 +1,104 @@
+/* Histogram binning and loop deadline accounting of timing_stats_api.c, driven with made-up cycle stamps */
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "timing_stats_api.h"
+#include "host_hal.h"
+#include "host_rtos.h"
+#include "host_test.h"
+
+
+static void TestConversions (void) {
+    HostDwt.CYCCNT = 1234;
+    InitializeCycleCounter();
+    CHECK(HostCoreDebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+    CHECK(HostDwt.CTRL & DWT_CTRL_CYCCNTENA_Msk);
+    CHECK(GetCycleCount() == 0);
+    HostHal_AdvanceCycles(720);
+    CHECK(GetCycleCount() == 720);
+    CHECK(CyclesToUs(72000) == 1000);
+    CHECK(CyclesToUs(71) == 0);
+    CHECK(UsToCycles(5) == 360);
+    CHECK_NEAR(CyclesToSeconds(36000000), 0.5, 1e-6);
+}
+
+static void TestHistogram (void) {
+    sTimingHistogram_t Snapshot;
+    CHECK(!TimingHistogramAdd(eTimingHistogram_Last, 1));
+    CHECK(!TimingHistogramGet(eTimingHistogram_SampleJitter, NULL));
+    CHECK(TimingHistogramReset(eTimingHistogram_SampleJitter));
+    /* JIT bins are 5 us wide, anything past the last bin is clamped into it */
+    CHECK(TimingHistogramAdd(eTimingHistogram_SampleJitter, 7));
+    CHECK(TimingHistogramAdd(eTimingHistogram_SampleJitter, 0));
+    CHECK(TimingHistogramAdd(eTimingHistogram_SampleJitter, 4));
+    CHECK(TimingHistogramAdd(eTimingHistogram_SampleJitter, 500));
+    CHECK(TimingHistogramGet(eTimingHistogram_SampleJitter, &Snapshot));
+    CHECK(Snapshot.Count == 4);
+    CHECK(Snapshot.MinUs == 0);
+    CHECK(Snapshot.MaxUs == 500);
+    CHECK(Snapshot.SumUs == 511);
+    CHECK(Snapshot.Bins[0] == 2);
+    CHECK(Snapshot.Bins[1] == 1);
+    CHECK(Snapshot.Bins[TIMING_HISTOGRAM_BINS - 1] == 1);
+    /* Other histograms are untouched */
+    CHECK(TimingHistogramGet(eTimingHistogram_SampleLatency, &Snapshot));
+    CHECK(Snapshot.Count == 0);
+
+    HostHal_CaptureStart();
+    TimingHistogramPrint(eTimingHistogram_SampleJitter);
+    CHECK(strcmp(HostHal_CaptureGet(), "JIT[5us/bin] n=4 min=0 avg=127 max=500 | 2 1 0 0 0 0 0 0 0 0 0 0 0 0 0 1\n") == 0);
+    HostHal_CaptureStop();
+
+    CHECK(TimingHistogramReset(eTimingHistogram_SampleJitter));
+    CHECK(TimingHistogramGet(eTimingHistogram_SampleJitter, &Snapshot));
+    CHECK((Snapshot.Count == 0) && (Snapshot.MaxUs == 0) && (Snapshot.Bins[0] == 0));
+}
+
+static void TestLoopStats (void) {
+    const uint32_t PeriodUs = 1000;
+    sLoopStats_t Stats;
+    sTimingHistogram_t Cost;
+    LoopStatsReset();
+    /* On time: starts 10 us after trigger, runs 500 us */
+    uint32_t Trigger = 1000;
+    LoopStatsRecord(Trigger, Trigger + UsToCycles(10), Trigger + UsToCycles(510), PeriodUs, 0);
+    /* Overruns the period, start stamp taken across counter wrap */
+    Trigger = 0xFFFFFFFFu - UsToCycles(5);
+    LoopStatsRecord(Trigger, Trigger + UsToCycles(40), Trigger + UsToCycles(1100), PeriodUs, 0);
+    /* Short but a trigger was missed while the previous period ran */
+    Trigger = 5000000;
+    LoopStatsRecord(Trigger, Trigger + UsToCycles(20), Trigger + UsToCycles(220), PeriodUs, 2);
+    CHECK(LoopStatsGet(&Stats));
+    CHECK(Stats.Periods == 3);
+    CHECK(Stats.DeadlineMisses == 2);
+    CHECK(Stats.SkippedPeriods == 2);
+    CHECK(Stats.LastExecutionUs == 200);
+    CHECK(Stats.MaxExecutionUs == 1060);
+    CHECK(Stats.LastStartJitterUs == 20);
+    CHECK(Stats.MaxStartJitterUs == 40);
+    CHECK(TimingHistogramGet(eTimingHistogram_ControlCost, &Cost));
+    CHECK(Cost.Count == 3);
+
+    HostHal_CaptureStart();
+    LoopStatsPrint();
+    CHECK(strcmp(HostHal_CaptureGet(), "LOOP n=3 miss=2 skip=2 exec=200/1060us jit=20/40us\n") == 0);
+    HostHal_CaptureStop();
+
+    LoopStatsReset();
+    CHECK(LoopStatsGet(&Stats));
+    CHECK((Stats.Periods == 0) && (Stats.MaxExecutionUs == 0));
+    CHECK(TimingHistogramGet(eTimingHistogram_ControlCost, &Cost));
+    CHECK(Cost.Count == 0);
+    CHECK(!LoopStatsGet(NULL));
+}
+
+int TestMain (int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    TestConversions();
+    TestHistogram();
+    TestLoopStats();
+    CHECK(HostRtos_GetCriticalNesting() == 0);
+    return HostTest_Result("timing_stats");
+}